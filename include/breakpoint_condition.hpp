@@ -0,0 +1,114 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sdb {
+
+    class Registers;
+    class MemoryCache;
+
+    // A breakpoint condition such as "rdi == 0x1234 and [rsi+8] > 100",
+    // compiled once into bytecode for a small stack machine so a hit is
+    // checked against the cached registers without a round trip through
+    // the REPL.
+    //
+    // Operands are integer literals, general purpose registers, hits (the
+    // number of hits so far, this one included) and memory, written
+    // [address] for 8 bytes or prefixed with byte, word or dword. Operators
+    // from lowest to highest precedence are or, and, not, the comparisons,
+    // |, ^, &, + and -, with parentheses to group. Comparisons are signed.
+    class BreakpointCondition {
+      public:
+        enum struct Op : std::uint8_t {
+            Constant,
+            Register,
+            Load,
+            HitCount,
+            Add,
+            Subtract,
+            BitAnd,
+            BitOr,
+            BitXor,
+            Equal,
+            NotEqual,
+            Less,
+            LessEqual,
+            Greater,
+            GreaterEqual,
+            Not,
+            Negate,
+            // Jump over the right operand of and/or when the left one
+            // decides the result, leaving it on the stack
+            JumpIfFalse,
+            JumpIfTrue,
+            ToBool
+        };
+
+        struct Instruction {
+            Op theOp;
+
+            // Bytes to load
+            std::uint8_t theSize{0};
+
+            // The constant, the index of the register in g_register_infos
+            // or the target of a jump
+            std::uint64_t theOperand{0};
+
+            bool operator==(const Instruction& other) const = default;
+        };
+
+        // Throws an Error describing the first problem in the text
+        static BreakpointCondition compile(std::string_view aText);
+
+        // Counts the hit and returns whether the process should stop.
+        // Memory that cannot be read stops it, so the user can see why.
+        bool evaluate(const Registers& aRegisters, MemoryCache& aMemory);
+
+        const std::string& getText() const {
+            return theText;
+        }
+
+        std::span<const Instruction> getCode() const {
+            return theCode;
+        }
+
+        std::uint64_t getNumHits() const {
+            return theNumHits;
+        }
+
+        std::uint64_t getNumTrue() const {
+            return theNumTrue;
+        }
+
+        std::uint64_t getNumFalse() const {
+            return theNumFalse;
+        }
+
+        // Time spent evaluating over all hits
+        std::chrono::steady_clock::duration getTotalTime() const {
+            return theTotalTime;
+        }
+
+      private:
+        BreakpointCondition(std::string aText, std::vector<Instruction> aCode)
+            : theText{std::move(aText)}, theCode{std::move(aCode)} {
+        }
+
+        std::string theText;
+        std::vector<Instruction> theCode;
+
+        // Reused between hits so evaluating never allocates
+        std::vector<std::uint64_t> theStack;
+
+        std::uint64_t theNumHits{0};
+        std::uint64_t theNumTrue{0};
+        std::uint64_t theNumFalse{0};
+        std::chrono::steady_clock::duration theTotalTime{};
+    };
+
+} // namespace sdb
@@ -1,7 +1,13 @@
 #pragma once
 
+#include <breakpoint_condition.hpp>
+#include <chrono>
 #include <cstdint>
 #include <fmt/format.h>
+#include <functional>
+#include <native_condition.hpp>
+#include <optional>
+#include <span>
 #include <types.hpp>
 
 #include <sys/ptrace.h>
@@ -33,9 +39,19 @@ namespace sdb {
 
         using IdTypeT = BreakpointSiteId;
 
-        BreakpointSite(Process& aProcess, VirtualAddress anAddress)
+        // Called when the process stops at the site. Returning true resumes
+        // the process without reporting the stop.
+        using HitHandler = std::function<bool()>;
+
+        // Called once the process was resumed from a stop the hit handler
+        // handled, with the time from the stop until the resume
+        using ResumeHandler =
+            std::function<void(std::chrono::steady_clock::duration)>;
+
+        BreakpointSite(Process& aProcess, VirtualAddress anAddress,
+                       bool anIsInternal = false)
             : theProcess{aProcess}, theAddress{anAddress},
-              theSavedData{}, theId{getNextId()} {
+              theSavedData{}, theId{getNextId()}, theIsInternal{anIsInternal} {
         }
 
         BreakpointSite() = delete;
@@ -50,10 +66,72 @@ namespace sdb {
         void disable();
         bool isEnabled() const;
 
+        // Enables many sites of one process at once. Sites close together
+        // are read in one go and written back in one go, instead of with a
+        // peek and a poke each, so hundreds of PLT stubs take a few system
+        // calls.
+        static void enableAll(std::span<BreakpointSite* const> aSites);
+
         IdTypeT getId() const;
         VirtualAddress getAddress() const;
         std::byte getSavedData() const;
 
+        // The bytes under the jump while a native condition is enabled,
+        // which may cover more than one instruction
+        std::span<const std::byte> getSavedCode() const {
+            if (!theEnabled or !theNativeCondition) {
+                return {};
+            }
+            return theNativeCondition->getDisplaced().theOriginal;
+        }
+
+        // Internal sites are set by sdb itself and hidden from the user
+        bool isInternal() const {
+            return theIsInternal;
+        }
+
+        void setHitHandler(HitHandler aHandler) {
+            theHitHandler = std::move(aHandler);
+        }
+
+        const HitHandler& getHitHandler() const {
+            return theHitHandler;
+        }
+
+        void setResumeHandler(ResumeHandler aHandler) {
+            theResumeHandler = std::move(aHandler);
+        }
+
+        const ResumeHandler& getResumeHandler() const {
+            return theResumeHandler;
+        }
+
+        // Hits where the condition is false resume the process at once.
+        // The site goes back to an int3 if it had a native condition.
+        void setCondition(std::optional<BreakpointCondition> aCondition);
+
+        // Patches the site with a jump to the condition compiled to native
+        // code, so hits where it is false never stop the process. Throws,
+        // leaving the site as it was, if the condition or the code at the
+        // site cannot be handled that way.
+        void setNativeCondition(BreakpointCondition aCondition);
+
+        BreakpointCondition* getCondition() {
+            return theCondition ? &*theCondition : nullptr;
+        }
+
+        const BreakpointCondition* getCondition() const {
+            return theCondition ? &*theCondition : nullptr;
+        }
+
+        NativeCondition* getNativeCondition() {
+            return theNativeCondition ? &*theNativeCondition : nullptr;
+        }
+
+        const NativeCondition* getNativeCondition() const {
+            return theNativeCondition ? &*theNativeCondition : nullptr;
+        }
+
       private:
         bool theEnabled{false};
 
@@ -61,6 +139,13 @@ namespace sdb {
         VirtualAddress theAddress;
         std::byte theSavedData;
         BreakpointSiteId theId;
+        bool theIsInternal;
+        HitHandler theHitHandler;
+        ResumeHandler theResumeHandler;
+        std::optional<BreakpointCondition> theCondition;
+
+        // Evaluated in the process instead of theCondition when set
+        std::optional<NativeCondition> theNativeCondition;
 
         std::uint64_t getDataAtAddress();
         void putDataAtAddress(std::uint64_t myDataToWrite);
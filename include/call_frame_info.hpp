@@ -0,0 +1,136 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace sdb {
+
+    class DwarfCursor;
+    class ElfFile;
+
+    // How to recover a register of the calling frame
+    struct RegisterRule {
+        enum class Kind : std::uint8_t {
+            Undefined,
+            SameValue,
+            // Saved at CFA + theValue
+            Offset,
+            // Equal to CFA + theValue
+            ValueOffset,
+            // Held in register theValue
+            Register,
+        };
+
+        Kind theKind{Kind::Undefined};
+        std::int64_t theValue{0};
+
+        bool operator==(const RegisterRule& other) const = default;
+    };
+
+    // One row of the call frame table: the rules in effect from theLocation
+    // up to the next row's location
+    struct CfiRow {
+        // DWARF numbers 0-15 are the general purpose registers, 16 is the
+        // return address
+        static constexpr std::size_t NUM_REGISTERS{17};
+        static constexpr std::size_t RBP{6};
+        static constexpr std::size_t RSP{7};
+        static constexpr std::size_t RETURN_ADDRESS{16};
+
+        std::uint64_t theLocation{0};
+
+        // The CFA is theCfaRegister + theCfaOffset. A negative register
+        // marks a CFA computed by an expression, which is not supported.
+        std::int32_t theCfaRegister{-1};
+        std::int64_t theCfaOffset{0};
+
+        std::array<RegisterRule, NUM_REGISTERS> theRules{};
+
+        // Whether the row describes a standard frame pointer frame, where
+        // the caller's rbp and return address are at [rbp] and [rbp + 8]
+        bool isFramePointerFrame() const;
+    };
+
+    // Unwind tables from .eh_frame, located through the binary search table
+    // in .eh_frame_hdr when present. Each FDE's rows are computed the first
+    // time it is needed and cached, so repeated unwinds through the same
+    // functions only do a lookup.
+    class CallFrameInfo {
+      public:
+        explicit CallFrameInfo(const ElfFile& anElf);
+
+        CallFrameInfo(const CallFrameInfo& other) = delete;
+        CallFrameInfo& operator=(const CallFrameInfo& other) = delete;
+
+        bool hasUnwindInfo() const {
+            return !theEhFrame.empty();
+        }
+
+        // The row in effect at the given file address, or null if no FDE
+        // covers it
+        const CfiRow* findRow(std::uint64_t aFileAddress) const;
+
+        std::size_t getNumCachedFdes() const;
+
+      private:
+        struct Cie {
+            std::uint64_t theCodeAlignment{1};
+            std::int64_t theDataAlignment{1};
+            std::uint64_t theReturnAddressRegister{CfiRow::RETURN_ADDRESS};
+            std::uint8_t theFdeEncoding{0};
+            bool theHasAugmentationData{false};
+            std::uint64_t theInstructionsBegin{0};
+            std::uint64_t theInstructionsEnd{0};
+        };
+
+        struct Fde {
+            std::uint64_t theBegin{0};
+            std::uint64_t theEnd{0};
+            std::vector<CfiRow> theRows;
+        };
+
+        // Start addresses of the FDEs and their offsets into .eh_frame,
+        // for binaries whose .eh_frame_hdr cannot be searched directly
+        struct FdeLocation {
+            std::uint64_t theBegin;
+            std::uint64_t theOffset;
+        };
+
+        std::span<const std::byte> theEhFrame;
+        std::uint64_t theEhFrameAddress{0};
+        std::uint64_t theEhFrameHdrAddress{0};
+
+        // Pairs of 32-bit initial locations and FDE addresses relative to
+        // .eh_frame_hdr, sorted by location
+        std::span<const std::byte> theSearchTable;
+        std::size_t theSearchTableCount{0};
+
+        mutable std::unordered_map<std::uint64_t, Cie> theCies;
+        mutable std::unordered_map<std::uint64_t, Fde> theFdes;
+        mutable std::vector<FdeLocation> theFdeLocations;
+        mutable bool theFdeLocationsBuilt{false};
+
+        void parseEhFrameHdr(std::span<const std::byte> aHdr);
+        std::optional<std::uint64_t>
+        findFdeOffset(std::uint64_t anAddress) const;
+        void buildFdeLocations() const;
+
+        const Cie& getCie(std::uint64_t anOffset) const;
+        Fde parseFde(std::uint64_t anOffset) const;
+        // Reads a pointer with the given DW_EH_PE encoding from a cursor
+        // over the section loaded at aSectionAddress
+        std::uint64_t readPointer(DwarfCursor& aCursor, std::uint8_t anEncoding,
+                                  std::uint64_t aSectionAddress) const;
+        // Runs the instructions in [aBegin, anEnd) of .eh_frame on aRow,
+        // appending each completed row to aRows if given
+        void runInstructions(std::uint64_t aBegin, std::uint64_t anEnd,
+                             const Cie& aCie, const CfiRow& anInitialRow,
+                             CfiRow& aRow, std::vector<CfiRow>* aRows) const;
+    };
+
+} // namespace sdb
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <breakpoint_site.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <sys/types.h>
+#include <types.hpp>
+#include <unordered_map>
+#include <vector>
+
+namespace sdb {
+
+    class Process;
+
+    // Internal breakpoints at function entries that follow calls to their
+    // return, as uprobes with uretprobes would. The entry breakpoint reads
+    // the return address at [rsp] and sets a breakpoint there, shared by
+    // the calls that return to the same place; both let the process go on
+    // at once. Calls are matched to their return by thread and stack
+    // pointer, so recursion is followed call by call, and calls left by
+    // longjmp or an exception are dropped when an outer one returns.
+    class CallHooks {
+      public:
+        struct Hook {
+            // Returns whether to follow the call to its return
+            std::function<bool()> theOnEntry;
+
+            // Called once for each call followed: at its return, or with
+            // false when the return cannot be seen, as when another
+            // breakpoint is set at the return address, or the call was left
+            // without returning
+            std::function<void(bool anIsReturned)> theOnReturn;
+        };
+
+        // Return breakpoints are removed once no call is under way to
+        // them, unless kept for call sites that call again and again
+        CallHooks(Process& aProcess, bool anIsKeepingReturns,
+                  BreakpointSite::ResumeHandler anOnResume = {})
+            : theProcess{aProcess}, theIsKeepingReturns{anIsKeepingReturns},
+              theOnResume{std::move(anOnResume)} {
+        }
+
+        CallHooks(const CallHooks& other) = delete;
+        CallHooks& operator=(const CallHooks& other) = delete;
+
+        // Left disabled, so that many can be enabled at once. Throws if a
+        // breakpoint is already set at the entry.
+        BreakpointSite& createEntrySite(VirtualAddress anEntry, Hook aHook);
+
+        bool isEmpty() const {
+            return theEntrySites.empty();
+        }
+
+        // Removes every breakpoint and forgets the calls under way
+        void clear();
+
+      private:
+        // A call that has not returned yet
+        struct Frame {
+            std::size_t theHook;
+            std::uint64_t theReturn;
+
+            // The stack pointer at entry, which points at the return address
+            std::uint64_t theEntrySp;
+        };
+
+        struct ReturnSite {
+            BreakpointSiteId theSiteId;
+            std::size_t theNumCalls;
+        };
+
+        Process& theProcess;
+        bool theIsKeepingReturns;
+        BreakpointSite::ResumeHandler theOnResume;
+
+        std::vector<Hook> theHooks;
+        std::vector<BreakpointSiteId> theEntrySites;
+
+        // Innermost call last
+        std::unordered_map<pid_t, std::vector<Frame>> theFrames;
+        std::unordered_map<std::uint64_t, ReturnSite> theReturnSites;
+
+        // Return breakpoints no call returns to any more, disabled and
+        // removed at the next entry, since a site cannot be removed while
+        // its own handlers run
+        std::vector<std::uint64_t> theRetiredSites;
+
+        BreakpointSite& createSite(VirtualAddress anAddress);
+        bool onEntry(std::size_t aHook);
+        bool onReturn(std::uint64_t anAddress);
+        void releaseReturn(std::uint64_t anAddress);
+        void removeRetiredSites();
+    };
+
+} // namespace sdb
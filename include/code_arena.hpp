@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <libsdb/register_info.hpp>
+#include <optional>
+#include <span>
+#include <types.hpp>
+#include <vector>
+
+namespace sdb {
+
+    class Process;
+
+    // Bytes below the stack pointer that code may use without moving it
+    constexpr std::int32_t RED_ZONE_SIZE{128};
+
+    // Runs a system call in the stopped process, throwing if it fails
+    std::uint64_t injectCheckedSyscall(
+        Process& aProcess, std::uint64_t aNumber,
+        std::initializer_list<std::uint64_t> anArgs);
+
+    // The number of a general purpose register in instruction encodings
+    std::optional<std::uint8_t> getRegisterEncoding(RegisterId anId);
+
+    // Machine code with 32 bit branches patched once their targets are
+    // known
+    class CodeBuffer {
+      public:
+        void emit(std::initializer_list<std::uint8_t> aBytes) {
+            for (auto myByte : aBytes) {
+                theBytes.push_back(std::byte{myByte});
+            }
+        }
+
+        template <typename T>
+        void emitValue(T aValue) {
+            auto myBytes = std::as_bytes(std::span{&aValue, 1});
+            theBytes.insert(theBytes.end(), myBytes.begin(), myBytes.end());
+        }
+
+        void emitBytes(std::span<const std::byte> aBytes) {
+            theBytes.insert(theBytes.end(), aBytes.begin(), aBytes.end());
+        }
+
+        // Emits the opcode with a displacement to patch, returning its
+        // offset
+        std::size_t emitBranch(std::initializer_list<std::uint8_t> anOpcode) {
+            emit(anOpcode);
+            emitValue<std::int32_t>(0);
+            return theBytes.size() - sizeof(std::int32_t);
+        }
+
+        void patchBranch(std::size_t aDisplacement, std::size_t aTarget) {
+            auto myRelative = static_cast<std::int32_t>(
+                aTarget - (aDisplacement + sizeof(std::int32_t)));
+            std::memcpy(&theBytes[aDisplacement], &myRelative,
+                        sizeof(myRelative));
+        }
+
+        std::size_t getSize() const {
+            return theBytes.size();
+        }
+
+        std::span<const std::byte> getBytes() const {
+            return theBytes;
+        }
+
+      private:
+        std::vector<std::byte> theBytes;
+    };
+
+    // What a trampoline saves before running its own code: the flags and
+    // the registers it may change, below the red zone of the code it
+    // interrupted
+    struct TrampolineFrame {
+        // From the stack pointer right after the save
+        static constexpr std::int32_t SAVED_RSI{0};
+        static constexpr std::int32_t SAVED_RDX{8};
+        static constexpr std::int32_t SAVED_RCX{16};
+        static constexpr std::int32_t SAVED_RAX{24};
+        static constexpr std::int32_t SAVED_FLAGS{32};
+        static constexpr std::int32_t ORIGINAL_RSP{40 + RED_ZONE_SIZE};
+
+        static void emitSave(CodeBuffer& aCode);
+
+        // Pops the saved registers, which leaves the flags of the
+        // trampoline's last test for a branch
+        static void emitRestoreRegisters(CodeBuffer& aCode);
+
+        // Pops the flags and gives the red zone back
+        static void emitRestoreFlags(CodeBuffer& aCode);
+
+        // Loads a whole register as it was at the site into rax, with the
+        // given number of bytes pushed since the save. False if it is not
+        // one the trampoline can read.
+        static bool emitLoad(CodeBuffer& aCode, RegisterId anId,
+                             VirtualAddress aSite, std::int32_t aPushed = 0);
+    };
+
+    // Whole instructions moved from a site to make room for a jump to a
+    // trampoline, which runs them and jumps back
+    struct DisplacedCode {
+        static constexpr std::size_t JUMP_SIZE{5};
+
+        // The jump may end one byte into the longest instruction
+        static constexpr std::size_t MAX_LENGTH{JUMP_SIZE - 1 + 15};
+
+        // Throws if the instructions branch, use rip-relative addressing,
+        // or overlap another breakpoint or the pc
+        static DisplacedCode at(Process& aProcess, VirtualAddress aSite);
+
+        VirtualAddress theSite;
+        std::vector<std::byte> theOriginal;
+
+        VirtualAddress getEnd() const {
+            return theSite + theOriginal.size();
+        }
+
+        // Appends the instructions and an absolute jump back after them
+        void emit(CodeBuffer& aCode) const;
+
+        // A jump to the trampoline, with traps over the rest of the
+        // displaced bytes so nothing runs them by accident
+        std::vector<std::byte> makePatch(VirtualAddress aTrampoline) const;
+    };
+
+    // Pages sdb maps into the process for trampolines and the counters
+    // they keep. Code pages are placed within reach of a 32 bit jump from
+    // the sites using them and are only ever written through ptrace.
+    class CodeArena {
+      public:
+        static constexpr std::size_t PAGE_BYTES{0x1000};
+
+        explicit CodeArena(Process& aProcess) : theProcess{aProcess} {
+        }
+
+        CodeArena(const CodeArena& other) = delete;
+        CodeArena& operator=(const CodeArena& other) = delete;
+
+        // Maps the process's memory as needed, so it must be stopped
+        VirtualAddress allocateCode(VirtualAddress aNear, std::size_t aSize);
+        VirtualAddress allocateData(std::size_t aSize);
+
+      private:
+        struct Page {
+            VirtualAddress theAddress;
+            std::size_t theUsed;
+        };
+
+        Process& theProcess;
+        std::vector<Page> theCodePages;
+        std::vector<Page> theDataPages;
+    };
+
+} // namespace sdb
@@ -0,0 +1,317 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <dwarf_cursor.hpp>
+#include <string_arena.hpp>
+
+namespace sdb {
+
+    class ElfFile;
+
+    struct LineEntry {
+        static constexpr std::uint8_t IS_STMT = 0x1;
+        static constexpr std::uint8_t END_SEQUENCE = 0x2;
+        static constexpr std::uint8_t PROLOGUE_END = 0x4;
+
+        std::uint64_t theAddress;
+        std::uint32_t theLine;
+        std::uint16_t theFileIndex;
+        std::uint8_t theFlags;
+
+        bool isStatement() const {
+            return theFlags & IS_STMT;
+        }
+
+        bool isEndSequence() const {
+            return theFlags & END_SEQUENCE;
+        }
+    };
+
+    // The decoded line number program of one compile unit. Entries are
+    // sorted by address; a second array of indices orders the statement
+    // entries by (file, line) for line to address lookups.
+    class LineTable {
+      public:
+        const std::vector<std::string>& getFileNames() const {
+            return theFileNames;
+        }
+
+        std::span<const LineEntry> getEntries() const {
+            return theEntries;
+        }
+
+        bool isDecoded() const {
+            return theIsDecoded;
+        }
+
+        const LineEntry*
+        getEntryContainingAddress(std::uint64_t aFileAddress) const;
+
+        // Entries for the given line, or for the closest following line
+        // with code if the line itself has none
+        std::vector<const LineEntry*>
+        getEntriesForLine(std::uint16_t aFileIndex, std::uint32_t aLine) const;
+
+      private:
+        friend class Dwarf;
+
+        bool theIsDecoded{false};
+        std::vector<std::string> theFileNames;
+        std::vector<LineEntry> theEntries;
+        std::vector<std::uint32_t> theEntriesByLine;
+
+        void sortEntries(std::vector<std::vector<LineEntry>> aSequences);
+    };
+
+    struct CompileUnit {
+        std::uint64_t theOffset{0};
+        std::uint64_t theEnd{0};
+        std::uint64_t theDieOffset{0};
+        std::uint64_t theAbbrevOffset{0};
+
+        std::uint16_t theVersion{0};
+        std::uint8_t theUnitType{0};
+        std::uint8_t theAddressSize{8};
+        bool theIs64Bit{false};
+
+        std::optional<std::uint64_t> theLineOffset;
+        std::string_view theName;
+        std::string_view theCompDir;
+
+        std::uint64_t theBaseAddress{0};
+        std::uint64_t theStrOffsetsBase{0};
+        std::uint64_t theAddrBase{0};
+        std::uint64_t theRnglistsBase{0};
+    };
+
+    struct AttributeSpec {
+        std::uint64_t theAttribute;
+        std::uint64_t theForm;
+        std::int64_t theImplicitConst;
+    };
+
+    struct Abbrev {
+        std::uint64_t theTag{0};
+        bool theHasChildren{false};
+        std::vector<AttributeSpec> theAttributes;
+    };
+
+    struct AttributeValue {
+        std::uint64_t theForm{0};
+        std::uint64_t theValue{0};
+        std::string_view theString;
+    };
+
+    struct UnitRange {
+        std::uint64_t theLow;
+        std::uint64_t theHigh;
+        std::uint32_t theUnitIdx;
+    };
+
+    struct FunctionEntry {
+        // Qualified with the enclosing namespaces and classes
+        std::string_view theName;
+        std::uint64_t theLow;
+        std::uint64_t theHigh;
+        std::uint32_t theUnitIdx;
+    };
+
+    // Functions described by the debug info. Entries are grouped into
+    // shards by a hash of their name and sorted by name within a shard, so
+    // threads can merge into the index without contending on one lock.
+    struct FunctionIndex {
+        static constexpr std::size_t NUM_SHARDS{64};
+
+        // Stable across runs, since the layout is persisted in the cache
+        static std::size_t getShard(std::string_view aName);
+
+        std::vector<FunctionEntry> theEntries;
+
+        // Shard i occupies [theShardOffsets[i], theShardOffsets[i + 1])
+        std::vector<std::uint32_t> theShardOffsets;
+
+        // Indices into theEntries ordered by start address
+        std::vector<std::uint32_t> theByAddress;
+    };
+
+    struct IndexProgress {
+        std::size_t theUnitsIndexed;
+        std::size_t theUnitsTotal;
+        bool theIsComplete;
+    };
+
+    struct SourceLocation {
+        std::string_view theFile;
+        std::uint32_t theLine;
+
+        // File address of the line table entry the location came from
+        std::uint64_t theAddress;
+    };
+
+    // Lazily indexed DWARF reader. Construction only walks the unit
+    // headers; the compile unit address ranges and the function index are
+    // then built per unit on a pool of background threads. Queries block
+    // until that index is complete. Line programs are decoded the first
+    // time a unit is queried.
+    class Dwarf {
+      public:
+        using IndexedCallback = std::function<void(const Dwarf&)>;
+
+        // The callback runs on the indexing thread once the index is
+        // complete.
+        explicit Dwarf(const ElfFile& anElf,
+                       IndexedCallback anOnIndexed = nullptr);
+
+        // Uses a previously built index, such as one restored from the
+        // on-disk cache. The range and name memory must outlive this object.
+        Dwarf(const ElfFile& anElf, std::vector<CompileUnit> aUnits,
+              std::span<const UnitRange> aUnitRanges,
+              FunctionIndex aFunctions);
+
+        // Stops and joins the indexing threads
+        ~Dwarf();
+
+        Dwarf(const Dwarf& other) = delete;
+        Dwarf& operator=(const Dwarf& other) = delete;
+
+        Dwarf(Dwarf&& other) = delete;
+        Dwarf& operator=(Dwarf&& other) = delete;
+
+        bool hasDebugInfo() const {
+            return !theUnits.empty();
+        }
+
+        IndexProgress getIndexProgress() const;
+
+        // Waits up to the given time for background indexing to finish and
+        // returns whether it has
+        bool waitForIndex(std::chrono::milliseconds aTimeout) const;
+
+        // Wall time spent building the index in the background
+        std::chrono::steady_clock::duration getIndexTime() const {
+            waitForIndex();
+            return theIndexTime;
+        }
+
+        std::span<const CompileUnit> getCompileUnits() const {
+            waitForIndex();
+            return theUnits;
+        }
+
+        // Address ranges of the compile units, sorted by start address
+        std::span<const UnitRange> getUnitRanges() const {
+            waitForIndex();
+            return theUnitRanges;
+        }
+
+        const FunctionIndex& getFunctionIndex() const {
+            waitForIndex();
+            return theFunctions;
+        }
+
+        std::vector<const FunctionEntry*>
+        findFunctions(std::string_view aName) const;
+        const FunctionEntry*
+        getFunctionContainingAddress(std::uint64_t aFileAddress) const;
+
+        const CompileUnit*
+        getCompileUnitContainingAddress(std::uint64_t aFileAddress) const;
+
+        const LineTable& getLineTable(const CompileUnit& aUnit) const;
+
+        std::optional<SourceLocation>
+        getSourceLocation(std::uint64_t aFileAddress) const;
+
+        // File addresses at which a breakpoint on the given source line
+        // should be placed. The file matches on a whole path suffix.
+        std::vector<std::uint64_t> getLineAddresses(std::string_view aFile,
+                                                    std::uint32_t aLine) const;
+
+      private:
+        const ElfFile& theElf;
+
+        std::span<const std::byte> theInfo;
+        std::span<const std::byte> theAbbrev;
+        std::span<const std::byte> theLine;
+        std::span<const std::byte> theStr;
+        std::span<const std::byte> theLineStr;
+        std::span<const std::byte> theStrOffsets;
+        std::span<const std::byte> theAddr;
+        std::span<const std::byte> theRnglists;
+        std::span<const std::byte> theRanges;
+
+        std::vector<CompileUnit> theUnits;
+        std::span<const UnitRange> theUnitRanges;
+        std::vector<UnitRange> theOwnedUnitRanges;
+
+        FunctionIndex theFunctions;
+        std::vector<StringArena> theArenas;
+
+        mutable std::vector<std::unique_ptr<LineTable>> theLineTables;
+
+        IndexedCallback theOnIndexed;
+        std::chrono::steady_clock::duration theIndexTime{};
+        std::atomic<std::size_t> theUnitsIndexed{0};
+        bool theIsIndexed{false};
+        mutable std::mutex theIndexMutex;
+        mutable std::condition_variable theIndexCondition;
+
+        // Declared last so it is stopped before anything it uses is torn
+        // down
+        std::jthread theIndexThread;
+
+        void mapSections();
+        void indexUnits();
+        void buildIndex(std::stop_token aStopToken);
+        void finishFunctionIndex(
+            std::vector<std::vector<FunctionEntry>>& aShards);
+        void waitForIndex() const;
+
+        CompileUnit parseUnitHeader(DwarfCursor& aCursor) const;
+        void parseRootDie(CompileUnit& aUnit, std::uint32_t aUnitIdx,
+                          std::vector<UnitRange>& aRanges) const;
+        void indexFunctions(std::uint32_t aUnitIdx, StringArena& anArena,
+                            std::vector<FunctionEntry>& aFunctions) const;
+
+        std::vector<std::pair<std::uint64_t, Abbrev>>
+        parseAbbrevTable(std::uint64_t anOffset) const;
+        Abbrev findAbbrev(std::uint64_t anAbbrevOffset,
+                          std::uint64_t aCode) const;
+        AttributeValue readAttributeValue(DwarfCursor& aCursor,
+                                          const AttributeSpec& aSpec,
+                                          const CompileUnit& aUnit) const;
+
+        std::string_view resolveString(const CompileUnit& aUnit,
+                                       const AttributeValue& aValue) const;
+        std::uint64_t resolveAddress(const CompileUnit& aUnit,
+                                     const AttributeValue& aValue) const;
+        std::uint64_t readIndexedAddress(const CompileUnit& aUnit,
+                                         std::uint64_t anIndex) const;
+        void readRanges(
+            const CompileUnit& aUnit, const AttributeValue& aValue,
+            std::vector<std::pair<std::uint64_t, std::uint64_t>>& aRanges)
+            const;
+
+        const LineTable& ensureLineTable(std::size_t aUnitIdx,
+                                         bool aHeaderOnly) const;
+        void parseLineTable(const CompileUnit& aUnit, LineTable& aTable,
+                            bool aHeaderOnly) const;
+    };
+
+} // namespace sdb
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstdint>
+
+// The subset of the DWARF 2-5 constants sdb understands, named as in the
+// DWARF standard so they can be looked up there.
+namespace sdb::dwarf {
+
+    // Unit types (DWARF 5)
+    inline constexpr std::uint8_t DW_UT_compile = 0x01;
+    inline constexpr std::uint8_t DW_UT_type = 0x02;
+    inline constexpr std::uint8_t DW_UT_partial = 0x03;
+    inline constexpr std::uint8_t DW_UT_skeleton = 0x04;
+    inline constexpr std::uint8_t DW_UT_split_compile = 0x05;
+    inline constexpr std::uint8_t DW_UT_split_type = 0x06;
+
+    // Tags
+    inline constexpr std::uint64_t DW_TAG_compile_unit = 0x11;
+    inline constexpr std::uint64_t DW_TAG_partial_unit = 0x3c;
+    inline constexpr std::uint64_t DW_TAG_skeleton_unit = 0x4a;
+    inline constexpr std::uint64_t DW_TAG_subprogram = 0x2e;
+    inline constexpr std::uint64_t DW_TAG_inlined_subroutine = 0x1d;
+    inline constexpr std::uint64_t DW_TAG_namespace = 0x39;
+    inline constexpr std::uint64_t DW_TAG_class_type = 0x02;
+    inline constexpr std::uint64_t DW_TAG_structure_type = 0x13;
+    inline constexpr std::uint64_t DW_TAG_union_type = 0x17;
+
+    // Attributes
+    inline constexpr std::uint64_t DW_AT_sibling = 0x01;
+    inline constexpr std::uint64_t DW_AT_name = 0x03;
+    inline constexpr std::uint64_t DW_AT_stmt_list = 0x10;
+    inline constexpr std::uint64_t DW_AT_low_pc = 0x11;
+    inline constexpr std::uint64_t DW_AT_high_pc = 0x12;
+    inline constexpr std::uint64_t DW_AT_comp_dir = 0x1b;
+    inline constexpr std::uint64_t DW_AT_specification = 0x47;
+    inline constexpr std::uint64_t DW_AT_abstract_origin = 0x31;
+    inline constexpr std::uint64_t DW_AT_declaration = 0x3c;
+    inline constexpr std::uint64_t DW_AT_ranges = 0x55;
+    inline constexpr std::uint64_t DW_AT_str_offsets_base = 0x72;
+    inline constexpr std::uint64_t DW_AT_addr_base = 0x73;
+    inline constexpr std::uint64_t DW_AT_rnglists_base = 0x74;
+    inline constexpr std::uint64_t DW_AT_linkage_name = 0x6e;
+    inline constexpr std::uint64_t DW_AT_MIPS_linkage_name = 0x2007;
+    inline constexpr std::uint64_t DW_AT_GNU_addr_base = 0x2133;
+    inline constexpr std::uint64_t DW_AT_GNU_ranges_base = 0x2132;
+
+    // Attribute forms
+    inline constexpr std::uint64_t DW_FORM_addr = 0x01;
+    inline constexpr std::uint64_t DW_FORM_block2 = 0x03;
+    inline constexpr std::uint64_t DW_FORM_block4 = 0x04;
+    inline constexpr std::uint64_t DW_FORM_data2 = 0x05;
+    inline constexpr std::uint64_t DW_FORM_data4 = 0x06;
+    inline constexpr std::uint64_t DW_FORM_data8 = 0x07;
+    inline constexpr std::uint64_t DW_FORM_string = 0x08;
+    inline constexpr std::uint64_t DW_FORM_block = 0x09;
+    inline constexpr std::uint64_t DW_FORM_block1 = 0x0a;
+    inline constexpr std::uint64_t DW_FORM_data1 = 0x0b;
+    inline constexpr std::uint64_t DW_FORM_flag = 0x0c;
+    inline constexpr std::uint64_t DW_FORM_sdata = 0x0d;
+    inline constexpr std::uint64_t DW_FORM_strp = 0x0e;
+    inline constexpr std::uint64_t DW_FORM_udata = 0x0f;
+    inline constexpr std::uint64_t DW_FORM_ref_addr = 0x10;
+    inline constexpr std::uint64_t DW_FORM_ref1 = 0x11;
+    inline constexpr std::uint64_t DW_FORM_ref2 = 0x12;
+    inline constexpr std::uint64_t DW_FORM_ref4 = 0x13;
+    inline constexpr std::uint64_t DW_FORM_ref8 = 0x14;
+    inline constexpr std::uint64_t DW_FORM_ref_udata = 0x15;
+    inline constexpr std::uint64_t DW_FORM_indirect = 0x16;
+    inline constexpr std::uint64_t DW_FORM_sec_offset = 0x17;
+    inline constexpr std::uint64_t DW_FORM_exprloc = 0x18;
+    inline constexpr std::uint64_t DW_FORM_flag_present = 0x19;
+    inline constexpr std::uint64_t DW_FORM_strx = 0x1a;
+    inline constexpr std::uint64_t DW_FORM_addrx = 0x1b;
+    inline constexpr std::uint64_t DW_FORM_ref_sup4 = 0x1c;
+    inline constexpr std::uint64_t DW_FORM_strp_sup = 0x1d;
+    inline constexpr std::uint64_t DW_FORM_data16 = 0x1e;
+    inline constexpr std::uint64_t DW_FORM_line_strp = 0x1f;
+    inline constexpr std::uint64_t DW_FORM_ref_sig8 = 0x20;
+    inline constexpr std::uint64_t DW_FORM_implicit_const = 0x21;
+    inline constexpr std::uint64_t DW_FORM_loclistx = 0x22;
+    inline constexpr std::uint64_t DW_FORM_rnglistx = 0x23;
+    inline constexpr std::uint64_t DW_FORM_ref_sup8 = 0x24;
+    inline constexpr std::uint64_t DW_FORM_strx1 = 0x25;
+    inline constexpr std::uint64_t DW_FORM_strx2 = 0x26;
+    inline constexpr std::uint64_t DW_FORM_strx3 = 0x27;
+    inline constexpr std::uint64_t DW_FORM_strx4 = 0x28;
+    inline constexpr std::uint64_t DW_FORM_addrx1 = 0x29;
+    inline constexpr std::uint64_t DW_FORM_addrx2 = 0x2a;
+    inline constexpr std::uint64_t DW_FORM_addrx3 = 0x2b;
+    inline constexpr std::uint64_t DW_FORM_addrx4 = 0x2c;
+    inline constexpr std::uint64_t DW_FORM_GNU_addr_index = 0x1f01;
+    inline constexpr std::uint64_t DW_FORM_GNU_str_index = 0x1f02;
+    inline constexpr std::uint64_t DW_FORM_GNU_ref_alt = 0x1f20;
+    inline constexpr std::uint64_t DW_FORM_GNU_strp_alt = 0x1f21;
+
+    // Range list entries (DWARF 5)
+    inline constexpr std::uint8_t DW_RLE_end_of_list = 0x00;
+    inline constexpr std::uint8_t DW_RLE_base_addressx = 0x01;
+    inline constexpr std::uint8_t DW_RLE_startx_endx = 0x02;
+    inline constexpr std::uint8_t DW_RLE_startx_length = 0x03;
+    inline constexpr std::uint8_t DW_RLE_offset_pair = 0x04;
+    inline constexpr std::uint8_t DW_RLE_base_address = 0x05;
+    inline constexpr std::uint8_t DW_RLE_start_end = 0x06;
+    inline constexpr std::uint8_t DW_RLE_start_length = 0x07;
+
+    // Line number program opcodes
+    inline constexpr std::uint8_t DW_LNS_copy = 0x01;
+    inline constexpr std::uint8_t DW_LNS_advance_pc = 0x02;
+    inline constexpr std::uint8_t DW_LNS_advance_line = 0x03;
+    inline constexpr std::uint8_t DW_LNS_set_file = 0x04;
+    inline constexpr std::uint8_t DW_LNS_set_column = 0x05;
+    inline constexpr std::uint8_t DW_LNS_negate_stmt = 0x06;
+    inline constexpr std::uint8_t DW_LNS_set_basic_block = 0x07;
+    inline constexpr std::uint8_t DW_LNS_const_add_pc = 0x08;
+    inline constexpr std::uint8_t DW_LNS_fixed_advance_pc = 0x09;
+    inline constexpr std::uint8_t DW_LNS_set_prologue_end = 0x0a;
+    inline constexpr std::uint8_t DW_LNS_set_epilogue_begin = 0x0b;
+    inline constexpr std::uint8_t DW_LNS_set_isa = 0x0c;
+
+    inline constexpr std::uint8_t DW_LNE_end_sequence = 0x01;
+    inline constexpr std::uint8_t DW_LNE_set_address = 0x02;
+    inline constexpr std::uint8_t DW_LNE_define_file = 0x03;
+    inline constexpr std::uint8_t DW_LNE_set_discriminator = 0x04;
+
+    // Line table header entry content types (DWARF 5)
+    inline constexpr std::uint64_t DW_LNCT_path = 0x1;
+    inline constexpr std::uint64_t DW_LNCT_directory_index = 0x2;
+    inline constexpr std::uint64_t DW_LNCT_timestamp = 0x3;
+    inline constexpr std::uint64_t DW_LNCT_size = 0x4;
+    inline constexpr std::uint64_t DW_LNCT_MD5 = 0x5;
+
+    // Call frame instructions. The first three carry an operand in their low
+    // six bits.
+    inline constexpr std::uint8_t DW_CFA_advance_loc = 0x40;
+    inline constexpr std::uint8_t DW_CFA_offset = 0x80;
+    inline constexpr std::uint8_t DW_CFA_restore = 0xc0;
+    inline constexpr std::uint8_t DW_CFA_nop = 0x00;
+    inline constexpr std::uint8_t DW_CFA_set_loc = 0x01;
+    inline constexpr std::uint8_t DW_CFA_advance_loc1 = 0x02;
+    inline constexpr std::uint8_t DW_CFA_advance_loc2 = 0x03;
+    inline constexpr std::uint8_t DW_CFA_advance_loc4 = 0x04;
+    inline constexpr std::uint8_t DW_CFA_offset_extended = 0x05;
+    inline constexpr std::uint8_t DW_CFA_restore_extended = 0x06;
+    inline constexpr std::uint8_t DW_CFA_undefined = 0x07;
+    inline constexpr std::uint8_t DW_CFA_same_value = 0x08;
+    inline constexpr std::uint8_t DW_CFA_register = 0x09;
+    inline constexpr std::uint8_t DW_CFA_remember_state = 0x0a;
+    inline constexpr std::uint8_t DW_CFA_restore_state = 0x0b;
+    inline constexpr std::uint8_t DW_CFA_def_cfa = 0x0c;
+    inline constexpr std::uint8_t DW_CFA_def_cfa_register = 0x0d;
+    inline constexpr std::uint8_t DW_CFA_def_cfa_offset = 0x0e;
+    inline constexpr std::uint8_t DW_CFA_def_cfa_expression = 0x0f;
+    inline constexpr std::uint8_t DW_CFA_expression = 0x10;
+    inline constexpr std::uint8_t DW_CFA_offset_extended_sf = 0x11;
+    inline constexpr std::uint8_t DW_CFA_def_cfa_sf = 0x12;
+    inline constexpr std::uint8_t DW_CFA_def_cfa_offset_sf = 0x13;
+    inline constexpr std::uint8_t DW_CFA_val_offset = 0x14;
+    inline constexpr std::uint8_t DW_CFA_val_offset_sf = 0x15;
+    inline constexpr std::uint8_t DW_CFA_val_expression = 0x16;
+    inline constexpr std::uint8_t DW_CFA_GNU_args_size = 0x2e;
+    inline constexpr std::uint8_t DW_CFA_GNU_negative_offset_extended = 0x2f;
+
+    // Pointer encodings used by .eh_frame and .eh_frame_hdr. The low nibble
+    // is the value format and the next three bits how it is applied.
+    inline constexpr std::uint8_t DW_EH_PE_absptr = 0x00;
+    inline constexpr std::uint8_t DW_EH_PE_uleb128 = 0x01;
+    inline constexpr std::uint8_t DW_EH_PE_udata2 = 0x02;
+    inline constexpr std::uint8_t DW_EH_PE_udata4 = 0x03;
+    inline constexpr std::uint8_t DW_EH_PE_udata8 = 0x04;
+    inline constexpr std::uint8_t DW_EH_PE_sleb128 = 0x09;
+    inline constexpr std::uint8_t DW_EH_PE_sdata2 = 0x0a;
+    inline constexpr std::uint8_t DW_EH_PE_sdata4 = 0x0b;
+    inline constexpr std::uint8_t DW_EH_PE_sdata8 = 0x0c;
+    inline constexpr std::uint8_t DW_EH_PE_pcrel = 0x10;
+    inline constexpr std::uint8_t DW_EH_PE_textrel = 0x20;
+    inline constexpr std::uint8_t DW_EH_PE_datarel = 0x30;
+    inline constexpr std::uint8_t DW_EH_PE_funcrel = 0x40;
+    inline constexpr std::uint8_t DW_EH_PE_aligned = 0x50;
+    inline constexpr std::uint8_t DW_EH_PE_indirect = 0x80;
+    inline constexpr std::uint8_t DW_EH_PE_omit = 0xff;
+
+} // namespace sdb::dwarf
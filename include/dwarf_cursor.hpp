@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+#include <bit.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <error.hpp>
+#include <span>
+#include <string_view>
+
+namespace sdb {
+
+    // Bounds-checked reader over a mapped debug section. Shared by the DWARF
+    // and .eh_frame parsers, which use the same primitive encodings.
+    class DwarfCursor {
+      public:
+        explicit DwarfCursor(std::span<const std::byte> aData,
+                             std::size_t anOffset = 0)
+            : theData{aData}, theOffset{anOffset} {
+        }
+
+        bool finished() const {
+            return theOffset >= theData.size();
+        }
+
+        std::size_t getOffset() const {
+            return theOffset;
+        }
+
+        void seek(std::size_t anOffset) {
+            theOffset = anOffset;
+        }
+
+        void skip(std::size_t aNumBytes) {
+            ensureAvailable(aNumBytes);
+            theOffset += aNumBytes;
+        }
+
+        template <typename T>
+        T fixed() {
+            ensureAvailable(sizeof(T));
+            auto myValue = fromBytes<T>(theData.data() + theOffset);
+            theOffset += sizeof(T);
+            return myValue;
+        }
+
+        std::uint8_t u8() {
+            return fixed<std::uint8_t>();
+        }
+
+        std::uint16_t u16() {
+            return fixed<std::uint16_t>();
+        }
+
+        std::uint32_t u32() {
+            return fixed<std::uint32_t>();
+        }
+
+        std::uint64_t u64() {
+            return fixed<std::uint64_t>();
+        }
+
+        // Reads a little-endian unsigned value of 1 to 8 bytes
+        std::uint64_t sized(std::size_t aNumBytes) {
+            ensureAvailable(aNumBytes);
+
+            std::uint64_t myValue = 0;
+            for (std::size_t i = 0; i < aNumBytes; ++i) {
+                myValue |= static_cast<std::uint64_t>(
+                               theData[theOffset + i])
+                           << (8 * i);
+            }
+
+            theOffset += aNumBytes;
+            return myValue;
+        }
+
+        // Section offsets are 4 bytes in 32-bit DWARF, 8 bytes in 64-bit
+        std::uint64_t offset(bool anIs64Bit) {
+            return anIs64Bit ? u64() : u32();
+        }
+
+        std::uint64_t uleb128() {
+            std::uint64_t myResult = 0;
+            int myShift = 0;
+            std::uint8_t myByte = 0;
+
+            do {
+                myByte = u8();
+                if (myShift < 64) {
+                    myResult |= static_cast<std::uint64_t>(myByte & 0x7f)
+                                << myShift;
+                }
+                myShift += 7;
+            } while (myByte & 0x80);
+
+            return myResult;
+        }
+
+        std::int64_t sleb128() {
+            std::uint64_t myResult = 0;
+            int myShift = 0;
+            std::uint8_t myByte = 0;
+
+            do {
+                myByte = u8();
+                if (myShift < 64) {
+                    myResult |= static_cast<std::uint64_t>(myByte & 0x7f)
+                                << myShift;
+                }
+                myShift += 7;
+            } while (myByte & 0x80);
+
+            if (myShift < 64 and (myByte & 0x40)) {
+                myResult |= ~std::uint64_t{0} << myShift;
+            }
+
+            return static_cast<std::int64_t>(myResult);
+        }
+
+        std::string_view string() {
+            auto* myBegin = reinterpret_cast<const char*>(theData.data()) +
+                            theOffset;
+            auto myRemaining = theData.size() - std::min(theOffset,
+                                                         theData.size());
+
+            auto myLength = std::string_view{myBegin, myRemaining}.find('\0');
+            if (myLength == std::string_view::npos) {
+                Error::send("Unterminated string in debug section");
+            }
+
+            theOffset += myLength + 1;
+            return {myBegin, myLength};
+        }
+
+      private:
+        std::span<const std::byte> theData;
+        std::size_t theOffset{0};
+
+        void ensureAvailable(std::size_t aNumBytes) const {
+            if (theOffset + aNumBytes > theData.size()) {
+                Error::send("Read past the end of a debug section");
+            }
+        }
+    };
+
+} // namespace sdb
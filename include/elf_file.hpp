@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <elf.h>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace sdb {
+
+    // A single entry of the symbol index. Names are not copied out of the
+    // mapped file: theNameOffset is an offset into the string table the
+    // index was built from.
+    struct ElfSymbol {
+        std::uint64_t theAddress;
+        std::uint32_t theSize;
+        std::uint32_t theNameOffset;
+    };
+
+    // A stub of the procedure linkage table, through which code calls a
+    // function of another module. The name points into the mapped file.
+    struct ElfPltStub {
+        std::uint64_t theAddress;
+        std::string_view theName;
+    };
+
+    class ElfFile {
+      public:
+        explicit ElfFile(const std::filesystem::path& aPath);
+
+        // Parses an image held in memory, such as an object a JIT compiler
+        // registered. The name is only used to identify it.
+        ElfFile(std::vector<std::byte> anImage,
+                const std::filesystem::path& aName);
+
+        ElfFile() = delete;
+        ElfFile(const ElfFile& other) = delete;
+        ElfFile& operator=(const ElfFile& other) = delete;
+
+        ElfFile(ElfFile&& other) = delete;
+        ElfFile& operator=(ElfFile&& other) = delete;
+
+        ~ElfFile();
+
+        const std::filesystem::path& getPath() const {
+            return thePath;
+        }
+
+        const Elf64_Ehdr& getHeader() const {
+            return *theHeader;
+        }
+
+        std::span<const std::byte> getData() const {
+            return {theData, theSize};
+        }
+
+        std::span<const Elf64_Phdr> getProgramHeaders() const;
+
+        std::span<const Elf64_Shdr> getSectionHeaders() const {
+            return theSectionHeaders;
+        }
+
+        const Elf64_Shdr* getSection(std::string_view aName) const;
+        std::span<const std::byte>
+        getSectionContents(std::string_view aName) const;
+        std::string_view getSectionName(std::size_t anIndex) const;
+
+        // Symbols sorted by address. The index is built on first use from
+        // .symtab, or from .dynsym if the binary has been stripped.
+        std::span<const ElfSymbol> getSymbols() const;
+        std::string_view getSymbolName(const ElfSymbol& aSymbol) const;
+
+        const ElfSymbol*
+        getSymbolContainingAddress(std::uint64_t aFileAddress) const;
+        std::vector<const ElfSymbol*>
+        getSymbolsByName(std::string_view aName) const;
+
+        // Indices into getSymbols() ordered by symbol name
+        std::span<const std::uint32_t> getNameIndex() const;
+
+        // Uses a previously built index, such as one mapped from the on-disk
+        // cache, instead of parsing the symbol table. The memory must outlive
+        // this object.
+        void setSymbolIndex(std::span<const ElfSymbol> aSymbols,
+                            std::span<const std::uint32_t> aNameIndex);
+
+        // The stubs of .plt.sec, or of .plt when the binary was linked
+        // without one, in address order. Each is matched to the function it
+        // calls through the GOT slot its jump reads.
+        std::vector<ElfPltStub> getPltStubs() const;
+
+        // Hex-encoded contents of the NT_GNU_BUILD_ID note, if present
+        std::optional<std::string> getBuildId() const;
+
+      private:
+        std::filesystem::path thePath;
+        int theFd{-1};
+
+        const std::byte* theData{nullptr};
+        std::size_t theSize{0};
+
+        // Backs theData for images read from memory rather than mapped
+        std::vector<std::byte> theOwnedImage;
+
+        const Elf64_Ehdr* theHeader{nullptr};
+        std::span<const Elf64_Shdr> theSectionHeaders;
+        std::unordered_map<std::string_view, const Elf64_Shdr*>
+            theSectionMap;
+
+        // The index either points into the owned vectors or into memory
+        // provided through setSymbolIndex
+        mutable bool theSymbolsLoaded{false};
+        mutable std::span<const ElfSymbol> theSymbols;
+        mutable std::vector<ElfSymbol> theOwnedSymbols;
+        mutable std::string_view theSymbolStrings;
+
+        // Indices into theSymbols sorted by name, built on the first lookup
+        // by name.
+        mutable std::span<const std::uint32_t> theSymbolsByName;
+        mutable std::vector<std::uint32_t> theOwnedSymbolsByName;
+
+        bool hasValidHeader() const;
+
+        // Throws unless the bytes lie within the image, which for JIT
+        // objects comes straight from the process
+        void checkRange(std::uint64_t anOffset, std::uint64_t aSize) const;
+
+        // Throws unless the section is a string table whose last string
+        // ends in it, so that offsets into it give bounded strings
+        std::string_view getStringTable(std::size_t anIndex) const;
+        std::string_view getString(std::string_view aTable,
+                                   std::uint64_t anOffset) const;
+
+        void parseSectionHeaders();
+        const Elf64_Shdr* findSymbolTable() const;
+        void loadSymbols() const;
+        void buildNameIndex() const;
+    };
+
+} // namespace sdb
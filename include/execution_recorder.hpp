@@ -0,0 +1,137 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <disassembler.hpp>
+#include <optional>
+#include <span>
+#include <sys/user.h>
+#include <types.hpp>
+#include <unordered_map>
+#include <vector>
+
+namespace sdb {
+
+    class Process;
+
+    // Undo information for each instruction the process single-steps
+    // through, for reverse execution. A record holds the 8 byte words of
+    // the general purpose and floating point registers the instruction
+    // changed, with their old values, and the old contents of the memory
+    // its store operands wrote, which are decoded from its disassembly.
+    //
+    // Records are packed into a ring allocated once, each with its size at
+    // both ends so it can be walked from either. When it is full the
+    // oldest records are dropped, shortening the history.
+    //
+    // Memory written by system calls, by other threads or by code sdb
+    // injects is not recorded, and instructions are decoded once per
+    // address, so code that changes itself is not supported.
+    class ExecutionRecorder {
+      public:
+        static constexpr std::size_t DEFAULT_CAPACITY{64 << 20};
+
+        ExecutionRecorder(Process& aProcess, std::size_t aCapacity);
+
+        ExecutionRecorder(const ExecutionRecorder& other) = delete;
+        ExecutionRecorder& operator=(const ExecutionRecorder& other) = delete;
+
+        // Saves the memory the instruction at the pc is about to write,
+        // before the step
+        void beginStep(const user& aRegisters);
+
+        // Packs the registers that differ and the saved memory into a
+        // record, once the step finished
+        void commitStep(const user& anOld, const user& aNew);
+        void discardStep();
+
+        // Writes the saved memory of the newest record back and puts the
+        // old values into the registers, which the caller writes to the
+        // process. Returns false when there is nothing left to undo.
+        bool undoLast(user& aRegisters);
+
+        void clear();
+
+        std::size_t getNumRecords() const {
+            return theNumRecords;
+        }
+
+        std::size_t getUsed() const {
+            return theUsed;
+        }
+
+        std::size_t getCapacity() const {
+            return theData.size();
+        }
+
+        std::uint64_t getNumDropped() const {
+            return theNumDropped;
+        }
+
+        // Totals since recording started, for the throughput of stepping
+        // and the size of a record
+        std::uint64_t getNumRecorded() const {
+            return theNumRecorded;
+        }
+
+        std::uint64_t getBytesRecorded() const {
+            return theBytesRecorded;
+        }
+
+        std::chrono::steady_clock::duration getRecordingTime() const {
+            return theRecordingTime;
+        }
+
+      private:
+        // A memory operand as segment:disp(base,index,scale), with
+        // rip-relative displacements already made absolute. Registers are
+        // numbered by their 8 byte word in the user area.
+        struct MemoryOperand {
+            std::int64_t theDisplacement{0};
+            std::optional<std::size_t> theSegment;
+            std::optional<std::size_t> theBase;
+            std::optional<std::size_t> theIndex;
+            std::uint8_t theScale{1};
+            std::size_t theSize{0};
+        };
+
+        // What an instruction stores, which it pushes to the stack or
+        // writes to its destination
+        struct Stores {
+            std::optional<MemoryOperand> theDestination;
+            bool theIsPush{false};
+        };
+
+        Process& theProcess;
+        Disassembler theDisassembler;
+        std::unordered_map<std::uint64_t, Stores> theDecoded;
+
+        std::vector<std::byte> theData;
+
+        // Where the oldest record starts, which is dropped to make room.
+        // The newest, undone first, ends theUsed bytes later in the ring.
+        std::size_t theBegin{0};
+        std::size_t theUsed{0};
+        std::size_t theNumRecords{0};
+        std::uint64_t theNumDropped{0};
+
+        // The writes of the step in progress, as they are packed
+        std::vector<std::byte> theWrites;
+        std::uint8_t theNumWrites{0};
+        std::vector<std::byte> theRecord;
+        std::chrono::steady_clock::time_point theStepStart;
+
+        std::uint64_t theNumRecorded{0};
+        std::uint64_t theBytesRecorded{0};
+        std::chrono::steady_clock::duration theRecordingTime{};
+
+        const Stores& decode(VirtualAddress aPc);
+        void saveMemory(std::uint64_t anAddress, std::size_t aSize);
+        void push(std::span<const std::byte> aRecord);
+
+        void copyIn(std::size_t anOffset, std::span<const std::byte> aBytes);
+        void copyOut(std::size_t anOffset, std::span<std::byte> aBytes) const;
+    };
+
+} // namespace sdb
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <tracepoint.hpp>
+#include <types.hpp>
+#include <unordered_map>
+#include <vector>
+
+namespace sdb {
+
+    class Process;
+
+    // Layout of the ring the trampolines write into, shared by sdb and the
+    // inferior. Slots follow the header; a slot is committed once its
+    // sequence is its index in the ring plus one.
+    struct TraceRingHeader {
+        // Slots ever reserved by trampolines and ever read by sdb
+        std::uint64_t theHead;
+        std::uint64_t theTail;
+
+        // A power of two, with the mask used to find a slot
+        std::uint64_t theNumSlots;
+        std::uint64_t theDropped;
+        std::uint64_t theMask;
+        std::uint64_t thePadding[3];
+    };
+
+    struct TraceRingSlot {
+        std::uint64_t theSequence;
+        std::uint32_t theTracepoint;
+        std::uint32_t theSize;
+
+        // Time stamp counter when the trampoline ran
+        std::uint64_t theTicks;
+        std::uint64_t theValues[13];
+    };
+
+    static_assert(sizeof(TraceRingHeader) == 64);
+    static_assert(sizeof(TraceRingSlot) == 128);
+
+    // Fast tracepoints patch a jump over the instructions at the site to a
+    // trampoline in a code page injected into the inferior. The trampoline
+    // stores the registers into the shared ring, runs the displaced
+    // instructions and jumps back, so a hit never stops the process. A
+    // thread in sdb drains the ring while the process runs.
+    //
+    // Only registers can be collected, and the displaced instructions may
+    // not be branches or use rip-relative addressing.
+    class FastTracer {
+      public:
+        static constexpr std::size_t DEFAULT_NUM_SLOTS{1 << 12};
+
+        // Maps the ring into the stopped process
+        FastTracer(Process& aProcess, std::size_t aBufferBytes,
+                   std::size_t aNumSlots = DEFAULT_NUM_SLOTS);
+        ~FastTracer();
+
+        FastTracer(const FastTracer& other) = delete;
+        FastTracer& operator=(const FastTracer& other) = delete;
+
+        // Writes the trampoline and patches the site. Throws if the
+        // captures or the instructions at the site are not supported.
+        void install(const Tracepoint& aTracepoint);
+
+        // Puts back the instructions the jump replaced. The trampoline is
+        // left in place for a thread that may still be running it.
+        void uninstall(VirtualAddress aSite);
+
+        // Passes each record drained so far to the function with its
+        // payload, then forgets them. Returns the records that were lost
+        // because the ring or the buffer in between was full.
+        template <typename F>
+        std::uint64_t collect(F aFunction) {
+            std::lock_guard myLock{theMutex};
+            drain();
+
+            theDrained.forEach(aFunction);
+            auto myDropped = theDrained.getNumDropped() + theRingDropped;
+            theDrained.clear();
+            theRingDropped = 0;
+
+            return myDropped;
+        }
+
+      private:
+        Process& theProcess;
+
+        int theFd{-1};
+        std::byte* theRing{nullptr};
+        std::size_t theRingSize{0};
+        VirtualAddress theRemoteRing{0};
+
+        // The code under each installed jump, by site
+        std::unordered_map<std::uint64_t, std::vector<std::byte>> theOriginals;
+
+        // Guards everything below, which the drain thread updates
+        std::mutex theMutex;
+        TraceBuffer theDrained;
+        std::uint64_t theRingDropped{0};
+        std::uint64_t theSeenDropped{0};
+
+        // A time stamp counter reading and CLOCK_MONOTONIC at the same
+        // moment, to convert the ticks of each slot
+        std::uint64_t theBaseTicks{0};
+        std::uint64_t theBaseTime{0};
+
+        // Stopped by the destructor before the ring is unmapped
+        std::jthread theDrainThread;
+
+        TraceRingHeader& getHeader() {
+            return *reinterpret_cast<TraceRingHeader*>(theRing);
+        }
+
+        void drain();
+    };
+
+} // namespace sdb
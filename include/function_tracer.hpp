@@ -0,0 +1,134 @@
+#pragma once
+
+#include <breakpoint_site.hpp>
+#include <call_hooks.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <latency_histogram.hpp>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <sys/types.h>
+#include <types.hpp>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace sdb {
+
+    class Process;
+
+    // Times calls to chosen functions, hooked with CallHooks, from the
+    // process going on past the entry to the call returning, so the time
+    // it is held at either breakpoint is left out. Calls whose return is
+    // not seen are counted but not timed.
+    class FunctionTracer {
+      public:
+        // Calls kept for the timeline; later ones are only counted
+        static constexpr std::size_t MAX_CALLS{1 << 20};
+
+        struct Function {
+            Function(std::string aName, VirtualAddress anEntry)
+                : theName{std::move(aName)}, theEntry{anEntry} {
+            }
+
+            std::string theName;
+            VirtualAddress theEntry;
+            std::uint64_t theNumCalls{0};
+
+            // Of the calls that returned
+            LatencyHistogram theLatencies;
+        };
+
+        // A call that returned, in steady clock nanoseconds
+        struct Call {
+            std::uint32_t theFunction;
+            pid_t theThread;
+            std::uint32_t theDepth;
+            std::uint64_t theStart;
+            std::uint64_t theDuration;
+        };
+
+        explicit FunctionTracer(Process& aProcess)
+            : theProcess{aProcess},
+              theHooks{aProcess, false,
+                       [this](std::chrono::steady_clock::duration aLatency) {
+                           onResume(aLatency);
+                       }} {
+        }
+
+        FunctionTracer(const FunctionTracer& other) = delete;
+        FunctionTracer& operator=(const FunctionTracer& other) = delete;
+
+        // Throws if a breakpoint is already set at the entry. Entries given
+        // the same name, such as the PLT stubs of one function in several
+        // modules, are counted as one function.
+        const Function& add(std::string aName, VirtualAddress anEntry);
+
+        // Adds the entries with their breakpoints inserted in bulk, leaving
+        // out those where a breakpoint is already set; returns how many
+        // were added
+        std::size_t
+        addAll(std::span<const std::pair<std::string, VirtualAddress>>
+                   anEntries);
+
+        const std::vector<std::unique_ptr<Function>>& getFunctions() const {
+            return theFunctions;
+        }
+
+        const std::vector<Call>& getCalls() const {
+            return theCalls;
+        }
+
+        std::uint64_t getNumDroppedCalls() const {
+            return theNumDroppedCalls;
+        }
+
+        // Time from each entry or return breakpoint stopping the process
+        // until it was resumed
+        const LatencyHistogram& getOverhead() const {
+            return theOverhead;
+        }
+
+        // One row per function, with its calls and the median, 99th
+        // percentile and maximum of their latencies
+        void writeTable(std::ostream& aStream) const;
+
+        // The calls as complete events in the Chrome trace event format,
+        // for chrome://tracing or Perfetto
+        void writeChromeTrace(std::ostream& aStream) const;
+
+      private:
+        // A call that has not returned yet
+        struct Frame {
+            std::uint32_t theFunction;
+            std::uint64_t theStart;
+        };
+
+        Process& theProcess;
+        CallHooks theHooks;
+        std::vector<std::unique_ptr<Function>> theFunctions;
+
+        // Innermost call last
+        std::unordered_map<pid_t, std::vector<Frame>> theFrames;
+
+        // The thread whose call starts when the process is resumed
+        std::optional<pid_t> theStartingThread;
+
+        std::vector<Call> theCalls;
+        std::uint64_t theNumDroppedCalls{0};
+        LatencyHistogram theOverhead;
+
+        std::uint32_t getFunctionIndex(std::string aName,
+                                       VirtualAddress anEntry);
+        BreakpointSite& createEntrySite(std::uint32_t aFunction,
+                                        VirtualAddress anEntry);
+        bool onEntry(std::uint32_t aFunction);
+        void onReturn(bool anIsReturned);
+        void onResume(std::chrono::steady_clock::duration aLatency);
+    };
+
+} // namespace sdb
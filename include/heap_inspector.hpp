@@ -0,0 +1,104 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <types.hpp>
+#include <vector>
+
+namespace sdb {
+
+    class Target;
+
+    // Reads the state of glibc's malloc out of a stopped process: the
+    // arenas around the ring that starts at main_arena, the chunks of each
+    // arena's heaps, and the chunks parked in fastbins and in the tcache
+    // of each thread. Chunk headers are read through a window that slides
+    // along the heap and steps over large chunks without reading them, so
+    // the debugger's memory stays bounded however big the heap is.
+    class HeapInspector {
+      public:
+        static constexpr std::size_t WINDOW_BYTES{1 << 20};
+        static constexpr std::size_t MAX_ARENAS{1024};
+
+        // Longest fastbin or tcache list followed, should one loop
+        static constexpr std::size_t MAX_LIST_LENGTH{1 << 20};
+
+        // Free chunks of 2^i up to 2^(i+1) bytes share size class i
+        static constexpr std::size_t NUM_SIZE_CLASSES{64};
+
+        struct ArenaStats {
+            std::uint64_t theAddress{0};
+            bool theIsMain{false};
+            std::uint64_t theNumHeaps{0};
+
+            // What the arena got from the system, as malloc counts it
+            std::uint64_t theSystemBytes{0};
+
+            std::uint64_t theInUseBytes{0};
+            std::uint64_t theInUseCount{0};
+
+            // Free chunks in the bins
+            std::uint64_t theFreeBytes{0};
+            std::uint64_t theFreeCount{0};
+
+            // Freed into a fastbin or a tcache, which the arena still
+            // counts as in use
+            std::uint64_t theCachedBytes{0};
+            std::uint64_t theCachedCount{0};
+
+            std::uint64_t theTopBytes{0};
+            std::uint64_t theLargestFree{0};
+
+            // A chunk header that made no sense, ending the walk of its
+            // heap
+            std::optional<std::uint64_t> theCorruptAt;
+
+            // Share of the free and cached bytes outside the largest free
+            // chunk. The top chunk is left out since malloc can give it
+            // back to the system.
+            double getFragmentation() const;
+        };
+
+        struct FreeChunk {
+            std::uint64_t theAddress;
+            std::uint64_t theSize;
+            std::uint64_t theArena;
+        };
+
+        struct Stats {
+            std::vector<ArenaStats> theArenas;
+
+            // Free and cached chunks by size class
+            std::array<std::uint64_t, NUM_SIZE_CLASSES> theFreeCounts{};
+            std::array<std::uint64_t, NUM_SIZE_CLASSES> theFreeBytes{};
+
+            // Largest first
+            std::vector<FreeChunk> theLargestFree;
+
+            // Thread caches found at the start of a heap
+            std::uint64_t theNumTcaches{0};
+
+            std::uint64_t theBytesRead{0};
+            std::uint64_t theNumReads{0};
+        };
+
+        explicit HeapInspector(const Target& aTarget) : theTarget{aTarget} {
+        }
+
+        // From the symbol if the C library has one, and otherwise by
+        // looking through its data section for a structure shaped like an
+        // arena. Throws if there is none, as before the first malloc.
+        VirtualAddress findMainArena() const;
+
+        Stats inspect(std::size_t aNumLargest = 10) const;
+
+        static void writeStats(std::ostream& aStream, const Stats& aStats);
+
+      private:
+        const Target& theTarget;
+    };
+
+} // namespace sdb
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <call_hooks.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <types.hpp>
+#include <unordered_map>
+#include <vector>
+
+namespace sdb {
+
+    class FastTracer;
+    class Target;
+
+    // Live allocations by address in a single array with linear probing.
+    // An entry takes 16 bytes, inserting never allocates unless the table
+    // grows, and erasing shifts the entries after it back instead of
+    // leaving tombstones, so churn does not slow lookups down.
+    class AllocationTable {
+      public:
+        static constexpr std::size_t MIN_CAPACITY{1 << 10};
+        static constexpr std::uint64_t MAX_SIZE{(std::uint64_t{1} << 40) - 1};
+        static constexpr std::uint32_t MAX_SITE{(1 << 24) - 1};
+
+        struct Entry {
+            // Zero for an empty slot
+            std::uint64_t theAddress;
+
+            // Sizes are clamped to MAX_SIZE
+            std::uint64_t theSize : 40;
+            std::uint64_t theSite : 24;
+        };
+
+        AllocationTable() : theEntries(MIN_CAPACITY) {
+        }
+
+        // Replaces any entry at the same address
+        void insert(std::uint64_t anAddress, std::uint64_t aSize,
+                    std::uint32_t aSite);
+        std::optional<Entry> erase(std::uint64_t anAddress);
+        const Entry* find(std::uint64_t anAddress) const;
+
+        std::size_t getSize() const {
+            return theSize;
+        }
+
+        std::size_t getCapacity() const {
+            return theEntries.size();
+        }
+
+      private:
+        std::vector<Entry> theEntries;
+        std::size_t theSize{0};
+
+        std::size_t getHome(std::uint64_t anAddress) const;
+        std::size_t findSlot(std::uint64_t anAddress) const;
+        void grow();
+    };
+
+    // Attributes heap memory to the stacks that allocated it. CallHooks on
+    // malloc, calloc and realloc read the arguments and a short frame
+    // pointer stack at entry and the returned pointer at the return, with
+    // the return breakpoints kept since the same call sites allocate again
+    // and again. free, which needs nothing but its argument, gets a fast
+    // tracepoint trampoline when the code at its entry allows and a
+    // breakpoint otherwise. Nothing stops the process for the debugger.
+    class HeapProfiler {
+      public:
+        static constexpr std::size_t MAX_FRAMES{8};
+
+        // Frame pointers further than this above the stack pointer are
+        // taken as garbage and end the stack
+        static constexpr std::uint64_t MAX_STACK_BYTES{8 << 20};
+
+        // Allocated bytes and calls, in total and still live, for one stack
+        struct Site {
+            // The allocator's entry, then return addresses, innermost first
+            std::vector<std::uint64_t> theStack;
+
+            std::uint64_t theLiveBytes{0};
+            std::uint64_t theLiveCount{0};
+            std::uint64_t theTotalBytes{0};
+            std::uint64_t theTotalCount{0};
+        };
+
+        explicit HeapProfiler(Target& aTarget);
+        ~HeapProfiler();
+
+        HeapProfiler(const HeapProfiler& other) = delete;
+        HeapProfiler& operator=(const HeapProfiler& other) = delete;
+
+        // Hooks the allocator of the stopped process, forgetting any
+        // earlier profile. Throws if malloc cannot be found, as before the
+        // C library is loaded.
+        void start();
+
+        // Removes the hooks, keeping the profile
+        void stop();
+
+        bool isRunning() const {
+            return theIsRunning;
+        }
+
+        // Whether free is hooked with a trampoline rather than a breakpoint
+        bool isFreeFast() const {
+            return !theFastFrees.empty();
+        }
+
+        // Moves the frees the trampoline recorded into the profile
+        void collect();
+
+        const std::vector<Site>& getSites() const {
+            return theSites;
+        }
+
+        const AllocationTable& getLiveAllocations() const {
+            return theLive;
+        }
+
+        // Allocations whose result could not be seen, as when another
+        // breakpoint was set at the return address, and frees lost because
+        // the trampoline's ring was full
+        std::uint64_t getNumMissed() const {
+            return theNumMissed;
+        }
+
+        std::uint64_t getNumLostFrees() const {
+            return theNumLostFrees;
+        }
+
+        // One line per site with live memory, outermost frame first, with
+        // the live bytes or every byte allocated: "main;foo;malloc 4096"
+        void writeFoldedStacks(std::ostream& aStream,
+                               bool anIsTotal = false) const;
+
+        // The text heap profile format of gperftools, which pprof reads,
+        // with the process's mappings for symbolization
+        void writePprof(std::ostream& aStream) const;
+
+        // Sites by live bytes, most first
+        void writeTable(std::ostream& aStream, std::size_t aMaxSites) const;
+
+      private:
+        enum class Allocator { Malloc, Calloc, Realloc };
+
+        struct Pending {
+            Allocator theAllocator;
+            std::uint64_t theArgs[2];
+            std::vector<std::uint64_t> theStack;
+        };
+
+        struct StackHash {
+            std::size_t
+            operator()(const std::vector<std::uint64_t>& aStack) const;
+        };
+
+        Target& theTarget;
+        bool theIsRunning{false};
+
+        CallHooks theHooks;
+
+        // Mapped with the first trampoline on free and kept for the next
+        // profile
+        std::unique_ptr<FastTracer> theFreeTracer;
+        std::vector<VirtualAddress> theFastFrees;
+
+        // The allocator call under way; calls it makes itself, such as
+        // realloc of a null pointer calling malloc, are not counted again
+        std::optional<Pending> thePending;
+
+        std::vector<Site> theSites;
+        std::unordered_map<std::vector<std::uint64_t>, std::uint32_t,
+                           StackHash>
+            theSiteIndex;
+        AllocationTable theLive;
+
+        std::uint64_t theNumMissed{0};
+        std::uint64_t theNumLostFrees{0};
+
+        void hookAllocator(std::string_view aName, Allocator anAllocator);
+        void hookFree(VirtualAddress anEntry);
+        std::vector<std::uint64_t> readStack(VirtualAddress anEntry,
+                                             std::uint64_t aSp);
+
+        bool onEntry(Allocator anAllocator, VirtualAddress anEntry);
+        void onReturn(bool anIsReturned);
+        void onFree();
+
+        void addAllocation(std::uint64_t anAddress, std::uint64_t aSize,
+                           std::vector<std::uint64_t> aStack);
+        void removeAllocation(std::uint64_t anAddress);
+    };
+
+} // namespace sdb
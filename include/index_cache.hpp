@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <dwarf.hpp>
+#include <elf_file.hpp>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace sdb {
+
+    // Symbol, DWARF unit and function indexes persisted to disk so later
+    // sessions on the same binary can map them instead of parsing. Files are
+    // keyed by the ELF build-id and live under $SDB_CACHE_DIR,
+    // $XDG_CACHE_HOME/sdb or ~/.cache/sdb. Stored strings are offsets into
+    // the ELF file, except for built names such as qualified function names,
+    // which are kept in a string table in the cache.
+    class IndexCache {
+      public:
+        // Bumped whenever the layout of the file or of any stored record
+        // changes
+        static constexpr std::uint32_t VERSION{2};
+
+        // Maps and validates the cache for the given file. Returns null if
+        // there is no usable cache: the binary has no build-id, the file is
+        // missing, or it was written for a different binary or layout.
+        static std::unique_ptr<IndexCache> load(const ElfFile& anElf);
+
+        // Writes the indexes of the given file to the cache. Best effort:
+        // failures are ignored since the cache only saves time.
+        static void store(const ElfFile& anElf, const Dwarf& aDwarf);
+
+        static std::filesystem::path getDirectory();
+
+        IndexCache() = delete;
+        IndexCache(const IndexCache& other) = delete;
+        IndexCache& operator=(const IndexCache& other) = delete;
+
+        IndexCache(IndexCache&& other) = delete;
+        IndexCache& operator=(IndexCache&& other) = delete;
+
+        ~IndexCache();
+
+        std::span<const ElfSymbol> getSymbols() const {
+            return theSymbols;
+        }
+
+        std::span<const std::uint32_t> getNameIndex() const {
+            return theNameIndex;
+        }
+
+        std::span<const UnitRange> getUnitRanges() const {
+            return theUnitRanges;
+        }
+
+        // Compile units with their strings pointed back into the ELF file
+        std::vector<CompileUnit> getCompileUnits(const ElfFile& anElf) const;
+        FunctionIndex getFunctionIndex(const ElfFile& anElf) const;
+
+      private:
+        struct CachedCompileUnit;
+        struct CachedFunction;
+
+        IndexCache(const void* aMapping, std::size_t aSize)
+            : theMapping{aMapping}, theSize{aSize} {
+        }
+
+        const void* theMapping{nullptr};
+        std::size_t theSize{0};
+
+        std::span<const ElfSymbol> theSymbols;
+        std::span<const std::uint32_t> theNameIndex;
+        std::span<const CachedCompileUnit> theUnits;
+        std::span<const UnitRange> theUnitRanges;
+        std::span<const CachedFunction> theFunctions;
+        std::span<const std::uint32_t> theFunctionShards;
+        std::span<const std::uint32_t> theFunctionsByAddress;
+        std::span<const char> theNameStrings;
+
+        bool validate(const ElfFile& anElf, const std::string& aBuildId);
+    };
+
+} // namespace sdb
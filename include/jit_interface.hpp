@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <elf_file.hpp>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <types.hpp>
+#include <unordered_map>
+
+namespace sdb {
+
+    class Process;
+
+    // An in-memory object file a JIT compiler registered for its code
+    struct JitObject {
+        // Address of the jit_code_entry that registered the object
+        VirtualAddress theEntry;
+
+        VirtualAddress theBegin;
+        VirtualAddress theEnd;
+
+        // Symbol addresses in the object are already absolute
+        std::unique_ptr<ElfFile> theElf;
+
+        bool contains(VirtualAddress anAddress) const {
+            return theBegin <= anAddress and anAddress < theEnd;
+        }
+    };
+
+    // Implements the debugger side of the GDB JIT interface. An internal
+    // breakpoint on __jit_debug_register_code reports each registration
+    // through __jit_debug_descriptor; only the registered entry is read,
+    // and its symbols are indexed on first lookup, so registering an object
+    // costs a few small reads rather than a rebuild of any index.
+    class JitInterface {
+      public:
+        using RegisterCallback = std::function<void(const JitObject&)>;
+
+        explicit JitInterface(Process& aProcess,
+                              RegisterCallback anOnRegister = nullptr)
+            : theProcess{aProcess}, theOnRegister{std::move(anOnRegister)} {
+        }
+
+        JitInterface(const JitInterface& other) = delete;
+        JitInterface& operator=(const JitInterface& other) = delete;
+
+        // Starts following registrations if the image, loaded with the
+        // given bias, defines the interface. Objects registered before this
+        // call are read right away.
+        bool watch(const ElfFile& anElf, std::uint64_t aLoadBias);
+
+        bool isWatching() const {
+            return theDescriptor.has_value();
+        }
+
+        const JitObject*
+        findObjectContainingAddress(VirtualAddress anAddress) const;
+
+        std::size_t getNumObjects() const {
+            return theObjects.size();
+        }
+
+        template <typename F>
+        void forEachObject(F aFunction) const {
+            for (auto& [myEntry, myObject] : theObjects) {
+                aFunction(*myObject);
+            }
+        }
+
+      private:
+        Process& theProcess;
+        RegisterCallback theOnRegister;
+
+        std::optional<VirtualAddress> theDescriptor;
+
+        std::unordered_map<std::uint64_t, std::unique_ptr<JitObject>>
+            theObjects;
+
+        // Objects with code, by start address
+        std::map<std::uint64_t, const JitObject*> theObjectsByAddress;
+
+        bool onRegisterCode();
+        void addEntry(VirtualAddress anEntry);
+        void removeEntry(VirtualAddress anEntry);
+    };
+
+} // namespace sdb
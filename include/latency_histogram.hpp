@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+namespace sdb {
+
+    // Counts latencies in log-linear buckets: each power of two is split
+    // into SUB_BUCKETS equal parts, so a value read back is never more
+    // than 1/SUB_BUCKETS above the one recorded, and the memory taken is
+    // the same however many values there are or how far apart they lie.
+    class LatencyHistogram {
+      public:
+        static constexpr unsigned SUB_BUCKET_BITS{5};
+        static constexpr std::uint64_t SUB_BUCKETS{1 << SUB_BUCKET_BITS};
+        static constexpr std::size_t NUM_BUCKETS{(64 - SUB_BUCKET_BITS + 1) *
+                                                 SUB_BUCKETS};
+
+        void record(std::chrono::nanoseconds aValue);
+        void merge(const LatencyHistogram& other);
+
+        std::uint64_t getCount() const {
+            return theCount;
+        }
+
+        std::chrono::nanoseconds getTotal() const {
+            return std::chrono::nanoseconds(theTotal);
+        }
+
+        std::chrono::nanoseconds getMin() const {
+            return std::chrono::nanoseconds(theCount == 0 ? 0 : theMin);
+        }
+
+        std::chrono::nanoseconds getMax() const {
+            return std::chrono::nanoseconds(theMax);
+        }
+
+        // The least value at or above the given fraction of those recorded,
+        // to the precision of its bucket; 0.5 is the median
+        std::chrono::nanoseconds getQuantile(double aFraction) const;
+
+      private:
+        static std::size_t getBucket(std::uint64_t aValue);
+        static std::uint64_t getBucketEnd(std::size_t aBucket);
+
+        std::array<std::uint64_t, NUM_BUCKETS> theCounts{};
+        std::uint64_t theCount{0};
+        std::uint64_t theTotal{0};
+        std::uint64_t theMin{std::numeric_limits<std::uint64_t>::max()};
+        std::uint64_t theMax{0};
+    };
+
+    // With the unit that suits it, such as 950ns, 12.5us or 3.20ms
+    std::string formatLatency(std::chrono::nanoseconds aLatency);
+
+} // namespace sdb
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <call_hooks.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <latency_histogram.hpp>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <process.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sdb {
+
+    class Target;
+
+    // Finds the locks the traced thread waits for. It stops at futex waits
+    // and wakes, which Process::setSyscallCatchPolicy picks out by their
+    // operation: waits are timed like SyscallProfiler times calls and
+    // charged to the futex word with the stack unwound at the call, and
+    // wakes are counted. When asked to, CallHooks on pthread_mutex_lock
+    // also count acquisitions, and a wait made inside one is charged to
+    // the mutex and the stack that locked it.
+    //
+    // sdb traces a single thread. In a process sdb launched, threads
+    // started during the run inherit the filter untraced, as
+    // Process::installSyscallFilter describes; other processes are traced
+    // without one. A thread sdb does not trace is killed if it hits a
+    // breakpoint, so the hooks are only for processes whose other threads
+    // do not lock mutexes while it runs.
+    class LockProfiler {
+      public:
+        // Return addresses kept for each waiter, from the first outside
+        // the library that made the call
+        static constexpr std::size_t MAX_FRAMES{4};
+
+        struct Stats {
+            LatencyHistogram theWaits;
+            std::uint64_t theNumWakes{0};
+
+            // Only with the pthread_mutex_lock breakpoints
+            std::uint64_t theNumAcquired{0};
+            std::uint64_t theNumContended{0};
+        };
+
+        // Waits on one lock from one stack
+        struct Waiter {
+            std::uint64_t theLock;
+
+            // Return addresses, innermost first
+            std::vector<std::uint64_t> theStack;
+
+            auto operator<=>(const Waiter& other) const = default;
+        };
+
+        // Hooks pthread_mutex_lock only if asked to
+        LockProfiler(Target& aTarget, bool anIsHookingMutexes);
+
+        LockProfiler(const LockProfiler& other) = delete;
+        LockProfiler& operator=(const LockProfiler& other) = delete;
+
+        // Follows the futex calls for the given time with
+        // runCatchingSyscalls. Throws if pthread_mutex_lock is to be hooked
+        // but cannot be found.
+        StopReason run(std::chrono::steady_clock::duration aDuration);
+
+        // By the address of the futex word, which for a mutex is its own
+        const std::map<std::uint64_t, Stats>& getLocks() const {
+            return theLocks;
+        }
+
+        const std::map<Waiter, LatencyHistogram>& getWaiters() const {
+            return theWaiters;
+        }
+
+        // Time the process spent held at each futex call, from its stop
+        // until it was resumed
+        const LatencyHistogram& getOverhead() const {
+            return theOverhead;
+        }
+
+        std::chrono::steady_clock::duration getRunTime() const {
+            return theRunTime;
+        }
+
+        // The locks with the longest total wait first, each with the
+        // stacks that waited longest for it, symbolized when the lock is
+        // a global
+        void writeTable(std::ostream& aStream, std::size_t aMaxLocks) const;
+
+      private:
+        struct PendingLock {
+            std::uint64_t theLock;
+            std::vector<std::uint64_t> theStack;
+            bool theIsContended{false};
+        };
+
+        Target& theTarget;
+        bool theIsHookingMutexes;
+
+        CallHooks theHooks;
+        std::optional<PendingLock> thePendingLock;
+
+        std::map<std::uint64_t, Stats> theLocks;
+        std::map<Waiter, LatencyHistogram> theWaiters;
+        LatencyHistogram theOverhead;
+        std::chrono::steady_clock::duration theRunTime{};
+
+        void hookMutexes();
+        void unhookMutexes();
+        bool onLockEntry();
+        void onLockReturn(bool anIsReturned);
+
+        std::vector<std::uint64_t> readStack() const;
+    };
+
+} // namespace sdb
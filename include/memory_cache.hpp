@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <span>
+#include <sys/types.h>
+#include <types.hpp>
+#include <unordered_map>
+
+namespace sdb {
+
+    // Page granular cache of inferior memory, valid for as long as the
+    // process stays stopped. A miss reads the page together with the pages
+    // above it in a single process_vm_readv, which suits walking up a stack.
+    class MemoryCache {
+      public:
+        static constexpr std::size_t PAGE_BYTES{0x1000};
+        static constexpr std::size_t READ_AHEAD_PAGES{8};
+
+        explicit MemoryCache(pid_t aPid) : thePid{aPid} {
+        }
+
+        MemoryCache(const MemoryCache& other) = delete;
+        MemoryCache& operator=(const MemoryCache& other) = delete;
+
+        MemoryCache(MemoryCache&& other) = default;
+        MemoryCache& operator=(MemoryCache&& other) = default;
+
+        // Fills the buffer, returning false if any byte is unreadable
+        bool read(VirtualAddress anAddress, std::span<std::byte> aBuffer);
+
+        template <typename T>
+        std::optional<T> read(VirtualAddress anAddress) {
+            T myValue;
+            if (!read(anAddress, std::as_writable_bytes(
+                                     std::span<T, 1>{&myValue, 1}))) {
+                return std::nullopt;
+            }
+            return myValue;
+        }
+
+        // Drops everything read so far, for use after the process ran
+        void clear() {
+            thePages.clear();
+        }
+
+        // Number of process_vm_readv calls made
+        std::size_t getNumReads() const {
+            return theNumReads;
+        }
+
+      private:
+        using Page = std::array<std::byte, PAGE_BYTES>;
+
+        pid_t thePid;
+
+        // Pages that could not be read are cached as null
+        std::unordered_map<std::uint64_t, std::unique_ptr<Page>> thePages;
+        std::size_t theNumReads{0};
+
+        const Page* getPage(std::uint64_t aPageNumber);
+    };
+
+} // namespace sdb
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <code_arena.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+#include <types.hpp>
+#include <vector>
+
+namespace sdb {
+
+    class BreakpointCondition;
+    class Process;
+
+    // A breakpoint condition compiled to x86-64 in a trampoline the site
+    // jumps to. The trampoline counts the hit and evaluates the condition on
+    // the process's own stack, reaching an int3 only when it is true, and
+    // then runs the displaced instructions and jumps back. Hits where the
+    // condition is false never leave the process.
+    class NativeCondition {
+      public:
+        // Writes the trampoline but leaves the site alone. Throws if the
+        // condition reads memory or a register the trampoline cannot, or if
+        // the code at the site cannot be displaced.
+        static NativeCondition inject(Process& aProcess, VirtualAddress aSite,
+                                      const BreakpointCondition& aCondition);
+
+        const DisplacedCode& getDisplaced() const {
+            return theDisplaced;
+        }
+
+        // The jump that replaces the displaced instructions
+        const std::vector<std::byte>& getPatch() const {
+            return thePatch;
+        }
+
+        VirtualAddress getTrap() const {
+            return theTrap;
+        }
+
+        // Where the process goes on after a stop, at the displaced
+        // instructions right after the trap
+        VirtualAddress getResume() const {
+            return theTrap + 1;
+        }
+
+        // Reads the count the trampoline keeps. The last count read is
+        // returned once the process is gone.
+        std::uint64_t getNumHits() const;
+
+        std::uint64_t getNumTrue() const {
+            return theNumTrue;
+        }
+
+        void countTrue() {
+            ++theNumTrue;
+        }
+
+      private:
+        NativeCondition(pid_t aPid, DisplacedCode aDisplaced,
+                        std::vector<std::byte> aPatch, VirtualAddress aTrap,
+                        VirtualAddress aHitCounter)
+            : thePid{aPid}, theDisplaced{std::move(aDisplaced)},
+              thePatch{std::move(aPatch)}, theTrap{aTrap},
+              theHitCounter{aHitCounter} {
+        }
+
+        pid_t thePid;
+        DisplacedCode theDisplaced;
+        std::vector<std::byte> thePatch;
+        VirtualAddress theTrap;
+        VirtualAddress theHitCounter;
+        std::uint64_t theNumTrue{0};
+        mutable std::uint64_t theNumHits{0};
+    };
+
+} // namespace sdb
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <sys/types.h>
+#include <vector>
+
+namespace sdb {
+
+    enum struct PerfEvent {
+        Instructions,
+        Cycles,
+        TaskClock,
+        PageFaults,
+        ContextSwitches
+    };
+
+    std::string_view getPerfEventName(PerfEvent anEvent);
+
+    struct PerfCount {
+        PerfEvent theEvent;
+
+        // Nanoseconds for the task clock, a number of events otherwise
+        std::uint64_t theValue;
+    };
+
+    // A perf_event group counting the events of one traced thread. The
+    // software events are always opened; hardware events are left out
+    // when the machine or the perf_event_paranoid setting does not allow
+    // them, and only count user space. All counters are read together
+    // with a single read() of the group.
+    class PerfCounters {
+      public:
+        // Returns null if perf events cannot be used at all
+        static std::unique_ptr<PerfCounters> open(pid_t aPid);
+
+        PerfCounters(const PerfCounters& other) = delete;
+        PerfCounters& operator=(const PerfCounters& other) = delete;
+
+        PerfCounters(PerfCounters&& other) = delete;
+        PerfCounters& operator=(PerfCounters&& other) = delete;
+
+        ~PerfCounters();
+
+        // Reads the counters and makes the counts since the previous call
+        // available through getDelta
+        void update();
+
+        const std::vector<PerfCount>& getDelta() const {
+            return theDelta;
+        }
+
+      private:
+        PerfCounters() = default;
+
+        // File descriptors in the order their values are read; the first
+        // is the group leader
+        std::vector<int> theFds;
+        std::vector<PerfEvent> theEvents;
+
+        std::vector<std::uint64_t> theTotals;
+        std::vector<PerfCount> theDelta;
+
+        bool add(pid_t aPid, PerfEvent anEvent, std::uint32_t aType,
+                 std::uint64_t aConfig);
+    };
+
+} // namespace sdb
@@ -1,14 +1,27 @@
 #pragma once
 
+#include <array>
 #include <breakpoint_site.hpp>
+#include <chrono>
+#include <csignal>
+#include <execution_recorder.hpp>
 #include <filesystem>
+#include <functional>
+#include <initializer_list>
 #include <memory>
+#include <optional>
+#include <perf_counters.hpp>
 #include <registers.hpp>
+#include <set>
+#include <span>
 #include <stoppoint_collection.hpp>
 #include <string_view>
 #include <sys/ptrace.h>
+#include <syscall_recorder.hpp>
 #include <sys/types.h>
 
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace sdb {
@@ -17,6 +30,43 @@ namespace sdb {
 
     enum struct ProcessState { Running, Exited, Stopped, Terminated };
 
+    // The entry to or return from a caught system call, which the process
+    // reports as stopped with SIGTRAP
+    struct SyscallStop {
+        std::uint64_t theNumber;
+        bool theIsEntry;
+
+        // The arguments at entry and the result on return
+        std::array<std::uint64_t, 6> theArgs{};
+        std::int64_t theResult{0};
+
+        // When the debugger saw the stop
+        std::chrono::steady_clock::time_point theTime{};
+
+        bool operator==(const SyscallStop& other) const = default;
+    };
+
+    // Narrows a catch to the calls with one argument among the values, as
+    // seccomp sees it: the low 32 bits of the argument, masked
+    struct SyscallArgumentFilter {
+        std::size_t theIndex{0};
+        std::uint32_t theMask{0xffffffff};
+        std::vector<std::uint32_t> theValues;
+
+        bool matches(const std::array<std::uint64_t, 6>& anArgs) const;
+
+        bool operator==(const SyscallArgumentFilter& other) const = default;
+    };
+
+    // What the debugger does when the process gets a signal
+    struct SignalPolicy {
+        bool theStop{true};  // report it as a stop
+        bool thePass{true};  // deliver it when the process goes on
+        bool thePrint{true}; // tell the signal handler when not stopping
+
+        bool operator==(const SignalPolicy& other) const = default;
+    };
+
     struct StopReason {
         StopReason(int aStatus) {
             if (WIFEXITED(aStatus)) {
@@ -33,6 +83,7 @@ namespace sdb {
 
         ProcessState theStopState{};
         std::uint8_t theStatus{};
+        std::optional<SyscallStop> theSyscall;
 
         bool operator==(const StopReason& other) const = default;
     };
@@ -63,6 +114,19 @@ namespace sdb {
         return aStream << '}';
     }
 
+    // A stopped fork of the process, kept as a copy-on-write snapshot of
+    // its memory, with the registers it had when taken
+    struct Checkpoint {
+        std::size_t theId;
+        pid_t thePid;
+        user theRegisters;
+        std::chrono::steady_clock::duration theCreationTime;
+
+        VirtualAddress getPc() const {
+            return VirtualAddress{theRegisters.regs.rip};
+        }
+    };
+
     class Process {
 
       public:
@@ -83,6 +147,20 @@ namespace sdb {
         StopReason waitOnSignal();
         void resume();
 
+        // Stops the running process with SIGSTOP. If it stops for another
+        // reason first, that reason is returned instead.
+        StopReason interrupt();
+
+        // Drops a SIGSTOP sent to the stopped process that it has not taken
+        // yet, such as one that lost a race with another stop
+        void discardPendingStop();
+
+        // Stops the running process for a profiler sample, reading only the
+        // general purpose registers. A stop for any other reason, such as a
+        // breakpoint or exit, is handled as by waitOnSignal and returned.
+        std::optional<StopReason> stopForSample();
+        void resumeFromSample();
+
         Registers& getRegisters() {
             return theRegisters;
         }
@@ -94,7 +172,8 @@ namespace sdb {
         VirtualAddress getPc() const;
         void setPc(VirtualAddress anAddress);
 
-        BreakpointSite& createBreakpointSite(VirtualAddress anAddress);
+        BreakpointSite& createBreakpointSite(VirtualAddress anAddress,
+                                             bool anIsInternal = false);
 
         template <typename Self>
         StoppointCollection<BreakpointSite>&
@@ -108,6 +187,149 @@ namespace sdb {
 
         StopReason stepInstruction();
 
+        std::unordered_map<int, std::uint64_t> getAuxv() const;
+
+        static constexpr std::size_t SCRATCH_DATA_SIZE{0x1000};
+
+        // Runs a system call in the stopped process with up to six
+        // arguments and returns its raw result, a negated errno on failure.
+        // The registers are restored afterwards.
+        std::int64_t injectSyscall(std::uint64_t aNumber,
+                                   std::initializer_list<std::uint64_t> anArgs);
+
+        // Calls the function with up to six integer arguments as the SysV
+        // ABI does and returns rax. Breakpoints in the function are passed
+        // over, and a fault in it ends the call with an error. The
+        // registers are restored afterwards but memory is not.
+        std::uint64_t callFunction(VirtualAddress aFunction,
+                                   std::span<const std::uint64_t> anArgs);
+
+        // Writable memory in the process for the arguments of injected
+        // calls, such as strings, which the next caller may overwrite
+        VirtualAddress getScratchData();
+
+        // Forks the stopped process into a snapshot that stays stopped. The
+        // fork shares the process's parent, so the program never sees it
+        // as a child, and only the calling thread is copied.
+        const Checkpoint& checkpoint();
+
+        // Replaces the process with a fresh fork of the checkpoint, which
+        // can be restarted again. The process replaced is killed, and the
+        // breakpoints are written to the new one as they are now, so
+        // native conditions start counting again. Nothing else is carried
+        // over: fast tracepoint jumps and their ring are as they were at
+        // the checkpoint, and tools that follow the process, such as the
+        // heap profiler, keep what they saw of the one replaced. Returns
+        // how long the switch took.
+        std::chrono::steady_clock::duration restart(std::size_t anId);
+
+        void deleteCheckpoint(std::size_t anId);
+
+        const std::vector<Checkpoint>& getCheckpoints() const {
+            return theCheckpoints;
+        }
+
+        // Single-steps the process whenever it runs from now on, keeping
+        // the undo information of each instruction for reverse execution
+        void startRecording(std::size_t aCapacity);
+        void stopRecording();
+
+        // Null unless recording
+        const ExecutionRecorder* getRecorder() const {
+            return theRecorder.get();
+        }
+
+        // Undoes the last recorded instruction, throwing when there is
+        // none left
+        StopReason reverseStepInstruction();
+
+        // Undoes instructions until the pc is at a breakpoint whose
+        // condition holds or the recording runs out
+        StopReason reverseContinue();
+
+        // Signals the process gets are reported, passed on and counted as
+        // their policy says. Those that do not stop are delivered at once,
+        // or after the step under way. SIGTRAP and SIGSTOP are the
+        // debugger's own and always stop without being passed on, so their
+        // policy cannot be changed.
+        void setSignalPolicy(int aSignal, SignalPolicy aPolicy);
+        const SignalPolicy& getSignalPolicy(int aSignal) const;
+
+        // Times the process got the signal, whether it stopped or not
+        std::uint64_t getSignalCount(int aSignal) const;
+
+        // Called with each signal that goes on without a stop but is to be
+        // printed
+        using SignalHandler = std::function<void(int aSignal)>;
+        void setSignalHandler(SignalHandler aHandler) {
+            theSignalHandler = std::move(aHandler);
+        }
+
+        // Stops the process on entry to the system calls, with
+        // PTRACE_EVENT_SECCOMP, using a seccomp filter injected into it.
+        // Filters cannot be removed, so only processes sdb launched, and
+        // kills on exit, are filtered. Threads and children the process
+        // starts later inherit them untraced, and their filtered calls
+        // fail with ENOSYS. Numbers filtered already are left out of the
+        // new filter. With an argument filter only the matching calls
+        // stop, and the numbers stay unfiltered for other arguments.
+        void installSyscallFilter(
+            std::span<const std::uint64_t> aNumbers,
+            const std::optional<SyscallArgumentFilter>& anArgumentFilter =
+                std::nullopt);
+
+        // Reports stops on entry to and return from the system calls, and
+        // no others. Calls caught before stay filtered, but the process
+        // goes on from them without a report. A process sdb did not launch
+        // is stopped at every call with PTRACE_SYSCALL instead, and sdb
+        // picks out the caught ones.
+        void setSyscallCatchPolicy(
+            std::vector<std::uint64_t> aNumbers,
+            std::optional<SyscallArgumentFilter> anArgumentFilter =
+                std::nullopt);
+
+        // Reports stops at every system call, through PTRACE_SYSCALL, which
+        // leaves nothing behind in the process
+        void catchAllSyscalls();
+
+        // Empty when catching every call
+        const std::vector<std::uint64_t>& getCaughtSyscalls() const {
+            return theCaughtSyscalls;
+        }
+
+        bool isCatchingAllSyscalls() const {
+            return theIsCatchingAllSyscalls;
+        }
+
+        const std::optional<SyscallArgumentFilter>&
+        getCaughtArgumentFilter() const {
+            return theCaughtArgumentFilter;
+        }
+
+        // Logs the results of the system calls a run cannot repeat to the
+        // file from now on, or plays back a log instead of making them;
+        // see SyscallRecorder. Only in processes sdb launched.
+        void recordSyscalls(const std::filesystem::path& aPath);
+        void replaySyscalls(const std::filesystem::path& aPath);
+
+        // Closes the log. The process still stops at the calls, but runs
+        // them as they are.
+        void stopSyscallLog();
+
+        // Null unless logging
+        const SyscallRecorder* getSyscallRecorder() const {
+            return theSyscallRecorder.get();
+        }
+
+        // Counters of the events since the previous reported stop, or null
+        // when perf events are not available
+        const PerfCounters* getPerfCounters() const {
+            return thePerfCounters.get();
+        }
+
+        // Memory for trampolines, mapped into the process on first use
+        CodeArena& getCodeArena();
+
         ~Process();
 
       private:
@@ -117,6 +339,25 @@ namespace sdb {
 
         void readAllRegisters();
 
+        int waitForStatus();
+
+        // Returns nothing when an internal breakpoint handled the stop and
+        // the process was resumed
+        std::optional<StopReason> handleStatus(int aStatus);
+
+        // Resumes the process as it is resumed again after stopping at a
+        // system call
+        long resumeWith(__ptrace_request aRequest);
+
+        // Returns true if the status was a stop at a filtered system call,
+        // after which the process was resumed. A stop at a caught call is
+        // left to be reported, with theSyscallStop set.
+        bool handleSyscallStop(int aStatus);
+
+        // Sends SIGSTOP and waits for the next stop, which may have another
+        // cause, in which case the signal is discarded
+        int waitForStop();
+
         pid_t thePid{};
         Origin theOrigin{};
         ProcessState theProcessState{ProcessState::Stopped};
@@ -125,6 +366,106 @@ namespace sdb {
         Registers theRegisters{*this};
         StoppointCollection<BreakpointSite> theStoppoints;
 
+        std::unique_ptr<PerfCounters> thePerfCounters;
+        std::unique_ptr<CodeArena> theCodeArena;
+
+        // Set while stepping over a breakpoint to resume, which is part of
+        // the region counted up to the next stop
+        bool theIsSteppingOver{false};
+
         void stepOverBreakpointIfExists();
+
+        // Maps the code injections run and the data page after it, using
+        // a system call written over the code at the pc
+        void mapScratch();
+        std::int64_t injectSyscallAtPc(std::uint64_t aNumber,
+                                       std::initializer_list<std::uint64_t>
+                                           anArgs);
+
+        // Runs injected code from the registers until it traps at the
+        // address, then restores the registers. Signals that arrive in
+        // the meantime are raised again for the next resume.
+        user_regs_struct runInjected(const user_regs_struct& aRegs,
+                                     VirtualAddress aReturn);
+
+        // Code for injections, followed by a page of data, once mapped
+        VirtualAddress theScratch{0};
+
+        std::unique_ptr<ExecutionRecorder> theRecorder;
+
+        // Set while a recorded step is under way, and while running on by
+        // recorded steps rather than stopping after one
+        bool theIsRecordingStep{false};
+        bool theIsRecordingContinue{false};
+
+        void beginRecordedStep();
+
+        // Records the step that ended with the status. Returns true if the
+        // process was stepped on again instead of stopping.
+        bool finishRecordedStep(int aStatus);
+
+        // The ptrace options the process is traced with
+        int theTraceOptions{0};
+        __ptrace_request theResumeRequest{PTRACE_CONT};
+
+        // Set when the process stops at every system call, entry and
+        // return, so that running on means PTRACE_SYSCALL
+        bool theIsTracingSyscalls{false};
+
+        __ptrace_request getContinueRequest() const {
+            return theIsTracingSyscalls ? PTRACE_SYSCALL : PTRACE_CONT;
+        }
+
+        void setSyscallTracing(bool anIsTracing);
+        bool theHasRun{false};
+
+        std::unique_ptr<SyscallRecorder> theSyscallRecorder;
+
+        std::set<std::uint64_t> theFilteredSyscalls;
+        std::vector<std::pair<std::uint64_t, SyscallArgumentFilter>>
+            theArgumentFilteredSyscalls;
+        std::vector<std::uint64_t> theCaughtSyscalls;
+        std::optional<SyscallArgumentFilter> theCaughtArgumentFilter;
+        bool theIsCatchingAllSyscalls{false};
+        std::optional<SyscallStop> theSyscallStop;
+
+        // The caught call reported at entry, whose return is reported too
+        // when the process is resumed
+        std::optional<std::uint64_t> theReturningSyscall;
+
+        void startSyscallLog(SyscallRecorder::Mode aMode,
+                             const std::filesystem::path& aPath);
+
+        static std::array<SignalPolicy, NSIG> getDefaultSignalPolicies();
+
+        std::array<SignalPolicy, NSIG> theSignalPolicies{
+            getDefaultSignalPolicies()};
+        std::array<std::uint64_t, NSIG> theSignalCounts{};
+        SignalHandler theSignalHandler;
+
+        // Delivered by the next resume that is not a step over a
+        // breakpoint
+        int thePendingSignal{0};
+
+        // Returns true if the status was a signal that does not stop,
+        // after which the process was resumed
+        bool handleSignalStop(int aStatus);
+
+        std::vector<Checkpoint> theCheckpoints;
+        std::size_t theNextCheckpointId{1};
+
+        // The enabled site with a native condition whose trampoline has
+        // its trap at the address
+        BreakpointSite* findSiteByTrap(VirtualAddress anAddress);
+
+        // The enabled site with a native condition whose jump covers the
+        // address
+        BreakpointSite* findNativeSiteCovering(VirtualAddress anAddress);
+
+        // Moves a pc in the jump of a native condition to the same place
+        // in the displaced copy of its instructions, or back again. The
+        // copy runs straight through, so offsets into both match.
+        void moveIntoDisplacedCopy(const BreakpointSite& aSite);
+        void moveOutOfDisplacedCopy(const BreakpointSite& aSite);
     };
 } // namespace sdb
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <process.hpp>
+#include <unordered_map>
+#include <vector>
+
+namespace sdb {
+
+    class Target;
+
+    // Samples the call stack of a running target at a fixed rate. Each
+    // sample stops the process with SIGSTOP, reads its general purpose
+    // registers with a single ptrace call, unwinds the stack through a
+    // memory cache and resumes it; symbols are only looked up once, when
+    // the stacks are written out.
+    class Profiler {
+      public:
+        static constexpr std::size_t MAX_FRAMES{128};
+
+        Profiler(Target& aTarget, unsigned aFrequency)
+            : theTarget{aTarget}, theFrequency{aFrequency} {
+        }
+
+        Profiler(const Profiler& other) = delete;
+        Profiler& operator=(const Profiler& other) = delete;
+
+        // Runs the stopped process for the given time, sampling it, and
+        // stops it again. Returns how it stopped, which is a SIGSTOP unless
+        // it hit a breakpoint, got a signal or ended first.
+        StopReason run(std::chrono::steady_clock::duration aDuration);
+
+        // One line per distinct stack, outermost frame first, in the folded
+        // format flame graph tools read: "main;foo;bar 42"
+        void writeFoldedStacks(std::ostream& aStream) const;
+
+        std::size_t getNumSamples() const {
+            return thePauses.size();
+        }
+
+        std::size_t getNumStacks() const {
+            return theStacks.size();
+        }
+
+        // Time the process spent stopped for each sample
+        const std::vector<std::chrono::steady_clock::duration>&
+        getPauses() const {
+            return thePauses;
+        }
+
+      private:
+        // Call sites, innermost first
+        using Stack = std::vector<std::uint64_t>;
+
+        struct StackHash {
+            std::size_t operator()(const Stack& aStack) const;
+        };
+
+        Target& theTarget;
+        unsigned theFrequency;
+
+        std::unordered_map<Stack, std::size_t, StackHash> theStacks;
+        std::vector<std::chrono::steady_clock::duration> thePauses;
+
+        void takeSample();
+    };
+
+} // namespace sdb
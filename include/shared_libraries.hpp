@@ -0,0 +1,103 @@
+#pragma once
+
+#include <call_frame_info.hpp>
+#include <cstdint>
+#include <elf_file.hpp>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <types.hpp>
+#include <unordered_set>
+#include <vector>
+
+namespace sdb {
+
+    class MemoryCache;
+    class Process;
+
+    struct SharedLibrary {
+        std::string thePath;
+
+        // Address of the dynamic linker's link_map entry, which identifies
+        // the library for as long as it stays loaded
+        VirtualAddress theLinkMap;
+
+        std::uint64_t theLoadBias;
+        VirtualAddress theBegin;
+        VirtualAddress theEnd;
+
+        std::unique_ptr<ElfFile> theElf;
+        std::unique_ptr<CallFrameInfo> theCallFrameInfo;
+
+        bool contains(VirtualAddress anAddress) const {
+            return theBegin <= anAddress and anAddress < theEnd;
+        }
+
+        std::uint64_t toFileAddress(VirtualAddress anAddress) const {
+            return std::to_underlying(anAddress) - theLoadBias;
+        }
+
+        VirtualAddress toVirtualAddress(std::uint64_t aFileAddress) const {
+            return VirtualAddress{aFileAddress + theLoadBias};
+        }
+    };
+
+    // Follows the libraries loaded by the dynamic linker. The r_debug
+    // rendezvous structure is found through DT_DEBUG in the executable's
+    // dynamic section, and an internal breakpoint on its r_brk function
+    // reports every change to the link_map list. Only the list is walked on
+    // a change; libraries already known are not read again.
+    class SharedLibraryTracker {
+      public:
+        using LoadCallback = std::function<void(const SharedLibrary&)>;
+
+        // Statically linked executables have nothing to track
+        SharedLibraryTracker(Process& aProcess, const ElfFile& anExecutable,
+                             std::uint64_t aLoadBias,
+                             LoadCallback anOnLoad = nullptr);
+
+        SharedLibraryTracker(const SharedLibraryTracker& other) = delete;
+        SharedLibraryTracker&
+        operator=(const SharedLibraryTracker& other) = delete;
+
+        const std::vector<std::unique_ptr<SharedLibrary>>&
+        getLibraries() const {
+            return theLibraries;
+        }
+
+        const SharedLibrary*
+        findLibraryContainingAddress(VirtualAddress anAddress) const;
+
+        // Number of times the link_map list has been walked
+        std::size_t getNumUpdates() const {
+            return theNumUpdates;
+        }
+
+      private:
+        Process& theProcess;
+        LoadCallback theOnLoad;
+
+        VirtualAddress theDynamicAddress{0};
+        std::size_t theDynamicSize{0};
+        std::optional<VirtualAddress> theRendezvous;
+
+        std::vector<std::unique_ptr<SharedLibrary>> theLibraries;
+
+        // link_map entries seen so far, including those that are not
+        // libraries sdb can load, such as the executable and the vDSO
+        std::unordered_set<std::uint64_t> theKnownLinkMaps;
+
+        std::size_t theNumUpdates{0};
+
+        std::optional<VirtualAddress> findRendezvous(MemoryCache& aCache);
+        bool startTracking(MemoryCache& aCache);
+        bool onEntry(VirtualAddress anEntry);
+        bool onRendezvousBreakpoint();
+        void update(MemoryCache& aCache);
+        std::unique_ptr<SharedLibrary> load(VirtualAddress aLinkMap,
+                                            std::string aPath,
+                                            std::uint64_t aLoadBias) const;
+    };
+
+} // namespace sdb
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace sdb {
+
+    // Append-only storage for strings built while indexing, such as
+    // qualified names. Strings never move once stored, so views into the
+    // arena stay valid for its lifetime. Not thread safe; indexing threads
+    // each own one.
+    class StringArena {
+      public:
+        static constexpr std::size_t BLOCK_SIZE{64 * 1024};
+
+        std::string_view store(std::string_view aString) {
+            if (aString.size() > theRemaining) {
+                auto mySize = std::max(BLOCK_SIZE, aString.size());
+                theBlocks.push_back(std::make_unique<char[]>(mySize));
+                theNext = theBlocks.back().get();
+                theRemaining = mySize;
+            }
+
+            std::memcpy(theNext, aString.data(), aString.size());
+            std::string_view myResult{theNext, aString.size()};
+
+            theNext += aString.size();
+            theRemaining -= aString.size();
+            return myResult;
+        }
+
+      private:
+        std::vector<std::unique_ptr<char[]>> theBlocks;
+        char* theNext{nullptr};
+        std::size_t theRemaining{0};
+    };
+
+} // namespace sdb
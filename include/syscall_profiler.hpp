@@ -0,0 +1,99 @@
+#pragma once
+
+#include <chrono>
+#include <compare>
+#include <cstdint>
+#include <functional>
+#include <latency_histogram.hpp>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <process.hpp>
+#include <vector>
+
+namespace sdb {
+
+    // Called at each stop at a call with the time the process was last
+    // resumed
+    using SyscallStopHandler =
+        std::function<void(const SyscallStop& aStop,
+                           std::chrono::steady_clock::time_point aResumed)>;
+
+    // Runs the stopped process for the given time and stops it again, even
+    // if it is blocked in a call, as Profiler::run does. The given calls,
+    // or every call through Process::catchAllSyscalls if there are none,
+    // stop the process while it runs instead of any catchpoints, which are
+    // put back after, and the time from each stop to the process going on
+    // is recorded in the overhead. An argument filter narrows the calls as
+    // Process::setSyscallCatchPolicy describes. Returns the stop that ended
+    // the run.
+    StopReason runCatchingSyscalls(
+        Process& aProcess, std::vector<std::uint64_t> aNumbers,
+        std::chrono::steady_clock::duration aDuration,
+        const SyscallStopHandler& aHandler, LatencyHistogram& anOverhead,
+        std::optional<SyscallArgumentFilter> anArgumentFilter = std::nullopt);
+
+    // Times the system calls of a running process from the stops at their
+    // entry and return, like strace -c, and keeps a latency histogram per
+    // call, and per file descriptor if asked. A call's latency runs from
+    // when the process is resumed at its entry to when the debugger sees
+    // it return, so it leaves out the time the debugger holds the process
+    // at each stop, which is measured on its own.
+    class SyscallProfiler {
+      public:
+        struct Key {
+            std::uint64_t theNumber;
+            // Only for calls on a file descriptor when they are split by it
+            std::optional<std::int32_t> theFd;
+
+            auto operator<=>(const Key& other) const = default;
+        };
+
+        struct Stats {
+            LatencyHistogram theLatencies;
+            std::uint64_t theNumErrors{0};
+        };
+
+        // Times the given calls, or every call if there are none
+        SyscallProfiler(Process& aProcess, std::vector<std::uint64_t> aNumbers,
+                        bool anIsPerFd)
+            : theProcess{aProcess}, theNumbers{std::move(aNumbers)},
+              theIsPerFd{anIsPerFd} {
+        }
+
+        SyscallProfiler(const SyscallProfiler& other) = delete;
+        SyscallProfiler& operator=(const SyscallProfiler& other) = delete;
+
+        // Times the calls for the given time with runCatchingSyscalls
+        StopReason run(std::chrono::steady_clock::duration aDuration);
+
+        const std::map<Key, Stats>& getStats() const {
+            return theStats;
+        }
+
+        // Time from each stop to the process going on again
+        const LatencyHistogram& getOverhead() const {
+            return theOverhead;
+        }
+
+        std::chrono::steady_clock::duration getRunTime() const {
+            return theRunTime;
+        }
+
+        // One row per call, the longest total time first, with the number
+        // of calls and errors and the median, 99th percentile and maximum
+        void writeTable(std::ostream& aStream) const;
+
+      private:
+        Process& theProcess;
+        std::vector<std::uint64_t> theNumbers;
+        bool theIsPerFd;
+
+        std::map<Key, Stats> theStats;
+        LatencyHistogram theOverhead;
+        std::chrono::steady_clock::duration theRunTime{};
+
+        Key getKey(const SyscallStop& aStop) const;
+    };
+
+} // namespace sdb
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <sys/user.h>
+#include <vector>
+
+namespace sdb {
+
+    class Process;
+
+    // Logs the results of the system calls a run cannot repeat, such as
+    // reads, clocks and random numbers, with the memory they wrote, and
+    // plays them back in a later run without executing them, so that run
+    // takes the same path through the program. The process only stops at
+    // these calls, which a seccomp filter picks out.
+    //
+    // Clocks are read through the vDSO without a system call, so a log
+    // started before the process first runs hides the vDSO from it. A
+    // replay must start at the same point in the program as its recording.
+    class SyscallRecorder {
+      public:
+        enum class Mode { Record, Replay };
+
+        // What to do with the call the process stopped at
+        enum class Action {
+            Execute,  // run it as it is
+            Capture,  // run it and call finishCall at the next stop
+            Replayed, // skip it, with the result in the registers
+            Diverged  // report the stop; the replay is over
+        };
+
+        // Magic at the start of saved logs, followed by the version
+        static constexpr std::string_view FILE_MAGIC{"SDBSYSCL"};
+        static constexpr std::uint32_t FILE_VERSION{1};
+
+        // The numbers of the calls logged
+        static std::span<const std::uint64_t> getSyscalls();
+        static bool isLogged(std::uint64_t aNumber);
+
+        // Hides the vDSO when the process has not run yet, as the log
+        // records
+        static std::unique_ptr<SyscallRecorder>
+        record(Process& aProcess, const std::filesystem::path& aPath,
+               bool aHasRun);
+
+        // Throws if the log is not one saved by this version, or if it
+        // was recorded from the start and the process has run since
+        static std::unique_ptr<SyscallRecorder>
+        replay(Process& aProcess, const std::filesystem::path& aPath,
+               bool aHasRun);
+
+        SyscallRecorder(const SyscallRecorder& other) = delete;
+        SyscallRecorder& operator=(const SyscallRecorder& other) = delete;
+
+        ~SyscallRecorder();
+
+        // At the seccomp stop on entry to a logged call. A replayed call
+        // has its result put into the registers and its output written to
+        // the process.
+        Action beginCall(user_regs_struct& aRegisters);
+
+        // Logs the call begun with its result and output
+        void finishCall(const user_regs_struct& aRegisters);
+
+        bool isCapturing() const {
+            return theCapture.has_value();
+        }
+
+        Mode getMode() const {
+            return theMode;
+        }
+
+        const std::filesystem::path& getPath() const {
+            return thePath;
+        }
+
+        bool isVdsoHidden() const {
+            return theIsVdsoHidden;
+        }
+
+        // Calls logged or replayed so far, and the bytes of their output
+        std::uint64_t getNumCalls() const {
+            return theNumCalls;
+        }
+
+        std::uint64_t getNumBytes() const {
+            return theNumBytes;
+        }
+
+        // Calls left to replay
+        std::size_t getNumRemaining() const {
+            return theCalls.size() - theNextCall;
+        }
+
+        // Why the replay stopped matching the process, once it has
+        std::optional<std::string> getDivergence() const {
+            return theDivergence;
+        }
+
+        void flush();
+
+      private:
+        struct Call {
+            std::uint64_t theNumber;
+            std::int64_t theResult;
+            std::vector<std::vector<std::byte>> theOutputs;
+        };
+
+        SyscallRecorder(Process& aProcess, Mode aMode,
+                        std::filesystem::path aPath, bool anIsVdsoHidden)
+            : theProcess{aProcess}, theMode{aMode}, thePath{std::move(aPath)},
+              theIsVdsoHidden{anIsVdsoHidden} {
+        }
+
+        Process& theProcess;
+        Mode theMode;
+        std::filesystem::path thePath;
+        bool theIsVdsoHidden;
+
+        std::ofstream theFile;
+
+        // The number and arguments of the call being recorded
+        std::optional<user_regs_struct> theCapture;
+
+        std::vector<Call> theCalls;
+        std::size_t theNextCall{0};
+        std::optional<std::string> theDivergence;
+
+        std::uint64_t theNumCalls{0};
+        std::uint64_t theNumBytes{0};
+    };
+
+} // namespace sdb
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sdb {
+
+    // Names of the x86-64 system calls, as the kernel headers give them
+    std::optional<std::string_view> getSyscallName(std::uint64_t aNumber);
+    std::optional<std::uint64_t> getSyscallNumber(std::string_view aName);
+
+    // Every known number, in ascending order
+    std::vector<std::uint64_t> getSyscallNumbers();
+
+    // Names or numbers, each argument holding one or more separated by
+    // commas; "none" adds nothing. Throws on an unknown name.
+    std::vector<std::uint64_t>
+    parseSyscalls(std::span<const std::string> anArgs);
+
+} // namespace sdb
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <call_frame_info.hpp>
+#include <chrono>
+#include <cstdint>
+#include <dwarf.hpp>
+#include <elf_file.hpp>
+#include <filesystem>
+#include <function_tracer.hpp>
+#include <heap_profiler.hpp>
+#include <index_cache.hpp>
+#include <jit_interface.hpp>
+#include <memory>
+#include <optional>
+#include <process.hpp>
+#include <shared_libraries.hpp>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tracepoint.hpp>
+#include <types.hpp>
+#include <unwinder.hpp>
+#include <utility>
+#include <vector>
+
+namespace sdb {
+
+    struct SymbolLocation {
+        std::string_view theName;
+        std::uint64_t theOffset;
+    };
+
+    // Ties a running process to the ELF file it was started from, so
+    // addresses can be translated to and from symbols.
+    class Target {
+      public:
+        static std::unique_ptr<Target>
+        launch(const std::filesystem::path& aPath,
+               std::optional<int> aStdoutReplacement = std::nullopt);
+        static std::unique_ptr<Target> attach(pid_t aPid);
+
+        Target() = delete;
+        Target(const Target& other) = delete;
+        Target& operator=(const Target& other) = delete;
+
+        Target(Target&& other) = delete;
+        Target& operator=(Target&& other) = delete;
+
+        Process& getProcess() {
+            return *theProcess;
+        }
+
+        const Process& getProcess() const {
+            return *theProcess;
+        }
+
+        const ElfFile& getElf() const {
+            return *theElf;
+        }
+
+        const Dwarf& getDwarf() const {
+            return *theDwarf;
+        }
+
+        const CallFrameInfo& getCallFrameInfo() const {
+            return *theCallFrameInfo;
+        }
+
+        const SharedLibraryTracker& getSharedLibraries() const {
+            return *theSharedLibraries;
+        }
+
+        const JitInterface& getJitInterface() const {
+            return *theJitInterface;
+        }
+
+        Tracer& getTracer() {
+            return *theTracer;
+        }
+
+        const Tracer& getTracer() const {
+            return *theTracer;
+        }
+
+        FunctionTracer& getFunctionTracer() {
+            return *theFunctionTracer;
+        }
+
+        const FunctionTracer& getFunctionTracer() const {
+            return *theFunctionTracer;
+        }
+
+        HeapProfiler& getHeapProfiler() {
+            return *theHeapProfiler;
+        }
+
+        const HeapProfiler& getHeapProfiler() const {
+            return *theHeapProfiler;
+        }
+
+        // Whether the symbol and debug info indexes were mapped from the
+        // on-disk cache rather than built from the ELF file
+        bool isIndexFromCache() const {
+            return theIndexCache != nullptr;
+        }
+
+        // Time spent on indexes before the target became usable. Without a
+        // cache, debug info indexing carries on in the background.
+        std::chrono::steady_clock::duration getIndexLoadTime() const {
+            return theIndexLoadTime;
+        }
+
+        // Difference between the address the executable was loaded at and
+        // the addresses recorded in the file; zero for non-PIE executables.
+        std::uint64_t getLoadBias() const {
+            return theLoadBias;
+        }
+
+        VirtualAddress toVirtualAddress(std::uint64_t aFileAddress) const {
+            return VirtualAddress{aFileAddress + theLoadBias};
+        }
+
+        std::uint64_t toFileAddress(VirtualAddress anAddress) const {
+            return std::to_underlying(anAddress) - theLoadBias;
+        }
+
+        std::optional<SymbolLocation> symbolize(VirtualAddress anAddress) const;
+
+        // The function containing the address, or the address in hex.
+        // Return addresses are looked up at the call before them, which may
+        // be the last instruction of the caller.
+        std::string getFunctionName(VirtualAddress anAddress,
+                                    bool anIsReturnAddress = false) const;
+
+        // Looks the name up in the ELF symbols, then among the qualified
+        // function names from the debug info, which may wait for indexing,
+        // and finally in the loaded shared libraries and JIT compiled code
+        std::vector<VirtualAddress>
+        findSymbolAddresses(std::string_view aName) const;
+
+        // The PLT stubs of the executable, and of the shared libraries
+        // loaded so far if asked, named after the function each calls with
+        // @plt appended. A function is kept if its name matches one of the
+        // include globs, or there are none, and none of the exclude globs.
+        std::vector<std::pair<std::string, VirtualAddress>>
+        findPltStubs(std::span<const std::string> anIncludes,
+                     std::span<const std::string> anExcludes,
+                     bool anIsWithLibraries = false) const;
+
+        // Remembers a symbol that is not loaded yet. A breakpoint is set on
+        // it as soon as a shared library or JIT compiled object defining it
+        // is loaded.
+        void addPendingBreakpoint(std::string aName);
+
+        const std::vector<std::string>& getPendingBreakpoints() const {
+            return thePendingBreakpoints;
+        }
+
+        // The unwind row for code in the executable or a loaded library
+        const CfiRow* findCallFrameRow(VirtualAddress anAddress) const;
+
+        std::optional<SourceLocation>
+        getSourceLocation(VirtualAddress anAddress) const;
+        std::vector<VirtualAddress>
+        findLineAddresses(std::string_view aFile, std::uint32_t aLine) const;
+
+        // Single steps until execution reaches the start of a different
+        // source line. Calls into code without line information, such as
+        // PLT stubs and libraries, are run to completion.
+        StopReason stepSourceLine();
+
+        // Unwinds the stack of the stopped process, innermost frame first
+        std::vector<StackFrame> backtrace(std::size_t aMaxFrames) const;
+
+      private:
+        Target(std::unique_ptr<Process> aProcess,
+               std::unique_ptr<ElfFile> anElf);
+
+        std::unique_ptr<Process> theProcess;
+
+        // Declared before the indexes that point into its mapping
+        std::unique_ptr<IndexCache> theIndexCache;
+        std::unique_ptr<ElfFile> theElf;
+        std::unique_ptr<Dwarf> theDwarf;
+        std::unique_ptr<CallFrameInfo> theCallFrameInfo;
+        std::chrono::steady_clock::duration theIndexLoadTime{};
+        std::uint64_t theLoadBias{0};
+
+        // Declared before the library tracker, which reports libraries
+        // that may define the JIT interface
+        std::unique_ptr<JitInterface> theJitInterface;
+        std::unique_ptr<SharedLibraryTracker> theSharedLibraries;
+        std::vector<std::string> thePendingBreakpoints;
+
+        std::unique_ptr<Tracer> theTracer;
+        std::unique_ptr<FunctionTracer> theFunctionTracer;
+        std::unique_ptr<HeapProfiler> theHeapProfiler;
+
+        void loadIndexes();
+        void resolvePendingBreakpoints(const ElfFile& anElf,
+                                       std::uint64_t aLoadBias);
+
+        StopReason runToAddress(VirtualAddress anAddress);
+    };
+
+} // namespace sdb
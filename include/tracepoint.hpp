@@ -0,0 +1,229 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <libsdb/register_info.hpp>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <types.hpp>
+#include <vector>
+
+namespace sdb {
+
+    class Process;
+    class FastTracer;
+
+    // A value collected when a tracepoint is hit: a general purpose
+    // register, or a range of memory at a register plus an offset or at a
+    // fixed address.
+    struct TraceCapture {
+        // Parses "rdi", "[rdi, 64]", "[rdi+8, 16]" or "[0x1000, 16]"
+        static std::optional<TraceCapture> parse(std::string_view aSpec);
+
+        // The capture as written, kept for display and saved traces
+        std::string theSpec;
+
+        // Null for memory at a fixed address
+        const RegisterInfo* theRegister{nullptr};
+
+        // Added to the register, or the address itself without one
+        std::uint64_t theOffset{0};
+
+        // Bytes of memory, or nothing to collect the register's value
+        std::optional<std::uint32_t> theSize;
+    };
+
+    struct Tracepoint {
+        std::uint32_t theId;
+        VirtualAddress theAddress;
+        std::vector<TraceCapture> theCaptures;
+        std::uint64_t theNumHits{0};
+
+        // Collected by a trampoline in the process rather than on a stop
+        bool theIsFast{false};
+    };
+
+    // Each record is this header followed by the captures in order. A
+    // register takes 8 bytes; a memory range takes a 4 byte length and the
+    // bytes that could be read.
+    struct TraceRecordHeader {
+        std::uint32_t theTracepoint;
+        std::uint32_t theSize;
+
+        // CLOCK_MONOTONIC in nanoseconds
+        std::uint64_t theTimestamp;
+    };
+
+    // Records packed into a buffer allocated once. When it is full the
+    // oldest records are overwritten and counted as dropped, so the buffer
+    // always holds the most recent hits.
+    class TraceBuffer {
+      public:
+        explicit TraceBuffer(std::size_t aCapacity) : theData(aCapacity) {
+        }
+
+        // Returns false, dropping the record, if it does not fit in the
+        // whole buffer
+        bool push(const TraceRecordHeader& aHeader,
+                  std::span<const std::byte> aPayload);
+
+        // Calls the function with each header and payload, oldest first
+        template <typename F>
+        void forEach(F aFunction) const {
+            std::vector<std::byte> myPayload;
+            auto myOffset = theBegin;
+            for (std::size_t i = 0; i < theNumRecords; ++i) {
+                TraceRecordHeader myHeader;
+                copyOut(myOffset, std::as_writable_bytes(
+                                      std::span{&myHeader, 1}));
+                myPayload.resize(myHeader.theSize);
+                copyOut(myOffset + sizeof(myHeader), myPayload);
+                aFunction(myHeader, std::span<const std::byte>{myPayload});
+                myOffset = (myOffset + sizeof(myHeader) + myHeader.theSize) %
+                           theData.size();
+            }
+        }
+
+        std::size_t getCapacity() const {
+            return theData.size();
+        }
+
+        std::size_t getUsed() const {
+            return theUsed;
+        }
+
+        std::size_t getNumRecords() const {
+            return theNumRecords;
+        }
+
+        std::uint64_t getNumDropped() const {
+            return theNumDropped;
+        }
+
+        // Counts records lost before they could reach this buffer, as when
+        // loading a saved trace
+        void addDropped(std::uint64_t aCount) {
+            theNumDropped += aCount;
+        }
+
+        void clear() {
+            theBegin = 0;
+            theUsed = 0;
+            theNumRecords = 0;
+            theNumDropped = 0;
+        }
+
+      private:
+        std::vector<std::byte> theData;
+
+        // Offset of the oldest record; records wrap around the end
+        std::size_t theBegin{0};
+        std::size_t theUsed{0};
+        std::size_t theNumRecords{0};
+        std::uint64_t theNumDropped{0};
+
+        void copyIn(std::size_t anOffset, std::span<const std::byte> aBytes);
+        void copyOut(std::size_t anOffset, std::span<std::byte> aBytes) const;
+    };
+
+    // Tracepoints are internal breakpoints whose hit handler collects the
+    // captures into the trace buffer and lets the process go on, so a hit
+    // costs a few ptrace calls instead of a round trip through the REPL.
+    class Tracer {
+      public:
+        static constexpr std::size_t DEFAULT_BUFFER_BYTES{1 << 20};
+
+        // Magic at the start of saved traces, followed by the version
+        static constexpr std::string_view FILE_MAGIC{"SDBTRACE"};
+        static constexpr std::uint32_t FILE_VERSION{1};
+
+        explicit Tracer(Process& aProcess,
+                        std::size_t aBufferBytes = DEFAULT_BUFFER_BYTES);
+
+        Tracer(const Tracer& other) = delete;
+        Tracer& operator=(const Tracer& other) = delete;
+
+        ~Tracer();
+
+        // Throws if a breakpoint or tracepoint is already set there
+        const Tracepoint& add(VirtualAddress anAddress,
+                              std::vector<TraceCapture> aCaptures);
+
+        // Sets a tracepoint that never stops the process; see FastTracer.
+        // Throws if the captures or the code at the address do not allow
+        // it.
+        const Tracepoint& addFast(VirtualAddress anAddress,
+                                  std::vector<TraceCapture> aCaptures);
+
+        // Moves the records of fast tracepoints drained so far into the
+        // buffer and counts their hits
+        void collect();
+
+        const std::vector<std::unique_ptr<Tracepoint>>&
+        getTracepoints() const {
+            return theTracepoints;
+        }
+
+        // Holds the records of fast tracepoints up to the last collect
+        const TraceBuffer& getBuffer() const {
+            return theBuffer;
+        }
+
+        // Time from a tracepoint stopping the process until it was resumed
+        std::uint64_t getNumResumes() const {
+            return theNumResumes;
+        }
+
+        std::chrono::steady_clock::duration getTotalLatency() const {
+            return theTotalLatency;
+        }
+
+        std::chrono::steady_clock::duration getMaxLatency() const {
+            return theMaxLatency;
+        }
+
+        // Writes the tracepoints and buffered records to a compact binary
+        // file that loadTrace reads back
+        void save(const std::filesystem::path& aPath) const;
+
+      private:
+        Process& theProcess;
+        std::vector<std::unique_ptr<Tracepoint>> theTracepoints;
+        TraceBuffer theBuffer;
+
+        // Sized for the largest record so a hit never allocates
+        std::vector<std::byte> theScratch;
+
+        // Created with the first fast tracepoint
+        std::unique_ptr<FastTracer> theFastTracer;
+
+        std::uint64_t theNumResumes{0};
+        std::chrono::steady_clock::duration theTotalLatency{};
+        std::chrono::steady_clock::duration theMaxLatency{};
+
+        bool onHit(Tracepoint& aTracepoint);
+        void onResume(std::chrono::steady_clock::duration aLatency);
+    };
+
+    // A trace saved by Tracer::save, browsable without the process
+    struct TraceFile {
+        std::vector<Tracepoint> theTracepoints;
+        TraceBuffer theBuffer;
+    };
+
+    TraceFile loadTrace(const std::filesystem::path& aPath);
+
+    // Formats the captures of a record with printf-style conversions, each
+    // taking the next capture: %d, %u and %x for integers, %s for memory as
+    // a string and %b for memory as hex bytes. An empty format shows every
+    // capture as spec=value.
+    std::string formatTraceRecord(const Tracepoint& aTracepoint,
+                                  std::span<const std::byte> aPayload,
+                                  std::string_view aFormat);
+
+} // namespace sdb
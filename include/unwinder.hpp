@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <call_frame_info.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <types.hpp>
+#include <vector>
+
+namespace sdb {
+
+    class MemoryCache;
+    class Target;
+
+    struct StackFrame {
+        // The current pc for the innermost frame, the return address for
+        // the frames above it
+        VirtualAddress thePc;
+
+        // The value of rsp before the call into this frame, or zero when
+        // the frame could not be unwound
+        VirtualAddress theCfa;
+
+        bool theIsInnermost;
+
+        // An address inside the call for frames above the innermost one, so
+        // symbol and line lookups land in the calling function even when
+        // the call is its last instruction
+        VirtualAddress getCallSite() const {
+            return theIsInnermost ? thePc : thePc - 1;
+        }
+    };
+
+    // Walks the stack of a stopped target. Standard frame pointer frames are
+    // unwound by reading the saved rbp and return address; other frames
+    // are unwound with the .eh_frame rules. All memory is read through the
+    // cache, so a deep stack costs a few reads of whole pages.
+    class Unwinder {
+      public:
+        Unwinder(const Target& aTarget, MemoryCache& aCache)
+            : theTarget{aTarget}, theCache{aCache} {
+        }
+
+        std::vector<StackFrame> unwind(std::size_t aMaxFrames);
+
+      private:
+        // Values of the registers numbered by DWARF, unknown if empty
+        using RegisterSet =
+            std::array<std::optional<std::uint64_t>, CfiRow::NUM_REGISTERS>;
+
+        const Target& theTarget;
+        MemoryCache& theCache;
+
+        RegisterSet readCurrentRegisters() const;
+
+        // Compute the caller's registers and this frame's CFA, returning
+        // false when the frame cannot be unwound
+        bool unwindFramePointer(const RegisterSet& aRegisters,
+                                RegisterSet& aCaller, std::uint64_t& aCfa);
+        bool unwindCfi(const CfiRow& aRow, const RegisterSet& aRegisters,
+                       RegisterSet& aCaller, std::uint64_t& aCfa);
+    };
+
+} // namespace sdb
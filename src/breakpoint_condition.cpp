@@ -0,0 +1,414 @@
+#include <breakpoint_condition.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <error.hpp>
+#include <fmt/format.h>
+#include <libsdb/register_info.hpp>
+#include <memory_cache.hpp>
+#include <registers.hpp>
+#include <type_traits>
+#include <variant>
+
+namespace sdb {
+
+    namespace {
+        using Op = BreakpointCondition::Op;
+        using Instruction = BreakpointCondition::Instruction;
+
+        std::uint64_t applyBinary(Op anOp, std::uint64_t aLeft,
+                                  std::uint64_t aRight) {
+            auto mySignedLeft = static_cast<std::int64_t>(aLeft);
+            auto mySignedRight = static_cast<std::int64_t>(aRight);
+            switch (anOp) {
+                case Op::Add: return aLeft + aRight;
+                case Op::Subtract: return aLeft - aRight;
+                case Op::BitAnd: return aLeft & aRight;
+                case Op::BitOr: return aLeft | aRight;
+                case Op::BitXor: return aLeft ^ aRight;
+                case Op::Equal: return aLeft == aRight;
+                case Op::NotEqual: return aLeft != aRight;
+                case Op::Less: return mySignedLeft < mySignedRight;
+                case Op::LessEqual: return mySignedLeft <= mySignedRight;
+                case Op::Greater: return mySignedLeft > mySignedRight;
+                case Op::GreaterEqual: return mySignedLeft >= mySignedRight;
+                default: Error::send("Not a binary operation");
+            }
+        }
+
+        std::uint64_t applyUnary(Op anOp, std::uint64_t aValue) {
+            switch (anOp) {
+                case Op::Not: return aValue == 0;
+                case Op::Negate: return -aValue;
+                case Op::ToBool: return aValue != 0;
+                default: Error::send("Not a unary operation");
+            }
+        }
+
+        std::uint64_t toUInt64(const RegisterValueT& aValue) {
+            return std::visit(
+                [](auto aConcreteValue) -> std::uint64_t {
+                    if constexpr (std::is_integral_v<
+                                      decltype(aConcreteValue)>) {
+                        return static_cast<std::uint64_t>(aConcreteValue);
+                    } else {
+                        return 0;
+                    }
+                },
+                aValue);
+        }
+
+        // Recursive descent straight to bytecode, folding operations on
+        // constants as they are emitted
+        class Parser {
+          public:
+            explicit Parser(std::string_view aText) : theText{aText} {
+            }
+
+            std::vector<Instruction> parse() {
+                parseOr();
+                skipSpaces();
+                if (thePos != theText.size()) {
+                    fail("Unexpected text");
+                }
+
+                return std::move(theCode);
+            }
+
+          private:
+            std::string_view theText;
+            std::size_t thePos{0};
+            std::vector<Instruction> theCode;
+
+            [[noreturn]] void fail(std::string_view aProblem) const {
+                Error::send(fmt::format("{} at column {} of condition",
+                                        aProblem, thePos + 1));
+            }
+
+            void skipSpaces() {
+                while (thePos < theText.size() and
+                       std::isspace(static_cast<unsigned char>(
+                           theText[thePos]))) {
+                    ++thePos;
+                }
+            }
+
+            static bool isWordCharacter(char aChar) {
+                return std::isalnum(static_cast<unsigned char>(aChar)) or
+                       aChar == '_';
+            }
+
+            // Consumes the symbol unless it is the start of the longer one
+            bool accept(std::string_view aSymbol,
+                        std::string_view aLonger = {}) {
+                skipSpaces();
+                auto myRest = theText.substr(thePos);
+                if (!myRest.starts_with(aSymbol) or
+                    (!aLonger.empty() and myRest.starts_with(aLonger))) {
+                    return false;
+                }
+
+                thePos += aSymbol.size();
+                return true;
+            }
+
+            bool acceptWord(std::string_view aWord) {
+                skipSpaces();
+                auto myEnd = thePos + aWord.size();
+                if (theText.substr(thePos, aWord.size()) != aWord or
+                    (myEnd < theText.size() and
+                     isWordCharacter(theText[myEnd]))) {
+                    return false;
+                }
+
+                thePos = myEnd;
+                return true;
+            }
+
+            void expect(std::string_view aSymbol) {
+                if (!accept(aSymbol)) {
+                    fail(fmt::format("Expected '{}'", aSymbol));
+                }
+            }
+
+            std::size_t emit(Instruction anInstruction) {
+                theCode.push_back(anInstruction);
+                return theCode.size() - 1;
+            }
+
+            bool isConstantAt(std::size_t aDistanceFromEnd) const {
+                return theCode.size() >= aDistanceFromEnd and
+                       theCode[theCode.size() - aDistanceFromEnd].theOp ==
+                           Op::Constant;
+            }
+
+            void emitUnary(Op anOp) {
+                if (isConstantAt(1)) {
+                    auto& myValue = theCode.back().theOperand;
+                    myValue = applyUnary(anOp, myValue);
+                    return;
+                }
+                emit({anOp});
+            }
+
+            void emitBinary(Op anOp) {
+                if (isConstantAt(1) and isConstantAt(2)) {
+                    auto myRight = theCode.back().theOperand;
+                    theCode.pop_back();
+                    auto& myLeft = theCode.back().theOperand;
+                    myLeft = applyBinary(anOp, myLeft, myRight);
+                    return;
+                }
+                emit({anOp});
+            }
+
+            // The right operand only runs when the left one does not
+            // decide the result
+            template <typename F>
+            void emitShortCircuit(Op aJump, F aParseRight) {
+                auto myJump = emit({aJump});
+                aParseRight();
+                theCode[myJump].theOperand = theCode.size();
+                emit({Op::ToBool});
+            }
+
+            void parseOr() {
+                parseAnd();
+                while (acceptWord("or") or accept("||")) {
+                    emitShortCircuit(Op::JumpIfTrue, [this] { parseAnd(); });
+                }
+            }
+
+            void parseAnd() {
+                parseNot();
+                while (acceptWord("and") or accept("&&")) {
+                    emitShortCircuit(Op::JumpIfFalse, [this] { parseNot(); });
+                }
+            }
+
+            void parseNot() {
+                if (acceptWord("not") or accept("!", "!=")) {
+                    parseNot();
+                    emitUnary(Op::Not);
+                    return;
+                }
+                parseComparison();
+            }
+
+            void parseComparison() {
+                static constexpr std::pair<std::string_view, Op>
+                    myComparisons[]{
+                        {"==", Op::Equal},      {"!=", Op::NotEqual},
+                        {"<=", Op::LessEqual},  {">=", Op::GreaterEqual},
+                        {"<", Op::Less},        {">", Op::Greater}};
+
+                parseBitOr();
+                for (auto [mySymbol, myOp] : myComparisons) {
+                    if (accept(mySymbol)) {
+                        parseBitOr();
+                        emitBinary(myOp);
+                        return;
+                    }
+                }
+            }
+
+            void parseBitOr() {
+                parseBitXor();
+                while (accept("|", "||")) {
+                    parseBitXor();
+                    emitBinary(Op::BitOr);
+                }
+            }
+
+            void parseBitXor() {
+                parseBitAnd();
+                while (accept("^")) {
+                    parseBitAnd();
+                    emitBinary(Op::BitXor);
+                }
+            }
+
+            void parseBitAnd() {
+                parseSum();
+                while (accept("&", "&&")) {
+                    parseSum();
+                    emitBinary(Op::BitAnd);
+                }
+            }
+
+            void parseSum() {
+                parseUnary();
+                while (true) {
+                    if (accept("+")) {
+                        parseUnary();
+                        emitBinary(Op::Add);
+                    } else if (accept("-")) {
+                        parseUnary();
+                        emitBinary(Op::Subtract);
+                    } else {
+                        return;
+                    }
+                }
+            }
+
+            void parseUnary() {
+                if (accept("-")) {
+                    parseUnary();
+                    emitUnary(Op::Negate);
+                    return;
+                }
+                parsePrimary();
+            }
+
+            void parseMemory(std::uint8_t aSize) {
+                expect("[");
+                parseBitOr();
+                expect("]");
+                emit({Op::Load, aSize});
+            }
+
+            void parsePrimary() {
+                if (accept("(")) {
+                    parseOr();
+                    expect(")");
+                    return;
+                }
+                skipSpaces();
+                if (theText.substr(thePos).starts_with('[')) {
+                    parseMemory(8);
+                    return;
+                }
+
+                auto myStart = thePos;
+                while (thePos < theText.size() and
+                       isWordCharacter(theText[thePos])) {
+                    ++thePos;
+                }
+                auto myWord = theText.substr(myStart, thePos - myStart);
+                if (myWord.empty()) {
+                    fail("Expected a value");
+                }
+
+                if (std::isdigit(static_cast<unsigned char>(myWord[0]))) {
+                    bool myIsHex = myWord.starts_with("0x");
+                    auto myDigits = myIsHex ? myWord.substr(2) : myWord;
+                    std::uint64_t myValue = 0;
+                    auto [myEnd, myError] = std::from_chars(
+                        myDigits.data(), myDigits.data() + myDigits.size(),
+                        myValue, myIsHex ? 16 : 10);
+                    if (myDigits.empty() or myError != std::errc{} or
+                        myEnd != myDigits.data() + myDigits.size()) {
+                        thePos = myStart;
+                        fail("Invalid number");
+                    }
+                    emit({Op::Constant, 0, myValue});
+                    return;
+                }
+
+                static constexpr std::pair<std::string_view, std::uint8_t>
+                    mySizes[]{{"byte", 1}, {"word", 2}, {"dword", 4},
+                              {"qword", 8}};
+                for (auto [myName, mySize] : mySizes) {
+                    if (myWord == myName) {
+                        parseMemory(mySize);
+                        return;
+                    }
+                }
+
+                if (myWord == "hits") {
+                    emit({Op::HitCount});
+                    return;
+                }
+
+                auto myRegister = std::ranges::find_if(
+                    g_register_infos, [&](const RegisterInfo& anInfo) {
+                        return anInfo.theName == myWord and
+                               anInfo.theRegisterFormat ==
+                                   RegisterFormat::UInt and
+                               (anInfo.theRegisterType == RegisterType::gpr or
+                                anInfo.theRegisterType ==
+                                    RegisterType::sub_gpr);
+                    });
+                if (myRegister == std::end(g_register_infos)) {
+                    thePos = myStart;
+                    fail(fmt::format("Unknown register {}", myWord));
+                }
+                emit({Op::Register, 0,
+                      static_cast<std::uint64_t>(myRegister -
+                                                 std::begin(
+                                                     g_register_infos))});
+            }
+        };
+    } // namespace
+
+    BreakpointCondition BreakpointCondition::compile(std::string_view aText) {
+        BreakpointCondition myCondition{std::string{aText},
+                                        Parser{aText}.parse()};
+        myCondition.theStack.reserve(myCondition.theCode.size());
+        return myCondition;
+    }
+
+    bool BreakpointCondition::evaluate(const Registers& aRegisters,
+                                       MemoryCache& aMemory) {
+        auto myStart = std::chrono::steady_clock::now();
+        ++theNumHits;
+
+        theStack.clear();
+        bool myIsReadable = true;
+        for (std::size_t myPc = 0; myPc < theCode.size() and myIsReadable;
+             ++myPc) {
+            auto& myInstruction = theCode[myPc];
+            switch (myInstruction.theOp) {
+                case Op::Constant:
+                    theStack.push_back(myInstruction.theOperand);
+                    break;
+                case Op::Register:
+                    theStack.push_back(toUInt64(aRegisters.read(
+                        g_register_infos[myInstruction.theOperand])));
+                    break;
+                case Op::HitCount:
+                    theStack.push_back(theNumHits);
+                    break;
+                case Op::Load: {
+                    std::uint64_t myValue = 0;
+                    myIsReadable = aMemory.read(
+                        VirtualAddress{theStack.back()},
+                        std::as_writable_bytes(std::span{&myValue, 1})
+                            .first(myInstruction.theSize));
+                    theStack.back() = myValue;
+                    break;
+                }
+                case Op::Not:
+                case Op::Negate:
+                case Op::ToBool:
+                    theStack.back() =
+                        applyUnary(myInstruction.theOp, theStack.back());
+                    break;
+                case Op::JumpIfFalse:
+                case Op::JumpIfTrue:
+                    if ((theStack.back() != 0) ==
+                        (myInstruction.theOp == Op::JumpIfTrue)) {
+                        myPc = myInstruction.theOperand - 1;
+                    } else {
+                        theStack.pop_back();
+                    }
+                    break;
+                default: {
+                    auto myRight = theStack.back();
+                    theStack.pop_back();
+                    theStack.back() = applyBinary(myInstruction.theOp,
+                                                  theStack.back(), myRight);
+                    break;
+                }
+            }
+        }
+
+        bool myIsTrue = !myIsReadable or theStack.back() != 0;
+        ++(myIsTrue ? theNumTrue : theNumFalse);
+        theTotalTime += std::chrono::steady_clock::now() - myStart;
+
+        return myIsTrue;
+    }
+
+} // namespace sdb
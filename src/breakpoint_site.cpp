@@ -1,12 +1,52 @@
 #include <breakpoint_site.hpp>
+#include <memory_operations.hpp>
 #include <process.hpp>
 
+#include <algorithm>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
 namespace sdb {
+    namespace {
+        // Sites further apart than this are written separately rather than
+        // with the code between them
+        constexpr std::uint64_t MAX_RUN_GAP{256};
+
+        // A tracer may write to code mapped read-only through the process's
+        // memory file, in a single call. Kernels can forbid that, in which
+        // case the caller falls back to poking a word at a time.
+        bool writeProcessMemoryFile(pid_t aPid, VirtualAddress anAddress,
+                                    std::span<const std::byte> aData) {
+            auto myPath = fmt::format("/proc/{}/mem", aPid);
+            int myFd = open(myPath.c_str(), O_RDWR | O_CLOEXEC);
+            if (myFd < 0) {
+                return false;
+            }
+
+            auto myWritten =
+                pwrite(myFd, aData.data(), aData.size(),
+                       static_cast<off_t>(std::to_underlying(anAddress)));
+            close(myFd);
+            return myWritten == static_cast<ssize_t>(aData.size());
+        }
+    } // namespace
+
     void BreakpointSite::enable() {
         if (theEnabled) {
             return;
         }
 
+        if (theNativeCondition) {
+            auto& myDisplaced = theNativeCondition->getDisplaced();
+            theSavedData = myDisplaced.theOriginal.front();
+            writeMemory(theProcess.getPid(), theAddress,
+                        theNativeCondition->getPatch());
+            theEnabled = true;
+            return;
+        }
+
         std::uint64_t myData = getDataAtAddress();
 
         theSavedData = static_cast<std::byte>(myData & 0xff);
@@ -17,6 +57,59 @@ namespace sdb {
         theEnabled = true;
     }
 
+    void BreakpointSite::enableAll(std::span<BreakpointSite* const> aSites) {
+        std::vector<BreakpointSite*> mySites;
+        for (auto* mySite : aSites) {
+            if (mySite->theEnabled) {
+                continue;
+            }
+
+            if (mySite->theNativeCondition) {
+                mySite->enable();
+                continue;
+            }
+            mySites.push_back(mySite);
+        }
+
+        std::ranges::sort(mySites, {}, [](const BreakpointSite* aSite) {
+            return aSite->theAddress;
+        });
+
+        std::size_t myRunBegin = 0;
+        while (myRunBegin < mySites.size()) {
+            auto myRunEnd = myRunBegin + 1;
+            while (myRunEnd < mySites.size() and
+                   std::to_underlying(mySites[myRunEnd]->theAddress) -
+                           std::to_underlying(
+                               mySites[myRunEnd - 1]->theAddress) <=
+                       MAX_RUN_GAP) {
+                ++myRunEnd;
+            }
+
+            auto& myProcess = mySites[myRunBegin]->theProcess;
+            auto myStart = mySites[myRunBegin]->theAddress;
+            auto mySize =
+                std::to_underlying(mySites[myRunEnd - 1]->theAddress) -
+                std::to_underlying(myStart) + 1;
+            auto myCode = readMemory(myProcess.getPid(), myStart, mySize);
+            for (auto myI = myRunBegin; myI < myRunEnd; ++myI) {
+                auto myOffset = std::to_underlying(mySites[myI]->theAddress) -
+                                std::to_underlying(myStart);
+                mySites[myI]->theSavedData = myCode[myOffset];
+                myCode[myOffset] = static_cast<std::byte>(INT3);
+            }
+
+            if (!writeProcessMemoryFile(myProcess.getPid(), myStart, myCode)) {
+                writeMemory(myProcess.getPid(), myStart, myCode);
+            }
+
+            for (auto myI = myRunBegin; myI < myRunEnd; ++myI) {
+                mySites[myI]->theEnabled = true;
+            }
+            myRunBegin = myRunEnd;
+        }
+    }
+
     void BreakpointSite::disable() {
         if (!theEnabled) {
             Error::send(fmt::format(
@@ -24,6 +117,14 @@ namespace sdb {
                 std::to_underlying(theAddress)));
         }
 
+        if (theNativeCondition) {
+            writeMemory(theProcess.getPid(), theAddress,
+                        theNativeCondition->getDisplaced().theOriginal);
+            theSavedData = std::byte{0};
+            theEnabled = false;
+            return;
+        }
+
         std::uint64_t myData = getDataAtAddress();
         std::uint64_t myDataToWrite =
             (myData & ~0xff) | static_cast<std::uint8_t>(theSavedData);
@@ -34,6 +135,38 @@ namespace sdb {
         theEnabled = false;
     }
 
+    void BreakpointSite::setCondition(
+        std::optional<BreakpointCondition> aCondition) {
+        bool myWasEnabled = theEnabled;
+        if (myWasEnabled and theNativeCondition) {
+            disable();
+        }
+
+        theNativeCondition.reset();
+        theCondition = std::move(aCondition);
+        if (myWasEnabled) {
+            enable();
+        }
+    }
+
+    void BreakpointSite::setNativeCondition(BreakpointCondition aCondition) {
+        // The trampoline reads the code the site displaces, so it is written
+        // before the site changes
+        auto myNative =
+            NativeCondition::inject(theProcess, theAddress, aCondition);
+
+        bool myWasEnabled = theEnabled;
+        if (myWasEnabled) {
+            disable();
+        }
+
+        theNativeCondition = std::move(myNative);
+        theCondition = std::move(aCondition);
+        if (myWasEnabled) {
+            enable();
+        }
+    }
+
     std::uint64_t BreakpointSite::getDataAtAddress() {
         errno = 0;
         std::uint64_t myData = ptrace(PTRACE_PEEKDATA, theProcess.getPid(),
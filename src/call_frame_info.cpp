@@ -0,0 +1,513 @@
+#include <call_frame_info.hpp>
+
+#include <algorithm>
+#include <dwarf_constants.hpp>
+#include <dwarf_cursor.hpp>
+#include <elf_file.hpp>
+#include <error.hpp>
+#include <fmt/format.h>
+
+namespace sdb {
+
+    using namespace dwarf;
+
+    namespace {
+        // Length and id of a CIE or FDE, returning the offset of its end
+        std::uint64_t readEntryHeader(DwarfCursor& aCursor, bool& anIs64Bit) {
+            std::uint64_t myLength = aCursor.u32();
+            anIs64Bit = myLength == 0xffffffff;
+            if (anIs64Bit) {
+                myLength = aCursor.u64();
+            }
+
+            return aCursor.getOffset() + myLength;
+        }
+
+        std::pair<std::span<const std::byte>, std::uint64_t>
+        getSectionWithAddress(const ElfFile& anElf, std::string_view aName) {
+            auto* mySection = anElf.getSection(aName);
+            if (mySection == nullptr or mySection->sh_type == SHT_NOBITS) {
+                return {};
+            }
+
+            return {anElf.getSectionContents(aName), mySection->sh_addr};
+        }
+    } // namespace
+
+    bool CfiRow::isFramePointerFrame() const {
+        return theCfaRegister == RBP and theCfaOffset == 16 and
+               theRules[RBP] ==
+                   RegisterRule{RegisterRule::Kind::Offset, -16} and
+               theRules[RETURN_ADDRESS] ==
+                   RegisterRule{RegisterRule::Kind::Offset, -8};
+    }
+
+    CallFrameInfo::CallFrameInfo(const ElfFile& anElf) {
+        std::tie(theEhFrame, theEhFrameAddress) =
+            getSectionWithAddress(anElf, ".eh_frame");
+
+        auto [myHdr, myHdrAddress] =
+            getSectionWithAddress(anElf, ".eh_frame_hdr");
+        theEhFrameHdrAddress = myHdrAddress;
+        if (!theEhFrame.empty() and !myHdr.empty()) {
+            parseEhFrameHdr(myHdr);
+        }
+    }
+
+    void CallFrameInfo::parseEhFrameHdr(std::span<const std::byte> aHdr) {
+        DwarfCursor myCursor{aHdr};
+
+        auto myVersion = myCursor.u8();
+        auto myEhFramePtrEncoding = myCursor.u8();
+        auto myCountEncoding = myCursor.u8();
+        auto myTableEncoding = myCursor.u8();
+
+        // Only the layout every linker emits is searched in place; anything
+        // else falls back to indexing .eh_frame
+        if (myVersion != 1 or
+            myTableEncoding != (DW_EH_PE_datarel | DW_EH_PE_sdata4) or
+            myCountEncoding == DW_EH_PE_omit) {
+            return;
+        }
+
+        readPointer(myCursor, myEhFramePtrEncoding, theEhFrameHdrAddress);
+        auto myCount =
+            readPointer(myCursor, myCountEncoding, theEhFrameHdrAddress);
+
+        auto myTable = aHdr.subspan(myCursor.getOffset());
+        if (myCount > myTable.size() / 8) {
+            return;
+        }
+
+        theSearchTable = myTable.first(myCount * 8);
+        theSearchTableCount = myCount;
+    }
+
+    std::uint64_t CallFrameInfo::readPointer(
+        DwarfCursor& aCursor, std::uint8_t anEncoding,
+        std::uint64_t aSectionAddress) const {
+        if (anEncoding == DW_EH_PE_omit) {
+            return 0;
+        }
+
+        auto myFieldAddress = aSectionAddress + aCursor.getOffset();
+
+        std::uint64_t myValue = 0;
+        switch (anEncoding & 0x0f) {
+            case DW_EH_PE_absptr:
+            case DW_EH_PE_udata8:
+            case DW_EH_PE_sdata8:
+                myValue = aCursor.u64();
+                break;
+            case DW_EH_PE_uleb128:
+                myValue = aCursor.uleb128();
+                break;
+            case DW_EH_PE_udata2:
+                myValue = aCursor.u16();
+                break;
+            case DW_EH_PE_udata4:
+                myValue = aCursor.u32();
+                break;
+            case DW_EH_PE_sleb128:
+                myValue = static_cast<std::uint64_t>(aCursor.sleb128());
+                break;
+            case DW_EH_PE_sdata2:
+                myValue = static_cast<std::uint64_t>(
+                    static_cast<std::int16_t>(aCursor.u16()));
+                break;
+            case DW_EH_PE_sdata4:
+                myValue = static_cast<std::uint64_t>(
+                    static_cast<std::int32_t>(aCursor.u32()));
+                break;
+            default:
+                Error::send(fmt::format("Unsupported pointer encoding {:#x}",
+                                        anEncoding));
+        }
+
+        // Indirect pointers are returned as the address they are stored at;
+        // only personality routines use them and those are never followed
+        switch (anEncoding & 0x70) {
+            case DW_EH_PE_absptr:
+                break;
+            case DW_EH_PE_pcrel:
+                myValue += myFieldAddress;
+                break;
+            case DW_EH_PE_datarel:
+                myValue += theEhFrameHdrAddress;
+                break;
+            default:
+                Error::send(fmt::format(
+                    "Unsupported pointer application {:#x}", anEncoding));
+        }
+
+        return myValue;
+    }
+
+    const CallFrameInfo::Cie&
+    CallFrameInfo::getCie(std::uint64_t anOffset) const {
+        if (auto myIt = theCies.find(anOffset); myIt != theCies.end()) {
+            return myIt->second;
+        }
+
+        DwarfCursor myCursor{theEhFrame, anOffset};
+        bool myIs64Bit = false;
+        auto myEnd = readEntryHeader(myCursor, myIs64Bit);
+
+        if (myCursor.offset(myIs64Bit) != 0) {
+            Error::send("FDE does not point to a CIE");
+        }
+
+        Cie myCie;
+        auto myVersion = myCursor.u8();
+        auto myAugmentation = myCursor.string();
+        if (myAugmentation.find("eh") != std::string_view::npos) {
+            myCursor.skip(8);
+        }
+
+        myCie.theCodeAlignment = myCursor.uleb128();
+        myCie.theDataAlignment = myCursor.sleb128();
+        myCie.theReturnAddressRegister =
+            myVersion == 1 ? myCursor.u8() : myCursor.uleb128();
+
+        if (myAugmentation.starts_with('z')) {
+            myCie.theHasAugmentationData = true;
+            auto myLength = myCursor.uleb128();
+            auto myDataEnd = myCursor.getOffset() + myLength;
+
+            for (auto myChar : myAugmentation.substr(1)) {
+                if (myChar == 'R') {
+                    myCie.theFdeEncoding = myCursor.u8();
+                } else if (myChar == 'L') {
+                    myCursor.u8();
+                } else if (myChar == 'P') {
+                    auto myEncoding = myCursor.u8();
+                    readPointer(myCursor, myEncoding, theEhFrameAddress);
+                } else if (myChar != 'S' and myChar != 'B') {
+                    // Unknown augmentations are skipped using the length
+                    break;
+                }
+            }
+
+            myCursor.seek(myDataEnd);
+        }
+
+        myCie.theInstructionsBegin = myCursor.getOffset();
+        myCie.theInstructionsEnd = myEnd;
+
+        return theCies.emplace(anOffset, myCie).first->second;
+    }
+
+    CallFrameInfo::Fde CallFrameInfo::parseFde(std::uint64_t anOffset) const {
+        DwarfCursor myCursor{theEhFrame, anOffset};
+        bool myIs64Bit = false;
+        auto myEnd = readEntryHeader(myCursor, myIs64Bit);
+
+        // The CIE pointer is relative to the position of the field itself
+        auto myPointerOffset = myCursor.getOffset();
+        auto myCieOffset = myPointerOffset - myCursor.offset(myIs64Bit);
+        auto& myCie = getCie(myCieOffset);
+
+        Fde myFde;
+        myFde.theBegin =
+            readPointer(myCursor, myCie.theFdeEncoding, theEhFrameAddress);
+
+        // The range is a length, so only the value format applies
+        myFde.theEnd = myFde.theBegin +
+                       readPointer(myCursor, myCie.theFdeEncoding & 0x0f,
+                                   theEhFrameAddress);
+
+        if (myCie.theHasAugmentationData) {
+            myCursor.skip(myCursor.uleb128());
+        }
+
+        CfiRow myInitialRow;
+        myInitialRow.theLocation = myFde.theBegin;
+        runInstructions(myCie.theInstructionsBegin, myCie.theInstructionsEnd,
+                        myCie, myInitialRow, myInitialRow, nullptr);
+
+        CfiRow myRow = myInitialRow;
+        runInstructions(myCursor.getOffset(), myEnd, myCie, myInitialRow, myRow,
+                        &myFde.theRows);
+        myFde.theRows.push_back(myRow);
+
+        return myFde;
+    }
+
+    void CallFrameInfo::runInstructions(std::uint64_t aBegin,
+                                        std::uint64_t anEnd, const Cie& aCie,
+                                        const CfiRow& anInitialRow,
+                                        CfiRow& aRow,
+                                        std::vector<CfiRow>* aRows) const {
+        DwarfCursor myCursor{theEhFrame.first(anEnd), aBegin};
+        std::vector<CfiRow> myRememberedRows;
+
+        auto myAdvance = [&](std::uint64_t aDelta) {
+            if (aRows != nullptr) {
+                aRows->push_back(aRow);
+            }
+            aRow.theLocation += aDelta * aCie.theCodeAlignment;
+        };
+
+        auto mySetRule = [&](std::uint64_t aRegister, RegisterRule aRule) {
+            // Rules for vector and other registers are of no use here
+            if (aRegister < CfiRow::NUM_REGISTERS) {
+                aRow.theRules[aRegister] = aRule;
+            }
+        };
+
+        auto myRestore = [&](std::uint64_t aRegister) {
+            if (aRegister < CfiRow::NUM_REGISTERS) {
+                aRow.theRules[aRegister] = anInitialRow.theRules[aRegister];
+            }
+        };
+
+        auto myFactored = [&](std::int64_t anOffset) {
+            return anOffset * aCie.theDataAlignment;
+        };
+
+        using enum RegisterRule::Kind;
+
+        while (!myCursor.finished()) {
+            auto myOpcode = myCursor.u8();
+            auto myOperand = myOpcode & 0x3f;
+
+            switch (myOpcode & 0xc0) {
+                case DW_CFA_advance_loc:
+                    myAdvance(myOperand);
+                    continue;
+                case DW_CFA_offset:
+                    mySetRule(myOperand,
+                              {Offset, myFactored(myCursor.uleb128())});
+                    continue;
+                case DW_CFA_restore:
+                    myRestore(myOperand);
+                    continue;
+                default:
+                    break;
+            }
+
+            switch (myOpcode) {
+                case DW_CFA_nop:
+                    break;
+                case DW_CFA_set_loc: {
+                    auto myLocation = readPointer(
+                        myCursor, aCie.theFdeEncoding, theEhFrameAddress);
+                    myAdvance(0);
+                    aRow.theLocation = myLocation;
+                    break;
+                }
+                case DW_CFA_advance_loc1:
+                    myAdvance(myCursor.u8());
+                    break;
+                case DW_CFA_advance_loc2:
+                    myAdvance(myCursor.u16());
+                    break;
+                case DW_CFA_advance_loc4:
+                    myAdvance(myCursor.u32());
+                    break;
+                case DW_CFA_offset_extended: {
+                    auto myRegister = myCursor.uleb128();
+                    mySetRule(myRegister,
+                              {Offset, myFactored(myCursor.uleb128())});
+                    break;
+                }
+                case DW_CFA_offset_extended_sf: {
+                    auto myRegister = myCursor.uleb128();
+                    mySetRule(myRegister,
+                              {Offset, myFactored(myCursor.sleb128())});
+                    break;
+                }
+                case DW_CFA_GNU_negative_offset_extended: {
+                    auto myRegister = myCursor.uleb128();
+                    mySetRule(myRegister,
+                              {Offset, -myFactored(myCursor.uleb128())});
+                    break;
+                }
+                case DW_CFA_val_offset: {
+                    auto myRegister = myCursor.uleb128();
+                    mySetRule(myRegister,
+                              {ValueOffset, myFactored(myCursor.uleb128())});
+                    break;
+                }
+                case DW_CFA_val_offset_sf: {
+                    auto myRegister = myCursor.uleb128();
+                    mySetRule(myRegister,
+                              {ValueOffset, myFactored(myCursor.sleb128())});
+                    break;
+                }
+                case DW_CFA_restore_extended:
+                    myRestore(myCursor.uleb128());
+                    break;
+                case DW_CFA_undefined:
+                    mySetRule(myCursor.uleb128(), {Undefined, 0});
+                    break;
+                case DW_CFA_same_value:
+                    mySetRule(myCursor.uleb128(), {SameValue, 0});
+                    break;
+                case DW_CFA_register: {
+                    auto myRegister = myCursor.uleb128();
+                    auto mySource =
+                        static_cast<std::int64_t>(myCursor.uleb128());
+                    mySetRule(myRegister, {Register, mySource});
+                    break;
+                }
+                case DW_CFA_remember_state:
+                    myRememberedRows.push_back(aRow);
+                    break;
+                case DW_CFA_restore_state: {
+                    if (myRememberedRows.empty()) {
+                        Error::send("Unbalanced DW_CFA_restore_state");
+                    }
+
+                    // The location is not part of the remembered state
+                    auto myLocation = aRow.theLocation;
+                    aRow = myRememberedRows.back();
+                    aRow.theLocation = myLocation;
+                    myRememberedRows.pop_back();
+                    break;
+                }
+                case DW_CFA_def_cfa:
+                    aRow.theCfaRegister =
+                        static_cast<std::int32_t>(myCursor.uleb128());
+                    aRow.theCfaOffset =
+                        static_cast<std::int64_t>(myCursor.uleb128());
+                    break;
+                case DW_CFA_def_cfa_sf:
+                    aRow.theCfaRegister =
+                        static_cast<std::int32_t>(myCursor.uleb128());
+                    aRow.theCfaOffset = myFactored(myCursor.sleb128());
+                    break;
+                case DW_CFA_def_cfa_register:
+                    aRow.theCfaRegister =
+                        static_cast<std::int32_t>(myCursor.uleb128());
+                    break;
+                case DW_CFA_def_cfa_offset:
+                    aRow.theCfaOffset =
+                        static_cast<std::int64_t>(myCursor.uleb128());
+                    break;
+                case DW_CFA_def_cfa_offset_sf:
+                    aRow.theCfaOffset = myFactored(myCursor.sleb128());
+                    break;
+                case DW_CFA_def_cfa_expression:
+                    myCursor.skip(myCursor.uleb128());
+                    aRow.theCfaRegister = -1;
+                    break;
+                case DW_CFA_expression:
+                case DW_CFA_val_expression: {
+                    auto myRegister = myCursor.uleb128();
+                    myCursor.skip(myCursor.uleb128());
+                    mySetRule(myRegister, {Undefined, 0});
+                    break;
+                }
+                case DW_CFA_GNU_args_size:
+                    myCursor.uleb128();
+                    break;
+                default:
+                    Error::send(fmt::format("Unsupported call frame "
+                                            "instruction {:#x}",
+                                            myOpcode));
+            }
+        }
+    }
+
+    void CallFrameInfo::buildFdeLocations() const {
+        theFdeLocationsBuilt = true;
+
+        DwarfCursor myCursor{theEhFrame};
+        while (!myCursor.finished()) {
+            auto myOffset = myCursor.getOffset();
+            bool myIs64Bit = false;
+            auto myEnd = readEntryHeader(myCursor, myIs64Bit);
+            if (myEnd == myCursor.getOffset()) {
+                break;
+            }
+
+            auto myPointerOffset = myCursor.getOffset();
+            auto myCiePointer = myCursor.offset(myIs64Bit);
+            if (myCiePointer != 0) {
+                auto& myCie = getCie(myPointerOffset - myCiePointer);
+                theFdeLocations.push_back(
+                    {readPointer(myCursor, myCie.theFdeEncoding,
+                                 theEhFrameAddress),
+                     myOffset});
+            }
+
+            myCursor.seek(myEnd);
+        }
+
+        std::ranges::sort(theFdeLocations, {}, &FdeLocation::theBegin);
+    }
+
+    std::optional<std::uint64_t>
+    CallFrameInfo::findFdeOffset(std::uint64_t anAddress) const {
+        if (theSearchTableCount > 0) {
+            auto myLocationAt = [&](std::size_t anIdx) {
+                DwarfCursor myCursor{theSearchTable, anIdx * 8};
+                return theEhFrameHdrAddress +
+                       static_cast<std::int32_t>(myCursor.u32());
+            };
+
+            // Last entry starting at or before the address
+            std::size_t myLow = 0;
+            std::size_t myHigh = theSearchTableCount;
+            while (myLow < myHigh) {
+                auto myMid = myLow + (myHigh - myLow) / 2;
+                if (myLocationAt(myMid) <= anAddress) {
+                    myLow = myMid + 1;
+                } else {
+                    myHigh = myMid;
+                }
+            }
+            if (myLow == 0) {
+                return std::nullopt;
+            }
+
+            DwarfCursor myCursor{theSearchTable, (myLow - 1) * 8 + 4};
+            auto myFdeAddress = theEhFrameHdrAddress +
+                                static_cast<std::int32_t>(myCursor.u32());
+            return myFdeAddress - theEhFrameAddress;
+        }
+
+        if (!theFdeLocationsBuilt) {
+            buildFdeLocations();
+        }
+
+        auto myIt = std::ranges::upper_bound(theFdeLocations, anAddress, {},
+                                             &FdeLocation::theBegin);
+        if (myIt == theFdeLocations.begin()) {
+            return std::nullopt;
+        }
+
+        return std::prev(myIt)->theOffset;
+    }
+
+    const CfiRow* CallFrameInfo::findRow(std::uint64_t aFileAddress) const {
+        if (theEhFrame.empty()) {
+            return nullptr;
+        }
+
+        auto myOffset = findFdeOffset(aFileAddress);
+        if (!myOffset or *myOffset >= theEhFrame.size()) {
+            return nullptr;
+        }
+
+        auto myIt = theFdes.find(*myOffset);
+        if (myIt == theFdes.end()) {
+            myIt = theFdes.emplace(*myOffset, parseFde(*myOffset)).first;
+        }
+
+        auto& myFde = myIt->second;
+        if (aFileAddress < myFde.theBegin or aFileAddress >= myFde.theEnd) {
+            return nullptr;
+        }
+
+        auto myRow = std::ranges::upper_bound(myFde.theRows, aFileAddress, {},
+                                              &CfiRow::theLocation);
+        return std::addressof(*std::prev(myRow));
+    }
+
+    std::size_t CallFrameInfo::getNumCachedFdes() const {
+        return theFdes.size();
+    }
+
+} // namespace sdb
@@ -0,0 +1,157 @@
+#include <call_hooks.hpp>
+
+#include <bit.hpp>
+#include <error.hpp>
+#include <memory_operations.hpp>
+#include <process.hpp>
+
+namespace sdb {
+
+    namespace {
+        void removeSite(Process& aProcess, BreakpointSiteId anId) {
+            auto& mySites = aProcess.getBreakpointSites();
+            if (!mySites.contains_id(anId)) {
+                return;
+            }
+
+            auto& mySite = mySites.getById(anId);
+            if (mySite.isEnabled()) {
+                mySite.disable();
+            }
+            mySites.removeById(anId);
+        }
+    } // namespace
+
+    BreakpointSite& CallHooks::createEntrySite(VirtualAddress anEntry,
+                                               Hook aHook) {
+        auto& mySite = createSite(anEntry);
+        auto myHook = theHooks.size();
+        theHooks.push_back(std::move(aHook));
+        mySite.setHitHandler([this, myHook]() { return onEntry(myHook); });
+        theEntrySites.push_back(mySite.getId());
+        return mySite;
+    }
+
+    void CallHooks::clear() {
+        for (auto myId : theEntrySites) {
+            removeSite(theProcess, myId);
+        }
+        for (auto& [myAddress, myReturn] : theReturnSites) {
+            removeSite(theProcess, myReturn.theSiteId);
+        }
+
+        theHooks.clear();
+        theEntrySites.clear();
+        theFrames.clear();
+        theReturnSites.clear();
+        theRetiredSites.clear();
+    }
+
+    BreakpointSite& CallHooks::createSite(VirtualAddress anAddress) {
+        auto& mySite = theProcess.createBreakpointSite(anAddress, true);
+        if (theOnResume) {
+            mySite.setResumeHandler(
+                [this](std::chrono::steady_clock::duration aLatency) {
+                    theOnResume(aLatency);
+                });
+        }
+        return mySite;
+    }
+
+    bool CallHooks::onEntry(std::size_t aHook) {
+        removeRetiredSites();
+        auto& myHook = theHooks[aHook];
+        if (!myHook.theOnEntry()) {
+            return true;
+        }
+
+        auto mySp = theProcess.getRegisters().getRegisterData().regs.rsp;
+        std::uint64_t myReturn = 0;
+        try {
+            auto myBytes =
+                readMemory(theProcess.getPid(), VirtualAddress{mySp}, 8);
+            myReturn = fromBytes<std::uint64_t>(myBytes.data());
+        } catch (const Error&) {
+            myHook.theOnReturn(false);
+            return true;
+        }
+
+        auto myIt = theReturnSites.find(myReturn);
+        if (myIt == theReturnSites.end()) {
+            // A breakpoint of another kind cannot be shared
+            auto& mySites = theProcess.getBreakpointSites();
+            if (mySites.contains_address(VirtualAddress{myReturn})) {
+                myHook.theOnReturn(false);
+                return true;
+            }
+
+            auto& mySite = createSite(VirtualAddress{myReturn});
+            mySite.setHitHandler(
+                [this, myReturn]() { return onReturn(myReturn); });
+            mySite.enable();
+            myIt = theReturnSites.emplace(myReturn,
+                                          ReturnSite{mySite.getId(), 0})
+                       .first;
+        }
+        ++myIt->second.theNumCalls;
+
+        theFrames[theProcess.getPid()].push_back(
+            Frame{aHook, myReturn, mySp});
+        return true;
+    }
+
+    bool CallHooks::onReturn(std::uint64_t anAddress) {
+        auto mySp = theProcess.getRegisters().getRegisterData().regs.rsp;
+        auto& myFrames = theFrames[theProcess.getPid()];
+
+        // The ret popped the return address, so the returning call entered
+        // with the stack pointer just below. Calls entered further down
+        // were left without returning.
+        while (!myFrames.empty() and myFrames.back().theEntrySp + 8 < mySp) {
+            auto myFrame = myFrames.back();
+            myFrames.pop_back();
+            releaseReturn(myFrame.theReturn);
+            theHooks[myFrame.theHook].theOnReturn(false);
+        }
+        if (myFrames.empty() or myFrames.back().theEntrySp + 8 != mySp or
+            myFrames.back().theReturn != anAddress) {
+            return true;
+        }
+
+        auto myFrame = myFrames.back();
+        myFrames.pop_back();
+        releaseReturn(anAddress);
+        theHooks[myFrame.theHook].theOnReturn(true);
+        return true;
+    }
+
+    void CallHooks::releaseReturn(std::uint64_t anAddress) {
+        auto myIt = theReturnSites.find(anAddress);
+        if (myIt == theReturnSites.end() or --myIt->second.theNumCalls > 0 or
+            theIsKeepingReturns) {
+            return;
+        }
+
+        theProcess.getBreakpointSites()
+            .getById(myIt->second.theSiteId)
+            .disable();
+        theRetiredSites.push_back(anAddress);
+    }
+
+    void CallHooks::removeRetiredSites() {
+        auto& mySites = theProcess.getBreakpointSites();
+        for (auto myAddress : theRetiredSites) {
+            auto myIt = theReturnSites.find(myAddress);
+            if (myIt == theReturnSites.end() or myIt->second.theNumCalls > 0) {
+                continue;
+            }
+
+            if (mySites.contains_id(myIt->second.theSiteId)) {
+                mySites.removeById(myIt->second.theSiteId);
+            }
+            theReturnSites.erase(myIt);
+        }
+        theRetiredSites.clear();
+    }
+
+} // namespace sdb
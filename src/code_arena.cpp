@@ -0,0 +1,336 @@
+#include <code_arena.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <disassembler.hpp>
+#include <error.hpp>
+#include <fmt/format.h>
+#include <fstream>
+#include <memory_operations.hpp>
+#include <optional>
+#include <process.hpp>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+namespace sdb {
+
+    namespace {
+        // Lowest address mmap allows by default, and the end of the user
+        // half of the address space
+        constexpr std::uint64_t MIN_MAP_ADDRESS{0x10000};
+        constexpr std::uint64_t USER_SPACE_END{0x7ffffffff000};
+
+        // Keeps a whole code page in reach of the 32 bit displacement of
+        // the jump at the site
+        constexpr std::uint64_t JUMP_REACH{(1ULL << 31) -
+                                           2 * CodeArena::PAGE_BYTES};
+
+        // Whether the instruction, as printed by the disassembler, runs the
+        // same at another address
+        bool isRelocatable(std::string_view anInstruction) {
+            if (anInstruction.find("%rip") != std::string_view::npos or
+                anInstruction.find("(bad)") != std::string_view::npos) {
+                return false;
+            }
+
+            static constexpr std::string_view myPrefixes[]{
+                "lock", "rep",     "repz", "repnz", "repe", "repne",
+                "bnd",  "notrack", "cs",   "ds",    "data16"};
+
+            std::string_view myMnemonic;
+            std::string_view myRest = anInstruction;
+            while (!myRest.empty()) {
+                auto myEnd = myRest.find_first_of(" \t");
+                auto myWord = myRest.substr(0, myEnd);
+                myRest = myEnd == std::string_view::npos
+                             ? std::string_view{}
+                             : myRest.substr(myEnd + 1);
+
+                if (!myWord.empty() and
+                    std::ranges::find(myPrefixes, myWord) ==
+                        std::end(myPrefixes)) {
+                    myMnemonic = myWord;
+                    break;
+                }
+            }
+
+            return !myMnemonic.empty() and !myMnemonic.starts_with('j') and
+                   !myMnemonic.starts_with("call") and
+                   !myMnemonic.starts_with("ret") and
+                   !myMnemonic.starts_with("loop") and
+                   !myMnemonic.starts_with("iret") and
+                   !myMnemonic.starts_with("xbegin");
+        }
+
+        // The closest unmapped page whose code can be reached with a 32 bit
+        // jump from the address. Pages below it are preferred, and the
+        // space just above the heap is left for it to grow into.
+        std::optional<VirtualAddress> findCodePage(pid_t aPid,
+                                                   VirtualAddress aNear) {
+            constexpr auto myPageSize = CodeArena::PAGE_BYTES;
+            auto myNear = std::to_underlying(aNear) & ~(myPageSize - 1);
+            auto myLow = std::max(
+                myNear > JUMP_REACH ? myNear - JUMP_REACH : 0,
+                MIN_MAP_ADDRESS);
+            auto myHigh = std::min(myNear + JUMP_REACH, USER_SPACE_END);
+
+            std::optional<std::uint64_t> myBelow;
+            std::optional<std::uint64_t> myAbove;
+            auto considerGap = [&](std::uint64_t aStart, std::uint64_t anEnd,
+                                   bool anIsAfterHeap) {
+                aStart = std::max(aStart, myLow);
+                anEnd = std::min(anEnd, myHigh);
+                if (aStart >= anEnd or anEnd - aStart < myPageSize) {
+                    return;
+                }
+
+                if (anEnd <= myNear) {
+                    myBelow = std::max(myBelow.value_or(0),
+                                       anEnd - myPageSize);
+                } else if (!anIsAfterHeap and !myAbove) {
+                    myAbove = aStart;
+                }
+            };
+
+            std::ifstream myMaps{fmt::format("/proc/{}/maps", aPid)};
+            std::string myLine;
+            std::uint64_t myPreviousEnd = MIN_MAP_ADDRESS;
+            bool myIsAfterHeap = false;
+            while (std::getline(myMaps, myLine)) {
+                auto myDash = myLine.find('-');
+                auto mySpace = myLine.find(' ');
+                if (myDash == std::string::npos or
+                    mySpace == std::string::npos) {
+                    continue;
+                }
+
+                auto myStart = std::stoull(myLine.substr(0, myDash), nullptr,
+                                           16);
+                auto myEnd = std::stoull(
+                    myLine.substr(myDash + 1, mySpace - myDash - 1), nullptr,
+                    16);
+                if (myStart >= USER_SPACE_END) {
+                    break;
+                }
+
+                considerGap(myPreviousEnd, myStart, myIsAfterHeap);
+                myPreviousEnd = std::max<std::uint64_t>(myPreviousEnd, myEnd);
+                myIsAfterHeap = myLine.ends_with("[heap]");
+            }
+            considerGap(myPreviousEnd, USER_SPACE_END, myIsAfterHeap);
+
+            if (auto myPage = myBelow ? myBelow : myAbove) {
+                return VirtualAddress{*myPage};
+            }
+            return std::nullopt;
+        }
+
+        bool isInJumpReach(VirtualAddress aFrom, VirtualAddress aTo) {
+            auto myFrom = std::to_underlying(aFrom);
+            auto myTo = std::to_underlying(aTo);
+            return (myFrom > myTo ? myFrom - myTo : myTo - myFrom) <
+                   JUMP_REACH;
+        }
+    } // namespace
+
+    std::uint64_t injectCheckedSyscall(
+        Process& aProcess, std::uint64_t aNumber,
+        std::initializer_list<std::uint64_t> anArgs) {
+        auto myResult = aProcess.injectSyscall(aNumber, anArgs);
+        if (myResult < 0 and myResult >= -4095) {
+            Error::send(fmt::format(
+                "Injected system call {} failed: {}", aNumber,
+                std::strerror(static_cast<int>(-myResult))));
+        }
+
+        return static_cast<std::uint64_t>(myResult);
+    }
+
+    std::optional<std::uint8_t> getRegisterEncoding(RegisterId anId) {
+        switch (anId) {
+            case RegisterId::rax: return 0;
+            case RegisterId::rcx: return 1;
+            case RegisterId::rdx: return 2;
+            case RegisterId::rbx: return 3;
+            case RegisterId::rsp: return 4;
+            case RegisterId::rbp: return 5;
+            case RegisterId::rsi: return 6;
+            case RegisterId::rdi: return 7;
+            case RegisterId::r8: return 8;
+            case RegisterId::r9: return 9;
+            case RegisterId::r10: return 10;
+            case RegisterId::r11: return 11;
+            case RegisterId::r12: return 12;
+            case RegisterId::r13: return 13;
+            case RegisterId::r14: return 14;
+            case RegisterId::r15: return 15;
+            default: return std::nullopt;
+        }
+    }
+
+    void TrampolineFrame::emitSave(CodeBuffer& aCode) {
+        aCode.emit({0x48, 0x8d, 0x64, 0x24, 0x80}); // lea rsp, [rsp-128]
+        aCode.emit({0x9c});                         // pushfq
+        aCode.emit({0x50, 0x51, 0x52, 0x56});       // push rax, rcx, rdx, rsi
+    }
+
+    void TrampolineFrame::emitRestoreRegisters(CodeBuffer& aCode) {
+        aCode.emit({0x5e, 0x5a, 0x59, 0x58}); // pop rsi, rdx, rcx, rax
+    }
+
+    void TrampolineFrame::emitRestoreFlags(CodeBuffer& aCode) {
+        aCode.emit({0x9d});                   // popfq
+        aCode.emit({0x48, 0x8d, 0xa4, 0x24}); // lea rsp, [rsp+128]
+        aCode.emitValue(RED_ZONE_SIZE);
+    }
+
+    bool TrampolineFrame::emitLoad(CodeBuffer& aCode, RegisterId anId,
+                                   VirtualAddress aSite,
+                                   std::int32_t aPushed) {
+        std::optional<std::int32_t> mySaved;
+        switch (anId) {
+            case RegisterId::rax: mySaved = SAVED_RAX; break;
+            case RegisterId::rcx: mySaved = SAVED_RCX; break;
+            case RegisterId::rdx: mySaved = SAVED_RDX; break;
+            case RegisterId::rsi: mySaved = SAVED_RSI; break;
+            case RegisterId::eflags: mySaved = SAVED_FLAGS; break;
+            default: break;
+        }
+
+        if (mySaved) {
+            aCode.emit({0x48, 0x8b, 0x84, 0x24}); // mov rax, [rsp+saved]
+            aCode.emitValue(*mySaved + aPushed);
+        } else if (anId == RegisterId::rsp) {
+            aCode.emit({0x48, 0x8d, 0x84, 0x24}); // lea rax, [rsp+...]
+            aCode.emitValue(ORIGINAL_RSP + aPushed);
+        } else if (anId == RegisterId::rip) {
+            aCode.emit({0x48, 0xb8}); // mov rax, site
+            aCode.emitValue(std::to_underlying(aSite));
+        } else if (auto myNumber = getRegisterEncoding(anId)) {
+            // mov rax, register
+            aCode.emit({static_cast<std::uint8_t>(
+                            *myNumber >= 8 ? 0x4c : 0x48),
+                        0x89,
+                        static_cast<std::uint8_t>(
+                            0xc0 | (*myNumber & 7) << 3)});
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    DisplacedCode DisplacedCode::at(Process& aProcess, VirtualAddress aSite) {
+        // Whole instructions covering the jump are moved to the trampoline
+        Disassembler myDisassembler{aProcess};
+        auto myInstructions = myDisassembler.disassemble(JUMP_SIZE + 1, aSite);
+        std::size_t myLength = 0;
+        for (std::size_t i = 0; myLength < JUMP_SIZE; ++i) {
+            if (!isRelocatable(myInstructions[i].theInstruction)) {
+                Error::send(fmt::format(
+                    "Cannot move \"{}\" at {:#x} to a trampoline",
+                    myInstructions[i].theInstruction,
+                    std::to_underlying(myInstructions[i].theAddress)));
+            }
+            myLength = std::to_underlying(myInstructions[i + 1].theAddress) -
+                       std::to_underlying(aSite);
+        }
+
+        // A site patched with a jump of its own may start just before
+        for (auto* mySite : aProcess.getBreakpointSites().getInRange(
+                 aSite - MAX_LENGTH, aSite + myLength - 1)) {
+            auto mySiteEnd = mySite->getAddress() +
+                             std::max<std::size_t>(
+                                 1, mySite->getSavedCode().size());
+            if (mySite->getAddress() != aSite and mySiteEnd > aSite) {
+                Error::send("A breakpoint is set in the instructions a "
+                            "trampoline would replace");
+            }
+        }
+        auto myPc = aProcess.getPc();
+        if (myPc > aSite and myPc < aSite + myLength) {
+            Error::send("The process is stopped in the instructions a "
+                        "trampoline would replace");
+        }
+
+        return DisplacedCode{
+            aSite, readMemoryWithoutBreakpointTraps(aProcess, aSite, myLength)};
+    }
+
+    void DisplacedCode::emit(CodeBuffer& aCode) const {
+        aCode.emitBytes(theOriginal);
+        aCode.emit({0xff, 0x25, 0x00, 0x00, 0x00, 0x00}); // jmp [rip]
+        aCode.emitValue(std::to_underlying(getEnd()));
+    }
+
+    std::vector<std::byte>
+    DisplacedCode::makePatch(VirtualAddress aTrampoline) const {
+        std::vector<std::byte> myPatch(theOriginal.size(), std::byte{0xcc});
+        myPatch[0] = std::byte{0xe9};
+        auto myRelative = static_cast<std::int32_t>(
+            std::to_underlying(aTrampoline) -
+            std::to_underlying(theSite + JUMP_SIZE));
+        std::memcpy(&myPatch[1], &myRelative, sizeof(myRelative));
+
+        return myPatch;
+    }
+
+    VirtualAddress CodeArena::allocateCode(VirtualAddress aNear,
+                                           std::size_t aSize) {
+        for (auto& myPage : theCodePages) {
+            auto myStart = myPage.theAddress + myPage.theUsed;
+            if (myPage.theUsed + aSize <= PAGE_BYTES and
+                isInJumpReach(aNear, myStart)) {
+                myPage.theUsed += aSize;
+                return myStart;
+            }
+        }
+
+        auto myPage = findCodePage(theProcess.getPid(), aNear);
+        if (!myPage) {
+            Error::send(fmt::format("No free memory within reach of {:#x}",
+                                    std::to_underlying(aNear)));
+        }
+
+        // Written through ptrace, so the page never has to be writable
+        auto myMapped = injectCheckedSyscall(
+            theProcess, SYS_mmap,
+            {std::to_underlying(*myPage), PAGE_BYTES, PROT_READ | PROT_EXEC,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE,
+             static_cast<std::uint64_t>(-1), 0});
+        if (myMapped != std::to_underlying(*myPage)) {
+            injectCheckedSyscall(theProcess, SYS_munmap,
+                                 {myMapped, PAGE_BYTES});
+            Error::send("The kernel does not support mapping code at a "
+                        "chosen address");
+        }
+
+        theCodePages.push_back(Page{*myPage, aSize});
+        return *myPage;
+    }
+
+    VirtualAddress CodeArena::allocateData(std::size_t aSize) {
+        // Kept aligned so counters can be updated with locked instructions
+        aSize = (aSize + 7) & ~std::size_t{7};
+        for (auto& myPage : theDataPages) {
+            if (myPage.theUsed + aSize <= PAGE_BYTES) {
+                auto myStart = myPage.theAddress + myPage.theUsed;
+                myPage.theUsed += aSize;
+                return myStart;
+            }
+        }
+
+        if (aSize > PAGE_BYTES) {
+            Error::send("Injected data does not fit in a page");
+        }
+
+        auto myPage = VirtualAddress{injectCheckedSyscall(
+            theProcess, SYS_mmap,
+            {0, PAGE_BYTES, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS, static_cast<std::uint64_t>(-1),
+             0})};
+        theDataPages.push_back(Page{myPage, aSize});
+        return myPage;
+    }
+
+} // namespace sdb
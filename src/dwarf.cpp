@@ -0,0 +1,1343 @@
+#include <dwarf.hpp>
+
+#include <algorithm>
+#include <array>
+#include <dwarf_constants.hpp>
+#include <elf_file.hpp>
+#include <error.hpp>
+#include <filesystem>
+#include <fmt/format.h>
+#include <numeric>
+#include <tuple>
+
+namespace sdb {
+
+    using namespace dwarf;
+
+    namespace {
+        std::span<const std::byte> getDebugSection(const ElfFile& anElf,
+                                                   std::string_view aName) {
+            // Compressed debug sections would need to be inflated before
+            // they can be read in place, which defeats mapping them
+            auto* mySection = anElf.getSection(aName);
+            if (mySection == nullptr or
+                (mySection->sh_flags & SHF_COMPRESSED)) {
+                return {};
+            }
+
+            return anElf.getSectionContents(aName);
+        }
+
+        std::string_view stringAt(std::span<const std::byte> aSection,
+                                  std::uint64_t anOffset) {
+            if (anOffset >= aSection.size()) {
+                return {};
+            }
+
+            return DwarfCursor{aSection, anOffset}.string();
+        }
+
+        bool isTombstone(std::uint64_t anAddress) {
+            return anAddress == 0 or anAddress >= ~std::uint64_t{1};
+        }
+
+        bool pathMatches(std::string_view aPath, std::string_view aQuery) {
+            if (aPath == aQuery) {
+                return true;
+            }
+
+            return aPath.size() > aQuery.size() and aPath.ends_with(aQuery) and
+                   aPath[aPath.size() - aQuery.size() - 1] == '/';
+        }
+
+        // Reads one abbreviation declaration, returning its code, or zero at
+        // the end of the table
+        std::uint64_t readAbbrev(DwarfCursor& aCursor, Abbrev& anAbbrev) {
+            auto myCode = aCursor.uleb128();
+            if (myCode == 0) {
+                return 0;
+            }
+
+            anAbbrev.theTag = aCursor.uleb128();
+            anAbbrev.theHasChildren = aCursor.u8() != 0;
+            anAbbrev.theAttributes.clear();
+
+            while (true) {
+                auto myAttribute = aCursor.uleb128();
+                auto myForm = aCursor.uleb128();
+                if (myAttribute == 0 and myForm == 0) {
+                    break;
+                }
+
+                std::int64_t myImplicitConst = 0;
+                if (myForm == DW_FORM_implicit_const) {
+                    myImplicitConst = aCursor.sleb128();
+                }
+
+                anAbbrev.theAttributes.push_back(
+                    {myAttribute, myForm, myImplicitConst});
+            }
+
+            return myCode;
+        }
+
+        // Tags whose names qualify the functions nested inside them
+        bool isScopeTag(std::uint64_t aTag) {
+            return aTag == DW_TAG_namespace or aTag == DW_TAG_class_type or
+                   aTag == DW_TAG_structure_type or aTag == DW_TAG_union_type;
+        }
+
+        bool isAddressForm(std::uint64_t aForm) {
+            switch (aForm) {
+                case DW_FORM_addr:
+                case DW_FORM_addrx:
+                case DW_FORM_addrx1:
+                case DW_FORM_addrx2:
+                case DW_FORM_addrx3:
+                case DW_FORM_addrx4:
+                case DW_FORM_GNU_addr_index:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+    } // namespace
+
+    const LineEntry*
+    LineTable::getEntryContainingAddress(std::uint64_t aFileAddress) const {
+        auto myIt = std::ranges::upper_bound(theEntries, aFileAddress, {},
+                                             &LineEntry::theAddress);
+        if (myIt == theEntries.begin()) {
+            return nullptr;
+        }
+
+        --myIt;
+        return myIt->isEndSequence() ? nullptr : std::addressof(*myIt);
+    }
+
+    std::vector<const LineEntry*>
+    LineTable::getEntriesForLine(std::uint16_t aFileIndex,
+                                 std::uint32_t aLine) const {
+        auto myKey = [this](std::uint32_t anIdx) {
+            auto& myEntry = theEntries[anIdx];
+            return std::tuple{myEntry.theFileIndex, myEntry.theLine};
+        };
+
+        auto myFirst = std::ranges::lower_bound(
+            theEntriesByLine, std::tuple{aFileIndex, aLine}, {}, myKey);
+        if (myFirst == theEntriesByLine.end() or
+            theEntries[*myFirst].theFileIndex != aFileIndex) {
+            return {};
+        }
+
+        auto myLine = theEntries[*myFirst].theLine;
+        std::vector<const LineEntry*> myResult;
+        for (auto myIt = myFirst; myIt != theEntriesByLine.end() and
+                                  std::get<0>(myKey(*myIt)) == aFileIndex and
+                                  std::get<1>(myKey(*myIt)) == myLine;
+             ++myIt) {
+            myResult.push_back(std::addressof(theEntries[*myIt]));
+        }
+
+        return myResult;
+    }
+
+    void
+    LineTable::sortEntries(std::vector<std::vector<LineEntry>> aSequences) {
+        std::ranges::sort(aSequences, {}, [](const auto& aSequence) {
+            return aSequence.front().theAddress;
+        });
+
+        std::size_t myTotal = 0;
+        for (auto& mySequence : aSequences) {
+            myTotal += mySequence.size();
+        }
+
+        theEntries.reserve(myTotal);
+        for (auto& mySequence : aSequences) {
+            theEntries.insert(theEntries.end(), mySequence.begin(),
+                              mySequence.end());
+        }
+
+        for (std::uint32_t i = 0; i < theEntries.size(); ++i) {
+            if (theEntries[i].isStatement() and
+                !theEntries[i].isEndSequence()) {
+                theEntriesByLine.push_back(i);
+            }
+        }
+
+        std::ranges::sort(theEntriesByLine, {}, [this](std::uint32_t anIdx) {
+            auto& myEntry = theEntries[anIdx];
+            return std::tuple{myEntry.theFileIndex, myEntry.theLine,
+                              myEntry.theAddress};
+        });
+    }
+
+    Dwarf::Dwarf(const ElfFile& anElf, IndexedCallback anOnIndexed)
+        : theElf{anElf}, theOnIndexed{std::move(anOnIndexed)} {
+        mapSections();
+        indexUnits();
+
+        theIndexThread = std::jthread{
+            [this](std::stop_token aStopToken) { buildIndex(aStopToken); }};
+    }
+
+    Dwarf::Dwarf(const ElfFile& anElf, std::vector<CompileUnit> aUnits,
+                 std::span<const UnitRange> aUnitRanges,
+                 FunctionIndex aFunctions)
+        : theElf{anElf}, theUnits{std::move(aUnits)},
+          theUnitRanges{aUnitRanges}, theFunctions{std::move(aFunctions)},
+          theUnitsIndexed{theUnits.size()}, theIsIndexed{true} {
+        mapSections();
+        theLineTables.resize(theUnits.size());
+    }
+
+    Dwarf::~Dwarf() {
+        if (theIndexThread.joinable()) {
+            theIndexThread.request_stop();
+            theIndexThread.join();
+        }
+    }
+
+    void Dwarf::mapSections() {
+        theInfo = getDebugSection(theElf, ".debug_info");
+        theAbbrev = getDebugSection(theElf, ".debug_abbrev");
+        theLine = getDebugSection(theElf, ".debug_line");
+        theStr = getDebugSection(theElf, ".debug_str");
+        theLineStr = getDebugSection(theElf, ".debug_line_str");
+        theStrOffsets = getDebugSection(theElf, ".debug_str_offsets");
+        theAddr = getDebugSection(theElf, ".debug_addr");
+        theRnglists = getDebugSection(theElf, ".debug_rnglists");
+        theRanges = getDebugSection(theElf, ".debug_ranges");
+    }
+
+    void Dwarf::indexUnits() {
+        DwarfCursor myCursor{theInfo};
+
+        while (!myCursor.finished()) {
+            auto myUnit = parseUnitHeader(myCursor);
+            myCursor.seek(myUnit.theEnd);
+
+            if (myUnit.theUnitType == DW_UT_compile or
+                myUnit.theUnitType == DW_UT_partial or
+                myUnit.theUnitType == DW_UT_skeleton) {
+                theUnits.push_back(myUnit);
+            }
+        }
+
+        theLineTables.resize(theUnits.size());
+    }
+
+    void Dwarf::buildIndex(std::stop_token aStopToken) {
+        auto myStart = std::chrono::steady_clock::now();
+
+        auto myNumWorkers = std::clamp<std::size_t>(
+            std::thread::hardware_concurrency(), 1,
+            std::max<std::size_t>(theUnits.size(), 1));
+        theArenas.resize(myNumWorkers);
+
+        std::vector<std::vector<UnitRange>> myRanges(myNumWorkers);
+        std::vector<std::vector<FunctionEntry>> myShards(
+            FunctionIndex::NUM_SHARDS);
+        std::array<std::mutex, FunctionIndex::NUM_SHARDS> myShardMutexes;
+        std::atomic<std::size_t> myNextUnit{0};
+
+        auto myWorker = [&](std::size_t aWorkerIdx) {
+            std::vector<FunctionEntry> myFunctions;
+            std::vector<std::vector<FunctionEntry>> myPending(
+                FunctionIndex::NUM_SHARDS);
+
+            while (!aStopToken.stop_requested()) {
+                auto myUnitIdx =
+                    myNextUnit.fetch_add(1, std::memory_order_relaxed);
+                if (myUnitIdx >= theUnits.size()) {
+                    break;
+                }
+
+                // A unit that fails to parse keeps whatever was read before
+                // the error rather than failing the whole index
+                myFunctions.clear();
+                try {
+                    parseRootDie(theUnits[myUnitIdx], myUnitIdx,
+                                 myRanges[aWorkerIdx]);
+                    indexFunctions(myUnitIdx, theArenas[aWorkerIdx],
+                                   myFunctions);
+                } catch (const Error&) {
+                }
+
+                for (auto& myFunction : myFunctions) {
+                    myPending[FunctionIndex::getShard(myFunction.theName)]
+                        .push_back(myFunction);
+                }
+
+                // Each shard is locked once per unit, and different workers
+                // mostly hit different shards
+                for (std::size_t i = 0; i < myPending.size(); ++i) {
+                    if (myPending[i].empty()) {
+                        continue;
+                    }
+
+                    std::lock_guard myLock{myShardMutexes[i]};
+                    myShards[i].insert(myShards[i].end(),
+                                       myPending[i].begin(),
+                                       myPending[i].end());
+                    myPending[i].clear();
+                }
+
+                theUnitsIndexed.fetch_add(1, std::memory_order_relaxed);
+            }
+        };
+
+        {
+            std::vector<std::jthread> myThreads;
+            for (std::size_t i = 1; i < myNumWorkers; ++i) {
+                myThreads.emplace_back(myWorker, i);
+            }
+            myWorker(0);
+        }
+
+        if (aStopToken.stop_requested()) {
+            return;
+        }
+
+        for (auto& myWorkerRanges : myRanges) {
+            theOwnedUnitRanges.insert(theOwnedUnitRanges.end(),
+                                      myWorkerRanges.begin(),
+                                      myWorkerRanges.end());
+        }
+        std::ranges::sort(theOwnedUnitRanges, {}, &UnitRange::theLow);
+        theUnitRanges = theOwnedUnitRanges;
+
+        finishFunctionIndex(myShards);
+
+        {
+            std::lock_guard myLock{theIndexMutex};
+            theIndexTime = std::chrono::steady_clock::now() - myStart;
+            theIsIndexed = true;
+        }
+        theIndexCondition.notify_all();
+
+        if (theOnIndexed) {
+            theOnIndexed(*this);
+        }
+    }
+
+    void Dwarf::finishFunctionIndex(
+        std::vector<std::vector<FunctionEntry>>& aShards) {
+        auto myByName = [](const FunctionEntry& aLeft,
+                           const FunctionEntry& aRight) {
+            return std::tie(aLeft.theName, aLeft.theLow) <
+                   std::tie(aRight.theName, aRight.theLow);
+        };
+
+        // Shards are independent, so they are sorted in parallel
+        std::atomic<std::size_t> myNextShard{0};
+        auto mySorter = [&] {
+            std::size_t myIdx;
+            while ((myIdx = myNextShard.fetch_add(1)) < aShards.size()) {
+                std::ranges::sort(aShards[myIdx], myByName);
+            }
+        };
+
+        {
+            std::vector<std::jthread> myThreads;
+            for (std::size_t i = 1; i < theArenas.size(); ++i) {
+                myThreads.emplace_back(mySorter);
+            }
+            mySorter();
+        }
+
+        auto& myEntries = theFunctions.theEntries;
+        theFunctions.theShardOffsets.clear();
+        for (auto& myShard : aShards) {
+            theFunctions.theShardOffsets.push_back(myEntries.size());
+            myEntries.insert(myEntries.end(), myShard.begin(), myShard.end());
+        }
+        theFunctions.theShardOffsets.push_back(myEntries.size());
+
+        auto& myByAddress = theFunctions.theByAddress;
+        myByAddress.resize(myEntries.size());
+        std::iota(myByAddress.begin(), myByAddress.end(), 0);
+        std::ranges::sort(myByAddress, {}, [&](std::uint32_t anIdx) {
+            return myEntries[anIdx].theLow;
+        });
+    }
+
+    void Dwarf::waitForIndex() const {
+        std::unique_lock myLock{theIndexMutex};
+        theIndexCondition.wait(myLock, [this] { return theIsIndexed; });
+    }
+
+    bool Dwarf::waitForIndex(std::chrono::milliseconds aTimeout) const {
+        std::unique_lock myLock{theIndexMutex};
+        return theIndexCondition.wait_for(myLock, aTimeout,
+                                          [this] { return theIsIndexed; });
+    }
+
+    IndexProgress Dwarf::getIndexProgress() const {
+        std::lock_guard myLock{theIndexMutex};
+        return {theUnitsIndexed.load(std::memory_order_relaxed),
+                theUnits.size(), theIsIndexed};
+    }
+
+    CompileUnit Dwarf::parseUnitHeader(DwarfCursor& aCursor) const {
+        CompileUnit myUnit;
+        myUnit.theOffset = aCursor.getOffset();
+
+        std::uint64_t myLength = aCursor.u32();
+        if (myLength == 0xffffffff) {
+            myUnit.theIs64Bit = true;
+            myLength = aCursor.u64();
+        }
+        myUnit.theEnd = aCursor.getOffset() + myLength;
+
+        myUnit.theVersion = aCursor.u16();
+        if (myUnit.theVersion < 2 or myUnit.theVersion > 5) {
+            Error::send(fmt::format("Unsupported DWARF version {}",
+                                    myUnit.theVersion));
+        }
+
+        if (myUnit.theVersion >= 5) {
+            myUnit.theUnitType = aCursor.u8();
+            myUnit.theAddressSize = aCursor.u8();
+            myUnit.theAbbrevOffset = aCursor.offset(myUnit.theIs64Bit);
+
+            if (myUnit.theUnitType == DW_UT_skeleton or
+                myUnit.theUnitType == DW_UT_split_compile) {
+                aCursor.skip(8);
+            } else if (myUnit.theUnitType == DW_UT_type or
+                       myUnit.theUnitType == DW_UT_split_type) {
+                aCursor.skip(8);
+                aCursor.offset(myUnit.theIs64Bit);
+            }
+        } else {
+            myUnit.theUnitType = DW_UT_compile;
+            myUnit.theAbbrevOffset = aCursor.offset(myUnit.theIs64Bit);
+            myUnit.theAddressSize = aCursor.u8();
+        }
+
+        myUnit.theDieOffset = aCursor.getOffset();
+        return myUnit;
+    }
+
+    void Dwarf::parseRootDie(CompileUnit& aUnit, std::uint32_t aUnitIdx,
+                             std::vector<UnitRange>& aRanges) const {
+        auto& myUnit = aUnit;
+
+        DwarfCursor myCursor{theInfo, myUnit.theDieOffset};
+        auto myCode = myCursor.uleb128();
+        if (myCode == 0) {
+            return;
+        }
+
+        auto myAbbrev = findAbbrev(myUnit.theAbbrevOffset, myCode);
+
+        AttributeValue myName{}, myCompDir{}, myLowPc{}, myHighPc{}, myRanges{};
+        for (auto& mySpec : myAbbrev.theAttributes) {
+            auto myValue = readAttributeValue(myCursor, mySpec, myUnit);
+
+            switch (mySpec.theAttribute) {
+                case DW_AT_name:
+                    myName = myValue;
+                    break;
+                case DW_AT_comp_dir:
+                    myCompDir = myValue;
+                    break;
+                case DW_AT_low_pc:
+                    myLowPc = myValue;
+                    break;
+                case DW_AT_high_pc:
+                    myHighPc = myValue;
+                    break;
+                case DW_AT_ranges:
+                    myRanges = myValue;
+                    break;
+                case DW_AT_stmt_list:
+                    myUnit.theLineOffset = myValue.theValue;
+                    break;
+                case DW_AT_str_offsets_base:
+                    myUnit.theStrOffsetsBase = myValue.theValue;
+                    break;
+                case DW_AT_addr_base:
+                case DW_AT_GNU_addr_base:
+                    myUnit.theAddrBase = myValue.theValue;
+                    break;
+                case DW_AT_rnglists_base:
+                    myUnit.theRnglistsBase = myValue.theValue;
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        // Indexed strings and addresses can only be resolved once the base
+        // attributes, which may follow them, have been read
+        myUnit.theName = resolveString(myUnit, myName);
+        myUnit.theCompDir = resolveString(myUnit, myCompDir);
+
+        if (myLowPc.theForm != 0) {
+            myUnit.theBaseAddress = resolveAddress(myUnit, myLowPc);
+        }
+
+        std::vector<std::pair<std::uint64_t, std::uint64_t>> myAddressRanges;
+        if (myRanges.theForm != 0) {
+            readRanges(myUnit, myRanges, myAddressRanges);
+        } else if (myLowPc.theForm != 0 and myHighPc.theForm != 0) {
+            auto myHigh = isAddressForm(myHighPc.theForm)
+                              ? resolveAddress(myUnit, myHighPc)
+                              : myUnit.theBaseAddress + myHighPc.theValue;
+            myAddressRanges.emplace_back(myUnit.theBaseAddress, myHigh);
+        }
+
+        for (auto [myLow, myHigh] : myAddressRanges) {
+            if (!isTombstone(myLow) and myLow < myHigh) {
+                aRanges.push_back({myLow, myHigh, aUnitIdx});
+            }
+        }
+    }
+
+    Abbrev Dwarf::findAbbrev(std::uint64_t anAbbrevOffset,
+                             std::uint64_t aCode) const {
+        DwarfCursor myCursor{theAbbrev, anAbbrevOffset};
+
+        Abbrev myAbbrev;
+        while (auto myCode = readAbbrev(myCursor, myAbbrev)) {
+            if (myCode == aCode) {
+                return myAbbrev;
+            }
+        }
+
+        Error::send(fmt::format("Abbreviation {} not found", aCode));
+    }
+
+    std::vector<std::pair<std::uint64_t, Abbrev>>
+    Dwarf::parseAbbrevTable(std::uint64_t anOffset) const {
+        DwarfCursor myCursor{theAbbrev, anOffset};
+
+        std::vector<std::pair<std::uint64_t, Abbrev>> myTable;
+        Abbrev myAbbrev;
+        while (auto myCode = readAbbrev(myCursor, myAbbrev)) {
+            myTable.emplace_back(myCode, std::move(myAbbrev));
+        }
+
+        std::ranges::sort(myTable, {}, [](auto& anEntry) {
+            return anEntry.first;
+        });
+        return myTable;
+    }
+
+    void Dwarf::indexFunctions(std::uint32_t aUnitIdx, StringArena& anArena,
+                               std::vector<FunctionEntry>& aFunctions) const {
+        auto& myUnit = theUnits[aUnitIdx];
+        auto myAbbrevs = parseAbbrevTable(myUnit.theAbbrevOffset);
+
+        // Codes are almost always numbered densely from 1
+        auto myFindAbbrev = [&](std::uint64_t aCode) -> const Abbrev& {
+            if (aCode - 1 < myAbbrevs.size() and
+                myAbbrevs[aCode - 1].first == aCode) {
+                return myAbbrevs[aCode - 1].second;
+            }
+
+            auto myIt = std::ranges::lower_bound(
+                myAbbrevs, aCode, {}, [](auto& anEntry) {
+                    return anEntry.first;
+                });
+            if (myIt == myAbbrevs.end() or myIt->first != aCode) {
+                Error::send(fmt::format("Abbreviation {} not found", aCode));
+            }
+            return myIt->second;
+        };
+
+        auto myReferenceOffset =
+            [&](const AttributeValue& aValue) -> std::optional<std::uint64_t> {
+            switch (aValue.theForm) {
+                case DW_FORM_ref1:
+                case DW_FORM_ref2:
+                case DW_FORM_ref4:
+                case DW_FORM_ref8:
+                case DW_FORM_ref_udata:
+                    return myUnit.theOffset + aValue.theValue;
+                case DW_FORM_ref_addr:
+                    return aValue.theValue;
+                default:
+                    return std::nullopt;
+            }
+        };
+
+        // Names of declarations that were not seen during the walk, such as
+        // those following their definition, are read directly
+        auto myReadName = [&](std::uint64_t aDieOffset) -> std::string_view {
+            if (aDieOffset < myUnit.theDieOffset or
+                aDieOffset >= myUnit.theEnd) {
+                return {};
+            }
+
+            DwarfCursor myCursor{theInfo, aDieOffset};
+            auto& myAbbrev = myFindAbbrev(myCursor.uleb128());
+            for (auto& mySpec : myAbbrev.theAttributes) {
+                auto myValue = readAttributeValue(myCursor, mySpec, myUnit);
+                if (mySpec.theAttribute == DW_AT_name) {
+                    return resolveString(myUnit, myValue);
+                }
+            }
+            return {};
+        };
+
+        // Out of line definitions refer back to their declaration for the
+        // name, so qualified names are remembered by DIE offset
+        std::unordered_map<std::uint64_t, std::string_view> myQualifiedNames;
+        std::vector<std::string_view> myScopes;
+        std::vector<bool> myScopePushed;
+        std::string myBuffer;
+
+        auto myQualify = [&](std::string_view aName) {
+            if (myScopes.empty()) {
+                return aName;
+            }
+
+            myBuffer.clear();
+            for (auto myScope : myScopes) {
+                myBuffer.append(myScope);
+                myBuffer.append("::");
+            }
+            myBuffer.append(aName);
+            return anArena.store(myBuffer);
+        };
+
+        DwarfCursor myCursor{theInfo, myUnit.theDieOffset};
+        while (myCursor.getOffset() < myUnit.theEnd) {
+            auto myDieOffset = myCursor.getOffset();
+            auto myCode = myCursor.uleb128();
+            if (myCode == 0) {
+                if (myScopePushed.empty()) {
+                    break;
+                }
+                if (myScopePushed.back()) {
+                    myScopes.pop_back();
+                }
+                myScopePushed.pop_back();
+                continue;
+            }
+
+            auto& myAbbrev = myFindAbbrev(myCode);
+
+            AttributeValue myName{}, myLowPc{}, myHighPc{}, myRanges{};
+            AttributeValue myReference{}, mySibling{};
+            bool myIsDeclaration = false;
+            for (auto& mySpec : myAbbrev.theAttributes) {
+                auto myValue = readAttributeValue(myCursor, mySpec, myUnit);
+
+                switch (mySpec.theAttribute) {
+                    case DW_AT_name:
+                        myName = myValue;
+                        break;
+                    case DW_AT_low_pc:
+                        myLowPc = myValue;
+                        break;
+                    case DW_AT_high_pc:
+                        myHighPc = myValue;
+                        break;
+                    case DW_AT_ranges:
+                        myRanges = myValue;
+                        break;
+                    case DW_AT_specification:
+                    case DW_AT_abstract_origin:
+                        myReference = myValue;
+                        break;
+                    case DW_AT_declaration:
+                        myIsDeclaration = myValue.theValue != 0;
+                        break;
+                    case DW_AT_sibling:
+                        mySibling = myValue;
+                        break;
+                    default:
+                        break;
+                }
+            }
+
+            if (myAbbrev.theTag == DW_TAG_subprogram) {
+                std::string_view myQualifiedName;
+                if (myName.theForm != 0) {
+                    myQualifiedName = myQualify(resolveString(myUnit, myName));
+                } else if (auto myTarget = myReferenceOffset(myReference)) {
+                    auto myIt = myQualifiedNames.find(*myTarget);
+                    myQualifiedName = myIt != myQualifiedNames.end()
+                                          ? myIt->second
+                                          : myQualify(myReadName(*myTarget));
+                }
+
+                if (!myQualifiedName.empty()) {
+                    myQualifiedNames.emplace(myDieOffset, myQualifiedName);
+                }
+
+                bool myIsDefinition =
+                    !myIsDeclaration and !myQualifiedName.empty();
+
+                std::vector<std::pair<std::uint64_t, std::uint64_t>>
+                    myAddressRanges;
+                if (myIsDefinition and myLowPc.theForm != 0 and
+                    myHighPc.theForm != 0) {
+                    auto myLow = resolveAddress(myUnit, myLowPc);
+                    auto myHigh = isAddressForm(myHighPc.theForm)
+                                      ? resolveAddress(myUnit, myHighPc)
+                                      : myLow + myHighPc.theValue;
+                    myAddressRanges.emplace_back(myLow, myHigh);
+                } else if (myIsDefinition and myRanges.theForm != 0) {
+                    // Functions split into hot and cold parts list the
+                    // entry point first
+                    readRanges(myUnit, myRanges, myAddressRanges);
+                    myAddressRanges.resize(
+                        std::min<std::size_t>(myAddressRanges.size(), 1));
+                }
+
+                for (auto [myLow, myHigh] : myAddressRanges) {
+                    if (!isTombstone(myLow) and myLow < myHigh) {
+                        aFunctions.push_back(
+                            {myQualifiedName, myLow, myHigh, aUnitIdx});
+                    }
+                }
+            }
+
+            if (!myAbbrev.theHasChildren) {
+                continue;
+            }
+
+            // Function bodies only hold locals and lexical blocks, so they
+            // are skipped whenever the producer says where they end
+            auto mySiblingOffset = myReferenceOffset(mySibling);
+            if (myAbbrev.theTag == DW_TAG_subprogram and mySiblingOffset and
+                *mySiblingOffset > myDieOffset and
+                *mySiblingOffset <= myUnit.theEnd) {
+                myCursor.seek(*mySiblingOffset);
+                continue;
+            }
+
+            bool myIsScope = isScopeTag(myAbbrev.theTag);
+            if (myIsScope) {
+                auto myScopeName = resolveString(myUnit, myName);
+                if (myScopeName.empty()) {
+                    myScopeName = myAbbrev.theTag == DW_TAG_namespace
+                                      ? "(anonymous namespace)"
+                                      : "(anonymous)";
+                }
+                myScopes.push_back(myScopeName);
+            }
+            myScopePushed.push_back(myIsScope);
+        }
+    }
+
+    std::size_t FunctionIndex::getShard(std::string_view aName) {
+        // FNV-1a
+        std::uint64_t myHash = 0xcbf29ce484222325;
+        for (auto myChar : aName) {
+            myHash ^= static_cast<unsigned char>(myChar);
+            myHash *= 0x100000001b3;
+        }
+
+        return myHash % NUM_SHARDS;
+    }
+
+    std::vector<const FunctionEntry*>
+    Dwarf::findFunctions(std::string_view aName) const {
+        waitForIndex();
+
+        auto myShard = FunctionIndex::getShard(aName);
+        std::span<const FunctionEntry> myEntries{
+            theFunctions.theEntries.begin() +
+                theFunctions.theShardOffsets[myShard],
+            theFunctions.theEntries.begin() +
+                theFunctions.theShardOffsets[myShard + 1]};
+
+        std::vector<const FunctionEntry*> myResult;
+        for (auto& myEntry : std::ranges::equal_range(
+                 myEntries, aName, {}, &FunctionEntry::theName)) {
+            myResult.push_back(&myEntry);
+        }
+
+        return myResult;
+    }
+
+    const FunctionEntry*
+    Dwarf::getFunctionContainingAddress(std::uint64_t aFileAddress) const {
+        waitForIndex();
+
+        auto& myEntries = theFunctions.theEntries;
+        auto myIt = std::ranges::upper_bound(
+            theFunctions.theByAddress, aFileAddress, {},
+            [&](std::uint32_t anIdx) { return myEntries[anIdx].theLow; });
+        if (myIt == theFunctions.theByAddress.begin()) {
+            return nullptr;
+        }
+
+        auto& myEntry = myEntries[*std::prev(myIt)];
+        return aFileAddress < myEntry.theHigh ? &myEntry : nullptr;
+    }
+
+    AttributeValue Dwarf::readAttributeValue(DwarfCursor& aCursor,
+                                             const AttributeSpec& aSpec,
+                                             const CompileUnit& aUnit) const {
+        AttributeValue myValue{aSpec.theForm, 0, {}};
+
+        switch (aSpec.theForm) {
+            case DW_FORM_addr:
+                myValue.theValue = aCursor.sized(aUnit.theAddressSize);
+                break;
+            case DW_FORM_data1:
+            case DW_FORM_ref1:
+            case DW_FORM_flag:
+            case DW_FORM_strx1:
+            case DW_FORM_addrx1:
+                myValue.theValue = aCursor.u8();
+                break;
+            case DW_FORM_data2:
+            case DW_FORM_ref2:
+            case DW_FORM_strx2:
+            case DW_FORM_addrx2:
+                myValue.theValue = aCursor.u16();
+                break;
+            case DW_FORM_strx3:
+            case DW_FORM_addrx3:
+                myValue.theValue = aCursor.sized(3);
+                break;
+            case DW_FORM_data4:
+            case DW_FORM_ref4:
+            case DW_FORM_ref_sup4:
+            case DW_FORM_strx4:
+            case DW_FORM_addrx4:
+                myValue.theValue = aCursor.u32();
+                break;
+            case DW_FORM_data8:
+            case DW_FORM_ref8:
+            case DW_FORM_ref_sig8:
+            case DW_FORM_ref_sup8:
+                myValue.theValue = aCursor.u64();
+                break;
+            case DW_FORM_data16:
+                aCursor.skip(16);
+                break;
+            case DW_FORM_sdata:
+                myValue.theValue =
+                    static_cast<std::uint64_t>(aCursor.sleb128());
+                break;
+            case DW_FORM_udata:
+            case DW_FORM_ref_udata:
+            case DW_FORM_strx:
+            case DW_FORM_addrx:
+            case DW_FORM_loclistx:
+            case DW_FORM_rnglistx:
+            case DW_FORM_GNU_addr_index:
+            case DW_FORM_GNU_str_index:
+                myValue.theValue = aCursor.uleb128();
+                break;
+            case DW_FORM_string:
+                myValue.theString = aCursor.string();
+                break;
+            case DW_FORM_ref_addr:
+                myValue.theValue = aUnit.theVersion <= 2
+                                       ? aCursor.sized(aUnit.theAddressSize)
+                                       : aCursor.offset(aUnit.theIs64Bit);
+                break;
+            case DW_FORM_strp:
+            case DW_FORM_line_strp:
+            case DW_FORM_sec_offset:
+            case DW_FORM_strp_sup:
+            case DW_FORM_GNU_ref_alt:
+            case DW_FORM_GNU_strp_alt:
+                myValue.theValue = aCursor.offset(aUnit.theIs64Bit);
+                break;
+            case DW_FORM_block1:
+                aCursor.skip(aCursor.u8());
+                break;
+            case DW_FORM_block2:
+                aCursor.skip(aCursor.u16());
+                break;
+            case DW_FORM_block4:
+                aCursor.skip(aCursor.u32());
+                break;
+            case DW_FORM_block:
+            case DW_FORM_exprloc:
+                aCursor.skip(aCursor.uleb128());
+                break;
+            case DW_FORM_flag_present:
+                myValue.theValue = 1;
+                break;
+            case DW_FORM_implicit_const:
+                myValue.theValue =
+                    static_cast<std::uint64_t>(aSpec.theImplicitConst);
+                break;
+            case DW_FORM_indirect: {
+                AttributeSpec myIndirectSpec{aSpec.theAttribute,
+                                             aCursor.uleb128(), 0};
+                return readAttributeValue(aCursor, myIndirectSpec, aUnit);
+            }
+            default:
+                Error::send(
+                    fmt::format("Unsupported DWARF form {:#x}", aSpec.theForm));
+        }
+
+        return myValue;
+    }
+
+    std::string_view Dwarf::resolveString(const CompileUnit& aUnit,
+                                          const AttributeValue& aValue) const {
+        switch (aValue.theForm) {
+            case DW_FORM_string:
+                return aValue.theString;
+            case DW_FORM_strp:
+                return stringAt(theStr, aValue.theValue);
+            case DW_FORM_line_strp:
+                return stringAt(theLineStr, aValue.theValue);
+            case DW_FORM_strx:
+            case DW_FORM_strx1:
+            case DW_FORM_strx2:
+            case DW_FORM_strx3:
+            case DW_FORM_strx4:
+            case DW_FORM_GNU_str_index: {
+                auto myEntrySize = aUnit.theIs64Bit ? 8 : 4;
+                DwarfCursor myCursor{theStrOffsets,
+                                     aUnit.theStrOffsetsBase +
+                                         aValue.theValue * myEntrySize};
+                return stringAt(theStr, myCursor.offset(aUnit.theIs64Bit));
+            }
+            default:
+                return {};
+        }
+    }
+
+    std::uint64_t Dwarf::resolveAddress(const CompileUnit& aUnit,
+                                        const AttributeValue& aValue) const {
+        if (aValue.theForm == DW_FORM_addr) {
+            return aValue.theValue;
+        }
+
+        return readIndexedAddress(aUnit, aValue.theValue);
+    }
+
+    std::uint64_t Dwarf::readIndexedAddress(const CompileUnit& aUnit,
+                                            std::uint64_t anIndex) const {
+        DwarfCursor myCursor{theAddr, aUnit.theAddrBase +
+                                          anIndex * aUnit.theAddressSize};
+        return myCursor.sized(aUnit.theAddressSize);
+    }
+
+    void Dwarf::readRanges(
+        const CompileUnit& aUnit, const AttributeValue& aValue,
+        std::vector<std::pair<std::uint64_t, std::uint64_t>>& aRanges) const {
+        auto myBase = aUnit.theBaseAddress;
+
+        if (aUnit.theVersion < 5) {
+            DwarfCursor myCursor{theRanges, aValue.theValue};
+            while (true) {
+                auto myBegin = myCursor.sized(aUnit.theAddressSize);
+                auto myEnd = myCursor.sized(aUnit.theAddressSize);
+
+                if (myBegin == 0 and myEnd == 0) {
+                    break;
+                } else if (myBegin == ~std::uint64_t{0}) {
+                    myBase = myEnd;
+                } else {
+                    aRanges.emplace_back(myBase + myBegin, myBase + myEnd);
+                }
+            }
+            return;
+        }
+
+        std::uint64_t myOffset = aValue.theValue;
+        if (aValue.theForm == DW_FORM_rnglistx) {
+            auto myEntrySize = aUnit.theIs64Bit ? 8 : 4;
+            DwarfCursor myCursor{theRnglists, aUnit.theRnglistsBase +
+                                                  myOffset * myEntrySize};
+            myOffset = aUnit.theRnglistsBase +
+                       myCursor.offset(aUnit.theIs64Bit);
+        }
+
+        DwarfCursor myCursor{theRnglists, myOffset};
+        while (true) {
+            switch (myCursor.u8()) {
+                case DW_RLE_end_of_list:
+                    return;
+                case DW_RLE_base_addressx:
+                    myBase = readIndexedAddress(aUnit, myCursor.uleb128());
+                    break;
+                case DW_RLE_startx_endx: {
+                    auto myBegin =
+                        readIndexedAddress(aUnit, myCursor.uleb128());
+                    auto myEnd = readIndexedAddress(aUnit, myCursor.uleb128());
+                    aRanges.emplace_back(myBegin, myEnd);
+                    break;
+                }
+                case DW_RLE_startx_length: {
+                    auto myBegin =
+                        readIndexedAddress(aUnit, myCursor.uleb128());
+                    aRanges.emplace_back(myBegin,
+                                         myBegin + myCursor.uleb128());
+                    break;
+                }
+                case DW_RLE_offset_pair: {
+                    auto myBegin = myCursor.uleb128();
+                    auto myEnd = myCursor.uleb128();
+                    aRanges.emplace_back(myBase + myBegin, myBase + myEnd);
+                    break;
+                }
+                case DW_RLE_base_address:
+                    myBase = myCursor.sized(aUnit.theAddressSize);
+                    break;
+                case DW_RLE_start_end: {
+                    auto myBegin = myCursor.sized(aUnit.theAddressSize);
+                    auto myEnd = myCursor.sized(aUnit.theAddressSize);
+                    aRanges.emplace_back(myBegin, myEnd);
+                    break;
+                }
+                case DW_RLE_start_length: {
+                    auto myBegin = myCursor.sized(aUnit.theAddressSize);
+                    aRanges.emplace_back(myBegin,
+                                         myBegin + myCursor.uleb128());
+                    break;
+                }
+                default:
+                    Error::send("Unknown range list entry");
+            }
+        }
+    }
+
+    const CompileUnit*
+    Dwarf::getCompileUnitContainingAddress(std::uint64_t aFileAddress) const {
+        waitForIndex();
+
+        auto myIt = std::ranges::upper_bound(theUnitRanges, aFileAddress, {},
+                                             &UnitRange::theLow);
+
+        if (myIt == theUnitRanges.begin()) {
+            return nullptr;
+        }
+
+        --myIt;
+        if (aFileAddress < myIt->theHigh) {
+            return std::addressof(theUnits[myIt->theUnitIdx]);
+        }
+
+        return nullptr;
+    }
+
+    const LineTable& Dwarf::getLineTable(const CompileUnit& aUnit) const {
+        waitForIndex();
+        return ensureLineTable(std::addressof(aUnit) - theUnits.data(), false);
+    }
+
+    const LineTable& Dwarf::ensureLineTable(std::size_t aUnitIdx,
+                                            bool aHeaderOnly) const {
+        auto& myTable = theLineTables[aUnitIdx];
+
+        if (!myTable) {
+            myTable = std::make_unique<LineTable>();
+            parseLineTable(theUnits[aUnitIdx], *myTable, aHeaderOnly);
+        } else if (!aHeaderOnly and !myTable->isDecoded()) {
+            parseLineTable(theUnits[aUnitIdx], *myTable, false);
+        }
+
+        return *myTable;
+    }
+
+    void Dwarf::parseLineTable(const CompileUnit& aUnit, LineTable& aTable,
+                               bool aHeaderOnly) const {
+        if (!aUnit.theLineOffset) {
+            aTable.theIsDecoded = true;
+            return;
+        }
+
+        DwarfCursor myCursor{theLine, *aUnit.theLineOffset};
+
+        // Strings in the file table are resolved against the unit, but the
+        // line table has its own offset size
+        CompileUnit myUnit = aUnit;
+
+        std::uint64_t myLength = myCursor.u32();
+        myUnit.theIs64Bit = false;
+        if (myLength == 0xffffffff) {
+            myUnit.theIs64Bit = true;
+            myLength = myCursor.u64();
+        }
+        auto myEnd = myCursor.getOffset() + myLength;
+
+        auto myVersion = myCursor.u16();
+        if (myVersion >= 5) {
+            myUnit.theAddressSize = myCursor.u8();
+            myCursor.u8(); // segment selector size
+        }
+
+        auto myHeaderLength = myCursor.offset(myUnit.theIs64Bit);
+        auto myProgramStart = myCursor.getOffset() + myHeaderLength;
+
+        auto myMinInstrLength = myCursor.u8();
+        if (myVersion >= 4) {
+            myCursor.u8(); // maximum operations per instruction
+        }
+        bool myDefaultIsStmt = myCursor.u8() != 0;
+        auto myLineBase = static_cast<std::int8_t>(myCursor.u8());
+        auto myLineRange = myCursor.u8();
+        auto myOpcodeBase = myCursor.u8();
+
+        std::vector<std::uint8_t> myStandardOpcodeLengths;
+        for (int i = 1; i < myOpcodeBase; ++i) {
+            myStandardOpcodeLengths.push_back(myCursor.u8());
+        }
+
+        std::vector<std::string_view> myDirectories;
+        std::vector<std::pair<std::string_view, std::uint64_t>> myFiles;
+
+        if (myVersion >= 5) {
+            auto myReadEntries = [&](auto aCallback) {
+                std::vector<AttributeSpec> myFormats;
+                auto myFormatCount = myCursor.u8();
+                for (int i = 0; i < myFormatCount; ++i) {
+                    auto myContentType = myCursor.uleb128();
+                    auto myForm = myCursor.uleb128();
+                    myFormats.push_back({myContentType, myForm, 0});
+                }
+
+                auto myCount = myCursor.uleb128();
+                for (std::uint64_t i = 0; i < myCount; ++i) {
+                    std::string_view myPath;
+                    std::uint64_t myDirIdx = 0;
+
+                    for (auto& myFormat : myFormats) {
+                        auto myValue =
+                            readAttributeValue(myCursor, myFormat, myUnit);
+
+                        if (myFormat.theAttribute == DW_LNCT_path) {
+                            myPath = resolveString(myUnit, myValue);
+                        } else if (myFormat.theAttribute ==
+                                   DW_LNCT_directory_index) {
+                            myDirIdx = myValue.theValue;
+                        }
+                    }
+
+                    aCallback(myPath, myDirIdx);
+                }
+            };
+
+            myReadEntries([&](std::string_view aPath, std::uint64_t) {
+                myDirectories.push_back(aPath);
+            });
+            myReadEntries([&](std::string_view aPath, std::uint64_t aDirIdx) {
+                myFiles.emplace_back(aPath, aDirIdx);
+            });
+        } else {
+            // Before DWARF 5, directory 0 and file 0 implicitly refer to the
+            // compilation directory and primary source file
+            myDirectories.push_back(aUnit.theCompDir);
+            while (true) {
+                auto myDir = myCursor.string();
+                if (myDir.empty()) {
+                    break;
+                }
+                myDirectories.push_back(myDir);
+            }
+
+            myFiles.emplace_back(aUnit.theName, 0);
+            while (true) {
+                auto myName = myCursor.string();
+                if (myName.empty()) {
+                    break;
+                }
+
+                auto myDirIdx = myCursor.uleb128();
+                myCursor.uleb128(); // modification time
+                myCursor.uleb128(); // file length
+                myFiles.emplace_back(myName, myDirIdx);
+            }
+        }
+
+        // The file table is kept if only the header had been read before, as
+        // callers may still hold on to it
+        if (aTable.theFileNames.empty()) {
+            for (auto [myName, myDirIdx] : myFiles) {
+                std::filesystem::path myPath{myName};
+                if (myPath.is_relative() and
+                    myDirIdx < myDirectories.size()) {
+                    myPath = std::filesystem::path{myDirectories[myDirIdx]} /
+                             myPath;
+                }
+                if (myPath.is_relative() and !aUnit.theCompDir.empty()) {
+                    myPath = std::filesystem::path{aUnit.theCompDir} / myPath;
+                }
+
+                aTable.theFileNames.push_back(
+                    myPath.lexically_normal().string());
+            }
+        }
+
+        if (aHeaderOnly) {
+            return;
+        }
+
+        struct {
+            std::uint64_t theAddress;
+            std::uint64_t theFile;
+            std::int64_t theLine;
+            bool theIsStmt;
+            bool theIsPrologueEnd;
+        } myState;
+
+        auto myReset = [&] {
+            myState = {0, 1, 1, myDefaultIsStmt, false};
+        };
+        myReset();
+
+        std::vector<std::vector<LineEntry>> mySequences;
+        std::vector<LineEntry> myCurrent;
+
+        auto myEmit = [&](bool anEndSequence) {
+            std::uint8_t myFlags = 0;
+            myFlags |= myState.theIsStmt ? LineEntry::IS_STMT : 0;
+            myFlags |= anEndSequence ? LineEntry::END_SEQUENCE : 0;
+            myFlags |= myState.theIsPrologueEnd ? LineEntry::PROLOGUE_END : 0;
+
+            myCurrent.push_back({myState.theAddress,
+                                 static_cast<std::uint32_t>(myState.theLine),
+                                 static_cast<std::uint16_t>(myState.theFile),
+                                 myFlags});
+            myState.theIsPrologueEnd = false;
+
+            if (anEndSequence) {
+                // Sequences for functions discarded by the linker are left
+                // at a tombstone address
+                if (!isTombstone(myCurrent.front().theAddress)) {
+                    mySequences.push_back(std::move(myCurrent));
+                }
+                myCurrent.clear();
+                myReset();
+            }
+        };
+
+        myCursor.seek(myProgramStart);
+        while (myCursor.getOffset() < myEnd) {
+            auto myOpcode = myCursor.u8();
+
+            if (myOpcode >= myOpcodeBase) {
+                auto myAdjusted = myOpcode - myOpcodeBase;
+                myState.theAddress +=
+                    (myAdjusted / myLineRange) * myMinInstrLength;
+                myState.theLine += myLineBase + myAdjusted % myLineRange;
+                myEmit(false);
+                continue;
+            }
+
+            switch (myOpcode) {
+                case 0: {
+                    auto myLength = myCursor.uleb128();
+                    auto myNext = myCursor.getOffset() + myLength;
+                    auto mySubOpcode = myCursor.u8();
+
+                    if (mySubOpcode == DW_LNE_end_sequence) {
+                        myEmit(true);
+                    } else if (mySubOpcode == DW_LNE_set_address) {
+                        myState.theAddress =
+                            myCursor.sized(myUnit.theAddressSize);
+                    }
+
+                    myCursor.seek(myNext);
+                    break;
+                }
+                case DW_LNS_copy:
+                    myEmit(false);
+                    break;
+                case DW_LNS_advance_pc:
+                    myState.theAddress += myCursor.uleb128() * myMinInstrLength;
+                    break;
+                case DW_LNS_advance_line:
+                    myState.theLine += myCursor.sleb128();
+                    break;
+                case DW_LNS_set_file:
+                    myState.theFile = myCursor.uleb128();
+                    break;
+                case DW_LNS_set_column:
+                    myCursor.uleb128();
+                    break;
+                case DW_LNS_negate_stmt:
+                    myState.theIsStmt = !myState.theIsStmt;
+                    break;
+                case DW_LNS_set_basic_block:
+                case DW_LNS_set_epilogue_begin:
+                    break;
+                case DW_LNS_const_add_pc:
+                    myState.theAddress +=
+                        ((255 - myOpcodeBase) / myLineRange) * myMinInstrLength;
+                    break;
+                case DW_LNS_fixed_advance_pc:
+                    myState.theAddress += myCursor.u16();
+                    break;
+                case DW_LNS_set_prologue_end:
+                    myState.theIsPrologueEnd = true;
+                    break;
+                default:
+                    // Unknown standard opcodes declare how many ULEB128
+                    // operands they take, so they can be skipped
+                    for (int i = 0; i < myStandardOpcodeLengths[myOpcode - 1];
+                         ++i) {
+                        myCursor.uleb128();
+                    }
+                    break;
+            }
+        }
+
+        aTable.sortEntries(std::move(mySequences));
+        aTable.theIsDecoded = true;
+    }
+
+    std::optional<SourceLocation>
+    Dwarf::getSourceLocation(std::uint64_t aFileAddress) const {
+        auto* myUnit = getCompileUnitContainingAddress(aFileAddress);
+        if (myUnit == nullptr) {
+            return std::nullopt;
+        }
+
+        auto& myTable = getLineTable(*myUnit);
+        auto* myEntry = myTable.getEntryContainingAddress(aFileAddress);
+        if (myEntry == nullptr or
+            myEntry->theFileIndex >= myTable.getFileNames().size()) {
+            return std::nullopt;
+        }
+
+        return SourceLocation{myTable.getFileNames()[myEntry->theFileIndex],
+                              myEntry->theLine, myEntry->theAddress};
+    }
+
+    std::vector<std::uint64_t>
+    Dwarf::getLineAddresses(std::string_view aFile, std::uint32_t aLine) const {
+        waitForIndex();
+
+        std::vector<std::uint64_t> myResult;
+
+        for (std::size_t i = 0; i < theUnits.size(); ++i) {
+            // Only the file table is needed to rule a unit out, so the line
+            // program is decoded only for units that mention the file
+            auto& myHeader = ensureLineTable(i, true);
+
+            auto& myFiles = myHeader.getFileNames();
+            for (std::size_t myFileIdx = 0; myFileIdx < myFiles.size();
+                 ++myFileIdx) {
+                if (!pathMatches(myFiles[myFileIdx], aFile)) {
+                    continue;
+                }
+
+                auto& myTable = ensureLineTable(i, false);
+                auto myEntries = myTable.getEntriesForLine(
+                    static_cast<std::uint16_t>(myFileIdx), aLine);
+                if (myEntries.empty()) {
+                    continue;
+                }
+
+                auto* myLowest = *std::ranges::min_element(
+                    myEntries, {}, &LineEntry::theAddress);
+                if (std::ranges::find(myResult, myLowest->theAddress) ==
+                    myResult.end()) {
+                    myResult.push_back(myLowest->theAddress);
+                }
+            }
+        }
+
+        return myResult;
+    }
+
+} // namespace sdb
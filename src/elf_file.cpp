@@ -0,0 +1,454 @@
+#include <elf_file.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <error.hpp>
+#include <fmt/format.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace sdb {
+
+    namespace {
+        bool isIndexableSymbol(const Elf64_Sym& aSymbol) {
+            auto myType = ELF64_ST_TYPE(aSymbol.st_info);
+
+            return aSymbol.st_shndx != SHN_UNDEF and aSymbol.st_name != 0 and
+                   (myType == STT_FUNC or myType == STT_OBJECT or
+                    myType == STT_GNU_IFUNC);
+        }
+    } // namespace
+
+    ElfFile::ElfFile(const std::filesystem::path& aPath) : thePath{aPath} {
+        theFd = open(aPath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (theFd < 0) {
+            Error::sendErrno(
+                fmt::format("Could not open ELF file {}: ", aPath.string()));
+        }
+
+        struct stat myStats;
+        if (fstat(theFd, &myStats) < 0) {
+            close(theFd);
+            Error::sendErrno("Could not stat ELF file: ");
+        }
+        theSize = myStats.st_size;
+
+        void* myMapping =
+            mmap(nullptr, theSize, PROT_READ, MAP_PRIVATE, theFd, 0);
+        if (myMapping == MAP_FAILED) {
+            close(theFd);
+            Error::sendErrno("Could not mmap ELF file: ");
+        }
+        theData = static_cast<const std::byte*>(myMapping);
+
+        if (!hasValidHeader()) {
+            munmap(myMapping, theSize);
+            close(theFd);
+            Error::send(fmt::format("{} is not a 64-bit ELF file",
+                                    aPath.string()));
+        }
+
+        theHeader = reinterpret_cast<const Elf64_Ehdr*>(theData);
+        parseSectionHeaders();
+    }
+
+    ElfFile::ElfFile(std::vector<std::byte> anImage,
+                     const std::filesystem::path& aName)
+        : thePath{aName}, theOwnedImage{std::move(anImage)} {
+        theData = theOwnedImage.data();
+        theSize = theOwnedImage.size();
+
+        if (!hasValidHeader()) {
+            Error::send(fmt::format("{} is not a 64-bit ELF file",
+                                    aName.string()));
+        }
+
+        theHeader = reinterpret_cast<const Elf64_Ehdr*>(theData);
+        parseSectionHeaders();
+    }
+
+    ElfFile::~ElfFile() {
+        if (theFd >= 0) {
+            munmap(const_cast<std::byte*>(theData), theSize);
+            close(theFd);
+        }
+    }
+
+    bool ElfFile::hasValidHeader() const {
+        return theSize >= sizeof(Elf64_Ehdr) and
+               std::memcmp(theData, ELFMAG, SELFMAG) == 0 and
+               static_cast<unsigned char>(theData[EI_CLASS]) == ELFCLASS64;
+    }
+
+    void ElfFile::checkRange(std::uint64_t anOffset,
+                             std::uint64_t aSize) const {
+        if (anOffset > theSize or aSize > theSize - anOffset) {
+            Error::send(fmt::format("{} refers to bytes past its end",
+                                    thePath.string()));
+        }
+    }
+
+    std::string_view ElfFile::getStringTable(std::size_t anIndex) const {
+        if (anIndex >= theSectionHeaders.size()) {
+            Error::send(fmt::format("{} has no string table at section {}",
+                                    thePath.string(), anIndex));
+        }
+
+        auto& mySection = theSectionHeaders[anIndex];
+        checkRange(mySection.sh_offset, mySection.sh_size);
+        std::string_view myStrings{
+            reinterpret_cast<const char*>(theData + mySection.sh_offset),
+            mySection.sh_size};
+        if (myStrings.empty() or myStrings.back() != '\0') {
+            Error::send(fmt::format("{} has a malformed string table",
+                                    thePath.string()));
+        }
+
+        return myStrings;
+    }
+
+    std::string_view ElfFile::getString(std::string_view aTable,
+                                        std::uint64_t anOffset) const {
+        if (anOffset >= aTable.size()) {
+            Error::send(fmt::format("{} names a string past its string table",
+                                    thePath.string()));
+        }
+
+        return {aTable.data() + anOffset};
+    }
+
+    void ElfFile::parseSectionHeaders() {
+        if (theHeader->e_shoff == 0) {
+            return;
+        }
+
+        checkRange(theHeader->e_shoff, sizeof(Elf64_Shdr));
+        std::size_t myNumSections = theHeader->e_shnum;
+        auto* myHeaders =
+            reinterpret_cast<const Elf64_Shdr*>(theData + theHeader->e_shoff);
+
+        // With more than SHN_LORESERVE sections, the real count lives in the
+        // size field of the first section header
+        if (myNumSections == 0) {
+            myNumSections = myHeaders[0].sh_size;
+        }
+
+        if (myNumSections >
+            (theSize - theHeader->e_shoff) / sizeof(Elf64_Shdr)) {
+            Error::send(fmt::format("{} has more section headers than fit",
+                                    thePath.string()));
+        }
+        theSectionHeaders = {myHeaders, myNumSections};
+
+        for (std::size_t i = 0; i < theSectionHeaders.size(); ++i) {
+            theSectionMap.emplace(getSectionName(i),
+                                  std::addressof(theSectionHeaders[i]));
+        }
+    }
+
+    std::string_view ElfFile::getSectionName(std::size_t anIndex) const {
+        std::size_t myStringTableIdx = theHeader->e_shstrndx;
+        if (myStringTableIdx == SHN_UNDEF) {
+            return {};
+        }
+        if (myStringTableIdx == SHN_XINDEX) {
+            myStringTableIdx = theSectionHeaders[0].sh_link;
+        }
+
+        return getString(getStringTable(myStringTableIdx),
+                         theSectionHeaders[anIndex].sh_name);
+    }
+
+    std::span<const Elf64_Phdr> ElfFile::getProgramHeaders() const {
+        if (theHeader->e_phoff == 0) {
+            return {};
+        }
+
+        checkRange(theHeader->e_phoff,
+                   theHeader->e_phnum * sizeof(Elf64_Phdr));
+        auto* myHeaders =
+            reinterpret_cast<const Elf64_Phdr*>(theData + theHeader->e_phoff);
+        return {myHeaders, theHeader->e_phnum};
+    }
+
+    const Elf64_Shdr* ElfFile::getSection(std::string_view aName) const {
+        auto myIt = theSectionMap.find(aName);
+        return myIt == theSectionMap.end() ? nullptr : myIt->second;
+    }
+
+    std::span<const std::byte>
+    ElfFile::getSectionContents(std::string_view aName) const {
+        auto* mySection = getSection(aName);
+        if (mySection == nullptr or mySection->sh_type == SHT_NOBITS) {
+            return {};
+        }
+
+        checkRange(mySection->sh_offset, mySection->sh_size);
+        return {theData + mySection->sh_offset, mySection->sh_size};
+    }
+
+    const Elf64_Shdr* ElfFile::findSymbolTable() const {
+        auto* mySymbolTable = getSection(".symtab");
+        if (mySymbolTable == nullptr) {
+            mySymbolTable = getSection(".dynsym");
+        }
+
+        if (mySymbolTable != nullptr) {
+            theSymbolStrings = getStringTable(mySymbolTable->sh_link);
+        }
+
+        return mySymbolTable;
+    }
+
+    void ElfFile::loadSymbols() const {
+        theSymbolsLoaded = true;
+
+        auto* mySymbolTable = findSymbolTable();
+        if (mySymbolTable == nullptr) {
+            return;
+        }
+
+        checkRange(mySymbolTable->sh_offset, mySymbolTable->sh_size);
+        std::span<const Elf64_Sym> myElfSymbols{
+            reinterpret_cast<const Elf64_Sym*>(theData +
+                                               mySymbolTable->sh_offset),
+            mySymbolTable->sh_size / sizeof(Elf64_Sym)};
+
+        // Symbols of relocatable objects are relative to their section,
+        // whose address is set once the object has been loaded, as JIT
+        // compilers do for the objects they register
+        bool myIsRelocatable = theHeader->e_type == ET_REL;
+
+        theOwnedSymbols.reserve(myElfSymbols.size());
+        for (auto& myElfSymbol : myElfSymbols) {
+            if (!isIndexableSymbol(myElfSymbol)) {
+                continue;
+            }
+
+            // Names are read without checks on lookup, so check them once
+            getString(theSymbolStrings, myElfSymbol.st_name);
+
+            auto myAddress = myElfSymbol.st_value;
+            if (myIsRelocatable and
+                myElfSymbol.st_shndx < theSectionHeaders.size()) {
+                myAddress += theSectionHeaders[myElfSymbol.st_shndx].sh_addr;
+            }
+
+            if (myAddress != 0) {
+                theOwnedSymbols.push_back(
+                    {myAddress, static_cast<std::uint32_t>(myElfSymbol.st_size),
+                     myElfSymbol.st_name});
+            }
+        }
+
+        std::ranges::sort(theOwnedSymbols, {}, &ElfSymbol::theAddress);
+        theOwnedSymbols.shrink_to_fit();
+        theSymbols = theOwnedSymbols;
+    }
+
+    void ElfFile::buildNameIndex() const {
+        auto mySymbols = getSymbols();
+
+        theOwnedSymbolsByName.resize(mySymbols.size());
+        for (std::uint32_t i = 0; i < theOwnedSymbolsByName.size(); ++i) {
+            theOwnedSymbolsByName[i] = i;
+        }
+
+        std::ranges::sort(theOwnedSymbolsByName, {}, [&](std::uint32_t anIdx) {
+            return getSymbolName(mySymbols[anIdx]);
+        });
+        theSymbolsByName = theOwnedSymbolsByName;
+    }
+
+    std::span<const std::uint32_t> ElfFile::getNameIndex() const {
+        if (theSymbolsByName.empty() and !getSymbols().empty()) {
+            buildNameIndex();
+        }
+
+        return theSymbolsByName;
+    }
+
+    void ElfFile::setSymbolIndex(std::span<const ElfSymbol> aSymbols,
+                                 std::span<const std::uint32_t> aNameIndex) {
+        findSymbolTable();
+
+        theOwnedSymbols.clear();
+        theOwnedSymbolsByName.clear();
+        theSymbols = aSymbols;
+        theSymbolsByName = aNameIndex;
+        theSymbolsLoaded = true;
+    }
+
+    std::optional<std::string> ElfFile::getBuildId() const {
+        for (auto& mySection : theSectionHeaders) {
+            if (mySection.sh_type != SHT_NOTE) {
+                continue;
+            }
+
+            checkRange(mySection.sh_offset, mySection.sh_size);
+            auto myOffset = mySection.sh_offset;
+            auto myEnd = mySection.sh_offset + mySection.sh_size;
+            while (myOffset + sizeof(Elf64_Nhdr) <= myEnd) {
+                auto* myNote =
+                    reinterpret_cast<const Elf64_Nhdr*>(theData + myOffset);
+                auto myNameOffset = myOffset + sizeof(Elf64_Nhdr);
+                auto myDescOffset =
+                    myNameOffset + ((myNote->n_namesz + 3) & ~3ull);
+
+                if (myDescOffset + myNote->n_descsz > myEnd) {
+                    break;
+                }
+
+                if (myNote->n_type == NT_GNU_BUILD_ID and
+                    myNote->n_namesz == 4 and
+                    std::memcmp(theData + myNameOffset, "GNU", 4) == 0) {
+                    std::string myBuildId;
+                    for (std::size_t i = 0; i < myNote->n_descsz; ++i) {
+                        myBuildId += fmt::format(
+                            "{:02x}", static_cast<std::uint8_t>(
+                                          theData[myDescOffset + i]));
+                    }
+                    return myBuildId;
+                }
+
+                myOffset = myDescOffset + ((myNote->n_descsz + 3) & ~3ull);
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    std::vector<ElfPltStub> ElfFile::getPltStubs() const {
+        auto* myRelocations = getSection(".rela.plt");
+        if (myRelocations == nullptr or
+            myRelocations->sh_link >= theSectionHeaders.size()) {
+            return {};
+        }
+
+        auto& mySymbolTable = theSectionHeaders[myRelocations->sh_link];
+        auto myStrings = getStringTable(mySymbolTable.sh_link);
+        checkRange(mySymbolTable.sh_offset, mySymbolTable.sh_size);
+        checkRange(myRelocations->sh_offset, myRelocations->sh_size);
+        std::span<const Elf64_Sym> mySymbols{
+            reinterpret_cast<const Elf64_Sym*>(theData +
+                                               mySymbolTable.sh_offset),
+            mySymbolTable.sh_size / sizeof(Elf64_Sym)};
+
+        // Irelative relocations name no symbol and are left out
+        std::unordered_map<std::uint64_t, std::string_view> mySlots;
+        std::span<const Elf64_Rela> myEntries{
+            reinterpret_cast<const Elf64_Rela*>(theData +
+                                                myRelocations->sh_offset),
+            myRelocations->sh_size / sizeof(Elf64_Rela)};
+        for (auto& myEntry : myEntries) {
+            auto mySymbol = ELF64_R_SYM(myEntry.r_info);
+            if (mySymbol == 0 or mySymbol >= mySymbols.size()) {
+                continue;
+            }
+
+            mySlots.emplace(myEntry.r_offset,
+                            getString(myStrings, mySymbols[mySymbol].st_name));
+        }
+
+        // With IBT the stubs called are in .plt.sec; otherwise .plt starts
+        // with a stub of its own that calls the dynamic linker
+        std::uint64_t myFirst = 0;
+        auto* myStubs = getSection(".plt.sec");
+        if (myStubs == nullptr) {
+            myStubs = getSection(".plt");
+            myFirst = 1;
+        }
+        if (myStubs == nullptr or myStubs->sh_type == SHT_NOBITS) {
+            return {};
+        }
+        checkRange(myStubs->sh_offset, myStubs->sh_size);
+
+        // The stub jumps through its slot with ff 25 and a displacement
+        // from the end of the jump, after an endbr64 or bnd prefix if any
+        std::uint64_t myStubSize =
+            myStubs->sh_entsize != 0 ? myStubs->sh_entsize : 16;
+        std::vector<ElfPltStub> myResult;
+        for (auto myOffset = myFirst * myStubSize;
+             myOffset + myStubSize <= myStubs->sh_size;
+             myOffset += myStubSize) {
+            auto* myStub = theData + myStubs->sh_offset + myOffset;
+            for (std::uint64_t i = 0; i + 6 <= myStubSize; ++i) {
+                if (myStub[i] != std::byte{0xff} or
+                    myStub[i + 1] != std::byte{0x25}) {
+                    continue;
+                }
+
+                std::int32_t myDisplacement;
+                std::memcpy(&myDisplacement, myStub + i + 2,
+                            sizeof(myDisplacement));
+                auto myAddress = myStubs->sh_addr + myOffset;
+                auto mySlot = myAddress + i + 6 + myDisplacement;
+                if (auto myIt = mySlots.find(mySlot); myIt != mySlots.end()) {
+                    myResult.push_back({myAddress, myIt->second});
+                }
+                break;
+            }
+        }
+
+        return myResult;
+    }
+
+    std::span<const ElfSymbol> ElfFile::getSymbols() const {
+        if (!theSymbolsLoaded) {
+            loadSymbols();
+        }
+
+        return theSymbols;
+    }
+
+    std::string_view ElfFile::getSymbolName(const ElfSymbol& aSymbol) const {
+        return {theSymbolStrings.data() + aSymbol.theNameOffset};
+    }
+
+    const ElfSymbol*
+    ElfFile::getSymbolContainingAddress(std::uint64_t aFileAddress) const {
+        auto mySymbols = getSymbols();
+
+        // Find the last symbol starting at or before the address. Aliases
+        // share an address, so walk back over them looking for one whose
+        // extent covers the address.
+        auto myIt = std::ranges::upper_bound(mySymbols, aFileAddress, {},
+                                             &ElfSymbol::theAddress);
+        if (myIt == mySymbols.begin()) {
+            return nullptr;
+        }
+
+        auto myStart = std::prev(myIt)->theAddress;
+        while (myIt != mySymbols.begin() and
+               std::prev(myIt)->theAddress == myStart) {
+            --myIt;
+
+            auto mySize = std::max<std::uint64_t>(myIt->theSize, 1);
+            if (aFileAddress < myIt->theAddress + mySize) {
+                return std::addressof(*myIt);
+            }
+        }
+
+        return nullptr;
+    }
+
+    std::vector<const ElfSymbol*>
+    ElfFile::getSymbolsByName(std::string_view aName) const {
+        auto mySymbols = getSymbols();
+        auto [myBegin, myEnd] = std::ranges::equal_range(
+            getNameIndex(), aName, {}, [&](std::uint32_t anIdx) {
+                return getSymbolName(mySymbols[anIdx]);
+            });
+
+        std::vector<const ElfSymbol*> myResult;
+        for (auto myIt = myBegin; myIt != myEnd; ++myIt) {
+            myResult.push_back(std::addressof(mySymbols[*myIt]));
+        }
+
+        return myResult;
+    }
+
+} // namespace sdb
@@ -0,0 +1,522 @@
+#include <execution_recorder.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <error.hpp>
+#include <libsdb/register_info.hpp>
+#include <memory_operations.hpp>
+#include <process.hpp>
+#include <ranges>
+#include <string_view>
+#include <sys/uio.h>
+
+namespace sdb {
+
+    namespace {
+        // Registers are compared as the 8 byte words of the general purpose
+        // registers followed by those of the floating point ones
+        constexpr std::size_t NUM_GPR_WORDS{sizeof(user_regs_struct) / 8};
+        constexpr std::size_t NUM_REGISTER_WORDS{
+            NUM_GPR_WORDS + sizeof(user_fpregs_struct) / 8};
+
+        std::size_t getWordOffset(std::size_t anIndex) {
+            return anIndex < NUM_GPR_WORDS
+                       ? offsetof(user, regs) + anIndex * 8
+                       : offsetof(user, i387) + (anIndex - NUM_GPR_WORDS) * 8;
+        }
+
+        std::uint64_t readWord(const user& aRegisters, std::size_t anIndex) {
+            std::uint64_t myWord;
+            std::memcpy(&myWord,
+                        reinterpret_cast<const std::byte*>(&aRegisters) +
+                            getWordOffset(anIndex),
+                        sizeof(myWord));
+            return myWord;
+        }
+
+        void writeWord(user& aRegisters, std::size_t anIndex,
+                       std::uint64_t aWord) {
+            std::memcpy(reinterpret_cast<std::byte*>(&aRegisters) +
+                            getWordOffset(anIndex),
+                        &aWord, sizeof(aWord));
+        }
+
+        template <typename T>
+        void append(std::vector<std::byte>& aBuffer, T aValue) {
+            auto myBytes = std::as_bytes(std::span{&aValue, 1});
+            aBuffer.insert(aBuffer.end(), myBytes.begin(), myBytes.end());
+        }
+
+        template <typename T>
+        T extract(std::span<const std::byte> aBuffer, std::size_t& anOffset) {
+            T myValue;
+            std::memcpy(&myValue, aBuffer.data() + anOffset, sizeof(myValue));
+            anOffset += sizeof(myValue);
+            return myValue;
+        }
+
+        // Mnemonics whose memory operand is only read, even when it is the
+        // last one
+        bool isReadOnly(std::string_view aMnemonic) {
+            static constexpr std::string_view myReaders[]{
+                "cmp",   "test",  "lea",   "nop",     "prefetch",
+                "j",     "call",  "push",  "ucomi",   "comi",
+                "ptest", "vptest", "fld",  "fild",    "fcom",
+                "fucom", "fadd",  "fsub",  "fmul",    "fdiv",
+                "mul",   "div",   "idiv",  "clflush", "ldmxcsr"};
+            // Comparisons read, but exchanges after one write, as do bts,
+            // btr and btc
+            if (aMnemonic.starts_with("cmpxchg")) {
+                return false;
+            }
+            if (aMnemonic.starts_with("bt")) {
+                return aMnemonic == "bt" or aMnemonic == "btw" or
+                       aMnemonic == "btl" or aMnemonic == "btq";
+            }
+            return std::ranges::any_of(myReaders, [&](auto aReader) {
+                return aMnemonic.starts_with(aReader);
+            });
+        }
+
+        const RegisterInfo* findAddressRegister(std::string_view aName) {
+            aName.remove_prefix(aName.starts_with('%') ? 1 : 0);
+            auto myFound = std::ranges::find_if(
+                g_register_infos, [&](const RegisterInfo& anInfo) {
+                    return anInfo.theName == aName and
+                           (anInfo.theRegisterType == RegisterType::gpr or
+                            anInfo.theRegisterType == RegisterType::sub_gpr);
+                });
+            return myFound == std::end(g_register_infos) ? nullptr : &*myFound;
+        }
+
+        std::size_t getRegisterOperandSize(std::string_view aName) {
+            aName.remove_prefix(1);
+            if (aName.starts_with("xmm")) {
+                return 16;
+            }
+            if (aName.starts_with("ymm")) {
+                return 32;
+            }
+            if (aName.starts_with("zmm")) {
+                return 64;
+            }
+            if (aName.starts_with("st")) {
+                return 10;
+            }
+            auto* myInfo = findAddressRegister(aName);
+            return myInfo ? myInfo->theSize : 8;
+        }
+
+        // The size written by an instruction with no register operand to
+        // tell it, from its name or its operand size suffix
+        std::size_t getSizeFromMnemonic(std::string_view aMnemonic) {
+            static constexpr std::pair<std::string_view, std::size_t>
+                mySpecial[]{{"fxsave", 512},   {"xsave", 4096},
+                            {"cmpxchg16b", 16}, {"fnstenv", 28},
+                            {"fnsave", 108},   {"fstpt", 10},
+                            {"fbstp", 10}};
+            for (auto [myName, mySize] : mySpecial) {
+                if (aMnemonic.starts_with(myName)) {
+                    return mySize;
+                }
+            }
+
+            switch (aMnemonic.back()) {
+                case 'b': return 1;
+                case 'w': return 2;
+                case 'l': return 4;
+                case 'q': return 8;
+                default: return 16;
+            }
+        }
+
+        std::optional<std::int64_t> parseDisplacement(std::string_view aText) {
+            bool myIsNegative = aText.starts_with('-');
+            aText.remove_prefix(myIsNegative ? 1 : 0);
+            if (aText.empty()) {
+                return 0;
+            }
+            if (!aText.starts_with("0x")) {
+                return std::nullopt;
+            }
+
+            std::uint64_t myValue = 0;
+            aText.remove_prefix(2);
+            auto [myEnd, myError] = std::from_chars(
+                aText.data(), aText.data() + aText.size(), myValue, 16);
+            if (myError != std::errc{} or
+                myEnd != aText.data() + aText.size()) {
+                return std::nullopt;
+            }
+
+            auto mySigned = static_cast<std::int64_t>(myValue);
+            return myIsNegative ? -mySigned : mySigned;
+        }
+
+        std::vector<std::string_view> splitOperands(std::string_view aText) {
+            std::vector<std::string_view> myOperands;
+            int myDepth = 0;
+            std::size_t myStart = 0;
+            for (std::size_t i = 0; i <= aText.size(); ++i) {
+                if (i == aText.size() or (aText[i] == ',' and myDepth == 0)) {
+                    auto myOperand = aText.substr(myStart, i - myStart);
+                    while (!myOperand.empty() and myOperand.front() == ' ') {
+                        myOperand.remove_prefix(1);
+                    }
+                    while (!myOperand.empty() and myOperand.back() == ' ') {
+                        myOperand.remove_suffix(1);
+                    }
+                    if (!myOperand.empty()) {
+                        myOperands.push_back(myOperand);
+                    }
+                    myStart = i + 1;
+                } else if (aText[i] == '(') {
+                    ++myDepth;
+                } else if (aText[i] == ')') {
+                    --myDepth;
+                }
+            }
+
+            return myOperands;
+        }
+    } // namespace
+
+    ExecutionRecorder::ExecutionRecorder(Process& aProcess,
+                                         std::size_t aCapacity)
+        : theProcess{aProcess}, theDisassembler{aProcess},
+          theData(aCapacity) {
+    }
+
+    const ExecutionRecorder::Stores&
+    ExecutionRecorder::decode(VirtualAddress aPc) {
+        auto myFound = theDecoded.find(std::to_underlying(aPc));
+        if (myFound != theDecoded.end()) {
+            return myFound->second;
+        }
+
+        auto myInstructions = theDisassembler.disassemble(2, aPc);
+        auto myNext = std::to_underlying(myInstructions[1].theAddress);
+        std::string_view myText = myInstructions[0].theInstruction;
+        myText = myText.substr(0, myText.find('#'));
+
+        static constexpr std::string_view myPrefixes[]{
+            "lock", "rep",  "repz",    "repnz", "repe", "repne",
+            "bnd",  "notrack", "cs",   "ds",    "data16", "addr32"};
+        std::string_view myMnemonic;
+        while (!myText.empty()) {
+            auto myEnd = myText.find_first_of(" \t");
+            auto myWord = myText.substr(0, myEnd);
+            myText = myEnd == std::string_view::npos ? std::string_view{}
+                                                     : myText.substr(myEnd + 1);
+            if (!myWord.empty() and std::ranges::find(myPrefixes, myWord) ==
+                                        std::end(myPrefixes)) {
+                myMnemonic = myWord;
+                break;
+            }
+        }
+
+        Stores myStores;
+        myStores.theIsPush = myMnemonic.starts_with("push") or
+                             myMnemonic.starts_with("call") or
+                             myMnemonic.starts_with("enter");
+
+        auto myOperands = splitOperands(myText);
+        auto parseMemory =
+            [&](std::string_view anOperand) -> std::optional<MemoryOperand> {
+            MemoryOperand myMemory;
+            if (anOperand.starts_with("%fs:") or
+                anOperand.starts_with("%gs:")) {
+                myMemory.theSegment =
+                    (anOperand[1] == 'f'
+                         ? offsetof(user_regs_struct, fs_base)
+                         : offsetof(user_regs_struct, gs_base)) /
+                    8;
+                anOperand.remove_prefix(4);
+            } else if (anOperand.size() > 4 and anOperand[0] == '%' and
+                       anOperand[3] == ':') {
+                anOperand.remove_prefix(4);
+            }
+            if (anOperand.empty() or anOperand.front() == '%' or
+                anOperand.front() == '$' or anOperand.front() == '*') {
+                return std::nullopt;
+            }
+
+            auto myParen = anOperand.find('(');
+            auto myDisplacement =
+                parseDisplacement(anOperand.substr(0, myParen));
+            if (!myDisplacement) {
+                return std::nullopt;
+            }
+            myMemory.theDisplacement = *myDisplacement;
+            if (myParen == std::string_view::npos) {
+                return myMemory;
+            }
+
+            auto myInside = anOperand.substr(myParen + 1);
+            myInside = myInside.substr(0, myInside.find(')'));
+            auto myParts = std::vector<std::string_view>{};
+            for (std::size_t myStart = 0; myStart <= myInside.size();) {
+                auto myComma = myInside.find(',', myStart);
+                myParts.push_back(myInside.substr(myStart, myComma - myStart));
+                if (myComma == std::string_view::npos) {
+                    break;
+                }
+                myStart = myComma + 1;
+            }
+
+            if (myParts[0] == "%rip" or myParts[0] == "%eip") {
+                myMemory.theDisplacement += static_cast<std::int64_t>(myNext);
+            } else if (!myParts[0].empty()) {
+                auto* myBase = findAddressRegister(myParts[0]);
+                if (!myBase) {
+                    return std::nullopt;
+                }
+                myMemory.theBase = myBase->theOffset / 8;
+            }
+            if (myParts.size() > 1 and !myParts[1].empty()) {
+                auto* myIndex = findAddressRegister(myParts[1]);
+                if (!myIndex) {
+                    return std::nullopt;
+                }
+                myMemory.theIndex = myIndex->theOffset / 8;
+            }
+            if (myParts.size() > 2 and !myParts[2].empty()) {
+                myMemory.theScale =
+                    static_cast<std::uint8_t>(myParts[2][0] - '0');
+            }
+            return myMemory;
+        };
+
+        if (!myMnemonic.empty() and !isReadOnly(myMnemonic) and
+            !myOperands.empty()) {
+            // The destination comes last, except that either operand of an
+            // exchange may be memory
+            auto myDestination = parseMemory(myOperands.back());
+            if (!myDestination and myMnemonic.starts_with("xchg")) {
+                myDestination = parseMemory(myOperands.front());
+            }
+
+            if (myDestination) {
+                std::size_t mySize = 0;
+                for (auto myOperand : myOperands) {
+                    if (myOperand.starts_with('%') and
+                        myOperand.find_first_of("(:") ==
+                            std::string_view::npos) {
+                        mySize = std::max(mySize,
+                                          getRegisterOperandSize(myOperand));
+                    }
+                }
+
+                // Saving a little more than is written is harmless, as
+                // the extra bytes are put back as they were
+                myDestination->theSize =
+                    std::max<std::size_t>(
+                        mySize ? mySize : getSizeFromMnemonic(myMnemonic), 8);
+                myStores.theDestination = myDestination;
+            }
+        }
+
+        return theDecoded.emplace(std::to_underlying(aPc), myStores)
+            .first->second;
+    }
+
+    void ExecutionRecorder::beginStep(const user& aRegisters) {
+        theStepStart = std::chrono::steady_clock::now();
+        theWrites.clear();
+        theNumWrites = 0;
+
+        auto& myStores = decode(VirtualAddress{aRegisters.regs.rip});
+        if (myStores.theIsPush) {
+            saveMemory(aRegisters.regs.rsp - 8, 8);
+        }
+        if (auto& myMemory = myStores.theDestination) {
+            auto myAddress = static_cast<std::uint64_t>(
+                myMemory->theDisplacement);
+            if (myMemory->theSegment) {
+                myAddress += readWord(aRegisters, *myMemory->theSegment);
+            }
+            if (myMemory->theBase) {
+                myAddress += readWord(aRegisters, *myMemory->theBase);
+            }
+            if (myMemory->theIndex) {
+                myAddress += readWord(aRegisters, *myMemory->theIndex) *
+                             myMemory->theScale;
+            }
+            saveMemory(myAddress, myMemory->theSize);
+        }
+    }
+
+    void ExecutionRecorder::saveMemory(std::uint64_t anAddress,
+                                       std::size_t aSize) {
+        // Stored as the address, the size and the bytes, of which only
+        // those that could be read count
+        auto myHeader = theWrites.size();
+        append(theWrites, anAddress);
+        append<std::uint16_t>(theWrites, 0);
+        auto myStart = theWrites.size();
+        theWrites.resize(myStart + aSize);
+
+        iovec myLocal{theWrites.data() + myStart, aSize};
+        iovec myRemote[2];
+        auto myToPageEnd = 0x1000 - (anAddress & 0xfff);
+        myRemote[0] = {reinterpret_cast<void*>(anAddress),
+                       std::min<std::size_t>(aSize, myToPageEnd)};
+        myRemote[1] = {reinterpret_cast<void*>(anAddress + myRemote[0].iov_len),
+                       aSize - myRemote[0].iov_len};
+        auto myRead = process_vm_readv(theProcess.getPid(), &myLocal, 1,
+                                       myRemote, myRemote[1].iov_len ? 2 : 1,
+                                       0);
+        if (myRead <= 0) {
+            // The instruction will fault on it, so there is nothing to undo
+            theWrites.resize(myHeader);
+            return;
+        }
+
+        auto mySize = static_cast<std::uint16_t>(myRead);
+        std::memcpy(theWrites.data() + myHeader + sizeof(anAddress), &mySize,
+                    sizeof(mySize));
+        theWrites.resize(myStart + mySize);
+        ++theNumWrites;
+    }
+
+    void ExecutionRecorder::commitStep(const user& anOld, const user& aNew) {
+        // Laid out as the size, the counts of registers and writes, the
+        // register numbers, their old values, the writes and the size again
+        theRecord.clear();
+        append<std::uint32_t>(theRecord, 0);
+        append<std::uint8_t>(theRecord, 0);
+        append(theRecord, theNumWrites);
+
+        std::uint8_t myNumRegisters = 0;
+        std::uint64_t myOldValues[NUM_REGISTER_WORDS];
+        for (std::size_t i = 0; i < NUM_REGISTER_WORDS; ++i) {
+            auto myOld = readWord(anOld, i);
+            if (myOld != readWord(aNew, i)) {
+                append(theRecord, static_cast<std::uint8_t>(i));
+                myOldValues[myNumRegisters++] = myOld;
+            }
+        }
+        theRecord.insert(
+            theRecord.end(),
+            reinterpret_cast<const std::byte*>(myOldValues),
+            reinterpret_cast<const std::byte*>(myOldValues + myNumRegisters));
+        theRecord.insert(theRecord.end(), theWrites.begin(), theWrites.end());
+
+        auto mySize = static_cast<std::uint32_t>(theRecord.size() +
+                                                 sizeof(std::uint32_t));
+        append(theRecord, mySize);
+        std::memcpy(theRecord.data(), &mySize, sizeof(mySize));
+        std::memcpy(theRecord.data() + sizeof(mySize), &myNumRegisters,
+                    sizeof(myNumRegisters));
+
+        push(theRecord);
+        ++theNumRecorded;
+        theBytesRecorded += theRecord.size();
+        theRecordingTime += std::chrono::steady_clock::now() - theStepStart;
+    }
+
+    void ExecutionRecorder::discardStep() {
+        theWrites.clear();
+        theNumWrites = 0;
+        theRecordingTime += std::chrono::steady_clock::now() - theStepStart;
+    }
+
+    void ExecutionRecorder::push(std::span<const std::byte> aRecord) {
+        if (aRecord.size() > theData.size()) {
+            // Too big to keep, so nothing before it can be undone either
+            theNumDropped += theNumRecords + 1;
+            theBegin = theUsed = theNumRecords = 0;
+            return;
+        }
+
+        while (theData.size() - theUsed < aRecord.size()) {
+            std::uint32_t myOldestSize;
+            copyOut(theBegin,
+                    std::as_writable_bytes(std::span{&myOldestSize, 1}));
+            theBegin = (theBegin + myOldestSize) % theData.size();
+            theUsed -= myOldestSize;
+            --theNumRecords;
+            ++theNumDropped;
+        }
+
+        copyIn(theBegin + theUsed, aRecord);
+        theUsed += aRecord.size();
+        ++theNumRecords;
+    }
+
+    bool ExecutionRecorder::undoLast(user& aRegisters) {
+        if (theNumRecords == 0) {
+            return false;
+        }
+
+        std::uint32_t mySize;
+        copyOut(theBegin + theUsed - sizeof(mySize),
+                std::as_writable_bytes(std::span{&mySize, 1}));
+        theRecord.resize(mySize);
+        copyOut(theBegin + theUsed - mySize, theRecord);
+
+        std::size_t myOffset = sizeof(mySize);
+        auto myNumRegisters = extract<std::uint8_t>(theRecord, myOffset);
+        auto myNumWrites = extract<std::uint8_t>(theRecord, myOffset);
+        auto myValues = myOffset + myNumRegisters;
+        for (std::size_t i = 0; i < myNumRegisters; ++i) {
+            auto myIndex = static_cast<std::uint8_t>(theRecord[myOffset + i]);
+            std::size_t myValueOffset = myValues + i * sizeof(std::uint64_t);
+            writeWord(aRegisters, myIndex,
+                      extract<std::uint64_t>(theRecord, myValueOffset));
+        }
+
+        // Writes of one instruction are put back newest first
+        myOffset = myValues + myNumRegisters * sizeof(std::uint64_t);
+        std::vector<std::pair<std::uint64_t, std::span<const std::byte>>>
+            myWrites;
+        for (std::size_t i = 0; i < myNumWrites; ++i) {
+            auto myAddress = extract<std::uint64_t>(theRecord, myOffset);
+            auto myWriteSize = extract<std::uint16_t>(theRecord, myOffset);
+            myWrites.emplace_back(myAddress, std::span<const std::byte>{
+                                                 theRecord.data() + myOffset,
+                                                 myWriteSize});
+            myOffset += myWriteSize;
+        }
+        for (auto& [myAddress, myBytes] : myWrites | std::views::reverse) {
+            writeMemory(theProcess.getPid(), VirtualAddress{myAddress},
+                        myBytes);
+        }
+
+        theUsed -= mySize;
+        --theNumRecords;
+        return true;
+    }
+
+    void ExecutionRecorder::clear() {
+        theDecoded.clear();
+        theBegin = 0;
+        theUsed = 0;
+        theNumRecords = 0;
+        theNumDropped = 0;
+        theNumRecorded = 0;
+        theBytesRecorded = 0;
+        theRecordingTime = {};
+    }
+
+    void ExecutionRecorder::copyIn(std::size_t anOffset,
+                                   std::span<const std::byte> aBytes) {
+        anOffset %= theData.size();
+        auto myFirst = std::min(aBytes.size(), theData.size() - anOffset);
+        std::memcpy(theData.data() + anOffset, aBytes.data(), myFirst);
+        std::memcpy(theData.data(), aBytes.data() + myFirst,
+                    aBytes.size() - myFirst);
+    }
+
+    void ExecutionRecorder::copyOut(std::size_t anOffset,
+                                    std::span<std::byte> aBytes) const {
+        anOffset %= theData.size();
+        auto myFirst = std::min(aBytes.size(), theData.size() - anOffset);
+        std::memcpy(aBytes.data(), theData.data() + anOffset, myFirst);
+        std::memcpy(aBytes.data() + myFirst, theData.data(),
+                    aBytes.size() - myFirst);
+    }
+
+} // namespace sdb
@@ -0,0 +1,271 @@
+#include <fast_tracepoint.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <code_arena.hpp>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <error.hpp>
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <memory_operations.hpp>
+#include <optional>
+#include <process.hpp>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <x86intrin.h>
+
+namespace sdb {
+
+    namespace {
+        bool isFastCapture(const TraceCapture& aCapture) {
+            if (aCapture.theSize or !aCapture.theRegister) {
+                return false;
+            }
+
+            auto myId = aCapture.theRegister->theId;
+            return myId == RegisterId::rip or myId == RegisterId::eflags or
+                   getRegisterEncoding(myId).has_value();
+        }
+
+        std::uint64_t getMonotonicTime() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                .count();
+        }
+    } // namespace
+
+    FastTracer::FastTracer(Process& aProcess, std::size_t aBufferBytes,
+                           std::size_t aNumSlots)
+        : theProcess{aProcess}, theDrained{aBufferBytes} {
+        if (!std::has_single_bit(aNumSlots)) {
+            Error::send("The trace ring needs a power of two slots");
+        }
+
+        theRingSize = sizeof(TraceRingHeader) +
+                      aNumSlots * sizeof(TraceRingSlot);
+        theFd = memfd_create("sdb-trace-ring", MFD_CLOEXEC);
+        if (theFd < 0) {
+            Error::sendErrno("Could not create trace ring: ");
+        }
+
+        void* myRing = MAP_FAILED;
+        if (ftruncate(theFd, theRingSize) == 0) {
+            myRing = mmap(nullptr, theRingSize, PROT_READ | PROT_WRITE,
+                          MAP_SHARED, theFd, 0);
+        }
+        if (myRing == MAP_FAILED) {
+            auto myError = errno;
+            close(theFd);
+            errno = myError;
+            Error::sendErrno("Could not map trace ring: ");
+        }
+        theRing = static_cast<std::byte*>(myRing);
+
+        getHeader().theNumSlots = aNumSlots;
+        getHeader().theMask = aNumSlots - 1;
+
+        // The inferior opens the ring through sdb's descriptor, with the
+        // path written to its scratch memory
+        try {
+            auto myPath = fmt::format("/proc/{}/fd/{}", getpid(), theFd);
+            auto myScratch = theProcess.getScratchData();
+            writeMemory(theProcess.getPid(), myScratch,
+                        std::as_bytes(std::span{myPath.c_str(),
+                                                myPath.size() + 1}));
+
+            auto myFd = injectCheckedSyscall(
+                theProcess, SYS_open, {std::to_underlying(myScratch), O_RDWR});
+
+            theRemoteRing = VirtualAddress{injectCheckedSyscall(
+                theProcess, SYS_mmap,
+                {0, theRingSize, PROT_READ | PROT_WRITE, MAP_SHARED, myFd,
+                 0})};
+            injectCheckedSyscall(theProcess, SYS_close, {myFd});
+        } catch (...) {
+            munmap(theRing, theRingSize);
+            close(theFd);
+            throw;
+        }
+
+        theBaseTicks = __rdtsc();
+        theBaseTime = getMonotonicTime();
+
+        theDrainThread = std::jthread{[this](std::stop_token aStopToken) {
+            std::mutex myWaitMutex;
+            std::condition_variable_any myWakeUp;
+            while (!aStopToken.stop_requested()) {
+                {
+                    std::unique_lock myLock{myWaitMutex};
+                    myWakeUp.wait_for(myLock, aStopToken,
+                                      std::chrono::milliseconds{10},
+                                      [] { return false; });
+                }
+
+                std::lock_guard myLock{theMutex};
+                drain();
+            }
+        }};
+    }
+
+    FastTracer::~FastTracer() {
+        theDrainThread.request_stop();
+        if (theDrainThread.joinable()) {
+            theDrainThread.join();
+        }
+
+        munmap(theRing, theRingSize);
+        close(theFd);
+    }
+
+    void FastTracer::install(const Tracepoint& aTracepoint) {
+        if (aTracepoint.theCaptures.size() >
+            std::size(TraceRingSlot{}.theValues)) {
+            Error::send(fmt::format("Fast tracepoints collect at most {} "
+                                    "registers",
+                                    std::size(TraceRingSlot{}.theValues)));
+        }
+        for (auto& myCapture : aTracepoint.theCaptures) {
+            if (!isFastCapture(myCapture)) {
+                Error::send(fmt::format("Fast tracepoints collect general "
+                                        "purpose registers only, not {}",
+                                        myCapture.theSpec));
+            }
+        }
+
+        auto mySite = aTracepoint.theAddress;
+        auto myDisplaced = DisplacedCode::at(theProcess, mySite);
+
+        CodeBuffer myCode;
+        TrampolineFrame::emitSave(myCode);
+        myCode.emit({0x48, 0xba}); // mov rdx, ring
+        myCode.emitValue(std::to_underlying(theRemoteRing));
+
+        // Reserves a slot unless the ring is full: rax is the old head and
+        // rcx the new one, which is also the slot's sequence
+        auto myRetry = myCode.getSize();
+        myCode.emit({0x48, 0x8b, 0x02});       // mov rax, [rdx]
+        myCode.emit({0x48, 0x89, 0xc1});       // mov rcx, rax
+        myCode.emit({0x48, 0x2b, 0x4a, 0x08}); // sub rcx, [rdx+8]
+        myCode.emit({0x48, 0x3b, 0x4a, 0x10}); // cmp rcx, [rdx+16]
+        auto myToFull = myCode.emitBranch({0x0f, 0x83}); // jae full
+        myCode.emit({0x48, 0x8d, 0x48, 0x01});       // lea rcx, [rax+1]
+        myCode.emit({0xf0, 0x48, 0x0f, 0xb1, 0x0a}); // lock cmpxchg [rdx], rcx
+        myCode.patchBranch(myCode.emitBranch({0x0f, 0x85}),
+                           myRetry); // jne retry
+
+        // rsi = rdx + header + (rax & mask) * slot
+        myCode.emit({0x48, 0x89, 0xc6});       // mov rsi, rax
+        myCode.emit({0x48, 0x23, 0x72, 0x20}); // and rsi, [rdx+32]
+        myCode.emit({0x48, 0xc1, 0xe6, 0x07}); // shl rsi, 7
+        myCode.emit({0x48, 0x01, 0xd6});       // add rsi, rdx
+        myCode.emit({0x48, 0x83, 0xc6, 0x40}); // add rsi, 64
+
+        myCode.emit({0x0f, 0x31});             // rdtsc
+        myCode.emit({0x48, 0xc1, 0xe2, 0x20}); // shl rdx, 32
+        myCode.emit({0x48, 0x09, 0xd0});       // or rax, rdx
+        myCode.emit({0x48, 0x89, 0x46,
+                     offsetof(TraceRingSlot, theTicks)}); // mov [rsi+16], rax
+        myCode.emit({0xc7, 0x46, offsetof(TraceRingSlot, theTracepoint)});
+        myCode.emitValue(aTracepoint.theId); // mov dword [rsi+8], id
+        myCode.emit({0xc7, 0x46, offsetof(TraceRingSlot, theSize)});
+        myCode.emitValue(static_cast<std::uint32_t>(
+            aTracepoint.theCaptures.size() * sizeof(std::uint64_t)));
+
+        for (std::size_t i = 0; i < aTracepoint.theCaptures.size(); ++i) {
+            auto myDisplacement = static_cast<std::uint8_t>(
+                offsetof(TraceRingSlot, theValues) +
+                i * sizeof(std::uint64_t));
+            auto myId = aTracepoint.theCaptures[i].theRegister->theId;
+
+            // isFastCapture let through only registers the frame can load
+            TrampolineFrame::emitLoad(myCode, myId, mySite);
+            // mov [rsi+value], rax
+            myCode.emit({0x48, 0x89, 0x46, myDisplacement});
+        }
+
+        // Storing the sequence last commits the slot for the reader
+        myCode.emit({0x48, 0x89, 0x0e}); // mov [rsi], rcx
+        auto myToDone = myCode.emitBranch({0xe9}); // jmp done
+
+        myCode.patchBranch(myToFull, myCode.getSize());
+        myCode.emit({0xf0, 0x48, 0xff, 0x42,
+                     offsetof(TraceRingHeader,
+                              theDropped)}); // lock inc qword [rdx+24]
+
+        myCode.patchBranch(myToDone, myCode.getSize());
+        TrampolineFrame::emitRestoreRegisters(myCode);
+        TrampolineFrame::emitRestoreFlags(myCode);
+
+        myDisplaced.emit(myCode);
+
+        auto myTrampoline = theProcess.getCodeArena().allocateCode(
+            mySite, myCode.getSize());
+        writeMemory(theProcess.getPid(), myTrampoline, myCode.getBytes());
+        writeMemory(theProcess.getPid(), mySite,
+                    myDisplaced.makePatch(myTrampoline));
+        theOriginals[std::to_underlying(mySite)] = myDisplaced.theOriginal;
+    }
+
+    void FastTracer::uninstall(VirtualAddress aSite) {
+        auto myIt = theOriginals.find(std::to_underlying(aSite));
+        if (myIt == theOriginals.end()) {
+            return;
+        }
+
+        writeMemory(theProcess.getPid(), aSite, myIt->second);
+        theOriginals.erase(myIt);
+    }
+
+    void FastTracer::drain() {
+        auto& myHeader = getHeader();
+        auto* mySlots = reinterpret_cast<TraceRingSlot*>(
+            theRing + sizeof(TraceRingHeader));
+
+        // The tick rate is measured over the whole time sdb has been
+        // draining, which gets more precise as it goes on
+        auto myTicks = __rdtsc();
+        auto myTime = getMonotonicTime();
+        double myNanosPerTick =
+            myTicks > theBaseTicks
+                ? static_cast<double>(myTime - theBaseTime) /
+                      static_cast<double>(myTicks - theBaseTicks)
+                : 0.0;
+
+        std::atomic_ref myTailRef{myHeader.theTail};
+        auto myTail = myTailRef.load(std::memory_order_relaxed);
+        auto myHead = std::atomic_ref{myHeader.theHead}.load(
+            std::memory_order_acquire);
+        for (; myTail != myHead; ++myTail) {
+            auto& mySlot = mySlots[myTail & myHeader.theMask];
+
+            // Reserved by a trampoline that has not finished writing it
+            if (std::atomic_ref{mySlot.theSequence}.load(
+                    std::memory_order_acquire) != myTail + 1) {
+                break;
+            }
+
+            auto myElapsed = static_cast<double>(static_cast<std::int64_t>(
+                                 mySlot.theTicks - theBaseTicks)) *
+                             myNanosPerTick;
+            auto mySize = std::min<std::uint32_t>(mySlot.theSize,
+                                                  sizeof(mySlot.theValues));
+            theDrained.push(
+                TraceRecordHeader{mySlot.theTracepoint, mySize,
+                                  theBaseTime + static_cast<std::int64_t>(
+                                                    myElapsed)},
+                std::as_bytes(std::span{mySlot.theValues}).first(mySize));
+        }
+        myTailRef.store(myTail, std::memory_order_release);
+
+        auto myDropped = std::atomic_ref{myHeader.theDropped}.load(
+            std::memory_order_relaxed);
+        theRingDropped += myDropped - theSeenDropped;
+        theSeenDropped = myDropped;
+    }
+
+} // namespace sdb
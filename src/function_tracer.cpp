@@ -0,0 +1,164 @@
+#include <function_tracer.hpp>
+
+#include <algorithm>
+#include <error.hpp>
+#include <fmt/format.h>
+#include <limits>
+#include <process.hpp>
+
+namespace sdb {
+
+    namespace {
+        std::uint64_t getSteadyTime() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                .count();
+        }
+
+        std::string escapeJson(std::string_view aText) {
+            std::string myEscaped;
+            for (char myChar : aText) {
+                if (myChar == '"' or myChar == '\\') {
+                    myEscaped += '\\';
+                }
+                myEscaped += myChar;
+            }
+
+            return myEscaped;
+        }
+    } // namespace
+
+    const FunctionTracer::Function&
+    FunctionTracer::add(std::string aName, VirtualAddress anEntry) {
+        if (theProcess.getBreakpointSites().contains_address(anEntry)) {
+            Error::send(fmt::format("A breakpoint is already set at {:#x}",
+                                    std::to_underlying(anEntry)));
+        }
+
+        auto myIndex = getFunctionIndex(std::move(aName), anEntry);
+        createEntrySite(myIndex, anEntry).enable();
+        return *theFunctions[myIndex];
+    }
+
+    std::size_t FunctionTracer::addAll(
+        std::span<const std::pair<std::string, VirtualAddress>> anEntries) {
+        auto& myExisting = theProcess.getBreakpointSites();
+        std::vector<BreakpointSite*> mySites;
+        for (auto& [myName, myEntry] : anEntries) {
+            if (myExisting.contains_address(myEntry)) {
+                continue;
+            }
+
+            auto myIndex = getFunctionIndex(myName, myEntry);
+            mySites.push_back(&createEntrySite(myIndex, myEntry));
+        }
+
+        BreakpointSite::enableAll(mySites);
+        return mySites.size();
+    }
+
+    std::uint32_t FunctionTracer::getFunctionIndex(std::string aName,
+                                                   VirtualAddress anEntry) {
+        auto myIt = std::ranges::find_if(theFunctions, [&](auto& aFunction) {
+            return aFunction->theName == aName;
+        });
+        if (myIt != theFunctions.end()) {
+            return static_cast<std::uint32_t>(myIt - theFunctions.begin());
+        }
+
+        theFunctions.push_back(
+            std::make_unique<Function>(std::move(aName), anEntry));
+        return static_cast<std::uint32_t>(theFunctions.size() - 1);
+    }
+
+    BreakpointSite& FunctionTracer::createEntrySite(std::uint32_t aFunction,
+                                                    VirtualAddress anEntry) {
+        return theHooks.createEntrySite(
+            anEntry, {[this, aFunction]() { return onEntry(aFunction); },
+                      [this](bool anIsReturned) { onReturn(anIsReturned); }});
+    }
+
+    bool FunctionTracer::onEntry(std::uint32_t aFunction) {
+        ++theFunctions[aFunction]->theNumCalls;
+
+        // Started once the process is resumed, so the time the debugger
+        // holds it here is not counted
+        auto myThread = theProcess.getPid();
+        theFrames[myThread].push_back(Frame{aFunction, 0});
+        theStartingThread = myThread;
+        return true;
+    }
+
+    void FunctionTracer::onReturn(bool anIsReturned) {
+        auto myNow = getSteadyTime();
+        auto& myFrames = theFrames[theProcess.getPid()];
+        auto myFrame = myFrames.back();
+        myFrames.pop_back();
+        if (!anIsReturned) {
+            // A call dropped at its entry is not started either
+            theStartingThread.reset();
+            return;
+        }
+
+        auto myDuration = myNow - myFrame.theStart;
+        theFunctions[myFrame.theFunction]->theLatencies.record(
+            std::chrono::nanoseconds(myDuration));
+        if (theCalls.size() < MAX_CALLS) {
+            theCalls.push_back(Call{
+                myFrame.theFunction, theProcess.getPid(),
+                static_cast<std::uint32_t>(myFrames.size()),
+                myFrame.theStart, myDuration});
+        } else {
+            ++theNumDroppedCalls;
+        }
+    }
+
+    void FunctionTracer::onResume(
+        std::chrono::steady_clock::duration aLatency) {
+        theOverhead.record(aLatency);
+        if (theStartingThread) {
+            theFrames[*theStartingThread].back().theStart = getSteadyTime();
+            theStartingThread.reset();
+        }
+    }
+
+    void FunctionTracer::writeTable(std::ostream& aStream) const {
+        aStream << fmt::format("{:<24} {:>9} {:>9} {:>10} {:>10} {:>10} "
+                               "{:>10}\n",
+                               "function", "calls", "returned", "total",
+                               "p50", "p99", "max");
+        for (auto& myFunction : theFunctions) {
+            auto& myLatencies = myFunction->theLatencies;
+            aStream << fmt::format(
+                "{:<24} {:>9} {:>9} {:>10} {:>10} {:>10} {:>10}\n",
+                myFunction->theName, myFunction->theNumCalls,
+                myLatencies.getCount(), formatLatency(myLatencies.getTotal()),
+                formatLatency(myLatencies.getQuantile(0.5)),
+                formatLatency(myLatencies.getQuantile(0.99)),
+                formatLatency(myLatencies.getMax()));
+        }
+    }
+
+    void FunctionTracer::writeChromeTrace(std::ostream& aStream) const {
+        auto myOrigin = std::numeric_limits<std::uint64_t>::max();
+        for (auto& myCall : theCalls) {
+            myOrigin = std::min(myOrigin, myCall.theStart);
+        }
+
+        // Times are in microseconds
+        aStream << "{\"traceEvents\":[";
+        for (std::size_t myI = 0; myI < theCalls.size(); ++myI) {
+            auto& myCall = theCalls[myI];
+            aStream << fmt::format(
+                "{}\n{{\"name\":\"{}\",\"cat\":\"function\",\"ph\":\"X\","
+                "\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":{},\"tid\":{},"
+                "\"args\":{{\"depth\":{}}}}}",
+                myI == 0 ? "" : ",",
+                escapeJson(theFunctions[myCall.theFunction]->theName),
+                (myCall.theStart - myOrigin) / 1e3, myCall.theDuration / 1e3,
+                theProcess.getPid(), myCall.theThread, myCall.theDepth);
+        }
+        aStream << "\n],\"displayTimeUnit\":\"ns\"}\n";
+    }
+
+} // namespace sdb
@@ -0,0 +1,633 @@
+#include <heap_inspector.hpp>
+
+#include <algorithm>
+#include <bit.hpp>
+#include <bit>
+#include <charconv>
+#include <error.hpp>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <memory_operations.hpp>
+#include <string>
+#include <string_view>
+#include <target.hpp>
+#include <unordered_set>
+#include <utility>
+
+namespace sdb {
+
+    namespace {
+        // Chunk headers: the size field's low bits are flags
+        constexpr std::uint64_t PREV_INUSE{0x1};
+        constexpr std::uint64_t SIZE_FLAGS{0x7};
+        constexpr std::uint64_t CHUNK_HEADER_BYTES{16};
+        constexpr std::uint64_t CHUNK_ALIGNMENT{16};
+        constexpr std::uint64_t MIN_CHUNK_BYTES{32};
+
+        // struct malloc_state since glibc 2.27, which added
+        // have_fastchunks
+        constexpr std::size_t ARENA_FASTBINS{16};
+        constexpr std::size_t NUM_FASTBINS{10};
+        constexpr std::size_t ARENA_TOP{96};
+        constexpr std::size_t ARENA_BINS{112};
+        constexpr std::size_t NUM_BINS{128};
+        constexpr std::size_t ARENA_NEXT{2160};
+        constexpr std::size_t ARENA_SYSTEM_MEM{2184};
+        constexpr std::size_t ARENA_BYTES{2200};
+
+        // Heaps of arenas other than main_arena are mappings aligned to
+        // their largest size, starting with a heap_info: the arena, the
+        // previous heap and the size in use
+        constexpr std::uint64_t HEAP_MAX_BYTES{std::uint64_t{64} << 20};
+        constexpr std::size_t HEAP_INFO_READ_BYTES{24};
+        constexpr std::uint64_t MIN_HEAP_INFO_BYTES{32};
+        constexpr std::size_t MAX_HEAPS{1 << 16};
+
+        constexpr std::size_t TCACHE_BINS{64};
+
+        struct Layout {
+            // Since glibc 2.32, fastbin and tcache links are stored xored
+            // with the address they are stored at shifted right by 12
+            bool theIsSafeLinking{true};
+
+            // Since glibc 2.30, tcache counts are 16 bit
+            std::size_t theTcacheCountBytes{2};
+
+            std::uint64_t getTcacheChunkBytes() const {
+                auto myBytes = TCACHE_BINS * (theTcacheCountBytes + 8);
+                return (myBytes + 8 + CHUNK_ALIGNMENT - 1) &
+                       ~(CHUNK_ALIGNMENT - 1);
+            }
+
+            std::uint64_t reveal(std::uint64_t aLink,
+                                 std::uint64_t aPosition) const {
+                return theIsSafeLinking ? aLink ^ (aPosition >> 12) : aLink;
+            }
+        };
+
+        struct Region {
+            std::uint64_t theBegin;
+            std::uint64_t theEnd;
+        };
+
+        struct Arena {
+            HeapInspector::ArenaStats theStats;
+            std::uint64_t theTop{0};
+            std::vector<Region> theRegions;
+        };
+
+        std::uint64_t readWordAt(std::span<const std::byte> aData,
+                                 std::size_t anOffset) {
+            return fromBytes<std::uint64_t>(aData.data() + anOffset);
+        }
+
+        // Counts what it reads. Chunk headers go through a window of
+        // WINDOW_BYTES that is read again only once a header falls outside.
+        class HeapReader {
+          public:
+            HeapReader(pid_t aPid, HeapInspector::Stats& aStats)
+                : thePid{aPid}, theStats{aStats} {
+            }
+
+            std::vector<std::byte> read(std::uint64_t anAddress,
+                                        std::size_t anAmount) {
+                ++theStats.theNumReads;
+                theStats.theBytesRead += anAmount;
+                return readMemory(thePid, VirtualAddress{anAddress},
+                                  anAmount);
+            }
+
+            std::optional<std::uint64_t> readWord(std::uint64_t anAddress) {
+                try {
+                    return readWordAt(read(anAddress, 8), 0);
+                } catch (const Error&) {
+                    return std::nullopt;
+                }
+            }
+
+            // The size field of the chunk, which with its header must end
+            // by the end of the region
+            std::optional<std::uint64_t> readChunkSize(std::uint64_t aChunk,
+                                                       std::uint64_t anEnd) {
+                if (aChunk < theWindowBegin or
+                    aChunk + CHUNK_HEADER_BYTES >
+                        theWindowBegin + theWindow.size()) {
+                    auto myAmount = std::min<std::uint64_t>(
+                        HeapInspector::WINDOW_BYTES, anEnd - aChunk);
+                    try {
+                        theWindow = read(aChunk, myAmount);
+                        theWindowBegin = aChunk;
+                    } catch (const Error&) {
+                        theWindow.clear();
+                        return std::nullopt;
+                    }
+                }
+
+                return readWordAt(theWindow, aChunk - theWindowBegin + 8);
+            }
+
+          private:
+            pid_t thePid;
+            HeapInspector::Stats& theStats;
+            std::uint64_t theWindowBegin{0};
+            std::vector<std::byte> theWindow;
+        };
+
+        // Sorts walked chunks into in use, free and cached, keeping the
+        // largest free ones in a heap with the smallest on top
+        class ChunkCounter {
+          public:
+            ChunkCounter(HeapInspector::Stats& aStats,
+                         const std::unordered_set<std::uint64_t>& aCached,
+                         std::size_t aNumLargest)
+                : theStats{aStats}, theCached{aCached},
+                  theNumLargest{aNumLargest} {
+            }
+
+            void add(HeapInspector::ArenaStats& anArena,
+                     std::uint64_t aChunk, std::uint64_t aSize,
+                     bool anIsFree) {
+                auto myIsCached = theCached.contains(aChunk);
+                if (!anIsFree and !myIsCached) {
+                    anArena.theInUseBytes += aSize;
+                    ++anArena.theInUseCount;
+                    return;
+                }
+
+                if (myIsCached) {
+                    anArena.theCachedBytes += aSize;
+                    ++anArena.theCachedCount;
+                } else {
+                    anArena.theFreeBytes += aSize;
+                    ++anArena.theFreeCount;
+                }
+                anArena.theLargestFree = std::max(anArena.theLargestFree,
+                                                  aSize);
+
+                auto myClass = std::bit_width(aSize) - 1;
+                ++theStats.theFreeCounts[myClass];
+                theStats.theFreeBytes[myClass] += aSize;
+
+                if (theNumLargest == 0) {
+                    return;
+                }
+                auto myLarger = [](auto& aLeft, auto& aRight) {
+                    return aLeft.theSize > aRight.theSize;
+                };
+                theLargest.push_back(HeapInspector::FreeChunk{
+                    aChunk, aSize, anArena.theAddress});
+                std::ranges::push_heap(theLargest, myLarger);
+                if (theLargest.size() > theNumLargest) {
+                    std::ranges::pop_heap(theLargest, myLarger);
+                    theLargest.pop_back();
+                }
+            }
+
+            std::vector<HeapInspector::FreeChunk> takeLargest() {
+                std::ranges::sort(theLargest, std::ranges::greater{},
+                                  &HeapInspector::FreeChunk::theSize);
+                return std::move(theLargest);
+            }
+
+          private:
+            HeapInspector::Stats& theStats;
+            const std::unordered_set<std::uint64_t>& theCached;
+            std::size_t theNumLargest;
+            std::vector<HeapInspector::FreeChunk> theLargest;
+        };
+
+        // A chunk is free in the bins if the chunk after it has
+        // PREV_INUSE clear, so each is counted once the next is read
+        void walkChunks(HeapReader& aReader, ChunkCounter& aCounter,
+                        Arena& anArena, Region aRegion) {
+            auto& myStats = anArena.theStats;
+            auto myChunk = aRegion.theBegin;
+            std::optional<std::pair<std::uint64_t, std::uint64_t>> myPrevious;
+            while (myChunk + CHUNK_HEADER_BYTES <= aRegion.theEnd) {
+                auto myField = aReader.readChunkSize(myChunk, aRegion.theEnd);
+                if (!myField) {
+                    myStats.theCorruptAt = myChunk;
+                    break;
+                }
+
+                if (myPrevious) {
+                    aCounter.add(myStats, myPrevious->first,
+                                 myPrevious->second,
+                                 (*myField & PREV_INUSE) == 0);
+                    myPrevious.reset();
+                }
+
+                auto mySize = *myField & ~SIZE_FLAGS;
+                if (myChunk == anArena.theTop) {
+                    myStats.theTopBytes = mySize;
+                    return;
+                }
+
+                // An arena that grew into a new heap or around a foreign
+                // sbrk ends the old one with fenceposts of 16 and 0 bytes
+                if (mySize < MIN_CHUNK_BYTES) {
+                    if (mySize != 0 and mySize != CHUNK_HEADER_BYTES) {
+                        myStats.theCorruptAt = myChunk;
+                    }
+                    return;
+                }
+                if (mySize % CHUNK_ALIGNMENT != 0 or
+                    mySize > aRegion.theEnd - myChunk) {
+                    myStats.theCorruptAt = myChunk;
+                    return;
+                }
+
+                myPrevious = {myChunk, mySize};
+                myChunk += mySize;
+            }
+
+            if (myPrevious) {
+                aCounter.add(myStats, myPrevious->first, myPrevious->second,
+                             false);
+            }
+        }
+
+        const ElfFile* findLibc(const Target& aTarget,
+                                std::uint64_t& aLoadBias) {
+            auto& myLibraries = aTarget.getSharedLibraries().getLibraries();
+            for (auto& myLibrary : myLibraries) {
+                auto myName =
+                    std::filesystem::path{myLibrary->thePath}.filename()
+                        .string();
+                if (myLibrary->theElf and (myName.starts_with("libc.so") or
+                                           myName.starts_with("libc-"))) {
+                    aLoadBias = myLibrary->theLoadBias;
+                    return myLibrary->theElf.get();
+                }
+            }
+
+            // Statically linked
+            aLoadBias = aTarget.getLoadBias();
+            return &aTarget.getElf();
+        }
+
+        // From the banner the library prints when run, which reads
+        // "... release version 2.36."
+        Layout getLayout(const ElfFile& aLibc) {
+            constexpr std::string_view MARKER{"release version "};
+            auto myData = aLibc.getData();
+            std::string_view myText{
+                reinterpret_cast<const char*>(myData.data()), myData.size()};
+
+            Layout myLayout;
+            auto myPosition = myText.find(MARKER);
+            if (myPosition == std::string_view::npos) {
+                return myLayout;
+            }
+
+            auto myVersion = myText.substr(myPosition + MARKER.size(), 16);
+            int myMajor = 0;
+            int myMinor = 0;
+            auto myEnd = myVersion.data() + myVersion.size();
+            auto [myDot, myError] =
+                std::from_chars(myVersion.data(), myEnd, myMajor);
+            if (myError != std::errc{} or myDot == myEnd or *myDot != '.' or
+                std::from_chars(myDot + 1, myEnd, myMinor).ec !=
+                    std::errc{}) {
+                return myLayout;
+            }
+
+            auto myIsAtLeast = [&](int aMinor) {
+                return std::pair{myMajor, myMinor} >= std::pair{2, aMinor};
+            };
+            if (!myIsAtLeast(27)) {
+                Error::send(fmt::format("glibc {}.{} predates the arena "
+                                        "layout that can be read",
+                                        myMajor, myMinor));
+            }
+            myLayout.theIsSafeLinking = myIsAtLeast(32);
+            myLayout.theTcacheCountBytes = myIsAtLeast(30) ? 2 : 1;
+            return myLayout;
+        }
+
+        // Once malloc has set an arena up, its empty bins point at
+        // themselves
+        bool hasEmptyBin(std::span<const std::byte> aData,
+                         std::size_t anOffset, std::uint64_t anAddress) {
+            for (std::size_t myBin = 2; myBin < NUM_BINS; ++myBin) {
+                auto myOffset = ARENA_BINS + (myBin - 1) * 16;
+                auto myHeader = anAddress + myOffset - CHUNK_HEADER_BYTES;
+                if (readWordAt(aData, anOffset + myOffset) == myHeader and
+                    readWordAt(aData, anOffset + myOffset + 8) == myHeader) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool isArenaRing(HeapReader& aReader, std::uint64_t anArena) {
+            auto myArena = anArena;
+            for (std::size_t myI = 0; myI < HeapInspector::MAX_ARENAS;
+                 ++myI) {
+                auto myNext = aReader.readWord(myArena + ARENA_NEXT);
+                if (!myNext or *myNext == 0) {
+                    return false;
+                }
+                if (*myNext == anArena) {
+                    return true;
+                }
+                myArena = *myNext;
+            }
+            return false;
+        }
+
+        VirtualAddress locateMainArena(const Target& aTarget,
+                                       HeapReader& aReader) {
+            for (auto myAddress : aTarget.findSymbolAddresses("main_arena")) {
+                if (isArenaRing(aReader, std::to_underlying(myAddress))) {
+                    return myAddress;
+                }
+            }
+
+            // Stripped libraries keep main_arena in .data without a symbol
+            std::uint64_t myLoadBias = 0;
+            auto* myLibc = findLibc(aTarget, myLoadBias);
+            auto* mySection = myLibc->getSection(".data");
+            if (mySection != nullptr and mySection->sh_size >= ARENA_BYTES) {
+                auto myBegin = mySection->sh_addr + myLoadBias;
+                auto myData = aReader.read(myBegin, mySection->sh_size);
+                for (std::size_t myOffset = 0;
+                     myOffset + ARENA_BYTES <= myData.size(); myOffset += 8) {
+                    auto myAddress = myBegin + myOffset;
+                    if (hasEmptyBin(myData, myOffset, myAddress) and
+                        isArenaRing(aReader, myAddress)) {
+                        return VirtualAddress{myAddress};
+                    }
+                }
+            }
+
+            Error::send("Could not find main_arena; the process may not "
+                        "have called malloc yet");
+        }
+
+        // The brk heap main_arena allocates from
+        std::optional<Region> findBrkHeap(pid_t aPid) {
+            std::ifstream myMaps{fmt::format("/proc/{}/maps", aPid)};
+            std::string myLine;
+            while (std::getline(myMaps, myLine)) {
+                auto myDash = myLine.find('-');
+                auto mySpace = myLine.find(' ');
+                if (myDash == std::string::npos or
+                    mySpace == std::string::npos or
+                    !myLine.ends_with("[heap]")) {
+                    continue;
+                }
+
+                return Region{
+                    std::stoull(myLine.substr(0, myDash), nullptr, 16),
+                    std::stoull(
+                        myLine.substr(myDash + 1, mySpace - myDash - 1),
+                        nullptr, 16)};
+            }
+            return std::nullopt;
+        }
+
+        // The heaps of an arena other than main_arena, oldest first. The
+        // newest holds the top chunk and the oldest the arena itself.
+        std::vector<Region> findArenaHeaps(HeapReader& aReader,
+                                           Arena& anArena) {
+            std::vector<Region> myHeaps;
+            auto myArena = anArena.theStats.theAddress;
+            auto myHeap = anArena.theTop & ~(HEAP_MAX_BYTES - 1);
+            while (myHeap != 0 and myHeaps.size() < MAX_HEAPS) {
+                std::vector<std::byte> myInfo;
+                try {
+                    myInfo = aReader.read(myHeap, HEAP_INFO_READ_BYTES);
+                } catch (const Error&) {
+                    anArena.theStats.theCorruptAt = myHeap;
+                    break;
+                }
+
+                if (readWordAt(myInfo, 0) != myArena) {
+                    anArena.theStats.theCorruptAt = myHeap;
+                    break;
+                }
+                myHeaps.push_back(Region{myHeap,
+                                         myHeap + readWordAt(myInfo, 16)});
+                myHeap = readWordAt(myInfo, 8);
+            }
+            std::ranges::reverse(myHeaps);
+
+            // Chunks follow the arena in the first heap and the heap_info,
+            // whose size differs between versions, in the others
+            auto myInfoBytes = MIN_HEAP_INFO_BYTES;
+            for (auto& myRegion : myHeaps) {
+                if (myArena > myRegion.theBegin and
+                    myArena < myRegion.theEnd) {
+                    myInfoBytes = myArena - myRegion.theBegin;
+                    myRegion.theBegin = (myArena + ARENA_BYTES +
+                                         CHUNK_ALIGNMENT - 1) &
+                                        ~(CHUNK_ALIGNMENT - 1);
+                } else {
+                    myRegion.theBegin += myInfoBytes;
+                }
+            }
+            return myHeaps;
+        }
+
+        void addFastbins(HeapReader& aReader, const Layout& aLayout,
+                         std::span<const std::byte> anArena,
+                         std::unordered_set<std::uint64_t>& aCached) {
+            for (std::size_t myBin = 0; myBin < NUM_FASTBINS; ++myBin) {
+                auto myChunk = readWordAt(anArena, ARENA_FASTBINS + myBin * 8);
+                for (std::size_t myI = 0; myChunk != 0 and
+                                          myChunk % CHUNK_ALIGNMENT == 0 and
+                                          myI < HeapInspector::MAX_LIST_LENGTH;
+                     ++myI) {
+                    aCached.insert(myChunk);
+                    auto myLink = aReader.readWord(myChunk + 16);
+                    if (!myLink) {
+                        break;
+                    }
+                    myChunk = aLayout.reveal(*myLink, myChunk + 16);
+                }
+            }
+        }
+
+        // The first thing a thread allocates is its tcache, so it starts
+        // the heap of an arena made for the thread. Chunks in it point at
+        // the user memory rather than the header.
+        bool addTcache(HeapReader& aReader, const Layout& aLayout,
+                       std::uint64_t aChunk,
+                       std::unordered_set<std::uint64_t>& aCached) {
+            auto myChunkBytes = aLayout.getTcacheChunkBytes();
+            std::vector<std::byte> myData;
+            try {
+                myData = aReader.read(aChunk, myChunkBytes);
+            } catch (const Error&) {
+                return false;
+            }
+            if ((readWordAt(myData, 8) & ~SIZE_FLAGS) != myChunkBytes) {
+                return false;
+            }
+
+            auto myCountBytes = aLayout.theTcacheCountBytes;
+            auto myEntries = CHUNK_HEADER_BYTES + TCACHE_BINS * myCountBytes;
+            auto getCount = [&](std::size_t aBin) -> std::uint64_t {
+                auto* myCount =
+                    myData.data() + CHUNK_HEADER_BYTES + aBin * myCountBytes;
+                return myCountBytes == 2 ? fromBytes<std::uint16_t>(myCount)
+                                         : fromBytes<std::uint8_t>(myCount);
+            };
+
+            // An empty bin has no entry and a full one has
+            for (std::size_t myBin = 0; myBin < TCACHE_BINS; ++myBin) {
+                auto myEntry = readWordAt(myData, myEntries + myBin * 8);
+                if ((getCount(myBin) == 0) != (myEntry == 0)) {
+                    return false;
+                }
+            }
+
+            for (std::size_t myBin = 0; myBin < TCACHE_BINS; ++myBin) {
+                auto myEntry = readWordAt(myData, myEntries + myBin * 8);
+                for (std::size_t myI = 0; myEntry != 0 and
+                                          myEntry % CHUNK_ALIGNMENT == 0 and
+                                          myI < HeapInspector::MAX_LIST_LENGTH;
+                     ++myI) {
+                    aCached.insert(myEntry - CHUNK_HEADER_BYTES);
+                    auto myLink = aReader.readWord(myEntry);
+                    if (!myLink) {
+                        break;
+                    }
+                    myEntry = aLayout.reveal(*myLink, myEntry);
+                }
+            }
+            return true;
+        }
+    } // namespace
+
+    double HeapInspector::ArenaStats::getFragmentation() const {
+        auto myFree = theFreeBytes + theCachedBytes;
+        if (myFree == 0) {
+            return 0;
+        }
+        return 1 - static_cast<double>(theLargestFree) / myFree;
+    }
+
+    VirtualAddress HeapInspector::findMainArena() const {
+        Stats myStats;
+        HeapReader myReader{theTarget.getProcess().getPid(), myStats};
+        return locateMainArena(theTarget, myReader);
+    }
+
+    HeapInspector::Stats HeapInspector::inspect(std::size_t aNumLargest) const {
+        Stats myStats;
+        auto myPid = theTarget.getProcess().getPid();
+        HeapReader myReader{myPid, myStats};
+
+        std::uint64_t myLoadBias = 0;
+        auto myLayout = getLayout(*findLibc(theTarget, myLoadBias));
+        auto myMain =
+            std::to_underlying(locateMainArena(theTarget, myReader));
+
+        // Everything parked in a fastbin or tcache is found before any
+        // heap is walked, since the chunks look in use from there
+        std::vector<Arena> myArenas;
+        std::unordered_set<std::uint64_t> myCached;
+        auto myAddress = myMain;
+        do {
+            if (myArenas.size() == MAX_ARENAS) {
+                break;
+            }
+
+            auto myData = myReader.read(myAddress, ARENA_BYTES);
+            auto& myArena = myArenas.emplace_back();
+            myArena.theStats.theAddress = myAddress;
+            myArena.theStats.theIsMain = myAddress == myMain;
+            myArena.theStats.theSystemBytes =
+                readWordAt(myData, ARENA_SYSTEM_MEM);
+            myArena.theTop = readWordAt(myData, ARENA_TOP);
+            addFastbins(myReader, myLayout, myData, myCached);
+
+            // An arena nothing was allocated from yet has no heap
+            if (myArena.theStats.theSystemBytes > 0 and
+                myArena.theStats.theIsMain) {
+                if (auto myHeap = findBrkHeap(myPid)) {
+                    myArena.theRegions.push_back(*myHeap);
+                }
+            } else if (myArena.theStats.theSystemBytes > 0) {
+                myArena.theRegions = findArenaHeaps(myReader, myArena);
+            }
+            myArena.theStats.theNumHeaps = myArena.theRegions.size();
+
+            if (!myArena.theRegions.empty() and
+                addTcache(myReader, myLayout,
+                          myArena.theRegions.front().theBegin, myCached)) {
+                ++myStats.theNumTcaches;
+            }
+
+            myAddress = readWordAt(myData, ARENA_NEXT);
+        } while (myAddress != myMain and myAddress != 0);
+
+        ChunkCounter myCounter{myStats, myCached, aNumLargest};
+        for (auto& myArena : myArenas) {
+            for (auto& myRegion : myArena.theRegions) {
+                walkChunks(myReader, myCounter, myArena, myRegion);
+            }
+            myStats.theArenas.push_back(myArena.theStats);
+        }
+        myStats.theLargestFree = myCounter.takeLargest();
+        return myStats;
+    }
+
+    void HeapInspector::writeStats(std::ostream& aStream,
+                                   const Stats& aStats) {
+        aStream << fmt::format("{:<24} {:>5} {:>12} {:>12} {:>8} {:>12} "
+                               "{:>8} {:>12} {:>8} {:>12} {:>6}\n",
+                               "arena", "heaps", "system", "in use",
+                               "chunks", "free", "chunks", "cached",
+                               "chunks", "top", "frag");
+        for (auto& myArena : aStats.theArenas) {
+            aStream << fmt::format(
+                "{:<24} {:>5} {:>12} {:>12} {:>8} {:>12} {:>8} {:>12} {:>8} "
+                "{:>12} {:>5.1f}%\n",
+                fmt::format("{:#x}{}", myArena.theAddress,
+                            myArena.theIsMain ? " (main)" : ""),
+                myArena.theNumHeaps, myArena.theSystemBytes,
+                myArena.theInUseBytes, myArena.theInUseCount,
+                myArena.theFreeBytes, myArena.theFreeCount,
+                myArena.theCachedBytes, myArena.theCachedCount,
+                myArena.theTopBytes, 100 * myArena.getFragmentation());
+            if (myArena.theCorruptAt) {
+                aStream << fmt::format("  walk stopped at a bad chunk "
+                                       "header at {:#x}\n",
+                                       *myArena.theCorruptAt);
+            }
+        }
+
+        aStream << "\nfree and cached chunks by size\n";
+        for (std::size_t myClass = 0; myClass < NUM_SIZE_CLASSES;
+             ++myClass) {
+            if (aStats.theFreeCounts[myClass] == 0) {
+                continue;
+            }
+            auto myLow = std::uint64_t{1} << myClass;
+            aStream << fmt::format("{:>12} - {:<12} {:>8} chunks {:>14} "
+                                   "bytes\n",
+                                   myLow, 2 * myLow - 1,
+                                   aStats.theFreeCounts[myClass],
+                                   aStats.theFreeBytes[myClass]);
+        }
+
+        if (!aStats.theLargestFree.empty()) {
+            aStream << "\nlargest free chunks\n";
+        }
+        for (auto& myChunk : aStats.theLargestFree) {
+            aStream << fmt::format("{:#18x} {:>14} bytes in arena {:#x}\n",
+                                   myChunk.theAddress, myChunk.theSize,
+                                   myChunk.theArena);
+        }
+
+        aStream << fmt::format("\n{} tcaches found; read {} bytes in {} "
+                               "reads\n",
+                               aStats.theNumTcaches, aStats.theBytesRead,
+                               aStats.theNumReads);
+    }
+
+} // namespace sdb
@@ -0,0 +1,488 @@
+#include <heap_profiler.hpp>
+
+#include <algorithm>
+#include <bit.hpp>
+#include <bit>
+#include <code_arena.hpp>
+#include <error.hpp>
+#include <fast_tracepoint.hpp>
+#include <fmt/format.h>
+#include <fstream>
+#include <functional>
+#include <memory_operations.hpp>
+#include <target.hpp>
+
+namespace sdb {
+
+    namespace {
+        // Frees between two allocations the ring and the buffer it is
+        // drained into hold before any are lost
+        constexpr std::size_t FREE_RING_SLOTS{1 << 15};
+        constexpr std::size_t FREE_BUFFER_BYTES{1 << 22};
+    } // namespace
+
+    std::size_t AllocationTable::getHome(std::uint64_t anAddress) const {
+        // Fibonacci hashing spreads the aligned addresses malloc returns
+        auto myBits = std::countr_zero(theEntries.size());
+        return (anAddress * 0x9e3779b97f4a7c15ull) >> (64 - myBits);
+    }
+
+    std::size_t AllocationTable::findSlot(std::uint64_t anAddress) const {
+        auto myMask = theEntries.size() - 1;
+        auto mySlot = getHome(anAddress);
+        while (theEntries[mySlot].theAddress != 0 and
+               theEntries[mySlot].theAddress != anAddress) {
+            mySlot = (mySlot + 1) & myMask;
+        }
+
+        return mySlot;
+    }
+
+    void AllocationTable::insert(std::uint64_t anAddress, std::uint64_t aSize,
+                                 std::uint32_t aSite) {
+        if (anAddress == 0) {
+            return;
+        }
+
+        // Kept at most half full so probe sequences stay short
+        if ((theSize + 1) * 2 > theEntries.size()) {
+            grow();
+        }
+
+        auto& myEntry = theEntries[findSlot(anAddress)];
+        if (myEntry.theAddress == 0) {
+            ++theSize;
+        }
+        myEntry.theAddress = anAddress;
+        myEntry.theSize = std::min(aSize, MAX_SIZE);
+        myEntry.theSite = std::min(aSite, MAX_SITE);
+    }
+
+    std::optional<AllocationTable::Entry>
+    AllocationTable::erase(std::uint64_t anAddress) {
+        if (anAddress == 0) {
+            return std::nullopt;
+        }
+
+        auto myHole = findSlot(anAddress);
+        if (theEntries[myHole].theAddress == 0) {
+            return std::nullopt;
+        }
+        auto myErased = theEntries[myHole];
+
+        // Entries after the hole move into it unless their home lies
+        // between the hole and where they are
+        auto myMask = theEntries.size() - 1;
+        for (auto mySlot = (myHole + 1) & myMask;
+             theEntries[mySlot].theAddress != 0;
+             mySlot = (mySlot + 1) & myMask) {
+            auto myHome = getHome(theEntries[mySlot].theAddress);
+            if (((mySlot - myHome) & myMask) >= ((mySlot - myHole) & myMask)) {
+                theEntries[myHole] = theEntries[mySlot];
+                myHole = mySlot;
+            }
+        }
+        theEntries[myHole] = Entry{};
+        --theSize;
+
+        return myErased;
+    }
+
+    const AllocationTable::Entry*
+    AllocationTable::find(std::uint64_t anAddress) const {
+        if (anAddress == 0) {
+            return nullptr;
+        }
+
+        auto& myEntry = theEntries[findSlot(anAddress)];
+        return myEntry.theAddress == 0 ? nullptr : &myEntry;
+    }
+
+    void AllocationTable::grow() {
+        auto myOld = std::move(theEntries);
+        theEntries = std::vector<Entry>(myOld.size() * 2);
+        for (auto& myEntry : myOld) {
+            if (myEntry.theAddress != 0) {
+                theEntries[findSlot(myEntry.theAddress)] = myEntry;
+            }
+        }
+    }
+
+    std::size_t HeapProfiler::StackHash::operator()(
+        const std::vector<std::uint64_t>& aStack) const {
+        std::size_t mySeed = aStack.size();
+        for (auto myAddress : aStack) {
+            mySeed ^= std::hash<std::uint64_t>{}(myAddress) + 0x9e3779b9 +
+                      (mySeed << 6) + (mySeed >> 2);
+        }
+
+        return mySeed;
+    }
+
+    HeapProfiler::HeapProfiler(Target& aTarget)
+        : theTarget{aTarget}, theHooks{aTarget.getProcess(), true} {
+    }
+
+    HeapProfiler::~HeapProfiler() = default;
+
+    void HeapProfiler::start() {
+        if (theIsRunning) {
+            Error::send("The heap profiler is already running");
+        }
+
+        theSites.clear();
+        theSiteIndex.clear();
+        theLive = AllocationTable{};
+        theNumMissed = 0;
+        theNumLostFrees = 0;
+        thePending.reset();
+
+        try {
+            hookAllocator("malloc", Allocator::Malloc);
+            if (theHooks.isEmpty()) {
+                Error::send("Could not find malloc; the C library may not "
+                            "be loaded yet");
+            }
+            hookAllocator("calloc", Allocator::Calloc);
+            hookAllocator("realloc", Allocator::Realloc);
+
+            for (auto myEntry : theTarget.findSymbolAddresses("free")) {
+                hookFree(myEntry);
+            }
+        } catch (...) {
+            theIsRunning = true;
+            stop();
+            throw;
+        }
+
+        theIsRunning = true;
+    }
+
+    void HeapProfiler::stop() {
+        if (!theIsRunning) {
+            return;
+        }
+        theIsRunning = false;
+
+        theHooks.clear();
+        for (auto mySite : theFastFrees) {
+            theFreeTracer->uninstall(mySite);
+        }
+        collect();
+
+        theFastFrees.clear();
+        thePending.reset();
+    }
+
+    void HeapProfiler::hookAllocator(std::string_view aName,
+                                     Allocator anAllocator) {
+        auto& myProcess = theTarget.getProcess();
+        for (auto myEntry : theTarget.findSymbolAddresses(aName)) {
+            if (myProcess.getBreakpointSites().contains_address(myEntry)) {
+                Error::send(fmt::format("A breakpoint is already set on {}",
+                                        aName));
+            }
+
+            theHooks
+                .createEntrySite(
+                    myEntry,
+                    {[this, anAllocator, myEntry]() {
+                         return onEntry(anAllocator, myEntry);
+                     },
+                     [this](bool anIsReturned) { onReturn(anIsReturned); }})
+                .enable();
+        }
+    }
+
+    void HeapProfiler::hookFree(VirtualAddress anEntry) {
+        auto& myProcess = theTarget.getProcess();
+        if (myProcess.getBreakpointSites().contains_address(anEntry)) {
+            Error::send("A breakpoint is already set on free");
+        }
+
+        // The ring is only mapped once the code at free is known to fit a
+        // jump
+        try {
+            DisplacedCode::at(myProcess, anEntry);
+            if (!theFreeTracer) {
+                theFreeTracer = std::make_unique<FastTracer>(
+                    myProcess, FREE_BUFFER_BYTES, FREE_RING_SLOTS);
+            }
+
+            Tracepoint myTracepoint{1, anEntry, {*TraceCapture::parse("rdi")}};
+            theFreeTracer->install(myTracepoint);
+            theFastFrees.push_back(anEntry);
+            return;
+        } catch (const Error&) {
+        }
+
+        // Nothing is needed from its return
+        auto myOnFree = [this]() {
+            onFree();
+            return false;
+        };
+        theHooks.createEntrySite(anEntry, {myOnFree, {}}).enable();
+    }
+
+    std::vector<std::uint64_t>
+    HeapProfiler::readStack(VirtualAddress anEntry, std::uint64_t aSp) {
+        auto myPid = theTarget.getProcess().getPid();
+        std::vector<std::uint64_t> myStack{std::to_underlying(anEntry)};
+        try {
+            auto myReturn = readMemory(myPid, VirtualAddress{aSp}, 8);
+            myStack.push_back(fromBytes<std::uint64_t>(myReturn.data()));
+
+            // The caller's frame pointer is still in rbp at the entry. A
+            // value that does not point further up the stack means the
+            // frames were built without one.
+            auto& myRegs =
+                theTarget.getProcess().getRegisters().getRegisterData().regs;
+            std::uint64_t myFp = myRegs.rbp;
+            std::uint64_t myLow = aSp;
+            while (myStack.size() < MAX_FRAMES and myFp > myLow and
+                   myFp - aSp < MAX_STACK_BYTES and myFp % 8 == 0) {
+                auto myFrame = readMemory(myPid, VirtualAddress{myFp}, 16);
+                auto myCaller = fromBytes<std::uint64_t>(myFrame.data() + 8);
+                if (myCaller == 0) {
+                    break;
+                }
+
+                myStack.push_back(myCaller);
+                myLow = myFp;
+                myFp = fromBytes<std::uint64_t>(myFrame.data());
+            }
+        } catch (const Error&) {
+        }
+
+        return myStack;
+    }
+
+    bool HeapProfiler::onEntry(Allocator anAllocator, VirtualAddress anEntry) {
+        if (thePending) {
+            return false;
+        }
+
+        auto& myRegs =
+            theTarget.getProcess().getRegisters().getRegisterData().regs;
+        auto myStack = readStack(anEntry, myRegs.rsp);
+        if (myStack.size() < 2) {
+            ++theNumMissed;
+            return false;
+        }
+
+        thePending =
+            Pending{anAllocator, {myRegs.rdi, myRegs.rsi}, std::move(myStack)};
+        return true;
+    }
+
+    void HeapProfiler::onReturn(bool anIsReturned) {
+        auto myPending = std::move(*thePending);
+        thePending.reset();
+        if (!anIsReturned) {
+            ++theNumMissed;
+            return;
+        }
+
+        // Frees the trampoline saw came before this return
+        collect();
+
+        auto myResult =
+            theTarget.getProcess().getRegisters().getRegisterData().regs.rax;
+        auto [myFirst, mySecond] = myPending.theArgs;
+        switch (myPending.theAllocator) {
+            case Allocator::Malloc:
+                if (myResult != 0) {
+                    addAllocation(myResult, myFirst,
+                                  std::move(myPending.theStack));
+                }
+                break;
+            case Allocator::Calloc:
+                if (myResult != 0) {
+                    addAllocation(myResult, myFirst * mySecond,
+                                  std::move(myPending.theStack));
+                }
+                break;
+            case Allocator::Realloc:
+                // A failed realloc leaves the old block alone, but one to
+                // no bytes frees it
+                if (myResult != 0 or mySecond == 0) {
+                    removeAllocation(myFirst);
+                }
+                if (myResult != 0) {
+                    addAllocation(myResult, mySecond,
+                                  std::move(myPending.theStack));
+                }
+                break;
+        }
+    }
+
+    void HeapProfiler::onFree() {
+        // realloc accounts for the block it frees itself
+        if (thePending) {
+            return;
+        }
+
+        collect();
+        removeAllocation(
+            theTarget.getProcess().getRegisters().getRegisterData().regs.rdi);
+    }
+
+    void HeapProfiler::collect() {
+        if (!theFreeTracer) {
+            return;
+        }
+
+        theNumLostFrees += theFreeTracer->collect(
+            [this](const TraceRecordHeader&,
+                   std::span<const std::byte> aPayload) {
+                if (aPayload.size() >= sizeof(std::uint64_t)) {
+                    removeAllocation(
+                        fromBytes<std::uint64_t>(aPayload.data()));
+                }
+            });
+    }
+
+    void HeapProfiler::addAllocation(std::uint64_t anAddress,
+                                     std::uint64_t aSize,
+                                     std::vector<std::uint64_t> aStack) {
+        // A block handed out again whose free was lost
+        removeAllocation(anAddress);
+        aSize = std::min(aSize, AllocationTable::MAX_SIZE);
+
+        // Stacks past the most the table can tell apart share the last
+        // site, which has none
+        std::uint32_t mySite;
+        if (auto myIt = theSiteIndex.find(aStack); myIt != theSiteIndex.end()) {
+            mySite = myIt->second;
+        } else if (theSites.size() < AllocationTable::MAX_SITE) {
+            mySite = static_cast<std::uint32_t>(theSites.size());
+            theSites.push_back(Site{aStack});
+            theSiteIndex.emplace(std::move(aStack), mySite);
+        } else {
+            if (theSites.size() == AllocationTable::MAX_SITE) {
+                theSites.push_back(Site{});
+            }
+            mySite = AllocationTable::MAX_SITE;
+        }
+
+        auto& mySiteStats = theSites[mySite];
+        mySiteStats.theLiveBytes += aSize;
+        ++mySiteStats.theLiveCount;
+        mySiteStats.theTotalBytes += aSize;
+        ++mySiteStats.theTotalCount;
+        theLive.insert(anAddress, aSize, mySite);
+    }
+
+    void HeapProfiler::removeAllocation(std::uint64_t anAddress) {
+        if (auto myEntry = theLive.erase(anAddress)) {
+            auto& mySite = theSites[myEntry->theSite];
+            mySite.theLiveBytes -= myEntry->theSize;
+            --mySite.theLiveCount;
+        }
+    }
+
+    void HeapProfiler::writeFoldedStacks(std::ostream& aStream,
+                                         bool anIsTotal) const {
+        std::unordered_map<std::uint64_t, std::string> myNames;
+        auto myGetName = [&](std::uint64_t anAddress,
+                             bool anIsEntry) -> const std::string& {
+            auto [myIt, myIsNew] = myNames.try_emplace(anAddress);
+            if (myIsNew) {
+                myIt->second = theTarget.getFunctionName(
+                    VirtualAddress{anAddress}, !anIsEntry);
+            }
+            return myIt->second;
+        };
+
+        for (auto& mySite : theSites) {
+            auto myBytes = anIsTotal ? mySite.theTotalBytes
+                                     : mySite.theLiveBytes;
+            if (myBytes == 0) {
+                continue;
+            }
+
+            std::string myLine;
+            for (auto myI = mySite.theStack.size(); myI-- > 0;) {
+                if (!myLine.empty()) {
+                    myLine += ';';
+                }
+                myLine += myGetName(mySite.theStack[myI], myI == 0);
+            }
+            if (myLine.empty()) {
+                myLine = "[other]";
+            }
+
+            aStream << myLine << ' ' << myBytes << '\n';
+        }
+    }
+
+    void HeapProfiler::writePprof(std::ostream& aStream) const {
+        Site myTotal;
+        for (auto& mySite : theSites) {
+            myTotal.theLiveBytes += mySite.theLiveBytes;
+            myTotal.theLiveCount += mySite.theLiveCount;
+            myTotal.theTotalBytes += mySite.theTotalBytes;
+            myTotal.theTotalCount += mySite.theTotalCount;
+        }
+
+        auto myCounts = [](const Site& aSite) {
+            return fmt::format("{:>6}: {:>8} [{:>6}: {:>8}] @",
+                               aSite.theLiveCount, aSite.theLiveBytes,
+                               aSite.theTotalCount, aSite.theTotalBytes);
+        };
+
+        aStream << "heap profile: " << myCounts(myTotal) << " heapprofile\n";
+        for (auto& mySite : theSites) {
+            if (mySite.theStack.empty()) {
+                continue;
+            }
+
+            aStream << myCounts(mySite);
+            for (auto myAddress : mySite.theStack) {
+                aStream << fmt::format(" {:#x}", myAddress);
+            }
+            aStream << '\n';
+        }
+
+        aStream << "\nMAPPED_LIBRARIES:\n";
+        std::ifstream myMaps{
+            fmt::format("/proc/{}/maps", theTarget.getProcess().getPid())};
+        aStream << myMaps.rdbuf();
+    }
+
+    void HeapProfiler::writeTable(std::ostream& aStream,
+                                  std::size_t aMaxSites) const {
+        std::vector<const Site*> mySites;
+        for (auto& mySite : theSites) {
+            if (mySite.theTotalCount > 0) {
+                mySites.push_back(&mySite);
+            }
+        }
+        std::ranges::sort(mySites, std::ranges::greater{},
+                          [](const Site* aSite) {
+                              return std::pair{aSite->theLiveBytes,
+                                               aSite->theTotalBytes};
+                          });
+
+        aStream << fmt::format("{:>12} {:>8} {:>12} {:>8}  {}\n", "live bytes",
+                               "live", "total bytes", "total", "stack");
+        for (std::size_t myI = 0; myI < mySites.size() and myI < aMaxSites;
+             ++myI) {
+            auto& mySite = *mySites[myI];
+            std::string myStack;
+            for (std::size_t myJ = 0; myJ < mySite.theStack.size(); ++myJ) {
+                if (myJ > 0) {
+                    myStack += " <- ";
+                }
+                myStack += theTarget.getFunctionName(
+                    VirtualAddress{mySite.theStack[myJ]}, myJ > 0);
+            }
+
+            aStream << fmt::format("{:>12} {:>8} {:>12} {:>8}  {}\n",
+                                   mySite.theLiveBytes, mySite.theLiveCount,
+                                   mySite.theTotalBytes, mySite.theTotalCount,
+                                   myStack.empty() ? "[other]" : myStack);
+        }
+    }
+
+} // namespace sdb
@@ -0,0 +1,480 @@
+#include <index_cache.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/format.h>
+#include <optional>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace sdb {
+
+    // Strings are stored as ranges of the ELF file so the cache never has to
+    // copy names out of the debug sections
+    struct IndexCache::CachedCompileUnit {
+        std::uint64_t theOffset;
+        std::uint64_t theEnd;
+        std::uint64_t theDieOffset;
+        std::uint64_t theAbbrevOffset;
+        std::uint64_t theLineOffset;
+        std::uint64_t theNameOffset;
+        std::uint64_t theCompDirOffset;
+        std::uint64_t theBaseAddress;
+        std::uint64_t theStrOffsetsBase;
+        std::uint64_t theAddrBase;
+        std::uint64_t theRnglistsBase;
+        std::uint32_t theNameLength;
+        std::uint32_t theCompDirLength;
+        std::uint16_t theVersion;
+        std::uint8_t theUnitType;
+        std::uint8_t theAddressSize;
+        std::uint8_t theIs64Bit;
+        std::uint8_t theHasLineOffset;
+        std::uint8_t thePadding[2];
+    };
+
+    // Names built during indexing live in the cache's string table, marked
+    // by the top bit of the offset; all others point into the ELF file
+    struct IndexCache::CachedFunction {
+        std::uint64_t theNameOffset;
+        std::uint64_t theLow;
+        std::uint64_t theHigh;
+        std::uint32_t theNameLength;
+        std::uint32_t theUnitIdx;
+    };
+
+    namespace {
+        constexpr std::array<char, 8> MAGIC{'S', 'D', 'B', 'I', 'D', 'X',
+                                            '\0', '\0'};
+        constexpr std::size_t MAX_BUILD_ID_LENGTH{64};
+
+        enum CacheSection : std::size_t {
+            SYMBOLS,
+            NAME_INDEX,
+            UNITS,
+            UNIT_RANGES,
+            FUNCTIONS,
+            FUNCTION_SHARDS,
+            FUNCTIONS_BY_ADDRESS,
+            NAME_STRINGS,
+            NUM_SECTIONS
+        };
+
+        struct SectionEntry {
+            std::uint64_t theOffset;
+            std::uint64_t theCount;
+        };
+
+        struct FileHeader {
+            std::array<char, 8> theMagic;
+            std::uint32_t theVersion;
+            std::uint32_t theBuildIdLength;
+            std::array<char, MAX_BUILD_ID_LENGTH> theBuildId;
+            std::uint64_t theElfSize;
+
+            // Record sizes guard against layout changes that were not
+            // accompanied by a version bump
+            std::array<std::uint32_t, NUM_SECTIONS> theRecordSizes;
+            std::array<SectionEntry, NUM_SECTIONS> theSections;
+        };
+
+        constexpr std::size_t ALIGNMENT{8};
+        constexpr std::uint64_t CACHE_STRING_BIT{std::uint64_t{1} << 63};
+
+        std::size_t alignUp(std::size_t aValue) {
+            return (aValue + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        }
+
+        std::filesystem::path getCachePath(const std::string& aBuildId) {
+            return IndexCache::getDirectory() / (aBuildId + ".idx");
+        }
+
+        template <typename T>
+        void appendSection(std::vector<std::byte>& aBuffer,
+                           FileHeader& aHeader, CacheSection aSection,
+                           std::span<const T> aRecords) {
+            aBuffer.resize(alignUp(aBuffer.size()));
+
+            aHeader.theRecordSizes[aSection] = sizeof(T);
+            aHeader.theSections[aSection] = {aBuffer.size(), aRecords.size()};
+
+            auto myBytes = std::as_bytes(aRecords);
+            aBuffer.insert(aBuffer.end(), myBytes.begin(), myBytes.end());
+        }
+
+        template <typename T>
+        std::optional<std::span<const T>>
+        getSection(const std::byte* aData, std::size_t aSize,
+                   const FileHeader& aHeader, CacheSection aSection) {
+            auto& myEntry = aHeader.theSections[aSection];
+
+            if (aHeader.theRecordSizes[aSection] != sizeof(T) or
+                myEntry.theOffset % ALIGNMENT != 0 or
+                myEntry.theOffset > aSize or
+                myEntry.theCount > (aSize - myEntry.theOffset) / sizeof(T)) {
+                return std::nullopt;
+            }
+
+            return std::span<const T>{
+                reinterpret_cast<const T*>(aData + myEntry.theOffset),
+                myEntry.theCount};
+        }
+
+        bool writeAll(int aFd, std::span<const std::byte> aData) {
+            while (!aData.empty()) {
+                auto myWritten = ::write(aFd, aData.data(), aData.size());
+                if (myWritten < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return false;
+                }
+                aData = aData.subspan(myWritten);
+            }
+
+            return true;
+        }
+    } // namespace
+
+    std::filesystem::path IndexCache::getDirectory() {
+        if (auto* myDir = std::getenv("SDB_CACHE_DIR");
+            myDir != nullptr and *myDir != '\0') {
+            return myDir;
+        }
+
+        if (auto* myDir = std::getenv("XDG_CACHE_HOME");
+            myDir != nullptr and *myDir != '\0') {
+            return std::filesystem::path{myDir} / "sdb";
+        }
+
+        if (auto* myHome = std::getenv("HOME");
+            myHome != nullptr and *myHome != '\0') {
+            return std::filesystem::path{myHome} / ".cache" / "sdb";
+        }
+
+        return std::filesystem::temp_directory_path() / "sdb";
+    }
+
+    std::unique_ptr<IndexCache> IndexCache::load(const ElfFile& anElf) {
+        auto myBuildId = anElf.getBuildId();
+        if (!myBuildId or myBuildId->size() > MAX_BUILD_ID_LENGTH) {
+            return nullptr;
+        }
+
+        int myFd = open(getCachePath(*myBuildId).c_str(), O_RDONLY | O_CLOEXEC);
+        if (myFd < 0) {
+            return nullptr;
+        }
+
+        struct stat myStats;
+        if (fstat(myFd, &myStats) < 0 or
+            static_cast<std::size_t>(myStats.st_size) < sizeof(FileHeader)) {
+            close(myFd);
+            return nullptr;
+        }
+
+        // The mapping stays valid after the descriptor is closed
+        void* myMapping =
+            mmap(nullptr, myStats.st_size, PROT_READ, MAP_PRIVATE, myFd, 0);
+        close(myFd);
+        if (myMapping == MAP_FAILED) {
+            return nullptr;
+        }
+
+        std::unique_ptr<IndexCache> myCache{
+            new IndexCache(myMapping, myStats.st_size)};
+        if (!myCache->validate(anElf, *myBuildId)) {
+            return nullptr;
+        }
+
+        return myCache;
+    }
+
+    IndexCache::~IndexCache() {
+        munmap(const_cast<void*>(theMapping), theSize);
+    }
+
+    bool IndexCache::validate(const ElfFile& anElf,
+                              const std::string& aBuildId) {
+        auto* myData = static_cast<const std::byte*>(theMapping);
+
+        FileHeader myHeader;
+        std::memcpy(&myHeader, myData, sizeof(myHeader));
+
+        if (myHeader.theMagic != MAGIC or myHeader.theVersion != VERSION or
+            myHeader.theElfSize != anElf.getData().size() or
+            myHeader.theBuildIdLength != aBuildId.size() or
+            std::string_view{myHeader.theBuildId.data(), aBuildId.size()} !=
+                aBuildId) {
+            return false;
+        }
+
+        auto mySymbols =
+            getSection<ElfSymbol>(myData, theSize, myHeader, SYMBOLS);
+        auto myNameIndex =
+            getSection<std::uint32_t>(myData, theSize, myHeader, NAME_INDEX);
+        auto myUnits =
+            getSection<CachedCompileUnit>(myData, theSize, myHeader, UNITS);
+        auto myRanges =
+            getSection<UnitRange>(myData, theSize, myHeader, UNIT_RANGES);
+        auto myFunctions = getSection<CachedFunction>(myData, theSize,
+                                                      myHeader, FUNCTIONS);
+        auto myShards = getSection<std::uint32_t>(myData, theSize, myHeader,
+                                                  FUNCTION_SHARDS);
+        auto myByAddress = getSection<std::uint32_t>(
+            myData, theSize, myHeader, FUNCTIONS_BY_ADDRESS);
+        auto myStrings =
+            getSection<char>(myData, theSize, myHeader, NAME_STRINGS);
+        if (!mySymbols or !myNameIndex or !myUnits or !myRanges or
+            !myFunctions or !myShards or !myByAddress or !myStrings or
+            myNameIndex->size() != mySymbols->size() or
+            myShards->size() != FunctionIndex::NUM_SHARDS + 1 or
+            myByAddress->size() != myFunctions->size()) {
+            return false;
+        }
+
+        auto myIsIndex = [](std::size_t aLimit) {
+            return [=](std::uint32_t anIdx) { return anIdx < aLimit; };
+        };
+        if (!std::ranges::all_of(*myNameIndex,
+                                 myIsIndex(mySymbols->size())) or
+            !std::ranges::all_of(*myByAddress,
+                                 myIsIndex(myFunctions->size())) or
+            !std::ranges::is_sorted(*myShards) or myShards->front() != 0 or
+            myShards->back() != myFunctions->size()) {
+            return false;
+        }
+
+        for (auto& myRange : *myRanges) {
+            if (myRange.theUnitIdx >= myUnits->size()) {
+                return false;
+            }
+        }
+
+        auto myElfSize = myHeader.theElfSize;
+        auto myInBounds = [](std::uint64_t anOffset, std::uint64_t aLength,
+                             std::uint64_t aSize) {
+            return anOffset <= aSize and aLength <= aSize - anOffset;
+        };
+
+        for (auto& myUnit : *myUnits) {
+            if (!myInBounds(myUnit.theNameOffset, myUnit.theNameLength,
+                            myElfSize) or
+                !myInBounds(myUnit.theCompDirOffset, myUnit.theCompDirLength,
+                            myElfSize)) {
+                return false;
+            }
+        }
+
+        for (auto& myFunction : *myFunctions) {
+            bool myIsCached = myFunction.theNameOffset & CACHE_STRING_BIT;
+            auto myOffset = myFunction.theNameOffset & ~CACHE_STRING_BIT;
+            if (myFunction.theUnitIdx >= myUnits->size() or
+                !myInBounds(myOffset, myFunction.theNameLength,
+                            myIsCached ? myStrings->size() : myElfSize)) {
+                return false;
+            }
+        }
+
+        theSymbols = *mySymbols;
+        theNameIndex = *myNameIndex;
+        theUnits = *myUnits;
+        theUnitRanges = *myRanges;
+        theFunctions = *myFunctions;
+        theFunctionShards = *myShards;
+        theFunctionsByAddress = *myByAddress;
+        theNameStrings = *myStrings;
+        return true;
+    }
+
+    std::vector<CompileUnit>
+    IndexCache::getCompileUnits(const ElfFile& anElf) const {
+        auto* myElfData = reinterpret_cast<const char*>(anElf.getData().data());
+
+        std::vector<CompileUnit> myUnits;
+        myUnits.reserve(theUnits.size());
+
+        for (auto& myCached : theUnits) {
+            CompileUnit myUnit;
+            myUnit.theOffset = myCached.theOffset;
+            myUnit.theEnd = myCached.theEnd;
+            myUnit.theDieOffset = myCached.theDieOffset;
+            myUnit.theAbbrevOffset = myCached.theAbbrevOffset;
+            myUnit.theVersion = myCached.theVersion;
+            myUnit.theUnitType = myCached.theUnitType;
+            myUnit.theAddressSize = myCached.theAddressSize;
+            myUnit.theIs64Bit = myCached.theIs64Bit;
+            if (myCached.theHasLineOffset) {
+                myUnit.theLineOffset = myCached.theLineOffset;
+            }
+            myUnit.theName = {myElfData + myCached.theNameOffset,
+                              myCached.theNameLength};
+            myUnit.theCompDir = {myElfData + myCached.theCompDirOffset,
+                                 myCached.theCompDirLength};
+            myUnit.theBaseAddress = myCached.theBaseAddress;
+            myUnit.theStrOffsetsBase = myCached.theStrOffsetsBase;
+            myUnit.theAddrBase = myCached.theAddrBase;
+            myUnit.theRnglistsBase = myCached.theRnglistsBase;
+
+            myUnits.push_back(myUnit);
+        }
+
+        return myUnits;
+    }
+
+    FunctionIndex IndexCache::getFunctionIndex(const ElfFile& anElf) const {
+        auto* myElfData = reinterpret_cast<const char*>(anElf.getData().data());
+
+        FunctionIndex myIndex;
+        myIndex.theEntries.reserve(theFunctions.size());
+        for (auto& myCached : theFunctions) {
+            auto myOffset = myCached.theNameOffset & ~CACHE_STRING_BIT;
+            auto* myName = (myCached.theNameOffset & CACHE_STRING_BIT)
+                               ? theNameStrings.data() + myOffset
+                               : myElfData + myOffset;
+
+            myIndex.theEntries.push_back(
+                {{myName, myCached.theNameLength}, myCached.theLow,
+                 myCached.theHigh, myCached.theUnitIdx});
+        }
+
+        myIndex.theShardOffsets.assign(theFunctionShards.begin(),
+                                       theFunctionShards.end());
+        myIndex.theByAddress.assign(theFunctionsByAddress.begin(),
+                                    theFunctionsByAddress.end());
+        return myIndex;
+    }
+
+    void IndexCache::store(const ElfFile& anElf, const Dwarf& aDwarf) {
+        auto myBuildId = anElf.getBuildId();
+        if (!myBuildId or myBuildId->size() > MAX_BUILD_ID_LENGTH) {
+            return;
+        }
+
+        auto myElfData = anElf.getData();
+        auto* myElfBegin = reinterpret_cast<const char*>(myElfData.data());
+
+        // Names that do not point into the file cannot be represented
+        auto myToOffset = [&](std::string_view aString, std::uint64_t& anOffset,
+                              std::uint32_t& aLength) {
+            if (aString.empty()) {
+                anOffset = 0;
+                aLength = 0;
+                return true;
+            }
+
+            if (aString.data() < myElfBegin or
+                aString.data() + aString.size() >
+                    myElfBegin + myElfData.size()) {
+                return false;
+            }
+
+            anOffset = aString.data() - myElfBegin;
+            aLength = aString.size();
+            return true;
+        };
+
+        std::vector<CachedCompileUnit> myUnits;
+        for (auto& myUnit : aDwarf.getCompileUnits()) {
+            CachedCompileUnit myCached{};
+            myCached.theOffset = myUnit.theOffset;
+            myCached.theEnd = myUnit.theEnd;
+            myCached.theDieOffset = myUnit.theDieOffset;
+            myCached.theAbbrevOffset = myUnit.theAbbrevOffset;
+            myCached.theLineOffset = myUnit.theLineOffset.value_or(0);
+            myCached.theHasLineOffset = myUnit.theLineOffset.has_value();
+            myCached.theBaseAddress = myUnit.theBaseAddress;
+            myCached.theStrOffsetsBase = myUnit.theStrOffsetsBase;
+            myCached.theAddrBase = myUnit.theAddrBase;
+            myCached.theRnglistsBase = myUnit.theRnglistsBase;
+            myCached.theVersion = myUnit.theVersion;
+            myCached.theUnitType = myUnit.theUnitType;
+            myCached.theAddressSize = myUnit.theAddressSize;
+            myCached.theIs64Bit = myUnit.theIs64Bit;
+
+            if (!myToOffset(myUnit.theName, myCached.theNameOffset,
+                            myCached.theNameLength) or
+                !myToOffset(myUnit.theCompDir, myCached.theCompDirOffset,
+                            myCached.theCompDirLength)) {
+                return;
+            }
+
+            myUnits.push_back(myCached);
+        }
+
+        std::vector<CachedFunction> myFunctions;
+        std::vector<char> myStrings;
+        auto& myFunctionIndex = aDwarf.getFunctionIndex();
+        for (auto& myFunction : myFunctionIndex.theEntries) {
+            CachedFunction myCached{0, myFunction.theLow, myFunction.theHigh,
+                                    0, myFunction.theUnitIdx};
+
+            if (!myToOffset(myFunction.theName, myCached.theNameOffset,
+                            myCached.theNameLength)) {
+                myCached.theNameOffset = myStrings.size() | CACHE_STRING_BIT;
+                myCached.theNameLength = myFunction.theName.size();
+                myStrings.insert(myStrings.end(), myFunction.theName.begin(),
+                                 myFunction.theName.end());
+            }
+
+            myFunctions.push_back(myCached);
+        }
+
+        FileHeader myHeader{};
+        myHeader.theMagic = MAGIC;
+        myHeader.theVersion = VERSION;
+        myHeader.theBuildIdLength = myBuildId->size();
+        std::ranges::copy(*myBuildId, myHeader.theBuildId.begin());
+        myHeader.theElfSize = myElfData.size();
+
+        std::vector<std::byte> myBuffer(sizeof(FileHeader));
+        appendSection(myBuffer, myHeader, SYMBOLS, anElf.getSymbols());
+        appendSection(myBuffer, myHeader, NAME_INDEX, anElf.getNameIndex());
+        appendSection(myBuffer, myHeader, UNITS,
+                      std::span<const CachedCompileUnit>{myUnits});
+        appendSection(myBuffer, myHeader, UNIT_RANGES, aDwarf.getUnitRanges());
+        appendSection(myBuffer, myHeader, FUNCTIONS,
+                      std::span<const CachedFunction>{myFunctions});
+        appendSection(
+            myBuffer, myHeader, FUNCTION_SHARDS,
+            std::span<const std::uint32_t>{myFunctionIndex.theShardOffsets});
+        appendSection(
+            myBuffer, myHeader, FUNCTIONS_BY_ADDRESS,
+            std::span<const std::uint32_t>{myFunctionIndex.theByAddress});
+        appendSection(myBuffer, myHeader, NAME_STRINGS,
+                      std::span<const char>{myStrings});
+        std::memcpy(myBuffer.data(), &myHeader, sizeof(myHeader));
+
+        std::error_code myError;
+        auto myDirectory = getDirectory();
+        std::filesystem::create_directories(myDirectory, myError);
+        if (myError) {
+            return;
+        }
+
+        // Write to a private file and rename it into place, so concurrent
+        // sessions never observe a partially written cache
+        auto myPath = getCachePath(*myBuildId);
+        auto myTempPath = myPath;
+        myTempPath += fmt::format(".{}.tmp", getpid());
+
+        int myFd = open(myTempPath.c_str(),
+                        O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (myFd < 0) {
+            return;
+        }
+
+        bool myWritten = writeAll(myFd, myBuffer);
+        if (close(myFd) < 0 or !myWritten or
+            rename(myTempPath.c_str(), myPath.c_str()) < 0) {
+            std::filesystem::remove(myTempPath, myError);
+        }
+    }
+
+} // namespace sdb
@@ -0,0 +1,182 @@
+#include <jit_interface.hpp>
+
+#include <bit.hpp>
+#include <error.hpp>
+#include <fmt/format.h>
+#include <memory_operations.hpp>
+#include <process.hpp>
+
+namespace sdb {
+
+    namespace {
+        // Layouts from the GDB JIT interface, with pointers widened to the
+        // 64-bit inferior's size
+        enum JitAction : std::uint32_t {
+            JIT_NOACTION = 0,
+            JIT_REGISTER_FN,
+            JIT_UNREGISTER_FN,
+        };
+
+        struct JitCodeEntry {
+            std::uint64_t theNextEntry;
+            std::uint64_t thePrevEntry;
+            std::uint64_t theSymfileAddress;
+            std::uint64_t theSymfileSize;
+        };
+
+        struct JitDescriptor {
+            std::uint32_t theVersion;
+            std::uint32_t theActionFlag;
+            std::uint64_t theRelevantEntry;
+            std::uint64_t theFirstEntry;
+        };
+
+        // A list the JIT left half linked may loop back on itself, so the
+        // walk at attach gives up after this many entries
+        constexpr std::size_t MAX_ENTRIES{1 << 20};
+
+        // Registered objects are small; anything larger is not an object
+        constexpr std::uint64_t MAX_SYMFILE_SIZE{256 << 20};
+
+        template <typename T>
+        T readStruct(pid_t aPid, VirtualAddress anAddress) {
+            return fromBytes<T>(readMemory(aPid, anAddress, sizeof(T)).data());
+        }
+    } // namespace
+
+    bool JitInterface::watch(const ElfFile& anElf, std::uint64_t aLoadBias) {
+        if (theDescriptor) {
+            return false;
+        }
+
+        auto myHooks = anElf.getSymbolsByName("__jit_debug_register_code");
+        auto myDescriptors = anElf.getSymbolsByName("__jit_debug_descriptor");
+        if (myHooks.empty() or myDescriptors.empty()) {
+            return false;
+        }
+
+        theDescriptor =
+            VirtualAddress{myDescriptors.front()->theAddress + aLoadBias};
+
+        auto myHook = VirtualAddress{myHooks.front()->theAddress + aLoadBias};
+        if (!theProcess.getBreakpointSites().contains_address(myHook)) {
+            auto& mySite = theProcess.createBreakpointSite(myHook, true);
+            mySite.setHitHandler([this]() { return onRegisterCode(); });
+            mySite.enable();
+        }
+
+        auto myDescriptor =
+            readStruct<JitDescriptor>(theProcess.getPid(), *theDescriptor);
+        auto myEntry = myDescriptor.theFirstEntry;
+        for (std::size_t i = 0; myEntry != 0 and i < MAX_ENTRIES; ++i) {
+            addEntry(VirtualAddress{myEntry});
+            myEntry = readStruct<JitCodeEntry>(theProcess.getPid(),
+                                               VirtualAddress{myEntry})
+                          .theNextEntry;
+        }
+
+        return true;
+    }
+
+    const JitObject* JitInterface::findObjectContainingAddress(
+        VirtualAddress anAddress) const {
+        auto myIt = theObjectsByAddress.upper_bound(
+            std::to_underlying(anAddress));
+        if (myIt == theObjectsByAddress.begin()) {
+            return nullptr;
+        }
+
+        auto* myObject = std::prev(myIt)->second;
+        return myObject->contains(anAddress) ? myObject : nullptr;
+    }
+
+    bool JitInterface::onRegisterCode() {
+        // A descriptor pointing at unreadable memory loses the registration
+        // but must not keep the program from running
+        try {
+            auto myDescriptor =
+                readStruct<JitDescriptor>(theProcess.getPid(), *theDescriptor);
+            auto myEntry = VirtualAddress{myDescriptor.theRelevantEntry};
+
+            if (myDescriptor.theActionFlag == JIT_REGISTER_FN) {
+                addEntry(myEntry);
+            } else if (myDescriptor.theActionFlag == JIT_UNREGISTER_FN) {
+                removeEntry(myEntry);
+            }
+        } catch (const Error&) {
+        }
+
+        return true;
+    }
+
+    void JitInterface::addEntry(VirtualAddress anEntry) {
+        if (std::to_underlying(anEntry) == 0 or
+            theObjects.contains(std::to_underlying(anEntry))) {
+            return;
+        }
+
+        auto myCodeEntry =
+            readStruct<JitCodeEntry>(theProcess.getPid(), anEntry);
+        if (myCodeEntry.theSymfileSize == 0 or
+            myCodeEntry.theSymfileSize > MAX_SYMFILE_SIZE) {
+            return;
+        }
+
+        auto myObject = std::make_unique<JitObject>();
+        myObject->theEntry = anEntry;
+
+        try {
+            myObject->theElf = std::make_unique<ElfFile>(
+                readMemory(theProcess.getPid(),
+                           VirtualAddress{myCodeEntry.theSymfileAddress},
+                           myCodeEntry.theSymfileSize),
+                fmt::format("<jit {:#x}>", myCodeEntry.theSymfileAddress));
+
+            // Loaded now so that a malformed symbol table drops the object
+            // here rather than failing a later lookup
+            myObject->theElf->getSymbols();
+        } catch (const Error&) {
+            return;
+        }
+
+        std::uint64_t myBegin = UINT64_MAX;
+        std::uint64_t myEnd = 0;
+        for (auto& mySection : myObject->theElf->getSectionHeaders()) {
+            if ((mySection.sh_flags & SHF_ALLOC) and mySection.sh_addr != 0) {
+                myBegin = std::min(myBegin, mySection.sh_addr);
+                myEnd = std::max(myEnd, mySection.sh_addr + mySection.sh_size);
+            }
+        }
+
+        auto myIt =
+            theObjects.emplace(std::to_underlying(anEntry), std::move(myObject))
+                .first;
+        auto& myStored = *myIt->second;
+        if (myBegin < myEnd) {
+            myStored.theBegin = VirtualAddress{myBegin};
+            myStored.theEnd = VirtualAddress{myEnd};
+            theObjectsByAddress[myBegin] = &myStored;
+        }
+
+        if (theOnRegister) {
+            theOnRegister(myStored);
+        }
+    }
+
+    void JitInterface::removeEntry(VirtualAddress anEntry) {
+        auto myIt = theObjects.find(std::to_underlying(anEntry));
+        if (myIt == theObjects.end()) {
+            return;
+        }
+
+        auto myByAddress = theObjectsByAddress.find(
+            std::to_underlying(myIt->second->theBegin));
+        if (myByAddress != theObjectsByAddress.end() and
+            myByAddress->second == myIt->second.get()) {
+            theObjectsByAddress.erase(myByAddress);
+        }
+
+        theObjects.erase(myIt);
+    }
+
+} // namespace sdb
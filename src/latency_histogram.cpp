@@ -0,0 +1,89 @@
+#include <latency_histogram.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <fmt/format.h>
+
+namespace sdb {
+
+    std::size_t LatencyHistogram::getBucket(std::uint64_t aValue) {
+        if (aValue < SUB_BUCKETS) {
+            return aValue;
+        }
+
+        // The top SUB_BUCKET_BITS + 1 bits of the value pick the bucket
+        unsigned myShift = std::bit_width(aValue) - 1 - SUB_BUCKET_BITS;
+        return (myShift + 1) * SUB_BUCKETS + (aValue >> myShift) -
+               SUB_BUCKETS;
+    }
+
+    std::uint64_t LatencyHistogram::getBucketEnd(std::size_t aBucket) {
+        if (aBucket < SUB_BUCKETS) {
+            return aBucket;
+        }
+
+        unsigned myShift = aBucket / SUB_BUCKETS - 1;
+        std::uint64_t myStart = (SUB_BUCKETS + aBucket % SUB_BUCKETS)
+                                << myShift;
+        return myStart + ((std::uint64_t{1} << myShift) - 1);
+    }
+
+    void LatencyHistogram::record(std::chrono::nanoseconds aValue) {
+        auto myValue =
+            static_cast<std::uint64_t>(std::max<std::int64_t>(aValue.count(),
+                                                              0));
+        ++theCounts[getBucket(myValue)];
+        ++theCount;
+        theTotal += myValue;
+        theMin = std::min(theMin, myValue);
+        theMax = std::max(theMax, myValue);
+    }
+
+    void LatencyHistogram::merge(const LatencyHistogram& other) {
+        for (std::size_t myI = 0; myI < NUM_BUCKETS; ++myI) {
+            theCounts[myI] += other.theCounts[myI];
+        }
+        theCount += other.theCount;
+        theTotal += other.theTotal;
+        theMin = std::min(theMin, other.theMin);
+        theMax = std::max(theMax, other.theMax);
+    }
+
+    std::chrono::nanoseconds
+    LatencyHistogram::getQuantile(double aFraction) const {
+        if (theCount == 0) {
+            return std::chrono::nanoseconds{0};
+        }
+
+        auto myRank = std::max<std::uint64_t>(
+            static_cast<std::uint64_t>(
+                std::ceil(std::clamp(aFraction, 0.0, 1.0) * theCount)),
+            1);
+        std::uint64_t mySeen = 0;
+        for (std::size_t myI = 0; myI < NUM_BUCKETS; ++myI) {
+            mySeen += theCounts[myI];
+            if (mySeen >= myRank) {
+                return std::chrono::nanoseconds(
+                    std::min(getBucketEnd(myI), theMax));
+            }
+        }
+
+        return getMax();
+    }
+
+    std::string formatLatency(std::chrono::nanoseconds aLatency) {
+        auto myNanos = aLatency.count();
+        if (myNanos < 1000) {
+            return fmt::format("{}ns", myNanos);
+        }
+        if (myNanos < 1000000) {
+            return fmt::format("{:.1f}us", myNanos / 1e3);
+        }
+        if (myNanos < 1000000000) {
+            return fmt::format("{:.2f}ms", myNanos / 1e6);
+        }
+        return fmt::format("{:.2f}s", myNanos / 1e9);
+    }
+
+} // namespace sdb
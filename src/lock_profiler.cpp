@@ -0,0 +1,246 @@
+#include <lock_profiler.hpp>
+
+#include <algorithm>
+#include <error.hpp>
+#include <fmt/format.h>
+#include <syscall_profiler.hpp>
+#include <target.hpp>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+namespace sdb {
+
+    namespace {
+        // Enough to get out of the C library from a futex call
+        constexpr std::size_t MAX_UNWOUND_FRAMES{16};
+
+        // Waiters listed under each lock
+        constexpr std::size_t MAX_WAITERS_SHOWN{3};
+
+        // The operations of the futex calls the process stops at, picked
+        // out by the seccomp filter so other operations run without a stop
+        const SyscallArgumentFilter FUTEX_OPERATIONS{
+            1, static_cast<std::uint32_t>(FUTEX_CMD_MASK),
+            {FUTEX_WAIT, FUTEX_WAIT_BITSET, FUTEX_LOCK_PI, FUTEX_WAKE,
+             FUTEX_WAKE_BITSET, FUTEX_UNLOCK_PI}};
+
+        bool isWait(std::uint64_t anOperation) {
+            switch (anOperation & FUTEX_CMD_MASK) {
+                case FUTEX_WAIT:
+                case FUTEX_WAIT_BITSET:
+                case FUTEX_LOCK_PI: return true;
+                default: return false;
+            }
+        }
+
+        bool isWake(std::uint64_t anOperation) {
+            switch (anOperation & FUTEX_CMD_MASK) {
+                case FUTEX_WAKE:
+                case FUTEX_WAKE_BITSET:
+                case FUTEX_UNLOCK_PI: return true;
+                default: return false;
+            }
+        }
+    } // namespace
+
+    LockProfiler::LockProfiler(Target& aTarget, bool anIsHookingMutexes)
+        : theTarget{aTarget}, theIsHookingMutexes{anIsHookingMutexes},
+          theHooks{aTarget.getProcess(), true} {
+    }
+
+    StopReason
+    LockProfiler::run(std::chrono::steady_clock::duration aDuration) {
+        using std::chrono::steady_clock;
+
+        if (theIsHookingMutexes) {
+            hookMutexes();
+        }
+
+        std::optional<Waiter> myPendingWait;
+        auto myOnStop = [&](const SyscallStop& aStop,
+                            steady_clock::time_point aResumed) {
+            auto myFutex = aStop.theArgs[0];
+            if (!aStop.theIsEntry) {
+                if (myPendingWait) {
+                    auto myWait = aStop.theTime - aResumed;
+                    theLocks[myPendingWait->theLock].theWaits.record(myWait);
+                    theWaiters[*myPendingWait].record(myWait);
+                    myPendingWait.reset();
+                }
+            } else if (isWait(aStop.theArgs[1])) {
+                // The futex word is the first member of a mutex
+                auto& myLock = thePendingLock;
+                if (myLock and myLock->theLock == myFutex) {
+                    myLock->theIsContended = true;
+                    myPendingWait = Waiter{myFutex, myLock->theStack};
+                } else {
+                    myPendingWait = Waiter{myFutex, readStack()};
+                }
+            } else if (isWake(aStop.theArgs[1])) {
+                ++theLocks[myFutex].theNumWakes;
+            }
+        };
+
+        auto myStart = steady_clock::now();
+        std::optional<StopReason> myReason;
+        try {
+            myReason =
+                runCatchingSyscalls(theTarget.getProcess(), {SYS_futex},
+                                    aDuration, myOnStop, theOverhead,
+                                    FUTEX_OPERATIONS);
+        } catch (...) {
+            unhookMutexes();
+            throw;
+        }
+        theRunTime += steady_clock::now() - myStart;
+        unhookMutexes();
+
+        return *myReason;
+    }
+
+    void LockProfiler::hookMutexes() {
+        auto& myProcess = theTarget.getProcess();
+        auto myEntries = theTarget.findSymbolAddresses("pthread_mutex_lock");
+        if (myEntries.empty()) {
+            Error::send("Could not find pthread_mutex_lock; the C library "
+                        "may not be loaded yet");
+        }
+
+        for (auto myEntry : myEntries) {
+            if (myProcess.getBreakpointSites().contains_address(myEntry)) {
+                unhookMutexes();
+                Error::send("A breakpoint is already set on "
+                            "pthread_mutex_lock");
+            }
+
+            theHooks
+                .createEntrySite(myEntry,
+                                 {[this]() { return onLockEntry(); },
+                                  [this](bool anIsReturned) {
+                                      onLockReturn(anIsReturned);
+                                  }})
+                .enable();
+        }
+    }
+
+    void LockProfiler::unhookMutexes() {
+        theHooks.clear();
+        thePendingLock.reset();
+    }
+
+    bool LockProfiler::onLockEntry() {
+        auto& myRegs =
+            theTarget.getProcess().getRegisters().getRegisterData().regs;
+        thePendingLock = PendingLock{myRegs.rdi, readStack()};
+        return true;
+    }
+
+    void LockProfiler::onLockReturn(bool anIsReturned) {
+        if (anIsReturned and thePendingLock) {
+            auto& myStats = theLocks[thePendingLock->theLock];
+            ++myStats.theNumAcquired;
+            if (thePendingLock->theIsContended) {
+                ++myStats.theNumContended;
+            }
+        }
+        thePendingLock.reset();
+    }
+
+    std::vector<std::uint64_t> LockProfiler::readStack() const {
+        auto myFrames = theTarget.backtrace(MAX_UNWOUND_FRAMES);
+        if (myFrames.empty()) {
+            return {};
+        }
+
+        // Frames in the library the stop is in, such as the C library's
+        // locking code, are skipped up to the first caller outside it
+        auto* myLibrary =
+            theTarget.getSharedLibraries().findLibraryContainingAddress(
+                myFrames.front().thePc);
+        std::vector<std::uint64_t> myStack;
+        for (std::size_t myI = 1;
+             myI < myFrames.size() and myStack.size() < MAX_FRAMES; ++myI) {
+            auto myPc = myFrames[myI].thePc;
+            if (myStack.empty() and myLibrary and myLibrary->contains(myPc)) {
+                continue;
+            }
+            myStack.push_back(std::to_underlying(myPc));
+        }
+
+        return myStack;
+    }
+
+    void LockProfiler::writeTable(std::ostream& aStream,
+                                  std::size_t aMaxLocks) const {
+        std::vector<const std::pair<const std::uint64_t, Stats>*> myLocks;
+        for (auto& myLock : theLocks) {
+            myLocks.push_back(&myLock);
+        }
+        std::ranges::stable_sort(myLocks, std::ranges::greater{},
+                                 [](auto* aLock) {
+                                     auto& myStats = aLock->second;
+                                     return std::pair{
+                                         myStats.theWaits.getTotal(),
+                                         myStats.theNumWakes};
+                                 });
+
+        aStream << fmt::format("{:<18} {:<24} {:>7} {:>10} {:>10} {:>9} "
+                               "{:>9} {:>7}\n",
+                               "lock", "symbol", "waits", "total", "max",
+                               "acquired", "contended", "wakes");
+        for (std::size_t myI = 0; myI < myLocks.size() and myI < aMaxLocks;
+             ++myI) {
+            auto& [myLock, myStats] = *myLocks[myI];
+
+            // Only globals have a symbol
+            std::string mySymbol;
+            if (auto myLocation = theTarget.symbolize(VirtualAddress{myLock})) {
+                mySymbol = myLocation->theOffset == 0
+                               ? std::string{myLocation->theName}
+                               : fmt::format("{}+{:#x}", myLocation->theName,
+                                             myLocation->theOffset);
+            }
+
+            aStream << fmt::format(
+                "{:<#18x} {:<24} {:>7} {:>10} {:>10} {:>9} {:>9} {:>7}\n",
+                myLock, mySymbol, myStats.theWaits.getCount(),
+                formatLatency(myStats.theWaits.getTotal()),
+                formatLatency(myStats.theWaits.getMax()),
+                myStats.theNumAcquired, myStats.theNumContended,
+                myStats.theNumWakes);
+
+            std::vector<const std::pair<const Waiter, LatencyHistogram>*>
+                myWaiters;
+            for (auto myIt = theWaiters.lower_bound(Waiter{myLock, {}});
+                 myIt != theWaiters.end() and myIt->first.theLock == myLock;
+                 ++myIt) {
+                myWaiters.push_back(&*myIt);
+            }
+            std::ranges::stable_sort(myWaiters, std::ranges::greater{},
+                                     [](auto* aWaiter) {
+                                         return aWaiter->second.getTotal();
+                                     });
+
+            for (std::size_t myJ = 0;
+                 myJ < myWaiters.size() and myJ < MAX_WAITERS_SHOWN; ++myJ) {
+                auto& [myWaiter, myWaits] = *myWaiters[myJ];
+                std::string myStack;
+                for (auto myAddress : myWaiter.theStack) {
+                    if (!myStack.empty()) {
+                        myStack += " <- ";
+                    }
+                    myStack += theTarget.getFunctionName(
+                        VirtualAddress{myAddress}, true);
+                }
+
+                aStream << fmt::format(
+                    "    {:>7} waits {:>10} total {:>10} max  {}\n",
+                    myWaits.getCount(), formatLatency(myWaits.getTotal()),
+                    formatLatency(myWaits.getMax()),
+                    myStack.empty() ? "[unknown]" : myStack);
+            }
+        }
+    }
+
+} // namespace sdb
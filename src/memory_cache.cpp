@@ -0,0 +1,75 @@
+#include <memory_cache.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include <sys/uio.h>
+
+namespace sdb {
+
+    bool MemoryCache::read(VirtualAddress anAddress,
+                           std::span<std::byte> aBuffer) {
+        auto myAddress = std::to_underlying(anAddress);
+
+        while (!aBuffer.empty()) {
+            auto* myPage = getPage(myAddress / PAGE_BYTES);
+            if (myPage == nullptr) {
+                return false;
+            }
+
+            auto myOffset = myAddress % PAGE_BYTES;
+            auto myChunk = std::min(aBuffer.size(), PAGE_BYTES - myOffset);
+            std::memcpy(aBuffer.data(), myPage->data() + myOffset, myChunk);
+
+            aBuffer = aBuffer.subspan(myChunk);
+            myAddress += myChunk;
+        }
+
+        return true;
+    }
+
+    const MemoryCache::Page* MemoryCache::getPage(std::uint64_t aPageNumber) {
+        if (auto myIt = thePages.find(aPageNumber); myIt != thePages.end()) {
+            return myIt->second.get();
+        }
+
+        // Pages already cached end the read-ahead window, so every page is
+        // read at most once
+        std::vector<std::unique_ptr<Page>> myPages;
+        std::vector<iovec> myLocal;
+        std::vector<iovec> myRemote;
+        for (std::size_t i = 0; i < READ_AHEAD_PAGES; ++i) {
+            auto myPageNumber = aPageNumber + i;
+            if (i > 0 and thePages.contains(myPageNumber)) {
+                break;
+            }
+
+            auto& myPage = myPages.emplace_back(std::make_unique<Page>());
+            myLocal.push_back({myPage->data(), PAGE_BYTES});
+            auto* myRemotePage =
+                reinterpret_cast<void*>(myPageNumber * PAGE_BYTES);
+            myRemote.push_back({myRemotePage, PAGE_BYTES});
+        }
+
+        ++theNumReads;
+        auto myBytesRead =
+            process_vm_readv(thePid, myLocal.data(), myLocal.size(),
+                             myRemote.data(), myRemote.size(), 0);
+
+        // Reads stop at the first unreadable page, such as the end of the
+        // stack mapping. Only the requested page is remembered as
+        // unreadable; the others may be readable on their own.
+        auto myPagesRead =
+            myBytesRead < 0 ? 0 : static_cast<std::size_t>(myBytesRead) /
+                                      PAGE_BYTES;
+        for (std::size_t i = 0; i < myPagesRead; ++i) {
+            thePages[aPageNumber + i] = std::move(myPages[i]);
+        }
+        if (myPagesRead == 0) {
+            thePages[aPageNumber] = nullptr;
+        }
+
+        return thePages[aPageNumber].get();
+    }
+
+} // namespace sdb
@@ -1,9 +1,11 @@
 #include <memory_operations.hpp>
 
+#include <algorithm>
 #include <span>
 #include <vector>
 
 #include <bit.hpp>
+#include <code_arena.hpp>
 #include <process.hpp>
 #include <types.hpp>
 
@@ -47,12 +49,32 @@ namespace sdb {
         std::vector<std::byte> myResult =
             readMemory(aProcess.getPid(), anAddress, anAmount);
 
+        // Sites patched with a jump cover bytes after their address, so
+        // those starting a little before the range are included
+        auto myBegin = std::to_underlying(anAddress);
+        auto myEnd = myBegin + anAmount;
         auto& myBreakpointSites = aProcess.getBreakpointSites();
-        for (auto&& mySiteInRange :
-             myBreakpointSites.getInRange(anAddress, anAddress + anAmount)) {
-            auto myOffset = std::to_underlying(mySiteInRange->getAddress()) -
-                            std::to_underlying(anAddress);
-            myResult[myOffset] = mySiteInRange->getSavedData();
+        for (auto&& mySiteInRange : myBreakpointSites.getInRange(
+                 anAddress - std::min<std::uint64_t>(
+                                 myBegin, DisplacedCode::MAX_LENGTH),
+                 anAddress + anAmount)) {
+            auto mySiteAddress =
+                std::to_underlying(mySiteInRange->getAddress());
+            auto mySaved = mySiteInRange->getSavedCode();
+            if (mySaved.empty()) {
+                if (mySiteAddress >= myBegin and mySiteAddress < myEnd) {
+                    myResult[mySiteAddress - myBegin] =
+                        mySiteInRange->getSavedData();
+                }
+                continue;
+            }
+
+            for (std::size_t i = 0; i < mySaved.size(); ++i) {
+                if (mySiteAddress + i >= myBegin and
+                    mySiteAddress + i < myEnd) {
+                    myResult[mySiteAddress + i - myBegin] = mySaved[i];
+                }
+            }
         }
 
         return myResult;
@@ -0,0 +1,214 @@
+#include <native_condition.hpp>
+
+#include <breakpoint_condition.hpp>
+#include <error.hpp>
+#include <fmt/format.h>
+#include <libsdb/register_info.hpp>
+#include <memory_operations.hpp>
+#include <process.hpp>
+
+namespace sdb {
+
+    namespace {
+        using Op = BreakpointCondition::Op;
+        using Instruction = BreakpointCondition::Instruction;
+
+        // Loads a register of the process into rax, reading those the
+        // trampoline changed from the stack with the condition's values
+        // above them
+        void emitRegister(CodeBuffer& aCode, const RegisterInfo& anInfo,
+                          std::size_t aDepth, VirtualAddress aSite) {
+            // Sub-registers are read from the whole register and cut down
+            auto& myWhole =
+                anInfo.theRegisterType == RegisterType::sub_gpr
+                    ? findRegisterByPredicate([&](const RegisterInfo& other) {
+                          return other.theRegisterType == RegisterType::gpr and
+                                 other.theOffset == (anInfo.theOffset & ~7);
+                      })
+                    : anInfo;
+            if (!TrampolineFrame::emitLoad(
+                    aCode, myWhole.theId, aSite,
+                    static_cast<std::int32_t>(aDepth * 8))) {
+                Error::send(fmt::format("Conditions checked in the process "
+                                        "cannot read {}",
+                                        anInfo.theName));
+            }
+
+            if (anInfo.theOffset & 7) {
+                aCode.emit({0x48, 0xc1, 0xe8, 0x08}); // shr rax, 8
+            }
+            switch (anInfo.theSize) {
+                case 4: aCode.emit({0x89, 0xc0}); break;       // mov eax, eax
+                case 2: aCode.emit({0x0f, 0xb7, 0xc0}); break; // movzx eax, ax
+                case 1: aCode.emit({0x0f, 0xb6, 0xc0}); break; // movzx eax, al
+                default: break;
+            }
+        }
+
+        // Stores the flag of the last comparison in rax
+        void emitSet(CodeBuffer& aCode, std::uint8_t aCondition) {
+            aCode.emit({0x0f, aCondition, 0xc0}); // setcc al
+            aCode.emit({0x0f, 0xb6, 0xc0});       // movzx eax, al
+        }
+
+        // Runs the bytecode as it is, with the process's stack as the
+        // operand stack, leaving the result in rax. Loads are rejected
+        // before.
+        void emitCondition(CodeBuffer& aCode,
+                           std::span<const Instruction> aBytecode,
+                           VirtualAddress aSite, VirtualAddress aHitCounter) {
+            std::vector<std::size_t> myStarts(aBytecode.size());
+            std::vector<std::pair<std::size_t, std::size_t>> myJumps;
+            std::size_t myDepth = 0;
+
+            for (std::size_t i = 0; i < aBytecode.size(); ++i) {
+                myStarts[i] = aCode.getSize();
+                auto& myInstruction = aBytecode[i];
+                switch (myInstruction.theOp) {
+                    case Op::Constant:
+                        aCode.emit({0x48, 0xb8}); // mov rax, constant
+                        aCode.emitValue(myInstruction.theOperand);
+                        break;
+                    case Op::Register:
+                        emitRegister(aCode,
+                                     g_register_infos[myInstruction.theOperand],
+                                     myDepth, aSite);
+                        break;
+                    case Op::HitCount:
+                        aCode.emit({0x48, 0xb8}); // mov rax, counter
+                        aCode.emitValue(std::to_underlying(aHitCounter));
+                        aCode.emit({0x48, 0x8b, 0x00}); // mov rax, [rax]
+                        break;
+                    case Op::Not:
+                    case Op::ToBool:
+                        aCode.emit({0x58});             // pop rax
+                        aCode.emit({0x48, 0x85, 0xc0}); // test rax, rax
+                        emitSet(aCode, myInstruction.theOp == Op::Not
+                                           ? 0x94  // sete
+                                           : 0x95); // setne
+                        --myDepth;
+                        break;
+                    case Op::Negate:
+                        aCode.emit({0x58});             // pop rax
+                        aCode.emit({0x48, 0xf7, 0xd8}); // neg rax
+                        --myDepth;
+                        break;
+                    case Op::JumpIfFalse:
+                    case Op::JumpIfTrue:
+                        // The value decides the result, so it stays on the
+                        // stack when jumping and is dropped otherwise
+                        aCode.emit({0x48, 0x8b, 0x04, 0x24}); // mov rax, [rsp]
+                        aCode.emit({0x48, 0x85, 0xc0});       // test rax, rax
+                        myJumps.emplace_back(
+                            aCode.emitBranch(
+                                {0x0f, static_cast<std::uint8_t>(
+                                           myInstruction.theOp ==
+                                                   Op::JumpIfFalse
+                                               ? 0x84    // jz
+                                               : 0x85)}), // jnz
+                            myInstruction.theOperand);
+                        aCode.emit({0x58}); // pop rax
+                        --myDepth;
+                        continue;
+                    default: {
+                        aCode.emit({0x59, 0x58}); // pop rcx, pop rax
+                        myDepth -= 2;
+                        static constexpr std::pair<Op, std::uint8_t>
+                            myArithmetic[]{{Op::Add, 0x01},
+                                           {Op::Subtract, 0x29},
+                                           {Op::BitAnd, 0x21},
+                                           {Op::BitOr, 0x09},
+                                           {Op::BitXor, 0x31}};
+                        static constexpr std::pair<Op, std::uint8_t>
+                            myComparisons[]{{Op::Equal, 0x94},
+                                            {Op::NotEqual, 0x95},
+                                            {Op::Less, 0x9c},
+                                            {Op::LessEqual, 0x9e},
+                                            {Op::Greater, 0x9f},
+                                            {Op::GreaterEqual, 0x9d}};
+                        for (auto [myOp, myOpcode] : myArithmetic) {
+                            if (myOp == myInstruction.theOp) {
+                                // op rax, rcx
+                                aCode.emit({0x48, myOpcode, 0xc8});
+                            }
+                        }
+                        for (auto [myOp, mySet] : myComparisons) {
+                            if (myOp == myInstruction.theOp) {
+                                aCode.emit({0x48, 0x39, 0xc8}); // cmp rax, rcx
+                                emitSet(aCode, mySet);
+                            }
+                        }
+                        break;
+                    }
+                }
+
+                aCode.emit({0x50}); // push rax
+                ++myDepth;
+            }
+
+            for (auto [myDisplacement, myTarget] : myJumps) {
+                aCode.patchBranch(myDisplacement, myStarts[myTarget]);
+            }
+            aCode.emit({0x58}); // pop rax
+        }
+    } // namespace
+
+    NativeCondition NativeCondition::inject(
+        Process& aProcess, VirtualAddress aSite,
+        const BreakpointCondition& aCondition) {
+        // A bad address would fault in the trampoline on every hit
+        for (auto& myInstruction : aCondition.getCode()) {
+            if (myInstruction.theOp == Op::Load) {
+                Error::send("Conditions checked in the process cannot read "
+                            "memory");
+            }
+        }
+
+        auto myDisplaced = DisplacedCode::at(aProcess, aSite);
+        auto& myArena = aProcess.getCodeArena();
+        auto myHitCounter = myArena.allocateData(sizeof(std::uint64_t));
+
+        CodeBuffer myCode;
+        TrampolineFrame::emitSave(myCode);
+        myCode.emit({0x48, 0xb8}); // mov rax, counter
+        myCode.emitValue(std::to_underlying(myHitCounter));
+        myCode.emit({0xf0, 0x48, 0xff, 0x00}); // lock inc qword [rax]
+
+        emitCondition(myCode, aCondition.getCode(), aSite, myHitCounter);
+
+        // Popping leaves the flags of the test for the branch
+        myCode.emit({0x48, 0x85, 0xc0}); // test rax, rax
+        TrampolineFrame::emitRestoreRegisters(myCode);
+        auto myToTrue = myCode.emitBranch({0x0f, 0x85}); // jnz true
+        TrampolineFrame::emitRestoreFlags(myCode);
+        auto myToDisplaced = myCode.emitBranch({0xe9}); // jmp displaced
+
+        myCode.patchBranch(myToTrue, myCode.getSize());
+        TrampolineFrame::emitRestoreFlags(myCode);
+        auto myTrapOffset = myCode.getSize();
+        myCode.emit({0xcc}); // int3
+
+        myCode.patchBranch(myToDisplaced, myCode.getSize());
+        myDisplaced.emit(myCode);
+
+        auto myTrampoline = myArena.allocateCode(aSite, myCode.getSize());
+        writeMemory(aProcess.getPid(), myTrampoline, myCode.getBytes());
+
+        auto myPatch = myDisplaced.makePatch(myTrampoline);
+        return NativeCondition{aProcess.getPid(), std::move(myDisplaced),
+                               std::move(myPatch),
+                               myTrampoline + myTrapOffset, myHitCounter};
+    }
+
+    std::uint64_t NativeCondition::getNumHits() const {
+        try {
+            auto myBytes = readMemory(thePid, theHitCounter,
+                                      sizeof(std::uint64_t));
+            std::memcpy(&theNumHits, myBytes.data(), sizeof(theNumHits));
+        } catch (const Error&) {
+        }
+
+        return theNumHits;
+    }
+
+} // namespace sdb
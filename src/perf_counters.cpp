@@ -0,0 +1,158 @@
+#include <perf_counters.hpp>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <error.hpp>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace sdb {
+
+    namespace {
+        struct EventConfig {
+            PerfEvent theEvent;
+            std::uint32_t theType;
+            std::uint64_t theConfig;
+        };
+
+        // The task clock leads the group since it can always be scheduled
+        constexpr std::array EVENTS{
+            EventConfig{PerfEvent::TaskClock, PERF_TYPE_SOFTWARE,
+                        PERF_COUNT_SW_TASK_CLOCK},
+            EventConfig{PerfEvent::Instructions, PERF_TYPE_HARDWARE,
+                        PERF_COUNT_HW_INSTRUCTIONS},
+            EventConfig{PerfEvent::Cycles, PERF_TYPE_HARDWARE,
+                        PERF_COUNT_HW_CPU_CYCLES},
+            EventConfig{PerfEvent::PageFaults, PERF_TYPE_SOFTWARE,
+                        PERF_COUNT_SW_PAGE_FAULTS},
+            EventConfig{PerfEvent::ContextSwitches, PERF_TYPE_SOFTWARE,
+                        PERF_COUNT_SW_CONTEXT_SWITCHES},
+        };
+
+        // Layout of a read() of the group with the read format below
+        struct GroupReadHeader {
+            std::uint64_t theNumValues;
+            std::uint64_t theTimeEnabled;
+            std::uint64_t theTimeRunning;
+        };
+
+        constexpr std::uint64_t READ_FORMAT{PERF_FORMAT_GROUP |
+                                            PERF_FORMAT_TOTAL_TIME_ENABLED |
+                                            PERF_FORMAT_TOTAL_TIME_RUNNING};
+
+        int openEvent(perf_event_attr& anAttr, pid_t aPid, int aGroupFd) {
+            return static_cast<int>(syscall(SYS_perf_event_open, &anAttr,
+                                            aPid, -1, aGroupFd,
+                                            PERF_FLAG_FD_CLOEXEC));
+        }
+    } // namespace
+
+    std::string_view getPerfEventName(PerfEvent anEvent) {
+        switch (anEvent) {
+            case PerfEvent::Instructions:
+                return "instructions";
+            case PerfEvent::Cycles:
+                return "cycles";
+            case PerfEvent::TaskClock:
+                return "task-clock";
+            case PerfEvent::PageFaults:
+                return "page-faults";
+            case PerfEvent::ContextSwitches:
+                return "context-switches";
+        }
+
+        return "unknown";
+    }
+
+    std::unique_ptr<PerfCounters> PerfCounters::open(pid_t aPid) {
+        auto myCounters = std::unique_ptr<PerfCounters>(new PerfCounters());
+        for (auto& myConfig : EVENTS) {
+            if (!myCounters->add(aPid, myConfig.theEvent, myConfig.theType,
+                                 myConfig.theConfig) and
+                myCounters->theFds.empty()) {
+                return nullptr;
+            }
+        }
+
+        myCounters->theTotals.assign(myCounters->theEvents.size(), 0);
+        for (auto myEvent : myCounters->theEvents) {
+            myCounters->theDelta.push_back(PerfCount{myEvent, 0});
+        }
+
+        return myCounters;
+    }
+
+    bool PerfCounters::add(pid_t aPid, PerfEvent anEvent, std::uint32_t aType,
+                           std::uint64_t aConfig) {
+        perf_event_attr myAttr;
+        std::memset(&myAttr, 0, sizeof(myAttr));
+        myAttr.size = sizeof(myAttr);
+        myAttr.type = aType;
+        myAttr.config = aConfig;
+        myAttr.read_format = READ_FORMAT;
+        myAttr.exclude_hv = 1;
+
+        // Hardware events leave out the kernel so the cost of the ptrace
+        // stops themselves is not counted. Software events such as context
+        // switches are only seen from the kernel, so they include it unless
+        // perf_event_paranoid forbids that.
+        myAttr.exclude_kernel = aType == PERF_TYPE_HARDWARE;
+
+        int myGroupFd = theFds.empty() ? -1 : theFds.front();
+        int myFd = openEvent(myAttr, aPid, myGroupFd);
+        if (myFd < 0 and (errno == EACCES or errno == EPERM) and
+            !myAttr.exclude_kernel) {
+            myAttr.exclude_kernel = 1;
+            myFd = openEvent(myAttr, aPid, myGroupFd);
+        }
+        if (myFd < 0) {
+            return false;
+        }
+
+        theFds.push_back(myFd);
+        theEvents.push_back(anEvent);
+        return true;
+    }
+
+    void PerfCounters::update() {
+        std::vector<std::uint64_t> myBuffer(sizeof(GroupReadHeader) /
+                                                sizeof(std::uint64_t) +
+                                            theFds.size());
+        auto myBytes = myBuffer.size() * sizeof(std::uint64_t);
+        if (::read(theFds.front(), myBuffer.data(), myBytes) !=
+            static_cast<ssize_t>(myBytes)) {
+            Error::sendErrno("Could not read performance counters: ");
+        }
+
+        GroupReadHeader myHeader;
+        std::memcpy(&myHeader, myBuffer.data(), sizeof(myHeader));
+        auto* myValues = myBuffer.data() + sizeof(myHeader) /
+                                               sizeof(std::uint64_t);
+
+        for (std::size_t i = 0; i < theEvents.size(); ++i) {
+            // The group is scheduled as a whole, so it shares one scaling
+            // factor when hardware counters had to be multiplexed
+            auto myTotal = myValues[i];
+            if (myHeader.theTimeRunning != 0 and
+                myHeader.theTimeRunning < myHeader.theTimeEnabled) {
+                myTotal = static_cast<std::uint64_t>(
+                    static_cast<double>(myTotal) * myHeader.theTimeEnabled /
+                    myHeader.theTimeRunning);
+            }
+
+            theDelta[i].theValue =
+                myTotal > theTotals[i] ? myTotal - theTotals[i] : 0;
+            theTotals[i] = myTotal;
+        }
+    }
+
+    PerfCounters::~PerfCounters() {
+        // Members are closed before the leader
+        for (auto myIt = theFds.rbegin(); myIt != theFds.rend(); ++myIt) {
+            ::close(*myIt);
+        }
+    }
+
+} // namespace sdb
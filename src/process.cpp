@@ -1,18 +1,35 @@
 #include <process.hpp>
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <code_arena.hpp>
+#include <cstddef>
 #include <cstdio>
 #include <error.hpp>
 #include <fmt/format.h>
+#include <fstream>
 #include <iostream>
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <memory_cache.hpp>
+#include <memory_operations.hpp>
 #include <pipe.hpp>
 #include <register_info.hpp>
+#include <sched.h>
+#include <sys/auxv.h>
+#include <sys/mman.h>
 #include <sys/personality.h>
+#include <sys/prctl.h>
 #include <types.hpp>
 
 #include <stdexcept>
 #include <sys/ptrace.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <unistd.h>
 #include <utility>
 
 namespace sdb {
@@ -41,6 +58,136 @@ namespace sdb {
             return anOrigin == Origin::LAUNCHED ||
                    anOrigin == Origin::LAUNCHED_AND_ATTACHED;
         }
+
+        // Tells the stops PTRACE_SYSCALL makes on entry to a call from those
+        // on return
+        bool isSyscallEntry(pid_t aPid) {
+            __ptrace_syscall_info myInfo{};
+            if (ptrace(PTRACE_GET_SYSCALL_INFO, aPid, sizeof(myInfo),
+                       &myInfo) < 0) {
+                Error::sendErrno("Could not read system call stop");
+            }
+            return myInfo.op == PTRACE_SYSCALL_INFO_ENTRY;
+        }
+
+        // The start of the scratch code: a system call with a trap after
+        // it, and the trap injected calls return to
+        constexpr std::array SCRATCH_CODE{std::byte{0x0f}, std::byte{0x05},
+                                          std::byte{0xcc}, std::byte{0xcc}};
+        constexpr std::uint64_t SYSCALL_TRAP{2};
+        constexpr std::uint64_t CALL_TRAP{3};
+        constexpr std::uint64_t SCRATCH_CODE_SIZE{0x1000};
+
+        // Loads the number and arguments of a system call into the
+        // registers the syscall instruction reads. Clearing orig_rax keeps
+        // the kernel from taking the registers, once written, for those of
+        // an interrupted call to restart.
+        void setSyscallRegisters(user_regs_struct& aRegs, std::uint64_t aNumber,
+                                 std::initializer_list<std::uint64_t> anArgs) {
+            static constexpr std::array myArgRegisters{
+                &user_regs_struct::rdi, &user_regs_struct::rsi,
+                &user_regs_struct::rdx, &user_regs_struct::r10,
+                &user_regs_struct::r8,  &user_regs_struct::r9};
+
+            aRegs.rax = aNumber;
+            aRegs.orig_rax = -1;
+            auto myArg = anArgs.begin();
+            for (std::size_t i = 0; i < anArgs.size(); ++i) {
+                aRegs.*myArgRegisters[i] = *myArg++;
+            }
+        }
+
+        // Signals the injected code itself caused, which end it
+        bool isFault(int aSignal) {
+            switch (aSignal) {
+                case SIGSEGV:
+                case SIGBUS:
+                case SIGILL:
+                case SIGFPE:
+                case SIGTRAP:
+                case SIGABRT:
+                case SIGSYS: return true;
+                default: return false;
+            }
+        }
+
+        // Runs a fork from the system call in the scratch code of the
+        // stopped process and returns the child, traced by sdb and stopped
+        // by the SIGSTOP traced children start with. The child is a
+        // sibling of the process, so sdb reaps it and the program never
+        // waits for it. The process's registers and its ptrace options
+        // are put back afterwards, and the child gets the same options.
+        pid_t forkTracee(pid_t aPid, const user_regs_struct& aRegs,
+                         VirtualAddress aSyscall, int anOptions) {
+            auto myRegs = aRegs;
+            myRegs.rip = std::to_underlying(aSyscall);
+            myRegs.rax = SYS_clone;
+            myRegs.orig_rax = -1;
+            myRegs.rdi = CLONE_PARENT | SIGCHLD;
+            myRegs.rsi = myRegs.rdx = myRegs.r10 = myRegs.r8 = 0;
+
+            if (ptrace(PTRACE_SETOPTIONS, aPid, nullptr,
+                       anOptions | PTRACE_O_TRACEFORK) < 0) {
+                Error::sendErrno("Could not trace forks");
+            }
+            if (ptrace(PTRACE_SETREGS, aPid, nullptr, &myRegs) < 0) {
+                Error::sendErrno("Could not write general purpose registers");
+            }
+
+            pid_t myChild = 0;
+            std::vector<int> myDeferred;
+            int myStatus = 0;
+            while (true) {
+                if (ptrace(PTRACE_CONT, aPid, nullptr, nullptr) < 0 or
+                    waitpid(aPid, &myStatus, 0) < 0) {
+                    Error::sendErrno("Could not run injected fork");
+                }
+                if (!WIFSTOPPED(myStatus)) {
+                    Error::send("Process ended during an injected fork");
+                }
+
+                if (myStatus >> 8 == (SIGTRAP | (PTRACE_EVENT_FORK << 8))) {
+                    unsigned long myMessage = 0;
+                    ptrace(PTRACE_GETEVENTMSG, aPid, nullptr, &myMessage);
+                    myChild = static_cast<pid_t>(myMessage);
+                    continue;
+                }
+                if (WSTOPSIG(myStatus) == SIGTRAP) {
+                    break;
+                }
+                myDeferred.push_back(WSTOPSIG(myStatus));
+            }
+
+            ptrace(PTRACE_GETREGS, aPid, nullptr, &myRegs);
+            ptrace(PTRACE_SETOPTIONS, aPid, nullptr, anOptions);
+            if (ptrace(PTRACE_SETREGS, aPid, nullptr, &aRegs) < 0) {
+                Error::sendErrno("Could not write general purpose registers");
+            }
+            for (auto mySignal : myDeferred) {
+                syscall(SYS_tgkill, aPid, aPid, mySignal);
+            }
+
+            if (myChild == 0) {
+                Error::send(fmt::format(
+                    "Injected fork failed: {}",
+                    std::strerror(static_cast<int>(
+                        -static_cast<std::int64_t>(myRegs.rax)))));
+            }
+            if (waitpid(myChild, &myStatus, __WALL) < 0 or
+                !WIFSTOPPED(myStatus)) {
+                Error::send("Forked process did not stop");
+            }
+
+            // Checkpoints die with sdb rather than run on untraced
+            ptrace(PTRACE_SETOPTIONS, myChild, nullptr,
+                   anOptions | PTRACE_O_EXITKILL);
+            return myChild;
+        }
+
+        void killTracee(pid_t aPid) {
+            kill(aPid, SIGKILL);
+            waitpid(aPid, nullptr, __WALL);
+        }
     } // namespace
 
     std::unique_ptr<Process> Process::attach(pid_t aPid) {
@@ -54,6 +201,7 @@ namespace sdb {
         auto myProcess =
             std::unique_ptr<Process>(new Process(aPid, Origin::ATTACHED, true));
         myProcess->waitOnSignal();
+        myProcess->thePerfCounters = PerfCounters::open(aPid);
 
         return myProcess;
     }
@@ -104,38 +252,196 @@ namespace sdb {
 
         if (aDebug) {
             myProcess->waitOnSignal();
+            myProcess->thePerfCounters = PerfCounters::open(myPid);
         }
 
         return myProcess;
     }
 
     StopReason Process::waitOnSignal() {
+        while (true) {
+            if (auto myStopReason = handleStatus(waitForStatus())) {
+                return *myStopReason;
+            }
+        }
+    }
+
+    StopReason Process::interrupt() {
+        while (true) {
+            if (auto myStopReason = handleStatus(waitForStop())) {
+                return *myStopReason;
+            }
+        }
+    }
+
+    std::optional<StopReason> Process::stopForSample() {
+        while (true) {
+            int myStatus = waitForStop();
+            if (WIFSTOPPED(myStatus) and WSTOPSIG(myStatus) == SIGSTOP) {
+                theProcessState = ProcessState::Stopped;
+                if (ptrace(PTRACE_GETREGS, thePid, nullptr,
+                           std::addressof(
+                               theRegisters.getRegisterData().regs)) < 0) {
+                    Error::sendErrno(
+                        "Could not read general-purpose registers");
+                }
+                return std::nullopt;
+            }
+
+            if (auto myStopReason = handleStatus(myStatus)) {
+                return myStopReason;
+            }
+        }
+    }
+
+    void Process::resumeFromSample() {
+        // Unlike resume, a breakpoint at the pc has not been hit yet and
+        // must trap when the process goes on
+        if (resumeWith(getContinueRequest()) < 0) {
+            Error::sendErrno("resume failed\n");
+            std::terminate();
+        }
+
+        theProcessState = ProcessState::Running;
+    }
+
+    int Process::waitForStatus() {
         int myStatus = 0;
         if ((waitpid(thePid, std::addressof(myStatus), 0)) < 0) {
             Error::sendErrno("waitpid failed\n");
             std::terminate();
         }
 
-        StopReason myStopReason(myStatus);
+        return myStatus;
+    }
+
+    std::optional<StopReason> Process::handleStatus(int aStatus) {
+        if (handleSyscallStop(aStatus)) {
+            return std::nullopt;
+        }
+        if (theIsRecordingStep and finishRecordedStep(aStatus)) {
+            return std::nullopt;
+        }
+        if (handleSignalStop(aStatus)) {
+            return std::nullopt;
+        }
+
+        StopReason myStopReason(aStatus);
         theProcessState = myStopReason.theStopState;
+        if ((myStopReason.theSyscall =
+                 std::exchange(theSyscallStop, std::nullopt))) {
+            myStopReason.theStatus = SIGTRAP;
+        }
 
         if (theProcessState == ProcessState::Stopped and theIsAttached) {
+            auto myStopTime = std::chrono::steady_clock::now();
             readAllRegisters();
 
             auto myInstrBegin = getPc() - 1;
             if (myStopReason.theStatus == SIGTRAP and
                 theStoppoints.stoppointEnabledAtAddress(myInstrBegin)) {
                 setPc(myInstrBegin);
+
+                auto& mySite = theStoppoints.getByAddress(myInstrBegin);
+                if (auto* myCondition = mySite.getCondition()) {
+                    MemoryCache myMemory{thePid};
+                    if (!myCondition->evaluate(theRegisters, myMemory)) {
+                        resume();
+                        return std::nullopt;
+                    }
+                }
+
+                // The handler may remove the site, so it is only found
+                // again by its id after the call
+                auto myId = mySite.getId();
+                auto myHandler = mySite.getHitHandler();
+                if (myHandler and myHandler()) {
+                    resume();
+                    if (theStoppoints.contains_id(myId)) {
+                        auto& myOnResume =
+                            theStoppoints.getById(myId).getResumeHandler();
+                        if (myOnResume) {
+                            myOnResume(std::chrono::steady_clock::now() -
+                                       myStopTime);
+                        }
+                    }
+                    return std::nullopt;
+                }
+            } else if (myStopReason.theStatus == SIGTRAP) {
+                // A native condition was true, which is reported as a stop
+                // at the site itself
+                if (auto* mySite = findSiteByTrap(myInstrBegin)) {
+                    mySite->getNativeCondition()->countTrue();
+                    setPc(mySite->getAddress());
+                }
             }
         }
 
+        if (thePerfCounters and !theIsSteppingOver) {
+            thePerfCounters->update();
+        }
+
         return myStopReason;
     }
 
+    int Process::waitForStop() {
+        // Directed at the traced thread only, so threads sdb does not trace
+        // never join a group stop
+        if (syscall(SYS_tgkill, thePid, thePid, SIGSTOP) < 0) {
+            Error::sendErrno("Could not stop process");
+        }
+
+        // The signal is discarded before anything else can resume the
+        // process, or it would stop it again later
+        int myStatus = waitForStatus();
+        if (WIFSTOPPED(myStatus) and WSTOPSIG(myStatus) != SIGSTOP) {
+            discardPendingStop();
+        }
+
+        return myStatus;
+    }
+
+    void Process::discardPendingStop() {
+        std::ifstream myStatusFile(
+            fmt::format("/proc/{}/task/{}/status", thePid, thePid));
+
+        std::uint64_t myPending = 0;
+        std::string myLine;
+        while (std::getline(myStatusFile, myLine)) {
+            if (myLine.starts_with("SigPnd:")) {
+                myPending = std::stoull(myLine.substr(7), nullptr, 16);
+                break;
+            }
+        }
+
+        if (!(myPending & (1ULL << (SIGSTOP - 1)))) {
+            return;
+        }
+
+        // A pending signal is delivered before any instruction runs, so the
+        // step stops at once and suppressing the signal leaves no trace
+        if (ptrace(PTRACE_SINGLESTEP, thePid, nullptr, nullptr) < 0) {
+            Error::sendErrno("Could not discard stop signal");
+        }
+        waitForStatus();
+    }
+
     void Process::resume() {
         stepOverBreakpointIfExists();
 
-        if (ptrace(PTRACE_CONT, thePid, nullptr, nullptr) < 0) {
+        if (theRecorder) {
+            theIsRecordingContinue = true;
+            beginRecordedStep();
+            if (resumeWith(PTRACE_SINGLESTEP) < 0) {
+                Error::sendErrno("resume failed\n");
+            }
+            theProcessState = ProcessState::Running;
+            return;
+        }
+
+        // A caught call stops again when it returns
+        if (resumeWith(theReturningSyscall ? PTRACE_SYSCALL
+                                           : getContinueRequest()) < 0) {
             Error::sendErrno("resume failed\n");
             std::terminate();
         }
@@ -143,13 +449,119 @@ namespace sdb {
         theProcessState = ProcessState::Running;
     }
 
+    long Process::resumeWith(__ptrace_request aRequest) {
+        // Only PTRACE_SYSCALL stops at the return of the caught call, and
+        // later system call stops go on without it
+        if (aRequest != PTRACE_SYSCALL) {
+            theReturningSyscall.reset();
+        }
+        theResumeRequest =
+            aRequest == PTRACE_SYSCALL ? getContinueRequest() : aRequest;
+        theHasRun = true;
+
+        // A step over a breakpoint would run the handler with the
+        // breakpoint removed
+        int mySignal =
+            theIsSteppingOver ? 0 : std::exchange(thePendingSignal, 0);
+        return ptrace(aRequest, thePid, nullptr, mySignal);
+    }
+
+    std::array<SignalPolicy, NSIG> Process::getDefaultSignalPolicies() {
+        std::array<SignalPolicy, NSIG> myPolicies{};
+
+        // The debugger's own, and the user's interrupt
+        for (int mySignal : {SIGTRAP, SIGSTOP, SIGINT}) {
+            myPolicies[mySignal].thePass = false;
+        }
+
+        // Frequent, and part of how a program normally runs
+        for (int mySignal : {SIGALRM, SIGURG, SIGCHLD, SIGWINCH, SIGIO,
+                             SIGVTALRM, SIGPROF}) {
+            myPolicies[mySignal] = SignalPolicy{false, true, false};
+        }
+
+        return myPolicies;
+    }
+
+    void Process::setSignalPolicy(int aSignal, SignalPolicy aPolicy) {
+        if (aSignal <= 0 or aSignal >= NSIG) {
+            Error::send(fmt::format("Invalid signal {}", aSignal));
+        }
+        if ((aSignal == SIGTRAP or aSignal == SIGSTOP) and
+            aPolicy != getDefaultSignalPolicies()[aSignal]) {
+            Error::send(fmt::format("SIG{} is used by the debugger",
+                                    sigabbrev_np(aSignal)));
+        }
+
+        theSignalPolicies[aSignal] = aPolicy;
+    }
+
+    const SignalPolicy& Process::getSignalPolicy(int aSignal) const {
+        if (aSignal <= 0 or aSignal >= NSIG) {
+            Error::send(fmt::format("Invalid signal {}", aSignal));
+        }
+
+        return theSignalPolicies[aSignal];
+    }
+
+    std::uint64_t Process::getSignalCount(int aSignal) const {
+        if (aSignal <= 0 or aSignal >= NSIG) {
+            Error::send(fmt::format("Invalid signal {}", aSignal));
+        }
+
+        return theSignalCounts[aSignal];
+    }
+
+    bool Process::handleSignalStop(int aStatus) {
+        // Not a ptrace event or system call stop, or a trap or stop of the
+        // debugger's own
+        if (!WIFSTOPPED(aStatus) or aStatus >> 16 != 0) {
+            return false;
+        }
+        int mySignal = WSTOPSIG(aStatus);
+        if (mySignal == SIGTRAP or mySignal == SIGSTOP or mySignal >= NSIG) {
+            return false;
+        }
+
+        ++theSignalCounts[mySignal];
+        auto& myPolicy = theSignalPolicies[mySignal];
+        thePendingSignal = myPolicy.thePass ? mySignal : 0;
+
+        // A recording ends at every signal, to see where the handler runs
+        if (myPolicy.theStop or theRecorder) {
+            return false;
+        }
+        if (myPolicy.thePrint and theSignalHandler) {
+            theSignalHandler(mySignal);
+        }
+
+        // A step goes on without the signal, which the next resume
+        // delivers, so it still stops after one instruction
+        int myDelivered = theResumeRequest == PTRACE_SINGLESTEP
+                              ? 0
+                              : std::exchange(thePendingSignal, 0);
+        if (ptrace(theResumeRequest, thePid, nullptr, myDelivered) < 0) {
+            Error::sendErrno("Could not resume from a signal");
+        }
+        return true;
+    }
+
     void Process::stepOverBreakpointIfExists() {
         VirtualAddress myPc = getPc();
+
+        // The jump stays, and the process goes on through the displaced
+        // copy, which jumps back past it
+        if (auto* myNativeSite = findNativeSiteCovering(myPc)) {
+            moveIntoDisplacedCopy(*myNativeSite);
+            return;
+        }
         if (!theStoppoints.stoppointEnabledAtAddress(myPc)) {
             return;
         }
 
+        theIsSteppingOver = true;
         stepInstruction();
+        theIsSteppingOver = false;
     }
 
     pid_t Process::getPid() const {
@@ -181,12 +593,20 @@ namespace sdb {
         BreakpointSite* myBreakpointSite = nullptr;
         VirtualAddress myPc = getPc();
 
-        if (theStoppoints.stoppointEnabledAtAddress(myPc)) {
-            myBreakpointSite = std::addressof(theStoppoints.getByAddress(myPc));
+        // The jump stays, and the step runs the displaced copy of the
+        // instruction in the trampoline instead
+        auto* myNativeSite = findNativeSiteCovering(myPc);
+        if (myNativeSite) {
+            moveIntoDisplacedCopy(*myNativeSite);
+        } else if (theStoppoints.stoppointEnabledAtAddress(myPc)) {
+            myBreakpointSite = &theStoppoints.getByAddress(myPc);
             myBreakpointSite->disable();
         }
 
-        if (ptrace(PTRACE_SINGLESTEP, thePid, nullptr, nullptr) < 0) {
+        if (theRecorder) {
+            beginRecordedStep();
+        }
+        if (resumeWith(PTRACE_SINGLESTEP) < 0) {
             Error::sendErrno("Failed to single step");
         }
 
@@ -194,10 +614,484 @@ namespace sdb {
         if (myBreakpointSite) {
             myBreakpointSite->enable();
         }
+        if (myNativeSite and myReason.theStopState == ProcessState::Stopped) {
+            moveOutOfDisplacedCopy(*myNativeSite);
+        }
 
         return myReason;
     }
 
+    void Process::startRecording(std::size_t aCapacity) {
+        if (theProcessState != ProcessState::Stopped) {
+            Error::send("Recording can only start while stopped");
+        }
+
+        theRecorder = std::make_unique<ExecutionRecorder>(*this, aCapacity);
+    }
+
+    void Process::stopRecording() {
+        theRecorder.reset();
+    }
+
+    void Process::beginRecordedStep() {
+        theRecorder->beginStep(theRegisters.getRegisterData());
+        theIsRecordingStep = true;
+    }
+
+    bool Process::finishRecordedStep(int aStatus) {
+        theIsRecordingStep = false;
+        if (!WIFSTOPPED(aStatus)) {
+            theRecorder->discardStep();
+            theIsRecordingContinue = false;
+            return false;
+        }
+
+        // Only the registers a step can change are read, and the cache is
+        // kept current as the base of the next comparison
+        auto& myOld = theRegisters.getRegisterData();
+        user myNew = myOld;
+        if (ptrace(PTRACE_GETREGS, thePid, nullptr, &myNew.regs) < 0 or
+            ptrace(PTRACE_GETFPREGS, thePid, nullptr, &myNew.i387) < 0) {
+            Error::sendErrno("Could not read registers");
+        }
+
+        // The step ends with a trace trap, or a breakpoint trap after a
+        // system call. An int3, of a breakpoint or the program, is handled
+        // as when running freely, and other signals may come before or
+        // after the instruction.
+        siginfo_t myInfo{};
+        bool myIsStep = WSTOPSIG(aStatus) == SIGTRAP and
+                        ptrace(PTRACE_GETSIGINFO, thePid, nullptr, &myInfo) >=
+                            0 and
+                        (myInfo.si_code == TRAP_TRACE or
+                         myInfo.si_code == TRAP_BRKPT);
+        bool myDidRun = myIsStep or (WSTOPSIG(aStatus) != SIGTRAP and
+                                     myNew.regs.rip != myOld.regs.rip);
+        if (myDidRun) {
+            theRecorder->commitStep(myOld, myNew);
+        } else {
+            theRecorder->discardStep();
+        }
+        myOld.regs = myNew.regs;
+        myOld.i387 = myNew.i387;
+
+        if (theIsRecordingContinue and myIsStep) {
+            beginRecordedStep();
+            if (resumeWith(PTRACE_SINGLESTEP) < 0) {
+                Error::sendErrno("Could not step recorded process");
+            }
+            return true;
+        }
+
+        theIsRecordingContinue = false;
+        return false;
+    }
+
+    StopReason Process::reverseStepInstruction() {
+        if (!theRecorder) {
+            Error::send("The process is not being recorded");
+        }
+        if (theProcessState != ProcessState::Stopped) {
+            Error::send("Can only execute in reverse while stopped");
+        }
+
+        auto& myData = theRegisters.getRegisterData();
+        if (!theRecorder->undoLast(myData)) {
+            Error::send("Reached the start of the recording");
+        }
+        writeGeneralPurposeRegisters(myData.regs);
+        writeFloatingPointRegisters(myData.i387);
+
+        return StopReason{W_STOPCODE(SIGTRAP)};
+    }
+
+    StopReason Process::reverseContinue() {
+        reverseStepInstruction();
+
+        auto& myData = theRegisters.getRegisterData();
+        while (true) {
+            auto myPc = VirtualAddress{myData.regs.rip};
+            if (theStoppoints.stoppointEnabledAtAddress(myPc)) {
+                auto& mySite = theStoppoints.getByAddress(myPc);
+                auto* myCondition = mySite.getCondition();
+                MemoryCache myMemory{thePid};
+                if (!mySite.isInternal() and
+                    (!myCondition or
+                     myCondition->evaluate(theRegisters, myMemory))) {
+                    break;
+                }
+            }
+            if (!theRecorder->undoLast(myData)) {
+                break;
+            }
+        }
+        writeGeneralPurposeRegisters(myData.regs);
+        writeFloatingPointRegisters(myData.i387);
+
+        return StopReason{W_STOPCODE(SIGTRAP)};
+    }
+
+    bool Process::handleSyscallStop(int aStatus) {
+        if (!WIFSTOPPED(aStatus)) {
+            return false;
+        }
+        auto myTime = std::chrono::steady_clock::now();
+
+        // A traced call was handled at its entry stop, which comes before
+        // the seccomp stop of a filtered one
+        bool myIsSeccomp =
+            aStatus >> 8 == (SIGTRAP | (PTRACE_EVENT_SECCOMP << 8));
+        if (myIsSeccomp and theIsTracingSyscalls) {
+            if (ptrace(theResumeRequest, thePid, nullptr, nullptr) < 0) {
+                Error::sendErrno("Could not resume from a system call");
+            }
+            return true;
+        }
+
+        // The call being logged ended, at its exit stop or at the stop of
+        // the step over it
+        if (theSyscallRecorder and theSyscallRecorder->isCapturing()) {
+            user_regs_struct myRegs{};
+            if (ptrace(PTRACE_GETREGS, thePid, nullptr, &myRegs) < 0) {
+                Error::sendErrno("Could not read general-purpose registers");
+            }
+            theSyscallRecorder->finishCall(myRegs);
+        }
+
+        // PTRACE_SYSCALL stops at both ends of every call while tracing,
+        // and otherwise only at the return of a caught or logged one
+        bool myIsTraced = WSTOPSIG(aStatus) == (SIGTRAP | 0x80);
+        if (!myIsTraced and !myIsSeccomp) {
+            return false;
+        }
+        bool myIsEntry =
+            myIsSeccomp or (theIsTracingSyscalls and isSyscallEntry(thePid));
+        bool myIsExit = !myIsEntry;
+
+        user_regs_struct myRegs{};
+        if (ptrace(PTRACE_GETREGS, thePid, nullptr, &myRegs) < 0) {
+            Error::sendErrno("Could not read general-purpose registers");
+        }
+
+        auto myRequest = theResumeRequest;
+        if (myIsExit) {
+            if (auto myNumber =
+                    std::exchange(theReturningSyscall, std::nullopt)) {
+                theSyscallStop =
+                    SyscallStop{*myNumber, false, {},
+                                static_cast<std::int64_t>(myRegs.rax),
+                                myTime};
+                return false;
+            }
+        } else {
+            // Taken before a replay skips the call
+            auto myNumber = myRegs.orig_rax;
+            auto myAction = theSyscallRecorder and
+                                    SyscallRecorder::isLogged(myNumber)
+                                ? theSyscallRecorder->beginCall(myRegs)
+                                : SyscallRecorder::Action::Execute;
+            switch (myAction) {
+                case SyscallRecorder::Action::Diverged: return false;
+                case SyscallRecorder::Action::Replayed:
+                    writeGeneralPurposeRegisters(myRegs);
+                    break;
+                case SyscallRecorder::Action::Capture:
+                    // A step stops right after the call anyway
+                    if (myRequest == PTRACE_CONT) {
+                        myRequest = PTRACE_SYSCALL;
+                    }
+                    break;
+                default: break;
+            }
+
+            // An argument filter is checked again for calls traced without
+            // it
+            std::array<std::uint64_t, 6> myArgs{myRegs.rdi, myRegs.rsi,
+                                                myRegs.rdx, myRegs.r10,
+                                                myRegs.r8,  myRegs.r9};
+            if (theIsCatchingAllSyscalls or
+                (std::ranges::binary_search(theCaughtSyscalls, myNumber) and
+                 (!theCaughtArgumentFilter or
+                  theCaughtArgumentFilter->matches(myArgs)))) {
+                theSyscallStop = SyscallStop{myNumber, true, myArgs, 0,
+                                             myTime};
+                theReturningSyscall = myNumber;
+                return false;
+            }
+        }
+
+        if (ptrace(myRequest, thePid, nullptr, nullptr) < 0) {
+            Error::sendErrno("Could not resume from a system call");
+        }
+        return true;
+    }
+
+    bool SyscallArgumentFilter::matches(
+        const std::array<std::uint64_t, 6>& anArgs) const {
+        auto myValue = static_cast<std::uint32_t>(anArgs[theIndex]) & theMask;
+        return std::ranges::find(theValues, myValue) != theValues.end();
+    }
+
+    void Process::installSyscallFilter(
+        std::span<const std::uint64_t> aNumbers,
+        const std::optional<SyscallArgumentFilter>& anArgumentFilter) {
+        // sdb kills what it launched when it exits, so no filter outlives
+        // it
+        if (!isLaunched(theOrigin)) {
+            Error::send("System calls can only be filtered in processes sdb "
+                        "launched");
+        }
+
+        std::vector<std::uint64_t> myNumbers;
+        std::ranges::copy_if(
+            aNumbers, std::back_inserter(myNumbers),
+            [&](std::uint64_t aNumber) {
+                return !theFilteredSyscalls.contains(aNumber) and
+                       !(anArgumentFilter and
+                         std::ranges::find(
+                             theArgumentFilteredSyscalls,
+                             std::pair{aNumber, *anArgumentFilter}) !=
+                             theArgumentFilteredSyscalls.end());
+            });
+        std::ranges::sort(myNumbers);
+        myNumbers.erase(std::ranges::unique(myNumbers).begin(),
+                        myNumbers.end());
+        if (myNumbers.empty()) {
+            return;
+        }
+
+        // Calls of other architectures are numbered differently and are
+        // let through
+        std::vector<sock_filter> myFilter{
+            BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(seccomp_data, arch)),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_X86_64, 1, 0),
+            BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+            BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(seccomp_data, nr))};
+
+        // Consecutive numbers are tested as one range, so catching every
+        // call takes a few instructions. With an argument filter a match
+        // jumps to the test of the argument after them.
+        sock_filter myMatched = BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRACE);
+        if (anArgumentFilter) {
+            myMatched = BPF_JUMP(BPF_JMP | BPF_JA, 0, 0, 0);
+        }
+        std::vector<std::size_t> myJumps;
+        for (std::size_t i = 0; i < myNumbers.size();) {
+            auto myFirst = static_cast<std::uint32_t>(myNumbers[i]);
+            auto myLast = myFirst;
+            while (++i < myNumbers.size() and myNumbers[i] == myLast + 1) {
+                ++myLast;
+            }
+
+            if (myFirst == myLast) {
+                myFilter.push_back(
+                    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, myFirst, 0, 1));
+            } else {
+                myFilter.push_back(
+                    BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, myFirst, 0, 2));
+                myFilter.push_back(
+                    BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, myLast, 1, 0));
+            }
+            myJumps.push_back(myFilter.size());
+            myFilter.push_back(myMatched);
+        }
+        myFilter.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
+
+        if (anArgumentFilter) {
+            for (auto myJump : myJumps) {
+                myFilter[myJump].k =
+                    static_cast<std::uint32_t>(myFilter.size() - myJump - 1);
+            }
+
+            // The masked low word of the argument, then a jump to the
+            // trace for each value
+            auto& myValues = anArgumentFilter->theValues;
+            if (myValues.size() > 255) {
+                Error::send("Too many argument values to filter");
+            }
+            auto myOffset = offsetof(seccomp_data, args) +
+                            anArgumentFilter->theIndex * sizeof(std::uint64_t);
+            myFilter.push_back(
+                BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+                         static_cast<std::uint32_t>(myOffset)));
+            myFilter.push_back(BPF_STMT(BPF_ALU | BPF_AND | BPF_K,
+                                        anArgumentFilter->theMask));
+            for (std::size_t i = 0; i < myValues.size(); ++i) {
+                myFilter.push_back(BPF_JUMP(
+                    BPF_JMP | BPF_JEQ | BPF_K, myValues[i],
+                    static_cast<std::uint8_t>(myValues.size() - i), 0));
+            }
+            myFilter.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
+            myFilter.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRACE));
+        }
+
+        auto myFilterBytes = std::as_bytes(std::span{myFilter});
+        if (sizeof(sock_fprog) + myFilterBytes.size() > SCRATCH_DATA_SIZE) {
+            Error::send("Too many system calls to filter");
+        }
+
+        // The program is passed in the scratch data, with the filter
+        // after its header
+        auto myData = getScratchData();
+        sock_fprog myProgram{
+            static_cast<unsigned short>(myFilter.size()),
+            reinterpret_cast<sock_filter*>(std::to_underlying(myData) +
+                                           sizeof(sock_fprog))};
+        writeMemory(thePid, myData, std::as_bytes(std::span{&myProgram, 1}));
+        writeMemory(thePid, myData + sizeof(sock_fprog), myFilterBytes);
+
+        theTraceOptions |= PTRACE_O_TRACESECCOMP | PTRACE_O_TRACESYSGOOD;
+        if (ptrace(PTRACE_SETOPTIONS, thePid, nullptr, theTraceOptions) < 0) {
+            Error::sendErrno("Could not trace system calls");
+        }
+
+        // Unprivileged processes need no_new_privs for a filter, so
+        // set-user-ID programs they run no longer gain privileges
+        injectCheckedSyscall(*this, SYS_prctl,
+                             {PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0});
+        injectCheckedSyscall(*this, SYS_seccomp,
+                             {SECCOMP_SET_MODE_FILTER, 0,
+                              std::to_underlying(myData)});
+        if (anArgumentFilter) {
+            for (auto myNumber : myNumbers) {
+                theArgumentFilteredSyscalls.emplace_back(myNumber,
+                                                         *anArgumentFilter);
+            }
+        } else {
+            theFilteredSyscalls.insert(myNumbers.begin(), myNumbers.end());
+        }
+    }
+
+    void Process::setSyscallCatchPolicy(
+        std::vector<std::uint64_t> aNumbers,
+        std::optional<SyscallArgumentFilter> anArgumentFilter) {
+        std::ranges::sort(aNumbers);
+        aNumbers.erase(std::ranges::unique(aNumbers).begin(), aNumbers.end());
+        if (anArgumentFilter and anArgumentFilter->theIndex >= 6) {
+            Error::send("System calls have six arguments");
+        }
+
+        // A filter would outlive sdb in a process it did not launch
+        bool myIsTracing = !aNumbers.empty() and !isLaunched(theOrigin);
+        if (!myIsTracing) {
+            installSyscallFilter(aNumbers, anArgumentFilter);
+        }
+        setSyscallTracing(myIsTracing);
+        theCaughtSyscalls = std::move(aNumbers);
+        theCaughtArgumentFilter = std::move(anArgumentFilter);
+        theIsCatchingAllSyscalls = false;
+    }
+
+    void Process::catchAllSyscalls() {
+        setSyscallTracing(true);
+        theCaughtSyscalls.clear();
+        theCaughtArgumentFilter.reset();
+        theIsCatchingAllSyscalls = true;
+    }
+
+    void Process::setSyscallTracing(bool anIsTracing) {
+        if (anIsTracing and !(theTraceOptions & PTRACE_O_TRACESYSGOOD)) {
+            theTraceOptions |= PTRACE_O_TRACESYSGOOD;
+            if (ptrace(PTRACE_SETOPTIONS, thePid, nullptr, theTraceOptions) <
+                0) {
+                Error::sendErrno("Could not trace system calls");
+            }
+        }
+        theIsTracingSyscalls = anIsTracing;
+    }
+
+    void Process::recordSyscalls(const std::filesystem::path& aPath) {
+        startSyscallLog(SyscallRecorder::Mode::Record, aPath);
+    }
+
+    void Process::replaySyscalls(const std::filesystem::path& aPath) {
+        startSyscallLog(SyscallRecorder::Mode::Replay, aPath);
+    }
+
+    void Process::stopSyscallLog() {
+        theSyscallRecorder.reset();
+    }
+
+    void Process::startSyscallLog(SyscallRecorder::Mode aMode,
+                                  const std::filesystem::path& aPath) {
+        if (theProcessState != ProcessState::Stopped) {
+            Error::send("System calls can only be logged while stopped");
+        }
+
+        if (!isLaunched(theOrigin)) {
+            Error::send("System calls can only be logged in processes sdb "
+                        "launched");
+        }
+
+        theSyscallRecorder.reset();
+        theSyscallRecorder =
+            aMode == SyscallRecorder::Mode::Record
+                ? SyscallRecorder::record(*this, aPath, theHasRun)
+                : SyscallRecorder::replay(*this, aPath, theHasRun);
+
+        try {
+            installSyscallFilter(SyscallRecorder::getSyscalls());
+        } catch (const Error&) {
+            theSyscallRecorder.reset();
+            throw;
+        }
+    }
+
+    BreakpointSite* Process::findSiteByTrap(VirtualAddress anAddress) {
+        BreakpointSite* myFound = nullptr;
+        theStoppoints.forEach([&](BreakpointSite& aSite) {
+            auto* myNative = aSite.getNativeCondition();
+            if (aSite.isEnabled() and myNative and
+                myNative->getTrap() == anAddress) {
+                myFound = &aSite;
+            }
+        });
+
+        return myFound;
+    }
+
+    BreakpointSite* Process::findNativeSiteCovering(VirtualAddress anAddress) {
+        BreakpointSite* myFound = nullptr;
+        theStoppoints.forEach([&](BreakpointSite& aSite) {
+            auto* myNative = aSite.getNativeCondition();
+            if (aSite.isEnabled() and myNative and
+                aSite.getAddress() <= anAddress and
+                anAddress < myNative->getDisplaced().getEnd()) {
+                myFound = &aSite;
+            }
+        });
+
+        return myFound;
+    }
+
+    void Process::moveIntoDisplacedCopy(const BreakpointSite& aSite) {
+        auto* myNative = aSite.getNativeCondition();
+        setPc(myNative->getResume() + (std::to_underlying(getPc()) -
+                                       std::to_underlying(aSite.getAddress())));
+    }
+
+    void Process::moveOutOfDisplacedCopy(const BreakpointSite& aSite) {
+        auto* myNative = aSite.getNativeCondition();
+        auto myPc = getPc();
+
+        // The end of the copy is the jump back to the end of the site
+        auto myCopyEnd = myNative->getResume() +
+                         myNative->getDisplaced().theOriginal.size();
+        if (myNative->getResume() <= myPc and myPc <= myCopyEnd) {
+            setPc(aSite.getAddress() +
+                  (std::to_underlying(myPc) -
+                   std::to_underlying(myNative->getResume())));
+        }
+    }
+
+    CodeArena& Process::getCodeArena() {
+        if (!theCodeArena) {
+            theCodeArena = std::make_unique<CodeArena>(*this);
+        }
+
+        return *theCodeArena;
+    }
+
     void Process::readAllRegisters() {
         auto& myRegisterData = theRegisters.getRegisterData();
         if (ptrace(PTRACE_GETREGS, thePid, nullptr,
@@ -238,17 +1132,370 @@ namespace sdb {
                            std::to_underlying(anAddress));
     }
 
-    BreakpointSite& Process::createBreakpointSite(VirtualAddress anAddress) {
+    BreakpointSite& Process::createBreakpointSite(VirtualAddress anAddress,
+                                                  bool anIsInternal) {
         if (theStoppoints.contains_address(anAddress)) [[unlikely]] {
             Error::send(fmt::format("Trying to create breakpoint at address {}",
                                     std::to_underlying(anAddress)));
         }
 
         return theStoppoints.push(
-            std::make_unique<BreakpointSite>(*this, anAddress));
+            std::make_unique<BreakpointSite>(*this, anAddress, anIsInternal));
+    }
+
+    std::unordered_map<int, std::uint64_t> Process::getAuxv() const {
+        std::ifstream myAuxvFile(fmt::format("/proc/{}/auxv", thePid),
+                                 std::ios::binary);
+        if (!myAuxvFile) {
+            Error::send("Could not open auxiliary vector");
+        }
+
+        std::unordered_map<int, std::uint64_t> myAuxv;
+
+        std::uint64_t myType{};
+        std::uint64_t myValue{};
+        while (myAuxvFile.read(reinterpret_cast<char*>(&myType),
+                               sizeof(myType)) and
+               myType != AT_NULL) {
+            myAuxvFile.read(reinterpret_cast<char*>(&myValue), sizeof(myValue));
+            myAuxv[myType] = myValue;
+        }
+
+        return myAuxv;
+    }
+
+    std::int64_t
+    Process::injectSyscall(std::uint64_t aNumber,
+                           std::initializer_list<std::uint64_t> anArgs) {
+        if (theProcessState != ProcessState::Stopped) {
+            Error::send("System calls can only be injected while stopped");
+        }
+        if (anArgs.size() > 6) {
+            Error::send("A system call takes at most six arguments");
+        }
+        if (theScratch == VirtualAddress{0}) {
+            mapScratch();
+        }
+
+        auto myRegs = theRegisters.getRegisterData().regs;
+        myRegs.rip = std::to_underlying(theScratch);
+        setSyscallRegisters(myRegs, aNumber, anArgs);
+
+        auto myResult = runInjected(myRegs, theScratch + SYSCALL_TRAP);
+        return static_cast<std::int64_t>(myResult.rax);
+    }
+
+    std::uint64_t
+    Process::callFunction(VirtualAddress aFunction,
+                          std::span<const std::uint64_t> anArgs) {
+        if (theProcessState != ProcessState::Stopped) {
+            Error::send("Functions can only be called while stopped");
+        }
+        if (anArgs.size() > 6) {
+            Error::send("Functions can be called with at most six "
+                        "arguments");
+        }
+        if (theScratch == VirtualAddress{0}) {
+            mapScratch();
+        }
+
+        static constexpr std::array myArgRegisters{
+            &user_regs_struct::rdi, &user_regs_struct::rsi,
+            &user_regs_struct::rdx, &user_regs_struct::rcx,
+            &user_regs_struct::r8,  &user_regs_struct::r9};
+
+        // Below the red zone of the interrupted code, with the stack 16 byte
+        // aligned before the return address is pushed
+        auto myRegs = theRegisters.getRegisterData().regs;
+        myRegs.rsp = ((myRegs.rsp - RED_ZONE_SIZE) & ~std::uint64_t{0xf}) -
+                     sizeof(std::uint64_t);
+        auto myReturn = std::to_underlying(theScratch + CALL_TRAP);
+        writeMemory(thePid, VirtualAddress{myRegs.rsp},
+                    std::as_bytes(std::span{&myReturn, 1}));
+
+        myRegs.rip = std::to_underlying(aFunction);
+        myRegs.orig_rax = -1;
+        // The number of vector registers used by a variadic function
+        myRegs.rax = 0;
+        for (std::size_t i = 0; i < anArgs.size(); ++i) {
+            myRegs.*myArgRegisters[i] = anArgs[i];
+        }
+
+        return runInjected(myRegs, theScratch + CALL_TRAP).rax;
+    }
+
+    VirtualAddress Process::getScratchData() {
+        if (theScratch == VirtualAddress{0}) {
+            mapScratch();
+        }
+
+        return theScratch + SCRATCH_CODE_SIZE;
+    }
+
+    const Checkpoint& Process::checkpoint() {
+        if (theProcessState != ProcessState::Stopped) {
+            Error::send("Checkpoints can only be taken while stopped");
+        }
+        if (theScratch == VirtualAddress{0}) {
+            mapScratch();
+        }
+
+        // The snapshot is taken without breakpoints, which are written to
+        // each restarted process as they are then
+        auto myStart = std::chrono::steady_clock::now();
+        std::vector<BreakpointSite*> myEnabled;
+        theStoppoints.forEach([&](BreakpointSite& aSite) {
+            if (aSite.isEnabled()) {
+                myEnabled.push_back(&aSite);
+            }
+        });
+        for (auto* mySite : myEnabled) {
+            mySite->disable();
+        }
+
+        pid_t myChild = 0;
+        try {
+            myChild = forkTracee(thePid, theRegisters.getRegisterData().regs,
+                                 theScratch, theTraceOptions);
+        } catch (const Error&) {
+            for (auto* mySite : myEnabled) {
+                mySite->enable();
+            }
+            throw;
+        }
+        for (auto* mySite : myEnabled) {
+            mySite->enable();
+        }
+
+        theCheckpoints.push_back(
+            Checkpoint{theNextCheckpointId++, myChild,
+                       theRegisters.getRegisterData(),
+                       std::chrono::steady_clock::now() - myStart});
+        return theCheckpoints.back();
+    }
+
+    std::chrono::steady_clock::duration Process::restart(std::size_t anId) {
+        auto myCheckpoint = std::ranges::find(theCheckpoints, anId,
+                                              &Checkpoint::theId);
+        if (myCheckpoint == theCheckpoints.end()) {
+            Error::send(fmt::format("No checkpoint {}", anId));
+        }
+
+        // The checkpoint forks from the scratch code it shares with the
+        // process, and the copy is given the checkpoint's registers
+        auto myStart = std::chrono::steady_clock::now();
+        user_regs_struct myRegs{};
+        if (ptrace(PTRACE_GETREGS, myCheckpoint->thePid, nullptr, &myRegs) <
+            0) {
+            Error::sendErrno("Could not read checkpoint registers");
+        }
+        auto myChild = forkTracee(myCheckpoint->thePid, myRegs, theScratch,
+                                  theTraceOptions | PTRACE_O_EXITKILL);
+        if (ptrace(PTRACE_SETREGS, myChild, nullptr,
+                   &myCheckpoint->theRegisters.regs) < 0 or
+            ptrace(PTRACE_SETFPREGS, myChild, nullptr,
+                   &myCheckpoint->theRegisters.i387) < 0) {
+            killTracee(myChild);
+            Error::sendErrno("Could not restore checkpoint registers");
+        }
+
+        if (theProcessState != ProcessState::Exited and
+            theProcessState != ProcessState::Terminated) {
+            killTracee(thePid);
+        }
+        thePid = myChild;
+        if (theRecorder) {
+            theRecorder->clear();
+        }
+        // The log no longer matches the calls the process makes
+        theSyscallRecorder.reset();
+        thePendingSignal = 0;
+        theOrigin = Origin::LAUNCHED_AND_ATTACHED;
+        theIsAttached = true;
+        theProcessState = ProcessState::Stopped;
+        readAllRegisters();
+
+        // Trampolines mapped after the checkpoint are missing from it, so
+        // native conditions are injected again
+        theCodeArena.reset();
+        theStoppoints.forEach([&](BreakpointSite& aSite) {
+            if (!aSite.isEnabled()) {
+                return;
+            }
+
+            // Writes back the original code the snapshot already has
+            aSite.disable();
+            if (aSite.getNativeCondition()) {
+                aSite.setNativeCondition(*aSite.getCondition());
+            }
+            aSite.enable();
+        });
+
+        thePerfCounters = PerfCounters::open(thePid);
+        return std::chrono::steady_clock::now() - myStart;
+    }
+
+    void Process::deleteCheckpoint(std::size_t anId) {
+        auto myCheckpoint = std::ranges::find(theCheckpoints, anId,
+                                              &Checkpoint::theId);
+        if (myCheckpoint == theCheckpoints.end()) {
+            Error::send(fmt::format("No checkpoint {}", anId));
+        }
+
+        killTracee(myCheckpoint->thePid);
+        theCheckpoints.erase(myCheckpoint);
+    }
+
+    void Process::mapScratch() {
+        auto myScratch = injectSyscallAtPc(
+            SYS_mmap, {0, SCRATCH_CODE_SIZE + SCRATCH_DATA_SIZE,
+                       PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                       static_cast<std::uint64_t>(-1), 0});
+        if (myScratch < 0 and myScratch >= -4095) {
+            Error::send(fmt::format("Could not map scratch memory: {}",
+                                    std::strerror(static_cast<int>(
+                                        -myScratch))));
+        }
+
+        auto myAddress = static_cast<std::uint64_t>(myScratch);
+        writeMemory(thePid, VirtualAddress{myAddress}, SCRATCH_CODE);
+        auto myProtected = injectSyscallAtPc(
+            SYS_mprotect,
+            {myAddress, SCRATCH_CODE_SIZE, PROT_READ | PROT_EXEC});
+        if (myProtected < 0) {
+            Error::send(fmt::format("Could not protect scratch code: {}",
+                                    std::strerror(static_cast<int>(
+                                        -myProtected))));
+        }
+
+        theScratch = VirtualAddress{myAddress};
+    }
+
+    user_regs_struct Process::runInjected(const user_regs_struct& aRegs,
+                                          VirtualAddress aReturn) {
+        auto mySaved = theRegisters.getRegisterData();
+        writeGeneralPurposeRegisters(aRegs);
+
+        user_regs_struct myRegs{};
+        std::vector<int> myDeferred;
+        std::optional<int> myFault;
+        while (true) {
+            if (ptrace(PTRACE_CONT, thePid, nullptr, nullptr) < 0) {
+                Error::sendErrno("Could not run injected code");
+            }
+
+            int myStatus = waitForStatus();
+            if (!WIFSTOPPED(myStatus)) {
+                theProcessState = StopReason{myStatus}.theStopState;
+                Error::send("Process ended during injected code");
+            }
+            // Filtered system calls the injected code makes are run as they
+            // are, without being logged
+            if (myStatus >> 16 == PTRACE_EVENT_SECCOMP) {
+                continue;
+            }
+            if (ptrace(PTRACE_GETREGS, thePid, nullptr, &myRegs) < 0) {
+                Error::sendErrno("Could not read general-purpose registers");
+            }
+
+            auto mySignal = WSTOPSIG(myStatus);
+            auto myTrap = VirtualAddress{myRegs.rip - 1};
+            if (mySignal == SIGTRAP and myTrap == aReturn) {
+                break;
+            }
+
+            // A true native condition goes on from the trap by itself,
+            // and a breakpoint is stepped over
+            if (mySignal == SIGTRAP and findSiteByTrap(myTrap)) {
+                continue;
+            }
+            if (mySignal == SIGTRAP and
+                theStoppoints.stoppointEnabledAtAddress(myTrap)) {
+                auto& mySite = theStoppoints.getByAddress(myTrap);
+                myRegs.rip = std::to_underlying(myTrap);
+                writeGeneralPurposeRegisters(myRegs);
+                mySite.disable();
+                if (ptrace(PTRACE_SINGLESTEP, thePid, nullptr, nullptr) < 0) {
+                    Error::sendErrno("Could not step over breakpoint");
+                }
+                myStatus = waitForStatus();
+                mySite.enable();
+                if (!WIFSTOPPED(myStatus)) {
+                    theProcessState = StopReason{myStatus}.theStopState;
+                    Error::send("Process ended during injected code");
+                }
+                continue;
+            }
+
+            if (isFault(mySignal)) {
+                myFault = mySignal;
+                break;
+            }
+            myDeferred.push_back(mySignal);
+        }
+
+        writeGeneralPurposeRegisters(mySaved.regs);
+        writeFloatingPointRegisters(mySaved.i387);
+        for (auto mySignal : myDeferred) {
+            syscall(SYS_tgkill, thePid, thePid, mySignal);
+        }
+
+        if (myFault) {
+            Error::send(fmt::format("Injected code stopped with {} at {:#x}",
+                                    sigabbrev_np(*myFault), myRegs.rip));
+        }
+
+        return myRegs;
+    }
+
+    std::int64_t
+    Process::injectSyscallAtPc(std::uint64_t aNumber,
+                               std::initializer_list<std::uint64_t> anArgs) {
+        static constexpr std::array mySyscall{std::byte{0x0f},
+                                              std::byte{0x05}};
+
+        auto mySaved = theRegisters.getRegisterData().regs;
+        auto myPc = VirtualAddress{mySaved.rip};
+        auto mySavedCode = readMemory(thePid, myPc, mySyscall.size());
+        writeMemory(thePid, myPc, mySyscall);
+
+        auto myRegs = mySaved;
+        setSyscallRegisters(myRegs, aNumber, anArgs);
+        writeGeneralPurposeRegisters(myRegs);
+
+        if (ptrace(PTRACE_SINGLESTEP, thePid, nullptr, nullptr) < 0) {
+            Error::sendErrno("Could not run injected system call: ");
+        }
+
+        int myStatus = waitForStatus();
+        if (!WIFSTOPPED(myStatus)) {
+            theProcessState = StopReason{myStatus}.theStopState;
+            Error::send("Process ended during an injected system call");
+        }
+
+        bool myIsDone = WSTOPSIG(myStatus) == SIGTRAP;
+        if (myIsDone and
+            ptrace(PTRACE_GETREGS, thePid, nullptr, &myRegs) < 0) {
+            Error::sendErrno("Could not read general-purpose registers");
+        }
+
+        writeMemory(thePid, myPc, mySavedCode);
+        writeGeneralPurposeRegisters(mySaved);
+
+        if (!myIsDone) {
+            Error::send(fmt::format("Injected system call was interrupted by "
+                                    "{}",
+                                    sigabbrev_np(WSTOPSIG(myStatus))));
+        }
+
+        return static_cast<std::int64_t>(myRegs.rax);
     }
 
     Process::~Process() {
+        for (auto& myCheckpoint : theCheckpoints) {
+            killTracee(myCheckpoint.thePid);
+        }
+
         if (thePid == 0) {
             return;
         }
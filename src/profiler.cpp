@@ -0,0 +1,94 @@
+#include <profiler.hpp>
+
+#include <algorithm>
+#include <fmt/format.h>
+#include <functional>
+#include <string>
+#include <target.hpp>
+#include <thread>
+
+namespace sdb {
+
+    std::size_t Profiler::StackHash::operator()(const Stack& aStack) const {
+        std::size_t mySeed = aStack.size();
+        for (auto myAddress : aStack) {
+            mySeed ^= std::hash<std::uint64_t>{}(myAddress) + 0x9e3779b9 +
+                      (mySeed << 6) + (mySeed >> 2);
+        }
+
+        return mySeed;
+    }
+
+    StopReason Profiler::run(std::chrono::steady_clock::duration aDuration) {
+        using std::chrono::steady_clock;
+
+        auto& myProcess = theTarget.getProcess();
+        auto myPeriod = std::chrono::duration_cast<steady_clock::duration>(
+            std::chrono::duration<double>{1.0 / std::max(theFrequency, 1u)});
+
+        myProcess.resume();
+
+        auto myNow = steady_clock::now();
+        auto myDeadline = myNow + aDuration;
+        for (auto myNext = myNow + myPeriod; myNext < myDeadline;
+             myNext += myPeriod) {
+            std::this_thread::sleep_until(myNext);
+
+            auto myStart = steady_clock::now();
+            if (auto myStopReason = myProcess.stopForSample()) {
+                return *myStopReason;
+            }
+            takeSample();
+            myProcess.resumeFromSample();
+            myNow = steady_clock::now();
+            thePauses.push_back(myNow - myStart);
+
+            // Ticks missed while the debugger was descheduled are dropped
+            // rather than taken back to back
+            if (myNext + myPeriod < myNow) {
+                myNext = myNow;
+            }
+        }
+
+        return myProcess.interrupt();
+    }
+
+    void Profiler::takeSample() {
+        Stack myStack;
+        for (auto& myFrame : theTarget.backtrace(MAX_FRAMES)) {
+            myStack.push_back(std::to_underlying(myFrame.getCallSite()));
+        }
+        if (myStack.empty()) {
+            return;
+        }
+
+        ++theStacks[std::move(myStack)];
+    }
+
+    void Profiler::writeFoldedStacks(std::ostream& aStream) const {
+        std::unordered_map<std::uint64_t, std::string> myNames;
+        auto myGetName = [&](std::uint64_t anAddress) -> const std::string& {
+            auto [myIt, myIsNew] = myNames.try_emplace(anAddress);
+            if (myIsNew) {
+                auto myLocation =
+                    theTarget.symbolize(VirtualAddress{anAddress});
+                myIt->second = myLocation ? std::string{myLocation->theName}
+                                          : fmt::format("{:#x}", anAddress);
+            }
+            return myIt->second;
+        };
+
+        for (auto& [myStack, myCount] : theStacks) {
+            std::string myLine;
+            for (auto myIt = myStack.rbegin(); myIt != myStack.rend(); ++myIt) {
+                if (!myLine.empty()) {
+                    myLine += ';';
+                }
+                myLine += myGetName(*myIt);
+            }
+
+            aStream << myLine << ' ' << myCount << '\n';
+        }
+    }
+
+} // namespace sdb
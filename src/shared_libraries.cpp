@@ -0,0 +1,222 @@
+#include <shared_libraries.hpp>
+
+#include <algorithm>
+#include <error.hpp>
+#include <filesystem>
+#include <limits.h>
+#include <link.h>
+#include <memory_cache.hpp>
+#include <process.hpp>
+
+namespace sdb {
+
+    namespace {
+        // Guards against walking a corrupted list forever
+        constexpr std::size_t MAX_LINK_MAPS{1 << 16};
+
+        std::string readString(MemoryCache& aCache, VirtualAddress anAddress) {
+            std::string myResult;
+            while (myResult.size() < PATH_MAX) {
+                auto myChar = aCache.read<char>(anAddress + myResult.size());
+                if (!myChar or *myChar == '\0') {
+                    break;
+                }
+                myResult.push_back(*myChar);
+            }
+
+            return myResult;
+        }
+
+        std::uint64_t toAddress(const void* aPointer) {
+            return reinterpret_cast<std::uint64_t>(aPointer);
+        }
+    } // namespace
+
+    SharedLibraryTracker::SharedLibraryTracker(Process& aProcess,
+                                               const ElfFile& anExecutable,
+                                               std::uint64_t aLoadBias,
+                                               LoadCallback anOnLoad)
+        : theProcess{aProcess}, theOnLoad{std::move(anOnLoad)} {
+        auto* myDynamic = anExecutable.getSection(".dynamic");
+        if (myDynamic == nullptr or
+            anExecutable.getSection(".interp") == nullptr) {
+            return;
+        }
+
+        theDynamicAddress = VirtualAddress{myDynamic->sh_addr + aLoadBias};
+        theDynamicSize = myDynamic->sh_size;
+
+        MemoryCache myCache{theProcess.getPid()};
+        if (startTracking(myCache)) {
+            return;
+        }
+
+        // The dynamic linker fills in DT_DEBUG before it runs the program,
+        // so a freshly launched process is picked up at its entry point
+        auto myEntry =
+            VirtualAddress{anExecutable.getHeader().e_entry + aLoadBias};
+        auto& mySite = theProcess.createBreakpointSite(myEntry, true);
+        mySite.setHitHandler([this, myEntry]() { return onEntry(myEntry); });
+        mySite.enable();
+    }
+
+    const SharedLibrary* SharedLibraryTracker::findLibraryContainingAddress(
+        VirtualAddress anAddress) const {
+        auto myIt = std::ranges::find_if(theLibraries, [&](auto& aLibrary) {
+            return aLibrary->contains(anAddress);
+        });
+
+        return myIt == theLibraries.end() ? nullptr : myIt->get();
+    }
+
+    std::optional<VirtualAddress>
+    SharedLibraryTracker::findRendezvous(MemoryCache& aCache) {
+        for (std::size_t i = 0; i < theDynamicSize / sizeof(Elf64_Dyn); ++i) {
+            auto myEntry = aCache.read<Elf64_Dyn>(theDynamicAddress +
+                                                  i * sizeof(Elf64_Dyn));
+            if (!myEntry or myEntry->d_tag == DT_NULL) {
+                break;
+            }
+
+            if (myEntry->d_tag == DT_DEBUG and myEntry->d_un.d_ptr != 0) {
+                return VirtualAddress{myEntry->d_un.d_ptr};
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    bool SharedLibraryTracker::startTracking(MemoryCache& aCache) {
+        auto myRendezvous = findRendezvous(aCache);
+        if (!myRendezvous) {
+            return false;
+        }
+
+        auto myDebug = aCache.read<r_debug>(*myRendezvous);
+        if (!myDebug or myDebug->r_brk == 0) {
+            return false;
+        }
+
+        theRendezvous = myRendezvous;
+
+        auto myBreakAddress = VirtualAddress{myDebug->r_brk};
+        auto& mySites = theProcess.getBreakpointSites();
+        if (!mySites.contains_address(myBreakAddress)) {
+            auto& mySite =
+                theProcess.createBreakpointSite(myBreakAddress, true);
+            mySite.setHitHandler([this]() { return onRendezvousBreakpoint(); });
+            mySite.enable();
+        }
+
+        update(aCache);
+        return true;
+    }
+
+    bool SharedLibraryTracker::onEntry(VirtualAddress anEntry) {
+        auto& mySites = theProcess.getBreakpointSites();
+        auto& mySite = mySites.getByAddress(anEntry);
+        mySite.disable();
+        mySites.removeById(mySite.getId());
+
+        MemoryCache myCache{theProcess.getPid()};
+        startTracking(myCache);
+
+        return true;
+    }
+
+    bool SharedLibraryTracker::onRendezvousBreakpoint() {
+        MemoryCache myCache{theProcess.getPid()};
+
+        // Each change is announced before the list is modified and again
+        // once it is consistent; only the latter is worth reading
+        auto myDebug = myCache.read<r_debug>(*theRendezvous);
+        if (myDebug and myDebug->r_state == r_debug::RT_CONSISTENT) {
+            update(myCache);
+        }
+
+        return true;
+    }
+
+    void SharedLibraryTracker::update(MemoryCache& aCache) {
+        ++theNumUpdates;
+
+        auto myDebug = aCache.read<r_debug>(*theRendezvous);
+        if (!myDebug) {
+            return;
+        }
+
+        std::unordered_set<std::uint64_t> myPresent;
+        auto myNode = toAddress(myDebug->r_map);
+        while (myNode != 0 and myPresent.size() < MAX_LINK_MAPS) {
+            auto myEntry = aCache.read<link_map>(VirtualAddress{myNode});
+            if (!myEntry or !myPresent.insert(myNode).second) {
+                break;
+            }
+
+            if (theKnownLinkMaps.insert(myNode).second) {
+                auto myPath = readString(
+                    aCache, VirtualAddress{toAddress(myEntry->l_name)});
+                auto myLibrary =
+                    load(VirtualAddress{myNode}, std::move(myPath),
+                         myEntry->l_addr);
+
+                if (myLibrary) {
+                    theLibraries.push_back(std::move(myLibrary));
+                    if (theOnLoad) {
+                        theOnLoad(*theLibraries.back());
+                    }
+                }
+            }
+
+            myNode = toAddress(myEntry->l_next);
+        }
+
+        std::erase_if(theKnownLinkMaps, [&](std::uint64_t aNode) {
+            return !myPresent.contains(aNode);
+        });
+        std::erase_if(theLibraries, [&](auto& aLibrary) {
+            return !myPresent.contains(
+                std::to_underlying(aLibrary->theLinkMap));
+        });
+    }
+
+    std::unique_ptr<SharedLibrary>
+    SharedLibraryTracker::load(VirtualAddress aLinkMap, std::string aPath,
+                               std::uint64_t aLoadBias) const {
+        // The executable has an empty name and the vDSO has no file
+        if (aPath.empty() or !std::filesystem::exists(aPath)) {
+            return nullptr;
+        }
+
+        auto myLibrary = std::make_unique<SharedLibrary>();
+        myLibrary->thePath = std::move(aPath);
+        myLibrary->theLinkMap = aLinkMap;
+        myLibrary->theLoadBias = aLoadBias;
+
+        try {
+            myLibrary->theElf = std::make_unique<ElfFile>(myLibrary->thePath);
+        } catch (const Error&) {
+            return nullptr;
+        }
+
+        std::uint64_t myBegin = UINT64_MAX;
+        std::uint64_t myEnd = 0;
+        for (auto& mySegment : myLibrary->theElf->getProgramHeaders()) {
+            if (mySegment.p_type == PT_LOAD) {
+                myBegin = std::min(myBegin, mySegment.p_vaddr);
+                myEnd = std::max(myEnd, mySegment.p_vaddr + mySegment.p_memsz);
+            }
+        }
+        if (myBegin >= myEnd) {
+            return nullptr;
+        }
+
+        myLibrary->theBegin = myLibrary->toVirtualAddress(myBegin);
+        myLibrary->theEnd = myLibrary->toVirtualAddress(myEnd);
+        myLibrary->theCallFrameInfo =
+            std::make_unique<CallFrameInfo>(*myLibrary->theElf);
+
+        return myLibrary;
+    }
+
+} // namespace sdb
@@ -0,0 +1,171 @@
+#include <syscall_profiler.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <fmt/format.h>
+#include <mutex>
+#include <signal.h>
+#include <stop_token>
+#include <string>
+#include <sys/syscall.h>
+#include <syscalls.hpp>
+#include <thread>
+#include <unistd.h>
+
+namespace sdb {
+
+    namespace {
+        // Calls whose first argument is a file descriptor
+        constexpr std::uint64_t FD_SYSCALLS[]{
+            SYS_read, SYS_write, SYS_close, SYS_fstat, SYS_lseek, SYS_ioctl,
+            SYS_pread64, SYS_pwrite64, SYS_readv, SYS_writev, SYS_sendfile,
+            SYS_connect, SYS_accept, SYS_sendto, SYS_recvfrom, SYS_sendmsg,
+            SYS_recvmsg, SYS_shutdown, SYS_bind, SYS_listen, SYS_getsockname,
+            SYS_getpeername, SYS_setsockopt, SYS_getsockopt, SYS_fcntl,
+            SYS_flock, SYS_fsync, SYS_fdatasync, SYS_ftruncate, SYS_getdents64,
+            SYS_fadvise64, SYS_epoll_wait, SYS_epoll_ctl, SYS_splice,
+            SYS_sync_file_range, SYS_epoll_pwait, SYS_fallocate, SYS_accept4,
+            SYS_preadv, SYS_pwritev, SYS_recvmmsg, SYS_sendmmsg, SYS_preadv2,
+            SYS_pwritev2, SYS_io_uring_enter};
+    } // namespace
+
+    SyscallProfiler::Key
+    SyscallProfiler::getKey(const SyscallStop& aStop) const {
+        Key myKey{aStop.theNumber, std::nullopt};
+        if (theIsPerFd and
+            std::ranges::find(FD_SYSCALLS, aStop.theNumber) !=
+                std::ranges::end(FD_SYSCALLS)) {
+            myKey.theFd = static_cast<std::int32_t>(aStop.theArgs[0]);
+        }
+
+        return myKey;
+    }
+
+    StopReason runCatchingSyscalls(
+        Process& aProcess, std::vector<std::uint64_t> aNumbers,
+        std::chrono::steady_clock::duration aDuration,
+        const SyscallStopHandler& aHandler, LatencyHistogram& anOverhead,
+        std::optional<SyscallArgumentFilter> anArgumentFilter) {
+        using std::chrono::steady_clock;
+
+        auto myCaught = aProcess.getCaughtSyscalls();
+        auto myCaughtFilter = aProcess.getCaughtArgumentFilter();
+        auto myIsCatchingAll = aProcess.isCatchingAllSyscalls();
+        if (aNumbers.empty()) {
+            aProcess.catchAllSyscalls();
+        } else {
+            aProcess.setSyscallCatchPolicy(std::move(aNumbers),
+                                           std::move(anArgumentFilter));
+        }
+
+        std::atomic<bool> myIsTimeUp{false};
+        std::optional<StopReason> myReason;
+        {
+            // Stops the process when the time is up, even if it is blocked
+            // in a call or never makes one
+            std::jthread myTimer([&myIsTimeUp, myPid = aProcess.getPid(),
+                                  myDeadline = steady_clock::now() + aDuration](
+                                     std::stop_token aToken) {
+                std::mutex myMutex;
+                std::condition_variable_any myWakeUp;
+                std::unique_lock myLock{myMutex};
+                myWakeUp.wait_until(myLock, aToken, myDeadline,
+                                    [] { return false; });
+                if (!aToken.stop_requested()) {
+                    myIsTimeUp = true;
+                    syscall(SYS_tgkill, myPid, myPid, SIGSTOP);
+                }
+            });
+
+            aProcess.resume();
+            auto myResumed = steady_clock::now();
+            while (true) {
+                myReason = aProcess.waitOnSignal();
+                if (!myReason->theSyscall) {
+                    break;
+                }
+
+                auto& myStop = *myReason->theSyscall;
+                aHandler(myStop, myResumed);
+
+                aProcess.resume();
+                myResumed = steady_clock::now();
+                anOverhead.record(myResumed - myStop.theTime);
+            }
+        }
+
+        // The timer went off as the process stopped for something else
+        if (myIsTimeUp and myReason->theStopState == ProcessState::Stopped and
+            myReason->theStatus != SIGSTOP) {
+            aProcess.discardPendingStop();
+        }
+        if (myIsCatchingAll) {
+            aProcess.catchAllSyscalls();
+        } else {
+            aProcess.setSyscallCatchPolicy(std::move(myCaught),
+                                           std::move(myCaughtFilter));
+        }
+
+        return *myReason;
+    }
+
+    StopReason
+    SyscallProfiler::run(std::chrono::steady_clock::duration aDuration) {
+        using std::chrono::steady_clock;
+
+        std::optional<Key> myPending;
+        auto myStart = steady_clock::now();
+        auto myReason = runCatchingSyscalls(
+            theProcess, theNumbers, aDuration,
+            [&](const SyscallStop& aStop, steady_clock::time_point aResumed) {
+                if (aStop.theIsEntry) {
+                    myPending = getKey(aStop);
+                } else if (myPending and
+                           myPending->theNumber == aStop.theNumber) {
+                    auto& myStats = theStats[*myPending];
+                    myStats.theLatencies.record(aStop.theTime - aResumed);
+                    if (aStop.theResult < 0 and aStop.theResult >= -4095) {
+                        ++myStats.theNumErrors;
+                    }
+                    myPending.reset();
+                }
+            },
+            theOverhead);
+        theRunTime = steady_clock::now() - myStart;
+
+        return myReason;
+    }
+
+    void SyscallProfiler::writeTable(std::ostream& aStream) const {
+        std::vector<const std::pair<const Key, Stats>*> myRows;
+        for (auto& myRow : theStats) {
+            myRows.push_back(&myRow);
+        }
+        std::ranges::stable_sort(myRows, [](auto* aLeft, auto* aRight) {
+            return aLeft->second.theLatencies.getTotal() >
+                   aRight->second.theLatencies.getTotal();
+        });
+
+        aStream << fmt::format("{:<20} {:>5} {:>9} {:>7} {:>10} {:>10} "
+                               "{:>10} {:>10}\n",
+                               "syscall", "fd", "calls", "errors", "total",
+                               "p50", "p99", "max");
+        for (auto* myRow : myRows) {
+            auto& [myKey, myStats] = *myRow;
+            auto& myLatencies = myStats.theLatencies;
+            auto myName = getSyscallName(myKey.theNumber);
+            aStream << fmt::format(
+                "{:<20} {:>5} {:>9} {:>7} {:>10} {:>10} {:>10} {:>10}\n",
+                myName ? std::string{*myName}
+                       : fmt::format("{}", myKey.theNumber),
+                myKey.theFd ? fmt::format("{}", *myKey.theFd) : "",
+                myLatencies.getCount(), myStats.theNumErrors,
+                formatLatency(myLatencies.getTotal()),
+                formatLatency(myLatencies.getQuantile(0.5)),
+                formatLatency(myLatencies.getQuantile(0.99)),
+                formatLatency(myLatencies.getMax()));
+        }
+    }
+
+} // namespace sdb
@@ -0,0 +1,389 @@
+#include <syscall_recorder.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <error.hpp>
+#include <fmt/format.h>
+#include <memory_operations.hpp>
+#include <optional>
+#include <poll.h>
+#include <process.hpp>
+#include <sys/auxv.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/sysinfo.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+
+namespace sdb {
+
+    namespace {
+        constexpr std::uint64_t LOGGED_SYSCALLS[]{
+            SYS_read,       SYS_pread64,     SYS_readv,
+            SYS_preadv,     SYS_recvfrom,    SYS_poll,
+            SYS_ppoll,      SYS_epoll_wait,  SYS_epoll_pwait,
+            SYS_getrandom,  SYS_clock_gettime,
+            SYS_gettimeofday, SYS_time,      SYS_sysinfo};
+
+        // Written in the flags of the header
+        constexpr std::uint8_t VDSO_HIDDEN{1};
+
+        constexpr std::uint64_t MAX_IOVECS{1024};
+
+        // Results that make the kernel run the call again, which is
+        // logged then
+        bool isRestart(std::int64_t aResult) {
+            return aResult <= -512 and aResult >= -516;
+        }
+
+        struct Output {
+            std::uint64_t theAddress;
+            std::size_t theSize;
+        };
+
+        // The memory the call wrote given its arguments and result
+        std::vector<Output> getOutputs(pid_t aPid,
+                                       const user_regs_struct& aRegisters,
+                                       std::int64_t aResult) {
+            std::vector<Output> myOutputs;
+            if (aResult < 0) {
+                return myOutputs;
+            }
+
+            auto myResult = static_cast<std::size_t>(aResult);
+            auto myAdd = [&](std::uint64_t anAddress, std::size_t aSize) {
+                if (anAddress != 0 and aSize != 0) {
+                    myOutputs.push_back({anAddress, aSize});
+                }
+            };
+
+            switch (aRegisters.orig_rax) {
+                case SYS_read:
+                case SYS_pread64: myAdd(aRegisters.rsi, myResult); break;
+                case SYS_getrandom: myAdd(aRegisters.rdi, myResult); break;
+                case SYS_readv:
+                case SYS_preadv: {
+                    auto myCount =
+                        std::min<std::uint64_t>(aRegisters.rdx, MAX_IOVECS);
+                    auto myBytes =
+                        readMemory(aPid, VirtualAddress{aRegisters.rsi},
+                                   myCount * sizeof(iovec));
+                    for (std::size_t i = 0; i < myCount and myResult > 0;
+                         ++i) {
+                        iovec myVector;
+                        std::memcpy(&myVector, &myBytes[i * sizeof(iovec)],
+                                    sizeof(myVector));
+                        auto mySize = std::min(myVector.iov_len, myResult);
+                        myAdd(reinterpret_cast<std::uint64_t>(
+                                  myVector.iov_base),
+                              mySize);
+                        myResult -= mySize;
+                    }
+                    break;
+                }
+                case SYS_recvfrom: {
+                    myAdd(aRegisters.rsi, myResult);
+                    if (aRegisters.r8 != 0 and aRegisters.r9 != 0) {
+                        socklen_t myLength = 0;
+                        auto myBytes = readMemory(
+                            aPid, VirtualAddress{aRegisters.r9},
+                            sizeof(myLength));
+                        std::memcpy(&myLength, myBytes.data(),
+                                    sizeof(myLength));
+                        myAdd(aRegisters.r9, sizeof(myLength));
+                        myAdd(aRegisters.r8,
+                              std::min<std::size_t>(
+                                  myLength, sizeof(sockaddr_storage)));
+                    }
+                    break;
+                }
+                case SYS_poll:
+                case SYS_ppoll:
+                    myAdd(aRegisters.rdi, aRegisters.rsi * sizeof(pollfd));
+                    break;
+                case SYS_epoll_wait:
+                case SYS_epoll_pwait:
+                    myAdd(aRegisters.rsi, myResult * sizeof(epoll_event));
+                    break;
+                case SYS_clock_gettime:
+                    myAdd(aRegisters.rsi, sizeof(timespec));
+                    break;
+                case SYS_gettimeofday:
+                    myAdd(aRegisters.rdi, sizeof(timeval));
+                    myAdd(aRegisters.rsi, sizeof(struct timezone));
+                    break;
+                case SYS_time:
+                    myAdd(aRegisters.rdi, sizeof(time_t));
+                    break;
+                case SYS_sysinfo:
+                    myAdd(aRegisters.rdi, sizeof(struct sysinfo));
+                    break;
+                default: break;
+            }
+
+            return myOutputs;
+        }
+
+        // Turns the vDSO's entry in the auxiliary vector on the stack of a
+        // process that has not run yet into one the loader ignores, so the
+        // C library makes real system calls for the clocks. /proc still
+        // shows the vector the kernel wrote.
+        void hideVdso(Process& aProcess) {
+            auto myPid = aProcess.getPid();
+            auto myAddress =
+                aProcess.getRegisters().getRegisterData().regs.rsp;
+            auto myReadWord = [&] {
+                auto myBytes = readMemory(myPid, VirtualAddress{myAddress},
+                                          sizeof(std::uint64_t));
+                std::uint64_t myWord;
+                std::memcpy(&myWord, myBytes.data(), sizeof(myWord));
+                myAddress += sizeof(myWord);
+                return myWord;
+            };
+
+            // argc, then argv and the environment, each ending with null
+            auto myArgc = myReadWord();
+            myAddress += (myArgc + 1) * sizeof(std::uint64_t);
+            while (myReadWord() != 0) {
+            }
+
+            while (true) {
+                auto myType = myReadWord();
+                if (myType == AT_NULL) {
+                    break;
+                }
+                if (myType == AT_SYSINFO_EHDR) {
+                    std::uint64_t myIgnore = AT_IGNORE;
+                    writeMemory(myPid,
+                                VirtualAddress{myAddress -
+                                               sizeof(std::uint64_t)},
+                                std::as_bytes(std::span{&myIgnore, 1}));
+                }
+                myAddress += sizeof(std::uint64_t);
+            }
+        }
+
+        // The most the call can return given its arguments, for calls whose
+        // result is a count of what they wrote
+        std::optional<std::uint64_t>
+        getMaxResult(const user_regs_struct& aRegisters) {
+            switch (aRegisters.orig_rax) {
+                case SYS_read:
+                case SYS_pread64:
+                case SYS_recvfrom:
+                case SYS_epoll_wait:
+                case SYS_epoll_pwait: return aRegisters.rdx;
+                case SYS_getrandom:
+                case SYS_poll:
+                case SYS_ppoll: return aRegisters.rsi;
+                default: return std::nullopt;
+            }
+        }
+
+        template <typename T>
+        void writeValue(std::ofstream& aFile, const T& aValue) {
+            aFile.write(reinterpret_cast<const char*>(&aValue), sizeof(T));
+        }
+
+        template <typename T>
+        T readValue(std::ifstream& aFile) {
+            T myValue{};
+            if (!aFile.read(reinterpret_cast<char*>(&myValue), sizeof(T))) {
+                Error::send("Saved system call log is truncated");
+            }
+            return myValue;
+        }
+    } // namespace
+
+    std::span<const std::uint64_t> SyscallRecorder::getSyscalls() {
+        return LOGGED_SYSCALLS;
+    }
+
+    bool SyscallRecorder::isLogged(std::uint64_t aNumber) {
+        return std::ranges::find(LOGGED_SYSCALLS, aNumber) !=
+               std::ranges::end(LOGGED_SYSCALLS);
+    }
+
+    std::unique_ptr<SyscallRecorder>
+    SyscallRecorder::record(Process& aProcess,
+                            const std::filesystem::path& aPath,
+                            bool aHasRun) {
+        auto myRecorder = std::unique_ptr<SyscallRecorder>(
+            new SyscallRecorder(aProcess, Mode::Record, aPath, !aHasRun));
+
+        auto& myFile = myRecorder->theFile;
+        myFile.open(aPath, std::ios::binary);
+        if (!myFile) {
+            Error::send(fmt::format("Could not open {}", aPath.string()));
+        }
+        myFile.write(FILE_MAGIC.data(), FILE_MAGIC.size());
+        writeValue(myFile, FILE_VERSION);
+        writeValue(myFile, static_cast<std::uint8_t>(aHasRun ? 0
+                                                             : VDSO_HIDDEN));
+
+        if (!aHasRun) {
+            hideVdso(aProcess);
+        }
+        return myRecorder;
+    }
+
+    std::unique_ptr<SyscallRecorder>
+    SyscallRecorder::replay(Process& aProcess,
+                            const std::filesystem::path& aPath,
+                            bool aHasRun) {
+        std::ifstream myFile{aPath, std::ios::binary};
+        if (!myFile) {
+            Error::send(fmt::format("Could not open {}", aPath.string()));
+        }
+
+        std::string myMagic(FILE_MAGIC.size(), '\0');
+        myFile.read(myMagic.data(), myMagic.size());
+        if (myMagic != FILE_MAGIC or
+            readValue<std::uint32_t>(myFile) != FILE_VERSION) {
+            Error::send(fmt::format("{} is not a system call log saved by "
+                                    "this version of sdb",
+                                    aPath.string()));
+        }
+
+        bool myIsVdsoHidden = readValue<std::uint8_t>(myFile) & VDSO_HIDDEN;
+        if (myIsVdsoHidden and aHasRun) {
+            Error::send("The log was recorded from the start of the process "
+                        "and must be replayed from there");
+        }
+
+        auto myRecorder = std::unique_ptr<SyscallRecorder>(new SyscallRecorder(
+            aProcess, Mode::Replay, aPath, myIsVdsoHidden));
+        while (myFile.peek() != std::ifstream::traits_type::eof()) {
+            Call myCall;
+            myCall.theNumber = readValue<std::uint16_t>(myFile);
+            myCall.theResult = readValue<std::int64_t>(myFile);
+            myCall.theOutputs.resize(readValue<std::uint8_t>(myFile));
+            for (auto& myOutput : myCall.theOutputs) {
+                myOutput.resize(readValue<std::uint32_t>(myFile));
+                if (!myFile.read(reinterpret_cast<char*>(myOutput.data()),
+                                 myOutput.size())) {
+                    Error::send("Saved system call log is truncated");
+                }
+            }
+            myRecorder->theCalls.push_back(std::move(myCall));
+        }
+
+        if (myIsVdsoHidden) {
+            hideVdso(aProcess);
+        }
+        return myRecorder;
+    }
+
+    SyscallRecorder::~SyscallRecorder() {
+        flush();
+    }
+
+    void SyscallRecorder::flush() {
+        if (theFile.is_open()) {
+            theFile.flush();
+        }
+    }
+
+    SyscallRecorder::Action
+    SyscallRecorder::beginCall(user_regs_struct& aRegisters) {
+        if (theMode == Mode::Record) {
+            theCapture = aRegisters;
+            return Action::Capture;
+        }
+        if (theDivergence) {
+            return Action::Execute;
+        }
+
+        if (theNextCall == theCalls.size()) {
+            theDivergence = fmt::format(
+                "System call {} was made after the {} logged",
+                aRegisters.orig_rax, theCalls.size());
+            return Action::Diverged;
+        }
+
+        auto& myCall = theCalls[theNextCall];
+        if (aRegisters.orig_rax != myCall.theNumber) {
+            theDivergence = fmt::format(
+                "Call {} of the log is system call {}, but the process made "
+                "system call {}",
+                theNextCall, myCall.theNumber, aRegisters.orig_rax);
+            return Action::Diverged;
+        }
+
+        auto myMaxResult = getMaxResult(aRegisters);
+        if (myMaxResult and myCall.theResult > 0 and
+            static_cast<std::uint64_t>(myCall.theResult) > *myMaxResult) {
+            theDivergence = fmt::format(
+                "Call {} of the log returned {}, but the process passed {}",
+                theNextCall, myCall.theResult, *myMaxResult);
+            return Action::Diverged;
+        }
+
+        // The sizes come from the process's arguments, so the log cannot
+        // write past its buffers
+        auto myOutputs =
+            getOutputs(theProcess.getPid(), aRegisters, myCall.theResult);
+        if (myOutputs.size() != myCall.theOutputs.size()) {
+            theDivergence = fmt::format(
+                "Call {} of the log wrote {} buffers, but the process passed "
+                "{}",
+                theNextCall, myCall.theOutputs.size(), myOutputs.size());
+            return Action::Diverged;
+        }
+        for (std::size_t i = 0; i < myOutputs.size(); ++i) {
+            if (myCall.theOutputs[i].size() != myOutputs[i].theSize) {
+                theDivergence = fmt::format(
+                    "Call {} of the log wrote {} bytes to buffer {}, but the "
+                    "process's buffer takes {}",
+                    theNextCall, myCall.theOutputs[i].size(), i,
+                    myOutputs[i].theSize);
+                return Action::Diverged;
+            }
+        }
+
+        for (std::size_t i = 0; i < myOutputs.size(); ++i) {
+            writeMemory(theProcess.getPid(),
+                        VirtualAddress{myOutputs[i].theAddress},
+                        myCall.theOutputs[i]);
+            theNumBytes += myCall.theOutputs[i].size();
+        }
+
+        // Skipped by the kernel, which returns what is in rax
+        aRegisters.orig_rax = -1;
+        aRegisters.rax = static_cast<std::uint64_t>(myCall.theResult);
+        ++theNextCall;
+        ++theNumCalls;
+        return Action::Replayed;
+    }
+
+    void SyscallRecorder::finishCall(const user_regs_struct& aRegisters) {
+        auto myEntry = *theCapture;
+        theCapture.reset();
+
+        auto myResult = static_cast<std::int64_t>(aRegisters.rax);
+        if (isRestart(myResult)) {
+            return;
+        }
+
+        auto myOutputs = getOutputs(theProcess.getPid(), myEntry, myResult);
+        writeValue(theFile, static_cast<std::uint16_t>(myEntry.orig_rax));
+        writeValue(theFile, myResult);
+        writeValue(theFile, static_cast<std::uint8_t>(myOutputs.size()));
+        for (auto& myOutput : myOutputs) {
+            auto myBytes = readMemory(theProcess.getPid(),
+                                      VirtualAddress{myOutput.theAddress},
+                                      myOutput.theSize);
+            writeValue(theFile, static_cast<std::uint32_t>(myBytes.size()));
+            theFile.write(reinterpret_cast<const char*>(myBytes.data()),
+                          myBytes.size());
+            theNumBytes += myBytes.size();
+        }
+        ++theNumCalls;
+
+        if (!theFile) {
+            Error::send(fmt::format("Could not write {}", thePath.string()));
+        }
+    }
+
+} // namespace sdb
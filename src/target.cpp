@@ -0,0 +1,319 @@
+#include <target.hpp>
+
+#include <algorithm>
+#include <bit.hpp>
+#include <error.hpp>
+#include <fmt/format.h>
+#include <memory_cache.hpp>
+#include <memory_operations.hpp>
+
+#include <fnmatch.h>
+#include <sys/auxv.h>
+
+namespace sdb {
+
+    std::unique_ptr<Target>
+    Target::launch(const std::filesystem::path& aPath,
+                   std::optional<int> aStdoutReplacement) {
+        auto myElf = std::make_unique<ElfFile>(aPath);
+        auto myProcess = Process::launch(aPath, true, aStdoutReplacement);
+
+        return std::unique_ptr<Target>(
+            new Target(std::move(myProcess), std::move(myElf)));
+    }
+
+    std::unique_ptr<Target> Target::attach(pid_t aPid) {
+        auto myElf = std::make_unique<ElfFile>(
+            std::filesystem::path{fmt::format("/proc/{}/exe", aPid)});
+        auto myProcess = Process::attach(aPid);
+
+        return std::unique_ptr<Target>(
+            new Target(std::move(myProcess), std::move(myElf)));
+    }
+
+    Target::Target(std::unique_ptr<Process> aProcess,
+                   std::unique_ptr<ElfFile> anElf)
+        : theProcess{std::move(aProcess)}, theElf{std::move(anElf)},
+          theCallFrameInfo{std::make_unique<CallFrameInfo>(*theElf)},
+          theTracer{std::make_unique<Tracer>(*theProcess)},
+          theFunctionTracer{std::make_unique<FunctionTracer>(*theProcess)},
+          theHeapProfiler{std::make_unique<HeapProfiler>(*this)} {
+        loadIndexes();
+
+        auto myAuxv = theProcess->getAuxv();
+
+        auto myEntry = myAuxv.find(AT_ENTRY);
+        if (myEntry == myAuxv.end()) {
+            Error::send("Could not find entry point in auxiliary vector");
+        }
+
+        theLoadBias = myEntry->second - theElf->getHeader().e_entry;
+
+        theJitInterface = std::make_unique<JitInterface>(
+            *theProcess, [this](const JitObject& anObject) {
+                resolvePendingBreakpoints(*anObject.theElf, 0);
+            });
+        theJitInterface->watch(*theElf, theLoadBias);
+
+        theSharedLibraries = std::make_unique<SharedLibraryTracker>(
+            *theProcess, *theElf, theLoadBias,
+            [this](const SharedLibrary& aLibrary) {
+                theJitInterface->watch(*aLibrary.theElf,
+                                       aLibrary.theLoadBias);
+                resolvePendingBreakpoints(*aLibrary.theElf,
+                                          aLibrary.theLoadBias);
+            });
+    }
+
+    void Target::loadIndexes() {
+        auto myStart = std::chrono::steady_clock::now();
+
+        theIndexCache = IndexCache::load(*theElf);
+        if (theIndexCache) {
+            theElf->setSymbolIndex(theIndexCache->getSymbols(),
+                                   theIndexCache->getNameIndex());
+            theDwarf = std::make_unique<Dwarf>(
+                *theElf, theIndexCache->getCompileUnits(*theElf),
+                theIndexCache->getUnitRanges(),
+                theIndexCache->getFunctionIndex(*theElf));
+        } else {
+            // The symbol index is finished here so the indexing thread only
+            // ever reads it when storing the cache
+            theElf->getNameIndex();
+            theDwarf = std::make_unique<Dwarf>(
+                *theElf, [this](const Dwarf& aDwarf) {
+                    IndexCache::store(*theElf, aDwarf);
+                });
+        }
+
+        theIndexLoadTime = std::chrono::steady_clock::now() - myStart;
+    }
+
+    std::optional<SymbolLocation>
+    Target::symbolize(VirtualAddress anAddress) const {
+        const ElfFile* myElf = theElf.get();
+        auto myFileAddress = toFileAddress(anAddress);
+
+        if (auto* myLibrary =
+                theSharedLibraries->findLibraryContainingAddress(anAddress)) {
+            myElf = myLibrary->theElf.get();
+            myFileAddress = myLibrary->toFileAddress(anAddress);
+        } else if (auto* myObject =
+                       theJitInterface->findObjectContainingAddress(
+                           anAddress)) {
+            myElf = myObject->theElf.get();
+            myFileAddress = std::to_underlying(anAddress);
+        }
+
+        auto* mySymbol = myElf->getSymbolContainingAddress(myFileAddress);
+        if (mySymbol == nullptr) {
+            return std::nullopt;
+        }
+
+        return SymbolLocation{myElf->getSymbolName(*mySymbol),
+                              myFileAddress - mySymbol->theAddress};
+    }
+
+    std::string Target::getFunctionName(VirtualAddress anAddress,
+                                        bool anIsReturnAddress) const {
+        auto myLocation =
+            symbolize(anIsReturnAddress ? anAddress - 1 : anAddress);
+        return myLocation ? std::string{myLocation->theName}
+                          : fmt::format("{:#x}", std::to_underlying(anAddress));
+    }
+
+    std::vector<VirtualAddress>
+    Target::findSymbolAddresses(std::string_view aName) const {
+        std::vector<VirtualAddress> myResult;
+        for (auto* mySymbol : theElf->getSymbolsByName(aName)) {
+            myResult.push_back(toVirtualAddress(mySymbol->theAddress));
+        }
+
+        if (myResult.empty()) {
+            for (auto* myFunction : theDwarf->findFunctions(aName)) {
+                myResult.push_back(toVirtualAddress(myFunction->theLow));
+            }
+        }
+
+        if (myResult.empty()) {
+            for (auto& myLibrary : theSharedLibraries->getLibraries()) {
+                auto& myElf = *myLibrary->theElf;
+                for (auto* mySymbol : myElf.getSymbolsByName(aName)) {
+                    myResult.push_back(
+                        myLibrary->toVirtualAddress(mySymbol->theAddress));
+                }
+            }
+        }
+
+        if (myResult.empty()) {
+            theJitInterface->forEachObject([&](const JitObject& anObject) {
+                auto& myElf = *anObject.theElf;
+                for (auto* mySymbol : myElf.getSymbolsByName(aName)) {
+                    myResult.push_back(VirtualAddress{mySymbol->theAddress});
+                }
+            });
+        }
+
+        return myResult;
+    }
+
+    std::vector<std::pair<std::string, VirtualAddress>>
+    Target::findPltStubs(std::span<const std::string> anIncludes,
+                         std::span<const std::string> anExcludes,
+                         bool anIsWithLibraries) const {
+        auto myMatches = [](std::span<const std::string> aGlobs,
+                            std::string_view aName) {
+            std::string myName{aName};
+            return std::ranges::any_of(aGlobs, [&](const std::string& aGlob) {
+                return fnmatch(aGlob.c_str(), myName.c_str(), 0) == 0;
+            });
+        };
+
+        std::vector<std::pair<std::string, VirtualAddress>> myResult;
+        auto myAddStubs = [&](const ElfFile& anElf, std::uint64_t aLoadBias) {
+            for (auto& myStub : anElf.getPltStubs()) {
+                if ((!anIncludes.empty() and
+                     !myMatches(anIncludes, myStub.theName)) or
+                    myMatches(anExcludes, myStub.theName)) {
+                    continue;
+                }
+
+                myResult.emplace_back(
+                    fmt::format("{}@plt", myStub.theName),
+                    VirtualAddress{myStub.theAddress + aLoadBias});
+            }
+        };
+
+        myAddStubs(*theElf, theLoadBias);
+        if (anIsWithLibraries) {
+            for (auto& myLibrary : theSharedLibraries->getLibraries()) {
+                myAddStubs(*myLibrary->theElf, myLibrary->theLoadBias);
+            }
+        }
+
+        return myResult;
+    }
+
+    void Target::addPendingBreakpoint(std::string aName) {
+        thePendingBreakpoints.push_back(std::move(aName));
+    }
+
+    void Target::resolvePendingBreakpoints(const ElfFile& anElf,
+                                           std::uint64_t aLoadBias) {
+        std::erase_if(thePendingBreakpoints, [&](const std::string& aName) {
+            auto mySymbols = anElf.getSymbolsByName(aName);
+            for (auto* mySymbol : mySymbols) {
+                auto myAddress =
+                    VirtualAddress{mySymbol->theAddress + aLoadBias};
+                if (!theProcess->getBreakpointSites().contains_address(
+                        myAddress)) {
+                    theProcess->createBreakpointSite(myAddress).enable();
+                }
+            }
+
+            return !mySymbols.empty();
+        });
+    }
+
+    const CfiRow* Target::findCallFrameRow(VirtualAddress anAddress) const {
+        if (auto* myLibrary =
+                theSharedLibraries->findLibraryContainingAddress(anAddress)) {
+            return myLibrary->theCallFrameInfo->findRow(
+                myLibrary->toFileAddress(anAddress));
+        }
+
+        return theCallFrameInfo->findRow(toFileAddress(anAddress));
+    }
+
+    std::optional<SourceLocation>
+    Target::getSourceLocation(VirtualAddress anAddress) const {
+        return theDwarf->getSourceLocation(toFileAddress(anAddress));
+    }
+
+    std::vector<VirtualAddress>
+    Target::findLineAddresses(std::string_view aFile,
+                              std::uint32_t aLine) const {
+        std::vector<VirtualAddress> myResult;
+        for (auto myFileAddress : theDwarf->getLineAddresses(aFile, aLine)) {
+            myResult.push_back(toVirtualAddress(myFileAddress));
+        }
+
+        return myResult;
+    }
+
+    StopReason Target::runToAddress(VirtualAddress anAddress) {
+        auto& myStoppoints = theProcess->getBreakpointSites();
+
+        BreakpointSite* myTemporarySite = nullptr;
+        if (!myStoppoints.contains_address(anAddress)) {
+            myTemporarySite =
+                std::addressof(theProcess->createBreakpointSite(anAddress));
+            myTemporarySite->enable();
+        }
+
+        theProcess->resume();
+        auto myReason = theProcess->waitOnSignal();
+
+        if (myTemporarySite) {
+            if (myReason.theStopState == ProcessState::Stopped) {
+                myTemporarySite->disable();
+            }
+            myStoppoints.removeById(myTemporarySite->getId());
+        }
+
+        return myReason;
+    }
+
+    StopReason Target::stepSourceLine() {
+        auto myStart = getSourceLocation(theProcess->getPc());
+        if (!myStart) {
+            return theProcess->stepInstruction();
+        }
+
+        while (true) {
+            auto myReason = theProcess->stepInstruction();
+            if (myReason.theStopState != ProcessState::Stopped) {
+                return myReason;
+            }
+
+            auto myPc = theProcess->getPc();
+            auto myLocation = getSourceLocation(myPc);
+
+            if (!myLocation) {
+                // We most likely just followed a call, so the return address
+                // is on top of the stack. Only trust it if it leads back
+                // into code we have line information for.
+                auto myRsp = std::get<std::uint64_t>(
+                    theProcess->getRegisters().read(
+                        findRegisterById(RegisterId::rsp)));
+                auto myReturnAddress = VirtualAddress{fromBytes<std::uint64_t>(
+                    readMemory(theProcess->getPid(), VirtualAddress{myRsp}, 8)
+                        .data())};
+
+                if (!getSourceLocation(myReturnAddress)) {
+                    return myReason;
+                }
+
+                myReason = runToAddress(myReturnAddress);
+                if (theProcess->getPc() != myReturnAddress) {
+                    return myReason;
+                }
+
+                myPc = myReturnAddress;
+                myLocation = getSourceLocation(myPc);
+            }
+
+            bool myIsNewLine = myLocation->theLine != myStart->theLine or
+                               myLocation->theFile != myStart->theFile;
+            if (myIsNewLine and myLocation->theAddress == toFileAddress(myPc)) {
+                return myReason;
+            }
+        }
+    }
+
+    std::vector<StackFrame> Target::backtrace(std::size_t aMaxFrames) const {
+        MemoryCache myCache{theProcess->getPid()};
+        return Unwinder{*this, myCache}.unwind(aMaxFrames);
+    }
+
+} // namespace sdb
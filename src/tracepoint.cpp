@@ -0,0 +1,511 @@
+#include <tracepoint.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <error.hpp>
+#include <fast_tracepoint.hpp>
+#include <fmt/format.h>
+#include <fmt/ranges.h>
+#include <fstream>
+#include <process.hpp>
+#include <register_write.hpp>
+#include <sys/uio.h>
+
+namespace sdb {
+
+    namespace {
+        std::string_view trim(std::string_view aText) {
+            auto myBegin = aText.find_first_not_of(' ');
+            if (myBegin == std::string_view::npos) {
+                return {};
+            }
+
+            return aText.substr(myBegin,
+                                aText.find_last_not_of(' ') - myBegin + 1);
+        }
+
+        // Only full 64 bit registers, which are what addresses live in
+        const RegisterInfo* findGeneralPurposeRegister(std::string_view aName) {
+            auto myIt = std::ranges::find_if(
+                g_register_infos, [&](const RegisterInfo& anInfo) {
+                    return anInfo.theName == aName and
+                           anInfo.theRegisterType == RegisterType::gpr;
+                });
+
+            return myIt == std::end(g_register_infos) ? nullptr : myIt;
+        }
+
+        std::size_t getMaxRecordSize(const Tracepoint& aTracepoint) {
+            std::size_t mySize = 0;
+            for (auto& myCapture : aTracepoint.theCaptures) {
+                mySize += myCapture.theSize
+                              ? sizeof(std::uint32_t) + *myCapture.theSize
+                              : sizeof(std::uint64_t);
+            }
+
+            return mySize;
+        }
+
+        std::uint64_t getMonotonicTime() {
+            timespec myTime;
+            clock_gettime(CLOCK_MONOTONIC, &myTime);
+            return static_cast<std::uint64_t>(myTime.tv_sec) * 1'000'000'000 +
+                   myTime.tv_nsec;
+        }
+
+        template <typename T>
+        void writeValue(std::ofstream& aFile, const T& aValue) {
+            aFile.write(reinterpret_cast<const char*>(&aValue), sizeof(T));
+        }
+
+        template <typename T>
+        T readValue(std::ifstream& aFile) {
+            T myValue{};
+            if (!aFile.read(reinterpret_cast<char*>(&myValue), sizeof(T))) {
+                Error::send("Saved trace is truncated");
+            }
+            return myValue;
+        }
+
+        struct CaptureValue {
+            const TraceCapture* theCapture;
+            std::uint64_t theValue;
+            std::span<const std::byte> theBytes;
+        };
+
+        std::vector<CaptureValue>
+        decodeCaptures(const Tracepoint& aTracepoint,
+                       std::span<const std::byte> aPayload) {
+            std::vector<CaptureValue> myValues;
+            std::size_t myOffset = 0;
+            for (auto& myCapture : aTracepoint.theCaptures) {
+                CaptureValue myValue{&myCapture, 0, {}};
+                if (!myCapture.theSize) {
+                    if (myOffset + sizeof(std::uint64_t) > aPayload.size()) {
+                        break;
+                    }
+                    std::memcpy(&myValue.theValue, &aPayload[myOffset],
+                                sizeof(std::uint64_t));
+                    myOffset += sizeof(std::uint64_t);
+                } else {
+                    std::uint32_t myLength = 0;
+                    if (myOffset + sizeof(myLength) > aPayload.size()) {
+                        break;
+                    }
+                    std::memcpy(&myLength, &aPayload[myOffset],
+                                sizeof(myLength));
+                    myOffset += sizeof(myLength);
+                    myLength = std::min<std::size_t>(
+                        myLength, aPayload.size() - myOffset);
+
+                    myValue.theBytes = aPayload.subspan(myOffset, myLength);
+                    std::memcpy(&myValue.theValue, myValue.theBytes.data(),
+                                std::min<std::size_t>(myLength,
+                                                      sizeof(std::uint64_t)));
+                    myOffset += myLength;
+                }
+                myValues.push_back(myValue);
+            }
+
+            return myValues;
+        }
+
+        std::string formatBytes(std::span<const std::byte> aBytes) {
+            return fmt::format("[{:02x}]", fmt::join(aBytes, " "));
+        }
+
+        std::string formatString(std::span<const std::byte> aBytes) {
+            auto* myChars = reinterpret_cast<const char*>(aBytes.data());
+            return std::string{myChars,
+                               std::find(myChars, myChars + aBytes.size(),
+                                         '\0')};
+        }
+    } // namespace
+
+    std::optional<TraceCapture> TraceCapture::parse(std::string_view aSpec) {
+        TraceCapture myCapture;
+        myCapture.theSpec = std::string{trim(aSpec)};
+
+        std::string_view mySpec = myCapture.theSpec;
+        if (!mySpec.starts_with('[')) {
+            myCapture.theRegister = findGeneralPurposeRegister(mySpec);
+            if (!myCapture.theRegister) {
+                return std::nullopt;
+            }
+            return myCapture;
+        }
+
+        auto myComma = mySpec.find(',');
+        if (!mySpec.ends_with(']') or myComma == std::string_view::npos) {
+            return std::nullopt;
+        }
+
+        auto mySize = toIntegral<std::uint32_t>(
+            trim(mySpec.substr(myComma + 1, mySpec.size() - myComma - 2)));
+        if (!mySize or *mySize == 0) {
+            return std::nullopt;
+        }
+        myCapture.theSize = *mySize;
+
+        auto myLocation = trim(mySpec.substr(1, myComma - 1));
+        if (auto myAddress = toIntegral<std::uint64_t>(myLocation)) {
+            myCapture.theOffset = *myAddress;
+            return myCapture;
+        }
+
+        auto myPlus = myLocation.find('+');
+        myCapture.theRegister =
+            findGeneralPurposeRegister(trim(myLocation.substr(0, myPlus)));
+        if (!myCapture.theRegister) {
+            return std::nullopt;
+        }
+
+        if (myPlus != std::string_view::npos) {
+            auto myOffset =
+                toIntegral<std::uint64_t>(trim(myLocation.substr(myPlus + 1)));
+            if (!myOffset) {
+                return std::nullopt;
+            }
+            myCapture.theOffset = *myOffset;
+        }
+
+        return myCapture;
+    }
+
+    bool TraceBuffer::push(const TraceRecordHeader& aHeader,
+                           std::span<const std::byte> aPayload) {
+        auto myNeeded = sizeof(aHeader) + aPayload.size();
+        if (myNeeded > theData.size()) {
+            ++theNumDropped;
+            return false;
+        }
+
+        while (theData.size() - theUsed < myNeeded) {
+            TraceRecordHeader myOldest;
+            copyOut(theBegin, std::as_writable_bytes(std::span{&myOldest, 1}));
+
+            auto myOldestSize = sizeof(myOldest) + myOldest.theSize;
+            theBegin = (theBegin + myOldestSize) % theData.size();
+            theUsed -= myOldestSize;
+            --theNumRecords;
+            ++theNumDropped;
+        }
+
+        auto myEnd = theBegin + theUsed;
+        copyIn(myEnd, std::as_bytes(std::span{&aHeader, 1}));
+        copyIn(myEnd + sizeof(aHeader), aPayload);
+
+        theUsed += myNeeded;
+        ++theNumRecords;
+        return true;
+    }
+
+    void TraceBuffer::copyIn(std::size_t anOffset,
+                             std::span<const std::byte> aBytes) {
+        anOffset %= theData.size();
+        auto myFirst = std::min(aBytes.size(), theData.size() - anOffset);
+        std::memcpy(theData.data() + anOffset, aBytes.data(), myFirst);
+        std::memcpy(theData.data(), aBytes.data() + myFirst,
+                    aBytes.size() - myFirst);
+    }
+
+    void TraceBuffer::copyOut(std::size_t anOffset,
+                              std::span<std::byte> aBytes) const {
+        anOffset %= theData.size();
+        auto myFirst = std::min(aBytes.size(), theData.size() - anOffset);
+        std::memcpy(aBytes.data(), theData.data() + anOffset, myFirst);
+        std::memcpy(aBytes.data() + myFirst, theData.data(),
+                    aBytes.size() - myFirst);
+    }
+
+    const Tracepoint& Tracer::add(VirtualAddress anAddress,
+                                  std::vector<TraceCapture> aCaptures) {
+        if (theProcess.getBreakpointSites().contains_address(anAddress)) {
+            Error::send(fmt::format("A breakpoint is already set at {:#x}",
+                                    std::to_underlying(anAddress)));
+        }
+
+        auto& myTracepoint = *theTracepoints.emplace_back(
+            std::make_unique<Tracepoint>(Tracepoint{
+                static_cast<std::uint32_t>(theTracepoints.size() + 1),
+                anAddress, std::move(aCaptures)}));
+        theScratch.resize(
+            std::max(theScratch.size(), getMaxRecordSize(myTracepoint)));
+
+        auto& mySite = theProcess.createBreakpointSite(anAddress, true);
+        mySite.setHitHandler(
+            [this, &myTracepoint]() { return onHit(myTracepoint); });
+        mySite.setResumeHandler(
+            [this](std::chrono::steady_clock::duration aLatency) {
+                onResume(aLatency);
+            });
+        mySite.enable();
+
+        return myTracepoint;
+    }
+
+    Tracer::Tracer(Process& aProcess, std::size_t aBufferBytes)
+        : theProcess{aProcess}, theBuffer{aBufferBytes} {
+    }
+
+    Tracer::~Tracer() = default;
+
+    const Tracepoint& Tracer::addFast(VirtualAddress anAddress,
+                                      std::vector<TraceCapture> aCaptures) {
+        if (theProcess.getBreakpointSites().contains_address(anAddress)) {
+            Error::send(fmt::format("A breakpoint is already set at {:#x}",
+                                    std::to_underlying(anAddress)));
+        }
+
+        if (!theFastTracer) {
+            theFastTracer = std::make_unique<FastTracer>(
+                theProcess, theBuffer.getCapacity());
+        }
+
+        auto myTracepoint = std::make_unique<Tracepoint>(Tracepoint{
+            static_cast<std::uint32_t>(theTracepoints.size() + 1), anAddress,
+            std::move(aCaptures), 0, true});
+        theFastTracer->install(*myTracepoint);
+
+        return *theTracepoints.emplace_back(std::move(myTracepoint));
+    }
+
+    void Tracer::collect() {
+        if (!theFastTracer) {
+            return;
+        }
+
+        auto myDropped = theFastTracer->collect(
+            [this](const TraceRecordHeader& aHeader,
+                   std::span<const std::byte> aPayload) {
+                // Ids count up from one in the order tracepoints were added
+                if (aHeader.theTracepoint - 1 < theTracepoints.size()) {
+                    ++theTracepoints[aHeader.theTracepoint - 1]->theNumHits;
+                }
+                theBuffer.push(aHeader, aPayload);
+            });
+        theBuffer.addDropped(myDropped);
+    }
+
+    bool Tracer::onHit(Tracepoint& aTracepoint) {
+        ++aTracepoint.theNumHits;
+
+        auto& myRegisters = theProcess.getRegisters();
+        std::size_t mySize = 0;
+        for (auto& myCapture : aTracepoint.theCaptures) {
+            std::uint64_t myValue = 0;
+            if (myCapture.theRegister) {
+                myValue = std::get<std::uint64_t>(
+                    myRegisters.read(*myCapture.theRegister));
+            }
+
+            if (!myCapture.theSize) {
+                std::memcpy(theScratch.data() + mySize, &myValue,
+                            sizeof(myValue));
+                mySize += sizeof(myValue);
+                continue;
+            }
+
+            // Straight into the scratch buffer; an unreadable range is
+            // recorded as empty rather than failing the hit
+            iovec myLocal{theScratch.data() + mySize + sizeof(std::uint32_t),
+                          *myCapture.theSize};
+            iovec myRemote{
+                reinterpret_cast<void*>(myValue + myCapture.theOffset),
+                *myCapture.theSize};
+            auto myRead =
+                process_vm_readv(theProcess.getPid(), &myLocal, 1, &myRemote,
+                                 1, 0);
+
+            auto myLength = static_cast<std::uint32_t>(std::max<ssize_t>(
+                myRead, 0));
+            std::memcpy(theScratch.data() + mySize, &myLength,
+                        sizeof(myLength));
+            mySize += sizeof(myLength) + myLength;
+        }
+
+        theBuffer.push(
+            TraceRecordHeader{aTracepoint.theId,
+                              static_cast<std::uint32_t>(mySize),
+                              getMonotonicTime()},
+            std::span<const std::byte>{theScratch.data(), mySize});
+        return true;
+    }
+
+    void Tracer::onResume(std::chrono::steady_clock::duration aLatency) {
+        ++theNumResumes;
+        theTotalLatency += aLatency;
+        theMaxLatency = std::max(theMaxLatency, aLatency);
+    }
+
+    void Tracer::save(const std::filesystem::path& aPath) const {
+        std::ofstream myFile{aPath, std::ios::binary};
+        if (!myFile) {
+            Error::send(fmt::format("Could not open {}", aPath.string()));
+        }
+
+        myFile.write(FILE_MAGIC.data(), FILE_MAGIC.size());
+        writeValue(myFile, FILE_VERSION);
+
+        writeValue(myFile,
+                   static_cast<std::uint32_t>(theTracepoints.size()));
+        for (auto& myTracepoint : theTracepoints) {
+            writeValue(myFile, myTracepoint->theId);
+            writeValue(myFile, std::to_underlying(myTracepoint->theAddress));
+            writeValue(myFile, myTracepoint->theNumHits);
+            writeValue(myFile, static_cast<std::uint32_t>(
+                                   myTracepoint->theCaptures.size()));
+            for (auto& myCapture : myTracepoint->theCaptures) {
+                writeValue(myFile, static_cast<std::uint32_t>(
+                                       myCapture.theSpec.size()));
+                myFile.write(myCapture.theSpec.data(),
+                             myCapture.theSpec.size());
+            }
+        }
+
+        writeValue(myFile, theBuffer.getNumDropped());
+        writeValue(myFile,
+                   static_cast<std::uint64_t>(theBuffer.getNumRecords()));
+        writeValue(myFile, static_cast<std::uint64_t>(theBuffer.getUsed()));
+        theBuffer.forEach([&](const TraceRecordHeader& aHeader,
+                              std::span<const std::byte> aPayload) {
+            writeValue(myFile, aHeader);
+            myFile.write(reinterpret_cast<const char*>(aPayload.data()),
+                         aPayload.size());
+        });
+
+        if (!myFile) {
+            Error::send(fmt::format("Could not write {}", aPath.string()));
+        }
+    }
+
+    TraceFile loadTrace(const std::filesystem::path& aPath) {
+        std::ifstream myFile{aPath, std::ios::binary};
+        if (!myFile) {
+            Error::send(fmt::format("Could not open {}", aPath.string()));
+        }
+
+        std::string myMagic(Tracer::FILE_MAGIC.size(), '\0');
+        myFile.read(myMagic.data(), myMagic.size());
+        if (myMagic != Tracer::FILE_MAGIC or
+            readValue<std::uint32_t>(myFile) != Tracer::FILE_VERSION) {
+            Error::send(fmt::format("{} is not a trace saved by this version "
+                                    "of sdb",
+                                    aPath.string()));
+        }
+
+        std::vector<Tracepoint> myTracepoints(readValue<std::uint32_t>(myFile));
+        for (auto& myTracepoint : myTracepoints) {
+            myTracepoint.theId = readValue<std::uint32_t>(myFile);
+            myTracepoint.theAddress =
+                VirtualAddress{readValue<std::uint64_t>(myFile)};
+            myTracepoint.theNumHits = readValue<std::uint64_t>(myFile);
+
+            auto myNumCaptures = readValue<std::uint32_t>(myFile);
+            for (std::uint32_t i = 0; i < myNumCaptures; ++i) {
+                std::string mySpec(readValue<std::uint32_t>(myFile), '\0');
+                myFile.read(mySpec.data(), mySpec.size());
+
+                auto myCapture = TraceCapture::parse(mySpec);
+                if (!myCapture) {
+                    Error::send(fmt::format("Invalid capture {} in {}", mySpec,
+                                            aPath.string()));
+                }
+                myTracepoint.theCaptures.push_back(std::move(*myCapture));
+            }
+        }
+
+        auto myNumDropped = readValue<std::uint64_t>(myFile);
+        auto myNumRecords = readValue<std::uint64_t>(myFile);
+        auto myBytes = readValue<std::uint64_t>(myFile);
+
+        // Sized to hold every record, so none are dropped again
+        TraceFile myTrace{std::move(myTracepoints), TraceBuffer{myBytes}};
+        std::vector<std::byte> myPayload;
+        for (std::uint64_t i = 0; i < myNumRecords; ++i) {
+            auto myHeader = readValue<TraceRecordHeader>(myFile);
+            myPayload.resize(myHeader.theSize);
+            if (!myFile.read(reinterpret_cast<char*>(myPayload.data()),
+                             myPayload.size())) {
+                Error::send("Saved trace is truncated");
+            }
+            myTrace.theBuffer.push(myHeader, myPayload);
+        }
+        myTrace.theBuffer.addDropped(myNumDropped);
+
+        return myTrace;
+    }
+
+    std::string formatTraceRecord(const Tracepoint& aTracepoint,
+                                  std::span<const std::byte> aPayload,
+                                  std::string_view aFormat) {
+        auto myValues = decodeCaptures(aTracepoint, aPayload);
+
+        std::string myResult;
+        if (aFormat.empty()) {
+            for (auto& myValue : myValues) {
+                if (!myResult.empty()) {
+                    myResult += ", ";
+                }
+                myResult += myValue.theCapture->theSpec + "=";
+                myResult += myValue.theCapture->theSize
+                                ? formatBytes(myValue.theBytes)
+                                : fmt::format("{:#x}", myValue.theValue);
+            }
+            return myResult;
+        }
+
+        auto myNext = myValues.begin();
+        for (std::size_t i = 0; i < aFormat.size(); ++i) {
+            if (aFormat[i] != '%' or i + 1 == aFormat.size()) {
+                myResult += aFormat[i];
+                continue;
+            }
+
+            auto myConversion = aFormat[++i];
+            if (myConversion == '%') {
+                myResult += '%';
+                continue;
+            }
+            if (myNext == myValues.end()) {
+                myResult += "<missing>";
+                continue;
+            }
+
+            auto& myValue = *myNext++;
+            switch (myConversion) {
+                case 'd':
+                    myResult += fmt::format(
+                        "{}", static_cast<std::int64_t>(myValue.theValue));
+                    break;
+                case 'u':
+                    myResult += fmt::format("{}", myValue.theValue);
+                    break;
+                case 'x':
+                    myResult += fmt::format("{:#x}", myValue.theValue);
+                    break;
+                case 's':
+                case 'b':
+                    // Registers have no bytes to show, so they are shown in
+                    // hex instead
+                    if (!myValue.theCapture->theSize) {
+                        myResult += fmt::format("{:#x}", myValue.theValue);
+                    } else if (myConversion == 's') {
+                        myResult += formatString(myValue.theBytes);
+                    } else {
+                        myResult += formatBytes(myValue.theBytes);
+                    }
+                    break;
+                default:
+                    myResult += '%';
+                    myResult += myConversion;
+                    --myNext;
+                    break;
+            }
+        }
+
+        return myResult;
+    }
+
+} // namespace sdb
@@ -0,0 +1,156 @@
+#include <unwinder.hpp>
+
+#include <error.hpp>
+#include <memory_cache.hpp>
+#include <target.hpp>
+
+namespace sdb {
+
+    namespace {
+        // Registers the x86-64 ABI requires a function to preserve. Without
+        // a rule they still hold the caller's values.
+        bool isCalleeSaved(std::size_t aRegister) {
+            return aRegister == 3 or aRegister == CfiRow::RBP or
+                   (aRegister >= 12 and aRegister <= 15);
+        }
+    } // namespace
+
+    std::vector<StackFrame> Unwinder::unwind(std::size_t aMaxFrames) {
+        auto myRegisters = readCurrentRegisters();
+
+        std::vector<StackFrame> myFrames;
+        while (myFrames.size() < aMaxFrames) {
+            auto myPc = myRegisters[CfiRow::RETURN_ADDRESS];
+            if (!myPc or *myPc == 0) {
+                break;
+            }
+
+            auto& myFrame = myFrames.emplace_back(
+                VirtualAddress{*myPc}, VirtualAddress{0}, myFrames.empty());
+
+            // Unwind tables the parser does not understand end the walk
+            // rather than the command
+            const CfiRow* myRow = nullptr;
+            try {
+                myRow = theTarget.findCallFrameRow(myFrame.getCallSite());
+            } catch (const Error&) {
+                break;
+            }
+
+            RegisterSet myCaller;
+            std::uint64_t myCfa = 0;
+            bool myIsUnwound = false;
+            if (myRow == nullptr or myRow->isFramePointerFrame()) {
+                // Code without unwind tables, such as JIT compiled code, is
+                // assumed to keep frame pointers
+                myIsUnwound =
+                    unwindFramePointer(myRegisters, myCaller, myCfa);
+            } else {
+                myIsUnwound = unwindCfi(*myRow, myRegisters, myCaller, myCfa);
+            }
+
+            // The stack grows down, so a caller whose stack pointer is not
+            // above ours means the walk went wrong
+            auto mySp = myRegisters[CfiRow::RSP];
+            if (!myIsUnwound or (mySp and myCfa <= *mySp)) {
+                break;
+            }
+
+            myFrame.theCfa = VirtualAddress{myCfa};
+            myRegisters = myCaller;
+        }
+
+        return myFrames;
+    }
+
+    Unwinder::RegisterSet Unwinder::readCurrentRegisters() const {
+        auto& myRegisters = theTarget.getProcess().getRegisters();
+
+        RegisterSet myValues;
+        for (std::size_t i = 0; i < CfiRow::NUM_REGISTERS; ++i) {
+            myValues[i] = std::get<std::uint64_t>(myRegisters.read(
+                findRegisterByDwarfId(static_cast<std::int32_t>(i))));
+        }
+
+        return myValues;
+    }
+
+    bool Unwinder::unwindFramePointer(const RegisterSet& aRegisters,
+                                      RegisterSet& aCaller,
+                                      std::uint64_t& aCfa) {
+        auto myRbp = aRegisters[CfiRow::RBP];
+        auto mySp = aRegisters[CfiRow::RSP];
+        if (!myRbp or *myRbp == 0 or *myRbp % 8 != 0 or
+            (mySp and *myRbp < *mySp)) {
+            return false;
+        }
+
+        // The saved rbp and the return address are adjacent, so one read
+        // covers both
+        auto myRecord =
+            theCache.read<std::array<std::uint64_t, 2>>(VirtualAddress{*myRbp});
+        if (!myRecord) {
+            return false;
+        }
+
+        aCfa = *myRbp + 16;
+        for (std::size_t i = 0; i < CfiRow::NUM_REGISTERS; ++i) {
+            if (isCalleeSaved(i)) {
+                aCaller[i] = aRegisters[i];
+            }
+        }
+        aCaller[CfiRow::RBP] = (*myRecord)[0];
+        aCaller[CfiRow::RETURN_ADDRESS] = (*myRecord)[1];
+        aCaller[CfiRow::RSP] = aCfa;
+
+        return true;
+    }
+
+    bool Unwinder::unwindCfi(const CfiRow& aRow, const RegisterSet& aRegisters,
+                             RegisterSet& aCaller, std::uint64_t& aCfa) {
+        if (aRow.theCfaRegister < 0 or
+            static_cast<std::size_t>(aRow.theCfaRegister) >=
+                CfiRow::NUM_REGISTERS or
+            !aRegisters[aRow.theCfaRegister]) {
+            return false;
+        }
+
+        aCfa = *aRegisters[aRow.theCfaRegister] + aRow.theCfaOffset;
+
+        using enum RegisterRule::Kind;
+        for (std::size_t i = 0; i < CfiRow::NUM_REGISTERS; ++i) {
+            auto& myRule = aRow.theRules[i];
+            switch (myRule.theKind) {
+                case Undefined:
+                    if (isCalleeSaved(i)) {
+                        aCaller[i] = aRegisters[i];
+                    }
+                    break;
+                case SameValue:
+                    aCaller[i] = aRegisters[i];
+                    break;
+                case Offset:
+                    aCaller[i] = theCache.read<std::uint64_t>(
+                        VirtualAddress{aCfa + myRule.theValue});
+                    break;
+                case ValueOffset:
+                    aCaller[i] = aCfa + myRule.theValue;
+                    break;
+                case Register:
+                    if (static_cast<std::size_t>(myRule.theValue) <
+                        CfiRow::NUM_REGISTERS) {
+                        aCaller[i] = aRegisters[myRule.theValue];
+                    }
+                    break;
+            }
+        }
+
+        // The caller's stack pointer is the CFA by definition
+        if (aRow.theRules[CfiRow::RSP].theKind == Undefined) {
+            aCaller[CfiRow::RSP] = aCfa;
+        }
+
+        return aCaller[CfiRow::RETURN_ADDRESS].has_value();
+    }
+
+} // namespace sdb
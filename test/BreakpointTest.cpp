@@ -3,9 +3,12 @@
 #include "gtest/gtest.h"
 
 #include <TestUtil.hpp>
+#include <breakpoint_condition.hpp>
 #include <fmt/format.h>
+#include <memory_operations.hpp>
 #include <pipe.hpp>
 #include <process.hpp>
+#include <target.hpp>
 
 namespace sdb::test {
     TEST(BreakpointTest, CreateBreakpointSites) {
@@ -133,4 +136,112 @@ namespace sdb::test {
         EXPECT_EQ(myBreakpointSites.size(), 0);
     }
 
+    TEST(BreakpointTest, CompilesConditions) {
+        auto myFolded = BreakpointCondition::compile("(1 + 2) - 3 == 0");
+        EXPECT_EQ(myFolded.getCode().size(), 1);
+
+        auto myCondition =
+            BreakpointCondition::compile("rdi == 0x10 + 2 and [rsi+8] > -1");
+        EXPECT_EQ(myCondition.getCode().front().theOp,
+                  BreakpointCondition::Op::Register);
+        EXPECT_EQ(myCondition.getCode()[1],
+                  (BreakpointCondition::Instruction{
+                      BreakpointCondition::Op::Constant, 0, 0x12}));
+
+        EXPECT_THROW(BreakpointCondition::compile("rdi =="), Error);
+        EXPECT_THROW(BreakpointCondition::compile("xyz > 1"), Error);
+        EXPECT_THROW(BreakpointCondition::compile("[rdi"), Error);
+    }
+
+    TEST(BreakpointTest, ConditionalBreakpointStopsOnlyWhenTrue) {
+        auto myTarget = Target::launch("test/targets/trace_calls");
+        auto myRecord = myTarget->findSymbolAddresses("record");
+        ASSERT_EQ(myRecord.size(), 1);
+
+        auto& myProcess = myTarget->getProcess();
+        auto& mySite = myProcess.createBreakpointSite(myRecord.front());
+        mySite.setCondition(BreakpointCondition::compile(
+            "esi == 42 and byte [rdi] == 0x68 or hits == 100"));
+        mySite.enable();
+
+        myProcess.resume();
+        auto myReason = myProcess.waitOnSignal();
+        EXPECT_EQ(myReason.theStopState, ProcessState::Stopped);
+        EXPECT_EQ(myProcess.getRegisters().getRegisterData().regs.rsi, 42);
+
+        myProcess.resume();
+        myReason = myProcess.waitOnSignal();
+        EXPECT_EQ(myProcess.getRegisters().getRegisterData().regs.rsi, 99);
+
+        myProcess.resume();
+        myReason = myProcess.waitOnSignal();
+        EXPECT_EQ(myReason.theStopState, ProcessState::Exited);
+
+        auto& myCondition = *mySite.getCondition();
+        EXPECT_EQ(myCondition.getNumHits(), 100);
+        EXPECT_EQ(myCondition.getNumTrue(), 2);
+        EXPECT_EQ(myCondition.getNumFalse(), 98);
+        EXPECT_GT(myCondition.getTotalTime().count(), 0);
+    }
+
+    TEST(BreakpointTest, NativeConditionTrapsOnlyWhenTrue) {
+        auto myTarget = Target::launch("test/targets/trace_calls");
+        auto myRecord = myTarget->findSymbolAddresses("record");
+        ASSERT_EQ(myRecord.size(), 1);
+
+        auto& myProcess = myTarget->getProcess();
+        auto myOriginal =
+            readMemory(myProcess.getPid(), myRecord.front(), 16);
+        auto& mySite = myProcess.createBreakpointSite(myRecord.front());
+        EXPECT_THROW(mySite.setNativeCondition(
+                         BreakpointCondition::compile("cs == 0x33")),
+                     Error);
+        EXPECT_THROW(mySite.setNativeCondition(
+                         BreakpointCondition::compile("byte [rdi] == 0x68")),
+                     Error);
+
+        mySite.setNativeCondition(
+            BreakpointCondition::compile("esi == 42 or hits == 100"));
+        mySite.enable();
+        EXPECT_NE(readMemory(myProcess.getPid(), myRecord.front(), 16),
+                  myOriginal);
+        EXPECT_EQ(readMemoryWithoutBreakpointTraps(myProcess,
+                                                   myRecord.front(), 16),
+                  myOriginal);
+
+        myProcess.resume();
+        auto myReason = myProcess.waitOnSignal();
+        EXPECT_EQ(myReason.theStopState, ProcessState::Stopped);
+        EXPECT_EQ(myProcess.getPc(), myRecord.front());
+        EXPECT_EQ(myProcess.getRegisters().getRegisterData().regs.rsi, 42);
+
+        // Each step runs the displaced copy of an instruction and stops at
+        // the matching address under the jump, until past it
+        auto myEnd = mySite.getNativeCondition()->getDisplaced().getEnd();
+        myProcess.stepInstruction();
+        EXPECT_GT(myProcess.getPc(), myRecord.front());
+        EXPECT_LE(myProcess.getPc(), myEnd);
+        while (myProcess.getPc() < myEnd) {
+            auto myPc = myProcess.getPc();
+            myProcess.stepInstruction();
+            ASSERT_GT(myProcess.getPc(), myPc);
+        }
+        EXPECT_EQ(myProcess.getPc(), myEnd);
+
+        // The steps leave the jump in place for later hits
+        myProcess.resume();
+        myReason = myProcess.waitOnSignal();
+        EXPECT_EQ(myProcess.getPc(), myRecord.front());
+        EXPECT_EQ(myProcess.getRegisters().getRegisterData().regs.rsi, 99);
+
+        auto& myNative = *mySite.getNativeCondition();
+        EXPECT_EQ(myNative.getNumHits(), 100);
+        EXPECT_EQ(myNative.getNumTrue(), 2);
+
+        myProcess.resume();
+        myReason = myProcess.waitOnSignal();
+        EXPECT_EQ(myReason.theStopState, ProcessState::Exited);
+        EXPECT_EQ(myNative.getNumHits(), 100);
+    }
+
 } // namespace sdb::test
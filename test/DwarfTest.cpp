@@ -0,0 +1,117 @@
+#include "gtest/gtest.h"
+#include <gmock/gmock.h>
+
+#include <dwarf.hpp>
+#include <elf_file.hpp>
+#include <process.hpp>
+#include <target.hpp>
+
+namespace sdb::test {
+    TEST(DwarfTest, IndexesCompileUnits) {
+        ElfFile myElf{"test/targets/hello_sdb"};
+        Dwarf myDwarf{myElf};
+
+        ASSERT_TRUE(myDwarf.hasDebugInfo());
+
+        auto* myMain = myElf.getSymbolsByName("main").front();
+        auto* myUnit =
+            myDwarf.getCompileUnitContainingAddress(myMain->theAddress);
+        ASSERT_NE(myUnit, nullptr);
+        EXPECT_THAT(std::string{myUnit->theName},
+                    ::testing::EndsWith("hello_sdb.cpp"));
+    }
+
+    TEST(DwarfTest, MapsAddressesToLines) {
+        ElfFile myElf{"test/targets/hello_sdb"};
+        Dwarf myDwarf{myElf};
+
+        auto* myMain = myElf.getSymbolsByName("main").front();
+        auto myLocation = myDwarf.getSourceLocation(myMain->theAddress);
+
+        ASSERT_TRUE(myLocation.has_value());
+        EXPECT_THAT(std::string{myLocation->theFile},
+                    ::testing::EndsWith("hello_sdb.cpp"));
+        EXPECT_EQ(myLocation->theLine, 3);
+        EXPECT_EQ(myLocation->theAddress, myMain->theAddress);
+    }
+
+    TEST(DwarfTest, MapsLinesToAddresses) {
+        ElfFile myElf{"test/targets/hello_sdb"};
+        Dwarf myDwarf{myElf};
+
+        auto* myMain = myElf.getSymbolsByName("main").front();
+
+        auto myAddresses = myDwarf.getLineAddresses("hello_sdb.cpp", 4);
+        ASSERT_EQ(myAddresses.size(), 1);
+        EXPECT_GT(myAddresses.front(), myMain->theAddress);
+        EXPECT_LT(myAddresses.front(), myMain->theAddress + myMain->theSize);
+
+        auto myLocation = myDwarf.getSourceLocation(myAddresses.front());
+        ASSERT_TRUE(myLocation.has_value());
+        EXPECT_EQ(myLocation->theLine, 4);
+
+        EXPECT_TRUE(myDwarf.getLineAddresses("no_such_file.cpp", 4).empty());
+        EXPECT_TRUE(myDwarf.getLineAddresses("_sdb.cpp", 4).empty());
+    }
+
+    TEST(DwarfTest, StepsBySourceLine) {
+        auto myTarget = Target::launch("test/targets/hello_sdb");
+        auto& myProcess = myTarget->getProcess();
+
+        auto myAddresses = myTarget->findLineAddresses("hello_sdb.cpp", 4);
+        ASSERT_EQ(myAddresses.size(), 1);
+
+        myProcess.createBreakpointSite(myAddresses.front()).enable();
+        myProcess.resume();
+        myProcess.waitOnSignal();
+        EXPECT_EQ(myProcess.getPc(), myAddresses.front());
+
+        // Stepping over the line runs the call to puts to completion
+        auto myReason = myTarget->stepSourceLine();
+        EXPECT_EQ(myReason.theStopState, ProcessState::Stopped);
+
+        auto myLocation = myTarget->getSourceLocation(myProcess.getPc());
+        ASSERT_TRUE(myLocation.has_value());
+        EXPECT_EQ(myLocation->theLine, 5);
+    }
+
+    TEST(DwarfTest, IndexesQualifiedFunctionNames) {
+        ElfFile myElf{"test/targets/namespaces"};
+        Dwarf myDwarf{myElf};
+
+        for (auto myName : {"main", "outer::inner::add", "outer::Widget::value",
+                            "(anonymous namespace)::helper"}) {
+            auto myFunctions = myDwarf.findFunctions(myName);
+            ASSERT_EQ(myFunctions.size(), 1) << myName;
+
+            auto* myFunction = myFunctions.front();
+            EXPECT_EQ(myFunction->theName, myName);
+            EXPECT_EQ(myDwarf.getFunctionContainingAddress(myFunction->theLow),
+                      myFunction);
+            EXPECT_EQ(
+                myDwarf.getFunctionContainingAddress(myFunction->theHigh - 1),
+                myFunction);
+        }
+
+        EXPECT_TRUE(myDwarf.findFunctions("add").empty());
+
+        auto myProgress = myDwarf.getIndexProgress();
+        EXPECT_TRUE(myProgress.theIsComplete);
+        EXPECT_EQ(myProgress.theUnitsIndexed, myProgress.theUnitsTotal);
+    }
+
+    TEST(DwarfTest, BreakpointOnQualifiedFunctionIsHit) {
+        auto myTarget = Target::launch("test/targets/namespaces");
+        auto& myProcess = myTarget->getProcess();
+
+        // The ELF symbol is mangled, so the name comes from the debug info
+        auto myAddresses = myTarget->findSymbolAddresses("outer::inner::add");
+        ASSERT_EQ(myAddresses.size(), 1);
+
+        myProcess.createBreakpointSite(myAddresses.front()).enable();
+        myProcess.resume();
+        myProcess.waitOnSignal();
+        EXPECT_EQ(myProcess.getPc(), myAddresses.front());
+    }
+
+} // namespace sdb::test
@@ -0,0 +1,65 @@
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <heap_inspector.hpp>
+#include <process.hpp>
+#include <sstream>
+#include <string>
+#include <target.hpp>
+
+namespace sdb::test {
+
+    TEST(HeapInspectorTest, WalksArenasBinsAndCaches) {
+        auto myTarget = Target::launch("test/targets/fragmented");
+        auto& myProcess = myTarget->getProcess();
+        auto myDone = myTarget->findSymbolAddresses("done");
+        ASSERT_EQ(myDone.size(), 1);
+
+        myProcess.createBreakpointSite(myDone.front()).enable();
+        myProcess.resume();
+        myProcess.waitOnSignal();
+        ASSERT_EQ(myProcess.getPc(), myDone.front());
+
+        HeapInspector myInspector{*myTarget};
+        auto myStats = myInspector.inspect(5);
+
+        // main_arena and the one made for the thread
+        ASSERT_EQ(myStats.theArenas.size(), 2);
+        auto& myMain = myStats.theArenas[0];
+        auto& myThread = myStats.theArenas[1];
+        EXPECT_TRUE(myMain.theIsMain);
+        EXPECT_EQ(myMain.theAddress,
+                  std::to_underlying(myInspector.findMainArena()));
+        EXPECT_FALSE(myMain.theCorruptAt.has_value());
+        EXPECT_FALSE(myThread.theCorruptAt.has_value());
+
+        // The brk heap is walked end to end
+        EXPECT_EQ(myMain.theInUseBytes + myMain.theFreeBytes +
+                      myMain.theCachedBytes + myMain.theTopBytes,
+                  myMain.theSystemBytes);
+
+        // Ten holes of 2000 bytes and twenty small blocks in the tcache
+        // and a fastbin
+        EXPECT_GE(myMain.theFreeCount, 10);
+        EXPECT_EQ(myMain.theCachedCount, 20);
+        EXPECT_GE(myStats.theFreeCounts[10], 10);
+        EXPECT_GT(myMain.getFragmentation(), 0.5);
+        ASSERT_EQ(myStats.theLargestFree.size(), 5);
+        EXPECT_GE(myStats.theLargestFree.front().theSize, 2000);
+
+        // The thread's arena keeps its blocks behind the arena itself
+        EXPECT_EQ(myThread.theNumHeaps, 1);
+        EXPECT_GE(myThread.theInUseCount, 10);
+        EXPECT_GE(myThread.theInUseBytes, 10 * 500);
+        EXPECT_LT(myThread.theInUseBytes + myThread.theFreeBytes +
+                      myThread.theCachedBytes + myThread.theTopBytes,
+                  myThread.theSystemBytes);
+
+        std::ostringstream myOutput;
+        HeapInspector::writeStats(myOutput, myStats);
+        EXPECT_NE(myOutput.str().find("(main)"), std::string::npos);
+        EXPECT_NE(myOutput.str().find("largest free chunks"),
+                  std::string::npos);
+    }
+
+} // namespace sdb::test
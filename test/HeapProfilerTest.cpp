@@ -0,0 +1,106 @@
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <heap_profiler.hpp>
+#include <process.hpp>
+#include <random>
+#include <sstream>
+#include <string>
+#include <target.hpp>
+#include <unordered_map>
+
+namespace sdb::test {
+
+    TEST(HeapProfilerTest, AllocationTableKeepsEntriesThroughChurn) {
+        AllocationTable myTable;
+        std::unordered_map<std::uint64_t, std::uint64_t> myExpected;
+        std::mt19937_64 myRandom{42};
+
+        // Addresses close together, as malloc returns them, collide often
+        for (int i = 0; i < 20000; ++i) {
+            std::uint64_t myAddress = 0x10000 + (myRandom() % 4096) * 16;
+            if (myRandom() % 3 == 0) {
+                auto myErased = myTable.erase(myAddress);
+                EXPECT_EQ(myErased.has_value(), myExpected.contains(myAddress));
+                if (myErased) {
+                    EXPECT_EQ(myErased->theSize, myExpected[myAddress]);
+                }
+                myExpected.erase(myAddress);
+            } else {
+                myTable.insert(myAddress, i, i % 7);
+                myExpected[myAddress] = i;
+            }
+        }
+
+        EXPECT_EQ(myTable.getSize(), myExpected.size());
+        EXPECT_GE(myTable.getCapacity(), myTable.getSize() * 2);
+        for (auto [myAddress, mySize] : myExpected) {
+            auto* myEntry = myTable.find(myAddress);
+            ASSERT_NE(myEntry, nullptr);
+            EXPECT_EQ(myEntry->theSize, mySize);
+        }
+        EXPECT_EQ(myTable.find(0x10008), nullptr);
+        EXPECT_FALSE(myTable.erase(0).has_value());
+    }
+
+    TEST(HeapProfilerTest, AttributesLiveBytesToCallSites) {
+        auto myTarget = Target::launch("test/targets/heap");
+        auto& myProcess = myTarget->getProcess();
+        auto myMain = myTarget->findSymbolAddresses("main");
+        auto myDone = myTarget->findSymbolAddresses("done");
+        ASSERT_EQ(myMain.size(), 1);
+        ASSERT_EQ(myDone.size(), 1);
+
+        // The C library is loaded by the time main runs
+        myProcess.createBreakpointSite(myMain.front()).enable();
+        myProcess.createBreakpointSite(myDone.front()).enable();
+        myProcess.resume();
+        myProcess.waitOnSignal();
+        ASSERT_EQ(myProcess.getPc(), myMain.front());
+
+        auto& myProfiler = myTarget->getHeapProfiler();
+        myProfiler.start();
+        EXPECT_THROW(myProfiler.start(), Error);
+
+        myProcess.resume();
+        myProcess.waitOnSignal();
+        ASSERT_EQ(myProcess.getPc(), myDone.front());
+        myProfiler.stop();
+
+        // Ten kept buffers, the calloc'd array and the grown block
+        EXPECT_EQ(myProfiler.getLiveAllocations().getSize(), 12);
+        EXPECT_EQ(myProfiler.getNumMissed(), 0);
+        EXPECT_EQ(myProfiler.getNumLostFrees(), 0);
+
+        std::uint64_t myLiveBytes = 0;
+        std::uint64_t myTotalCount = 0;
+        for (auto& mySite : myProfiler.getSites()) {
+            myLiveBytes += mySite.theLiveBytes;
+            myTotalCount += mySite.theTotalCount;
+        }
+        EXPECT_EQ(myLiveBytes, 10 * 1000 + 16 * 32 + 4096);
+        EXPECT_EQ(myTotalCount, 100 + 10 + 1 + 1 + 1);
+
+        std::ostringstream myFolded;
+        myProfiler.writeFoldedStacks(myFolded);
+        EXPECT_NE(myFolded.str().find("main;keep_buffer;"), std::string::npos);
+        EXPECT_NE(myFolded.str().find(" 10000\n"), std::string::npos);
+        EXPECT_EQ(myFolded.str().find("churn"), std::string::npos);
+
+        std::ostringstream myTotal;
+        myProfiler.writeFoldedStacks(myTotal, true);
+        EXPECT_NE(myTotal.str().find("main;churn;"), std::string::npos);
+        EXPECT_NE(myTotal.str().find(" 6400\n"), std::string::npos);
+
+        std::ostringstream myPprof;
+        myProfiler.writePprof(myPprof);
+        EXPECT_EQ(myPprof.str().rfind("heap profile:", 0), 0);
+        EXPECT_NE(myPprof.str().find("MAPPED_LIBRARIES:"), std::string::npos);
+
+        // Nothing is hooked any more
+        myProcess.resume();
+        auto myReason = myProcess.waitOnSignal();
+        EXPECT_EQ(myReason.theStopState, ProcessState::Exited);
+    }
+
+} // namespace sdb::test
@@ -0,0 +1,119 @@
+#include "gtest/gtest.h"
+
+#include <cstdlib>
+#include <elf_file.hpp>
+#include <filesystem>
+#include <fstream>
+#include <index_cache.hpp>
+#include <target.hpp>
+
+namespace sdb::test {
+    class IndexCacheTest : public ::testing::Test {
+      protected:
+        void SetUp() override {
+            if (!ElfFile{"test/targets/hello_sdb"}.getBuildId()) {
+                GTEST_SKIP() << "hello_sdb was linked without a build-id";
+            }
+
+            std::string myTemplate =
+                (std::filesystem::temp_directory_path() / "sdb_cacheXXXXXX")
+                    .string();
+            ASSERT_NE(mkdtemp(myTemplate.data()), nullptr);
+
+            theDirectory = myTemplate;
+            setenv("SDB_CACHE_DIR", theDirectory.c_str(), 1);
+        }
+
+        void TearDown() override {
+            if (!theDirectory.empty()) {
+                unsetenv("SDB_CACHE_DIR");
+                std::filesystem::remove_all(theDirectory);
+            }
+        }
+
+        // Runs a session until its index is complete and returns whether
+        // the index came from the cache. Destroying the target waits for
+        // the cache to be written.
+        static bool buildCache() {
+            auto myTarget = Target::launch("test/targets/hello_sdb");
+            myTarget->getDwarf().getFunctionIndex();
+            return myTarget->isIndexFromCache();
+        }
+
+        std::filesystem::path getCacheFile() const {
+            auto myBuildId = ElfFile{"test/targets/hello_sdb"}.getBuildId();
+            return theDirectory / (*myBuildId + ".idx");
+        }
+
+        std::filesystem::path theDirectory;
+    };
+
+    TEST_F(IndexCacheTest, SecondSessionMapsCache) {
+        buildCache();
+        ASSERT_TRUE(std::filesystem::exists(getCacheFile()));
+
+        auto myTarget = Target::launch("test/targets/hello_sdb");
+        EXPECT_TRUE(myTarget->isIndexFromCache());
+
+        ElfFile myElf{"test/targets/hello_sdb"};
+        Dwarf myDwarf{myElf};
+
+        auto myBuilt = myElf.getSymbols();
+        auto myMapped = myTarget->getElf().getSymbols();
+        ASSERT_EQ(myBuilt.size(), myMapped.size());
+        for (std::size_t i = 0; i < myBuilt.size(); ++i) {
+            EXPECT_EQ(myBuilt[i].theAddress, myMapped[i].theAddress);
+            EXPECT_EQ(myElf.getSymbolName(myBuilt[i]),
+                      myTarget->getElf().getSymbolName(myMapped[i]));
+        }
+
+        EXPECT_EQ(myDwarf.getCompileUnits().size(),
+                  myTarget->getDwarf().getCompileUnits().size());
+
+        auto& myBuiltFunctions = myDwarf.getFunctionIndex().theEntries;
+        auto& myMappedFunctions =
+            myTarget->getDwarf().getFunctionIndex().theEntries;
+        ASSERT_EQ(myBuiltFunctions.size(), myMappedFunctions.size());
+        for (std::size_t i = 0; i < myBuiltFunctions.size(); ++i) {
+            EXPECT_EQ(myBuiltFunctions[i].theName,
+                      myMappedFunctions[i].theName);
+            EXPECT_EQ(myBuiltFunctions[i].theLow, myMappedFunctions[i].theLow);
+        }
+    }
+
+    TEST_F(IndexCacheTest, MappedIndexResolvesSymbolsAndLines) {
+        buildCache();
+        auto myTarget = Target::launch("test/targets/hello_sdb");
+        ASSERT_TRUE(myTarget->isIndexFromCache());
+
+        auto myAddresses = myTarget->findSymbolAddresses("main");
+        ASSERT_EQ(myAddresses.size(), 1);
+
+        auto& myProcess = myTarget->getProcess();
+        myProcess.createBreakpointSite(myAddresses.front()).enable();
+        myProcess.resume();
+        myProcess.waitOnSignal();
+        EXPECT_EQ(myProcess.getPc(), myAddresses.front());
+
+        auto myLocation = myTarget->getSourceLocation(myProcess.getPc());
+        ASSERT_TRUE(myLocation.has_value());
+        EXPECT_TRUE(myLocation->theFile.ends_with("hello_sdb.cpp"));
+    }
+
+    TEST_F(IndexCacheTest, CorruptCacheIsRebuilt) {
+        buildCache();
+
+        auto mySize = std::filesystem::file_size(getCacheFile());
+        std::filesystem::resize_file(getCacheFile(), mySize / 2);
+        EXPECT_FALSE(buildCache());
+        EXPECT_EQ(std::filesystem::file_size(getCacheFile()), mySize);
+
+        {
+            std::ofstream myFile{getCacheFile(),
+                                 std::ios::binary | std::ios::in};
+            myFile.write("garbage", 7);
+        }
+        EXPECT_FALSE(buildCache());
+        EXPECT_TRUE(buildCache());
+    }
+} // namespace sdb::test
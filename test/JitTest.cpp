@@ -0,0 +1,42 @@
+#include "gtest/gtest.h"
+
+#include <jit_interface.hpp>
+#include <process.hpp>
+#include <target.hpp>
+
+namespace sdb::test {
+    TEST(JitTest, RegisteredCodeIsSymbolized) {
+        auto myTarget = Target::launch("test/targets/jit");
+        ASSERT_TRUE(myTarget->getJitInterface().isWatching());
+
+        myTarget->addPendingBreakpoint("jit_function_500");
+
+        auto& myProcess = myTarget->getProcess();
+        myProcess.resume();
+        auto myReason = myProcess.waitOnSignal();
+        ASSERT_EQ(myReason.theStopState, ProcessState::Stopped);
+
+        EXPECT_EQ(myTarget->getJitInterface().getNumObjects(), 1000);
+
+        auto myLocation = myTarget->symbolize(myProcess.getPc());
+        ASSERT_TRUE(myLocation.has_value());
+        EXPECT_EQ(myLocation->theName, "jit_function_500");
+        EXPECT_EQ(myLocation->theOffset, 0);
+
+        auto myFirst = myTarget->findSymbolAddresses("jit_function_0");
+        ASSERT_EQ(myFirst.size(), 1);
+        EXPECT_EQ(myFirst.front() + 500 * 8, myProcess.getPc());
+
+        // The program unregisters the first half before trapping
+        myProcess.resume();
+        myReason = myProcess.waitOnSignal();
+        ASSERT_EQ(myReason.theStopState, ProcessState::Stopped);
+        EXPECT_EQ(myReason.theStatus, SIGTRAP);
+
+        EXPECT_EQ(myTarget->getJitInterface().getNumObjects(), 500);
+        EXPECT_FALSE(myTarget->symbolize(myFirst.front()).has_value());
+        EXPECT_TRUE(myTarget->findSymbolAddresses("jit_function_0").empty());
+        EXPECT_EQ(myTarget->findSymbolAddresses("jit_function_999").size(),
+                  1);
+    }
+} // namespace sdb::test
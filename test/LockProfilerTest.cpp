@@ -0,0 +1,99 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <cstdint>
+#include <lock_profiler.hpp>
+#include <memory>
+#include <process.hpp>
+#include <sstream>
+#include <string>
+#include <target.hpp>
+
+namespace sdb::test {
+
+    namespace {
+        // Runs the target to ready, when the other thread holds the lock
+        // and locks nothing more, with a breakpoint on done
+        std::unique_ptr<Target> launchHoldingLock() {
+            auto myTarget = Target::launch("test/targets/lock_contention");
+            auto& myProcess = myTarget->getProcess();
+            auto myReady = myTarget->findSymbolAddresses("ready");
+            auto myDone = myTarget->findSymbolAddresses("done");
+            EXPECT_EQ(myReady.size(), 1);
+            EXPECT_EQ(myDone.size(), 1);
+
+            myProcess.createBreakpointSite(myReady.front()).enable();
+            myProcess.createBreakpointSite(myDone.front()).enable();
+            myProcess.resume();
+            myProcess.waitOnSignal();
+            EXPECT_EQ(myProcess.getPc(), myReady.front());
+            return myTarget;
+        }
+    } // namespace
+
+    TEST(LockProfilerTest, ChargesWaitsToLocksAndCallers) {
+        using namespace std::chrono_literals;
+
+        auto myTarget = launchHoldingLock();
+        auto& myProcess = myTarget->getProcess();
+        auto myDone = myTarget->findSymbolAddresses("done");
+        auto myLock = myTarget->findSymbolAddresses("theLock");
+        ASSERT_EQ(myLock.size(), 1);
+
+        LockProfiler myProfiler{*myTarget, true};
+        auto myReason = myProfiler.run(30s);
+        EXPECT_EQ(myReason.theStopState, ProcessState::Stopped);
+        EXPECT_EQ(myProcess.getPc(), myDone.front());
+
+        auto& myLocks = myProfiler.getLocks();
+        auto myIt = myLocks.find(std::to_underlying(myLock.front()));
+        ASSERT_NE(myIt, myLocks.end());
+        auto& myStats = myIt->second;
+
+        // Held for 50ms after it was asked for
+        EXPECT_GE(myStats.theWaits.getCount(), 1);
+        EXPECT_GE(myStats.theWaits.getTotal(), 20ms);
+        EXPECT_EQ(myStats.theNumAcquired, 11);
+        EXPECT_EQ(myStats.theNumContended, 1);
+
+        // A contended mutex wakes waiters on unlock
+        EXPECT_GE(myStats.theNumWakes, 1);
+
+        std::ostringstream myTable;
+        myProfiler.writeTable(myTable, 10);
+        EXPECT_NE(myTable.str().find("theLock"), std::string::npos);
+        EXPECT_NE(myTable.str().find("wait_for_lock"), std::string::npos);
+
+        // Joining the other thread waits on a futex, which no longer stops
+        // the process
+        myProcess.resume();
+        EXPECT_EQ(myProcess.waitOnSignal().theStopState,
+                  ProcessState::Exited);
+    }
+
+    TEST(LockProfilerTest, CatchesOnlyFutexWaitsAndWakesByDefault) {
+        using namespace std::chrono_literals;
+
+        auto myTarget = launchHoldingLock();
+        auto myLock = myTarget->findSymbolAddresses("theLock");
+        ASSERT_EQ(myLock.size(), 1);
+
+        // Without the hooks nothing is counted as acquired, and only the
+        // wait inside wait_for_lock and the wakes of the unlocks after it
+        // stop the process
+        LockProfiler myProfiler{*myTarget, false};
+        myProfiler.run(30s);
+        auto& myStats = myProfiler.getLocks().at(
+            std::to_underlying(myLock.front()));
+        EXPECT_GE(myStats.theWaits.getCount(), 1);
+        EXPECT_EQ(myStats.theNumAcquired, 0);
+
+        std::uint64_t myNumCalls = 0;
+        for (auto& [myFutex, myFutexStats] : myProfiler.getLocks()) {
+            myNumCalls +=
+                myFutexStats.theWaits.getCount() + myFutexStats.theNumWakes;
+        }
+        EXPECT_EQ(myProfiler.getOverhead().getCount(), 2 * myNumCalls);
+    }
+
+} // namespace sdb::test
@@ -1,11 +1,24 @@
 #include "gtest/gtest.h"
 
+#include <TestUtil.hpp>
+#include <algorithm>
+#include <chrono>
 #include <filesystem>
 #include <format>
 #include <fstream>
+#include <memory_operations.hpp>
+#include <pipe.hpp>
 #include <process.hpp>
 #include <signal.h>
+#include <span>
+#include <string_view>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
+#include <syscalls.hpp>
+#include <target.hpp>
+#include <thread>
+#include <unistd.h>
 
 #include <gmock/gmock.h>
 
@@ -34,6 +47,18 @@ namespace sdb::test {
             auto myLastParenIdx = myFirstLine.rfind(')');
             return myFirstLine[myLastParenIdx + 2];
         }
+
+        // Whether the kernel reports a seccomp filter in the process
+        bool hasSeccompFilter(pid_t aPid) {
+            std::ifstream myStream(std::format("/proc/{}/status", aPid));
+            std::string myLine;
+            while (std::getline(myStream, myLine)) {
+                if (myLine.starts_with("Seccomp:")) {
+                    return std::stoi(myLine.substr(8)) != 0;
+                }
+            }
+            return false;
+        }
     } // namespace
 
     TEST(ProcessTest, ProcessExistsAfterLaunch) {
@@ -96,4 +121,261 @@ namespace sdb::test {
             sdb::Error);
     }
 
+    TEST(ProcessTest, CountsEventsSinceLastStop) {
+        using namespace std::chrono_literals;
+
+        auto myProc = Process::launch("test/targets/busy");
+        auto* myCounters = myProc->getPerfCounters();
+        if (!myCounters) {
+            GTEST_SKIP() << "perf events are not available";
+        }
+
+        myProc->resume();
+        std::this_thread::sleep_for(50ms);
+        myProc->interrupt();
+
+        auto myTaskClock = std::ranges::find(myCounters->getDelta(),
+                                             PerfEvent::TaskClock,
+                                             &PerfCount::theEvent);
+        ASSERT_NE(myTaskClock, myCounters->getDelta().end());
+        EXPECT_GT(myTaskClock->theValue, 10'000'000);
+
+        // A single step only counts what ran since the interrupt
+        myProc->stepInstruction();
+        EXPECT_LT(myTaskClock->theValue, 10'000'000);
+    }
+
+    TEST(ProcessTest, InjectsSystemCallsFromScratchMemory) {
+        auto myProc = Process::launch("test/targets/run_forever");
+        auto myPc = myProc->getPc();
+        auto myRsp = myProc->getRegisters().getRegisterData().regs.rsp;
+
+        for (int i = 0; i < 3; ++i) {
+            EXPECT_EQ(myProc->injectSyscall(SYS_getpid, {}), myProc->getPid());
+        }
+        EXPECT_EQ(myProc->injectSyscall(SYS_close, {1000}), -EBADF);
+
+        // The scratch data is in the process and writable by it
+        auto myScratch = myProc->getScratchData();
+        EXPECT_GT(myProc->injectSyscall(SYS_getcwd,
+                                        {std::to_underlying(myScratch),
+                                         Process::SCRATCH_DATA_SIZE}),
+                  0);
+
+        user_regs_struct myRegs;
+        ASSERT_EQ(ptrace(PTRACE_GETREGS, myProc->getPid(), nullptr, &myRegs),
+                  0);
+        EXPECT_EQ(myRegs.rip, std::to_underlying(myPc));
+        EXPECT_EQ(myRegs.rsp, myRsp);
+    }
+
+    TEST(ProcessTest, CallsFunctions) {
+        auto myTarget = Target::launch("test/targets/call_functions");
+        auto& myProc = myTarget->getProcess();
+        auto myAdd = myTarget->findSymbolAddresses("add_and_count");
+        auto myMeasure = myTarget->findSymbolAddresses("measure");
+        auto myCrash = myTarget->findSymbolAddresses("crash");
+        auto myMain = myTarget->findSymbolAddresses("main");
+        ASSERT_EQ(myAdd.size(), 1);
+        ASSERT_EQ(myMeasure.size(), 1);
+        ASSERT_EQ(myCrash.size(), 1);
+        ASSERT_EQ(myMain.size(), 1);
+
+        myProc.createBreakpointSite(myMain.front()).enable();
+        myProc.resume();
+        myProc.waitOnSignal();
+        ASSERT_EQ(myProc.getPc(), myMain.front());
+
+        // Breakpoints in the function are passed over
+        myProc.createBreakpointSite(myAdd.front()).enable();
+        std::uint64_t myArgs[]{40, 2};
+        EXPECT_EQ(myProc.callFunction(myAdd.front(), myArgs), 42);
+
+        std::string_view myText{"hello from sdb"};
+        auto myScratch = myProc.getScratchData();
+        writeMemory(myProc.getPid(), myScratch,
+                    std::as_bytes(std::span{myText.data(), myText.size() + 1}));
+        std::uint64_t myTextArg[]{std::to_underlying(myScratch)};
+        EXPECT_EQ(myProc.callFunction(myMeasure.front(), myTextArg),
+                  myText.size());
+
+        EXPECT_THROW(myProc.callFunction(myCrash.front(), {}), Error);
+        EXPECT_EQ(myProc.getPc(), myMain.front());
+
+        // The process goes on where it was, into the breakpoint
+        myProc.resume();
+        auto myReason = myProc.waitOnSignal();
+        EXPECT_EQ(myReason.theStopState, ProcessState::Stopped);
+        EXPECT_EQ(myProc.getPc(), myAdd.front());
+
+        myProc.resume();
+        myReason = myProc.waitOnSignal();
+        EXPECT_EQ(myReason.theStopState, ProcessState::Exited);
+        EXPECT_EQ(myReason.theStatus, 0);
+    }
+
+    TEST(ProcessTest, RestartsFromCheckpoints) {
+        auto myTarget = Target::launch("test/targets/call_functions");
+        auto& myProc = myTarget->getProcess();
+        auto myAdd = myTarget->findSymbolAddresses("add_and_count");
+        auto myMain = myTarget->findSymbolAddresses("main");
+        ASSERT_EQ(myAdd.size(), 1);
+        ASSERT_EQ(myMain.size(), 1);
+
+        myProc.createBreakpointSite(myMain.front()).enable();
+        myProc.resume();
+        myProc.waitOnSignal();
+        auto mySp = myProc.getRegisters().getRegisterData().regs.rsp;
+
+        auto myId = myProc.checkpoint().theId;
+        ASSERT_EQ(myProc.getCheckpoints().size(), 1);
+        EXPECT_EQ(myProc.getCheckpoints().front().getPc(), myMain.front());
+
+        auto myRunToExit = [&]() {
+            myProc.resume();
+            myProc.waitOnSignal();
+            EXPECT_EQ(myProc.getPc(), myAdd.front());
+
+            myProc.resume();
+            auto myReason = myProc.waitOnSignal();
+            EXPECT_EQ(myReason.theStopState, ProcessState::Exited);
+            EXPECT_EQ(myReason.theStatus, 0);
+        };
+
+        // Breakpoints set after the checkpoint are carried over
+        myProc.createBreakpointSite(myAdd.front()).enable();
+        myRunToExit();
+        for (int i = 0; i < 2; ++i) {
+            auto myOldPid = myProc.getPid();
+            myProc.restart(myId);
+            EXPECT_NE(myProc.getPid(), myOldPid);
+            EXPECT_EQ(myProc.getPc(), myMain.front());
+            EXPECT_EQ(myProc.getRegisters().getRegisterData().regs.rsp, mySp);
+            myRunToExit();
+        }
+
+        myProc.deleteCheckpoint(myId);
+        EXPECT_TRUE(myProc.getCheckpoints().empty());
+        EXPECT_THROW(myProc.restart(myId), Error);
+    }
+
+    TEST(ProcessTest, CatchesSelectedSystemCalls) {
+        Pipe myPipe(false);
+        auto myProc =
+            Process::launch("test/targets/hello_sdb", true, myPipe.getWrite());
+        myPipe.closeWrite();
+
+        // Only the write of the buffered output stops, not the calls of
+        // the loader or of exit
+        auto myWrite = getSyscallNumber("write");
+        ASSERT_TRUE(myWrite);
+        myProc->setSyscallCatchPolicy({*myWrite});
+
+        myProc->resume();
+        auto myReason = myProc->waitOnSignal();
+        EXPECT_EQ(myReason.theStopState, ProcessState::Stopped);
+        EXPECT_EQ(myReason.theStatus, SIGTRAP);
+        ASSERT_TRUE(myReason.theSyscall);
+        EXPECT_EQ(myReason.theSyscall->theNumber, SYS_write);
+        EXPECT_TRUE(myReason.theSyscall->theIsEntry);
+        EXPECT_EQ(myReason.theSyscall->theArgs[0], STDOUT_FILENO);
+        EXPECT_EQ(myReason.theSyscall->theArgs[2], 12);
+
+        myProc->resume();
+        myReason = myProc->waitOnSignal();
+        ASSERT_TRUE(myReason.theSyscall);
+        EXPECT_FALSE(myReason.theSyscall->theIsEntry);
+        EXPECT_EQ(myReason.theSyscall->theResult, 12);
+
+        myProc->resume();
+        EXPECT_EQ(myProc->waitOnSignal(), StopReason{0});
+        EXPECT_EQ(toStringView(myPipe.read()), "Hello, sdb!\n");
+    }
+
+    TEST(ProcessTest, CatchesEverySystemCallWithoutAFilter) {
+        Pipe myPipe(false);
+        auto myProc =
+            Process::launch("test/targets/hello_sdb", true, myPipe.getWrite());
+        myPipe.closeWrite();
+        myProc->catchAllSyscalls();
+        EXPECT_TRUE(myProc->isCatchingAllSyscalls());
+
+        // Entries and returns alternate, ending with exit_group's entry
+        std::vector<SyscallStop> myStops;
+        myProc->resume();
+        auto myReason = myProc->waitOnSignal();
+        while (myReason.theSyscall) {
+            EXPECT_EQ(myReason.theSyscall->theIsEntry,
+                      myStops.size() % 2 == 0);
+            myStops.push_back(*myReason.theSyscall);
+            myProc->resume();
+            myReason = myProc->waitOnSignal();
+        }
+        EXPECT_EQ(myReason, StopReason{0});
+        ASSERT_FALSE(myStops.empty());
+        EXPECT_EQ(myStops.back().theNumber, SYS_exit_group);
+
+        auto myWrite = std::ranges::find(myStops, SYS_write,
+                                         &SyscallStop::theNumber);
+        ASSERT_TRUE(myWrite != myStops.end() and
+                    myWrite + 1 != myStops.end());
+        EXPECT_EQ(myWrite->theArgs[2], 12);
+        EXPECT_EQ((myWrite + 1)->theResult, 12);
+        EXPECT_EQ(toStringView(myPipe.read()), "Hello, sdb!\n");
+    }
+
+    TEST(ProcessTest, CatchesSystemCallsOfAttachedProcessesWithoutAFilter) {
+        Pipe myPipe(false);
+        auto myLaunched = Process::launch("yes", false, myPipe.getWrite());
+        myPipe.closeWrite();
+        auto myProc = Process::attach(myLaunched->getPid());
+
+        // The process goes on as it was once sdb detaches
+        myProc->setSyscallCatchPolicy({SYS_write});
+        myProc->resume();
+        auto myReason = myProc->waitOnSignal();
+        ASSERT_TRUE(myReason.theSyscall);
+        EXPECT_EQ(myReason.theSyscall->theNumber, SYS_write);
+        EXPECT_TRUE(myReason.theSyscall->theIsEntry);
+        EXPECT_FALSE(hasSeccompFilter(myProc->getPid()));
+    }
+
+    TEST(ProcessTest, SignalPoliciesDecideStopsAndDelivery) {
+        // Signals that do not stop are counted and delivered without a
+        // report, and one that stops is delivered on resume
+        auto myProc = Process::launch("test/targets/signals");
+        myProc->setSignalPolicy(SIGUSR1, SignalPolicy{false, true, false});
+        std::vector<int> myPrinted;
+        myProc->setSignalHandler(
+            [&](int aSignal) { myPrinted.push_back(aSignal); });
+
+        myProc->resume();
+        auto myReason = myProc->waitOnSignal();
+        EXPECT_EQ(myReason.theStopState, ProcessState::Stopped);
+        EXPECT_EQ(myReason.theStatus, SIGUSR2);
+        EXPECT_EQ(myProc->getSignalCount(SIGUSR1), 100);
+        EXPECT_EQ(myProc->getSignalCount(SIGUSR2), 1);
+        EXPECT_TRUE(myPrinted.empty());
+
+        myProc->resume();
+        EXPECT_EQ(myProc->waitOnSignal(), StopReason{W_EXITCODE(101, 0)});
+
+        // Not passed, the signals never reach the handlers
+        myProc = Process::launch("test/targets/signals");
+        myProc->setSignalPolicy(SIGUSR1, SignalPolicy{false, false, true});
+        myProc->setSignalPolicy(SIGUSR2, SignalPolicy{true, false, true});
+        myProc->setSignalHandler(
+            [&](int aSignal) { myPrinted.push_back(aSignal); });
+
+        myProc->resume();
+        EXPECT_EQ(myProc->waitOnSignal().theStatus, SIGUSR2);
+        EXPECT_EQ(myPrinted, std::vector<int>(100, SIGUSR1));
+        myProc->resume();
+        EXPECT_EQ(myProc->waitOnSignal(), StopReason{W_EXITCODE(0, 0)});
+
+        EXPECT_THROW(
+            myProc->setSignalPolicy(SIGTRAP, SignalPolicy{false, true, true}),
+            Error);
+    }
+
 } // namespace sdb::test
@@ -0,0 +1,60 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <process.hpp>
+#include <profiler.hpp>
+#include <sstream>
+#include <string>
+#include <target.hpp>
+
+namespace sdb::test {
+
+    TEST(ProfilerTest, SamplesRunningProcess) {
+        using namespace std::chrono_literals;
+
+        auto myTarget = Target::launch("test/targets/busy");
+        auto& myProcess = myTarget->getProcess();
+
+        Profiler myProfiler{*myTarget, 200};
+        auto myReason = myProfiler.run(300ms);
+        EXPECT_EQ(myReason.theStopState, ProcessState::Stopped);
+        EXPECT_EQ(myReason.theStatus, SIGSTOP);
+
+        ASSERT_GE(myProfiler.getNumSamples(), 10);
+        EXPECT_LE(myProfiler.getNumStacks(), myProfiler.getNumSamples());
+        for (auto myPause : myProfiler.getPauses()) {
+            EXPECT_GT(myPause.count(), 0);
+        }
+
+        std::ostringstream myFolded;
+        myProfiler.writeFoldedStacks(myFolded);
+        EXPECT_NE(myFolded.str().find("main;work;spin "), std::string::npos)
+            << myFolded.str();
+
+        // No stop signal is left over to interrupt the next continue
+        myProcess.resume();
+        auto myNext = myProcess.interrupt();
+        EXPECT_EQ(myNext.theStatus, SIGSTOP);
+    }
+
+    TEST(ProfilerTest, EndsAtBreakpoint) {
+        using namespace std::chrono_literals;
+
+        auto myTarget = Target::launch("test/targets/busy");
+        auto& myProcess = myTarget->getProcess();
+
+        auto mySpin = myTarget->findSymbolAddresses("spin");
+        ASSERT_FALSE(mySpin.empty());
+        myProcess.createBreakpointSite(mySpin.front()).enable();
+
+        Profiler myProfiler{*myTarget, 200};
+        auto myReason = myProfiler.run(10s);
+        EXPECT_EQ(myReason.theStopState, ProcessState::Stopped);
+        EXPECT_EQ(myReason.theStatus, SIGTRAP);
+        EXPECT_EQ(myProcess.getPc(), mySpin.front());
+
+        myProcess.resume();
+        EXPECT_EQ(myProcess.waitOnSignal().theStatus, SIGTRAP);
+    }
+
+} // namespace sdb::test
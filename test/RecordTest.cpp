@@ -0,0 +1,149 @@
+#include "gtest/gtest.h"
+
+#include <TestUtil.hpp>
+#include <chrono>
+#include <error.hpp>
+#include <filesystem>
+#include <fmt/format.h>
+#include <memory_operations.hpp>
+#include <pipe.hpp>
+#include <process.hpp>
+#include <string>
+#include <target.hpp>
+#include <unistd.h>
+
+namespace sdb::test {
+
+    TEST(RecordTest, ReversesToEarlierBreakpoint) {
+        auto myTarget = Target::launch("test/targets/call_functions");
+        auto& myProc = myTarget->getProcess();
+        auto myAdd = myTarget->findSymbolAddresses("add_and_count");
+        auto myMain = myTarget->findSymbolAddresses("main");
+        ASSERT_EQ(myAdd.size(), 1);
+        ASSERT_EQ(myMain.size(), 1);
+
+        myProc.createBreakpointSite(myMain.front()).enable();
+        myProc.resume();
+        myProc.waitOnSignal();
+        ASSERT_EQ(myProc.getPc(), myMain.front());
+
+        // The stack main writes on the way to the call
+        auto mySp = myProc.getRegisters().getRegisterData().regs.rsp;
+        auto myStack = readMemory(myProc.getPid(), VirtualAddress{mySp - 64},
+                                  64);
+
+        myProc.startRecording(1 << 20);
+        EXPECT_THROW(myProc.reverseStepInstruction(), Error);
+
+        myProc.createBreakpointSite(myAdd.front()).enable();
+        myProc.resume();
+        auto myReason = myProc.waitOnSignal();
+        EXPECT_EQ(myReason.theStatus, SIGTRAP);
+        ASSERT_EQ(myProc.getPc(), myAdd.front());
+
+        auto* myRecorder = myProc.getRecorder();
+        ASSERT_GT(myRecorder->getNumRecords(), 0);
+        std::chrono::duration<double> myTime =
+            myRecorder->getRecordingTime();
+        RecordProperty("instructions_per_second",
+                       std::to_string(myRecorder->getNumRecorded() /
+                                      myTime.count()));
+        RecordProperty("bytes_per_instruction",
+                       std::to_string(myRecorder->getBytesRecorded() /
+                                      myRecorder->getNumRecorded()));
+
+        // One step back is the call, and stepping forward returns here
+        myProc.reverseStepInstruction();
+        EXPECT_NE(myProc.getPc(), myAdd.front());
+        myProc.stepInstruction();
+        EXPECT_EQ(myProc.getPc(), myAdd.front());
+
+        myProc.reverseContinue();
+        EXPECT_EQ(myProc.getPc(), myMain.front());
+        EXPECT_EQ(myProc.getRegisters().getRegisterData().regs.rsp, mySp);
+        EXPECT_EQ(readMemory(myProc.getPid(), VirtualAddress{mySp - 64}, 64),
+                  myStack);
+        EXPECT_EQ(myRecorder->getNumRecords(), 0);
+
+        // Running forward again takes the same path
+        myProc.resume();
+        myProc.waitOnSignal();
+        EXPECT_EQ(myProc.getPc(), myAdd.front());
+
+        myProc.stopRecording();
+        myProc.resume();
+        myReason = myProc.waitOnSignal();
+        EXPECT_EQ(myReason.theStopState, ProcessState::Exited);
+        EXPECT_EQ(myReason.theStatus, 0);
+    }
+
+    namespace {
+        // Runs the target to its exit, logging its system calls as asked,
+        // and returns what it printed
+        std::string runNondeterministic(
+            const std::filesystem::path& aLog,
+            std::optional<SyscallRecorder::Mode> aMode) {
+            Pipe myPipe(false);
+            auto myProc = Process::launch("test/targets/nondeterministic",
+                                          true, myPipe.getWrite());
+            myPipe.closeWrite();
+
+            if (aMode == SyscallRecorder::Mode::Record) {
+                myProc->recordSyscalls(aLog);
+            } else if (aMode == SyscallRecorder::Mode::Replay) {
+                myProc->replaySyscalls(aLog);
+            }
+
+            myProc->resume();
+            auto myReason = myProc->waitOnSignal();
+            EXPECT_EQ(myReason, StopReason{0});
+            if (auto* myRecorder = myProc->getSyscallRecorder()) {
+                EXPECT_GT(myRecorder->getNumCalls(), 0);
+                EXPECT_FALSE(myRecorder->getDivergence());
+            }
+            myProc->stopSyscallLog();
+
+            return std::string{toStringView(myPipe.read())};
+        }
+    } // namespace
+
+    TEST(RecordTest, ReplaysSystemCallResults) {
+        auto myLog = std::filesystem::temp_directory_path() /
+                     fmt::format("sdb_syscalls_{}.log", getpid());
+
+        auto myRecorded =
+            runNondeterministic(myLog, SyscallRecorder::Mode::Record);
+        EXPECT_NE(runNondeterministic(myLog, std::nullopt), myRecorded);
+        EXPECT_EQ(runNondeterministic(myLog, SyscallRecorder::Mode::Replay),
+                  myRecorded);
+
+        // A replay stops where the log ends, and the process then makes
+        // its own calls
+        Process::launch("test/targets/nondeterministic", true)
+            ->recordSyscalls(myLog);
+        auto myProc = Process::launch("test/targets/nondeterministic", true);
+        myProc->replaySyscalls(myLog);
+        myProc->resume();
+        auto myReason = myProc->waitOnSignal();
+        EXPECT_EQ(myReason.theStopState, ProcessState::Stopped);
+        EXPECT_EQ(myReason.theStatus, SIGTRAP);
+        EXPECT_TRUE(myProc->getSyscallRecorder()->getDivergence());
+        myProc->resume();
+        EXPECT_EQ(myProc->waitOnSignal(), StopReason{0});
+
+        std::filesystem::remove(myLog);
+    }
+
+    TEST(RecordTest, LogsOnlyProcessesSdbLaunched) {
+        auto myLog = std::filesystem::temp_directory_path() /
+                     fmt::format("sdb_attached_{}.log", getpid());
+        auto myLaunched = Process::launch("yes", false);
+        auto myAttached = Process::attach(myLaunched->getPid());
+
+        EXPECT_THROW(myAttached->recordSyscalls(myLog), Error);
+        EXPECT_FALSE(myAttached->getSyscallRecorder());
+
+        std::filesystem::remove(myLog);
+    }
+
+} // namespace sdb::test
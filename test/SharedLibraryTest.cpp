@@ -0,0 +1,74 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <process.hpp>
+#include <shared_libraries.hpp>
+#include <target.hpp>
+
+namespace sdb::test {
+    namespace {
+        bool hasLibrary(const Target& aTarget, std::string_view aName) {
+            auto& myLibraries = aTarget.getSharedLibraries().getLibraries();
+            return std::ranges::any_of(myLibraries, [&](auto& aLibrary) {
+                return aLibrary->thePath.find(aName) != std::string::npos;
+            });
+        }
+    } // namespace
+
+    TEST(SharedLibraryTest, FindsLibrariesLoadedAtStartup) {
+        auto myTarget = Target::launch("test/targets/hello_sdb");
+        EXPECT_TRUE(myTarget->getSharedLibraries().getLibraries().empty());
+
+        auto myMain = myTarget->findSymbolAddresses("main");
+        ASSERT_EQ(myMain.size(), 1);
+
+        auto& myProcess = myTarget->getProcess();
+        myProcess.createBreakpointSite(myMain.front()).enable();
+        myProcess.resume();
+        auto myReason = myProcess.waitOnSignal();
+
+        // The internal breakpoints along the way are not reported
+        ASSERT_EQ(myReason.theStopState, ProcessState::Stopped);
+        EXPECT_EQ(myProcess.getPc(), myMain.front());
+        EXPECT_TRUE(hasLibrary(*myTarget, "libc.so"));
+
+        auto myPuts = myTarget->findSymbolAddresses("puts");
+        ASSERT_FALSE(myPuts.empty());
+        auto myLocation = myTarget->symbolize(myPuts.front());
+        ASSERT_TRUE(myLocation.has_value());
+        EXPECT_EQ(myLocation->theOffset, 0);
+    }
+
+    TEST(SharedLibraryTest, PendingBreakpointResolvesOnDlopen) {
+        auto myTarget = Target::launch("test/targets/load_plugin");
+        myTarget->addPendingBreakpoint("plugin_function");
+
+        auto& myProcess = myTarget->getProcess();
+        myProcess.resume();
+        auto myReason = myProcess.waitOnSignal();
+
+        ASSERT_EQ(myReason.theStopState, ProcessState::Stopped);
+        EXPECT_TRUE(hasLibrary(*myTarget, "libplugin.so"));
+        EXPECT_TRUE(myTarget->getPendingBreakpoints().empty());
+
+        auto myLocation = myTarget->symbolize(myProcess.getPc());
+        ASSERT_TRUE(myLocation.has_value());
+        EXPECT_EQ(myLocation->theName, "plugin_function");
+        EXPECT_EQ(myLocation->theOffset, 0);
+
+        auto myFrames = myTarget->backtrace(8);
+        ASSERT_GE(myFrames.size(), 2);
+        auto myCaller = myTarget->symbolize(myFrames[1].getCallSite());
+        ASSERT_TRUE(myCaller.has_value());
+        EXPECT_EQ(myCaller->theName, "main");
+
+        // Only changes to the link_map list cause it to be walked
+        auto myNumUpdates = myTarget->getSharedLibraries().getNumUpdates();
+        EXPECT_LE(myNumUpdates, 3);
+
+        myProcess.resume();
+        myReason = myProcess.waitOnSignal();
+        EXPECT_EQ(myReason.theStopState, ProcessState::Exited);
+        EXPECT_EQ(myReason.theStatus, 0);
+    }
+} // namespace sdb::test
@@ -0,0 +1,119 @@
+#include "gtest/gtest.h"
+#include <gmock/gmock.h>
+
+#include <cstring>
+#include <elf_file.hpp>
+#include <error.hpp>
+#include <fstream>
+#include <iterator>
+#include <process.hpp>
+#include <target.hpp>
+
+namespace sdb::test {
+    TEST(SymbolTest, LooksUpSymbolsInElfFile) {
+        ElfFile myElf{"test/targets/hello_sdb"};
+
+        auto myMains = myElf.getSymbolsByName("main");
+        ASSERT_EQ(myMains.size(), 1);
+
+        auto* myMain = myMains.front();
+        EXPECT_EQ(myElf.getSymbolName(*myMain), "main");
+        EXPECT_GT(myMain->theSize, 0);
+
+        EXPECT_EQ(myElf.getSymbolContainingAddress(myMain->theAddress), myMain);
+        EXPECT_EQ(myElf.getSymbolContainingAddress(myMain->theAddress +
+                                                   myMain->theSize - 1),
+                  myMain);
+
+        EXPECT_TRUE(myElf.getSymbolsByName("no_such_symbol").empty());
+    }
+
+    TEST(SymbolTest, SymbolsAreSortedByAddress) {
+        ElfFile myElf{"test/targets/hello_sdb"};
+
+        auto mySymbols = myElf.getSymbols();
+        EXPECT_FALSE(mySymbols.empty());
+        EXPECT_TRUE(std::ranges::is_sorted(mySymbols, {},
+                                           &ElfSymbol::theAddress));
+    }
+
+    TEST(SymbolTest, ThrowsIfFileDoesNotExist) {
+        EXPECT_THROW(ElfFile{"test/targets/does_not_exist"}, sdb::Error);
+    }
+
+    TEST(SymbolTest, ThrowsOnOffsetsPastTheImage) {
+        std::ifstream myFile{"test/targets/hello_sdb", std::ios::binary};
+        std::vector<char> myChars{std::istreambuf_iterator<char>{myFile}, {}};
+        std::vector<std::byte> myImage(myChars.size());
+        std::memcpy(myImage.data(), myChars.data(), myChars.size());
+        EXPECT_NO_THROW(ElfFile(myImage, "<image>").getSymbols());
+
+        Elf64_Ehdr myHeader;
+        std::memcpy(&myHeader, myImage.data(), sizeof(myHeader));
+        auto myBadOffset = myHeader;
+        myBadOffset.e_shoff = myImage.size() - sizeof(Elf64_Shdr) / 2;
+        auto myBadImage = myImage;
+        std::memcpy(myBadImage.data(), &myBadOffset, sizeof(myBadOffset));
+        EXPECT_THROW(ElfFile(myBadImage, "<image>"), sdb::Error);
+
+        // A copy of the image with a section's header changed
+        ElfFile myElf{myImage, "<image>"};
+        auto myPatched = [&](const Elf64_Shdr& aSection, auto aChange) {
+            auto myIndex = &aSection - myElf.getSectionHeaders().data();
+            auto myChanged = aSection;
+            aChange(myChanged);
+            auto myCopy = myImage;
+            std::memcpy(myCopy.data() + myHeader.e_shoff +
+                            myIndex * sizeof(Elf64_Shdr),
+                        &myChanged, sizeof(myChanged));
+            return myCopy;
+        };
+
+        // The symbol table's strings are looked for in a missing section
+        auto* mySymbolTable = myElf.getSection(".symtab");
+        ASSERT_NE(mySymbolTable, nullptr);
+        myBadImage = myPatched(*mySymbolTable,
+                               [](Elf64_Shdr& aSection) {
+                                   aSection.sh_link = 0xffff;
+                               });
+        EXPECT_THROW(ElfFile(myBadImage, "<image>").getSymbols(), sdb::Error);
+
+        // The same for the symbols the PLT relocations name, and the
+        // relocations themselves past the end
+        auto* myRelocations = myElf.getSection(".rela.plt");
+        ASSERT_NE(myRelocations, nullptr);
+        EXPECT_NO_THROW(myElf.getPltStubs());
+        myBadImage = myPatched(
+            myElf.getSectionHeaders()[myRelocations->sh_link],
+            [](Elf64_Shdr& aSection) { aSection.sh_link = 0xffff; });
+        EXPECT_THROW(ElfFile(myBadImage, "<image>").getPltStubs(),
+                     sdb::Error);
+        myBadImage = myPatched(*myRelocations, [&](Elf64_Shdr& aSection) {
+            aSection.sh_offset = myImage.size();
+        });
+        EXPECT_THROW(ElfFile(myBadImage, "<image>").getPltStubs(),
+                     sdb::Error);
+    }
+
+    TEST(SymbolTest, BreakpointOnSymbolIsHit) {
+        auto myTarget = Target::launch("test/targets/hello_sdb");
+        auto& myProcess = myTarget->getProcess();
+
+        auto myAddresses = myTarget->findSymbolAddresses("main");
+        ASSERT_EQ(myAddresses.size(), 1);
+
+        myProcess.createBreakpointSite(myAddresses.front()).enable();
+        myProcess.resume();
+        auto myReason = myProcess.waitOnSignal();
+
+        EXPECT_EQ(myReason.theStopState, ProcessState::Stopped);
+        EXPECT_EQ(myReason.theStatus, SIGTRAP);
+        EXPECT_EQ(myProcess.getPc(), myAddresses.front());
+
+        auto myLocation = myTarget->symbolize(myProcess.getPc());
+        ASSERT_TRUE(myLocation.has_value());
+        EXPECT_EQ(myLocation->theName, "main");
+        EXPECT_EQ(myLocation->theOffset, 0);
+    }
+
+} // namespace sdb::test
@@ -0,0 +1,114 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <latency_histogram.hpp>
+#include <pipe.hpp>
+#include <process.hpp>
+#include <sstream>
+#include <string>
+#include <sys/syscall.h>
+#include <syscall_profiler.hpp>
+#include <vector>
+
+namespace sdb::test {
+
+    TEST(SyscallProfilerTest, HistogramKeepsRelativePrecision) {
+        using std::chrono::nanoseconds;
+
+        LatencyHistogram myHistogram;
+        EXPECT_EQ(myHistogram.getQuantile(0.5), nanoseconds{0});
+
+        for (std::int64_t myValue = 1; myValue <= 1000; ++myValue) {
+            myHistogram.record(nanoseconds{myValue * 1000});
+        }
+        EXPECT_EQ(myHistogram.getCount(), 1000);
+        EXPECT_EQ(myHistogram.getMin(), nanoseconds{1000});
+        EXPECT_EQ(myHistogram.getMax(), nanoseconds{1000000});
+        EXPECT_EQ(myHistogram.getQuantile(1.0), nanoseconds{1000000});
+
+        // Never below the true value and at most a bucket's width above
+        for (double myFraction : {0.5, 0.9, 0.99}) {
+            auto myExact = static_cast<std::int64_t>(myFraction * 1000) * 1000;
+            auto myValue = myHistogram.getQuantile(myFraction).count();
+            EXPECT_GE(myValue, myExact);
+            EXPECT_LE(myValue,
+                      myExact + myExact / LatencyHistogram::SUB_BUCKETS);
+        }
+
+        LatencyHistogram myOther;
+        myOther.record(nanoseconds{5});
+        myHistogram.merge(myOther);
+        EXPECT_EQ(myHistogram.getCount(), 1001);
+        EXPECT_EQ(myHistogram.getMin(), nanoseconds{5});
+    }
+
+    TEST(SyscallProfilerTest, TimesSystemCalls) {
+        using namespace std::chrono_literals;
+
+        Pipe myPipe(false);
+        auto myProc = Process::launch("test/targets/syscall_latency", true,
+                                      myPipe.getWrite());
+        myPipe.closeWrite();
+        myProc->setSyscallCatchPolicy({SYS_exit_group});
+
+        SyscallProfiler myProfiler{
+            *myProc,
+            {SYS_nanosleep, SYS_clock_nanosleep, SYS_getppid, SYS_write},
+            true};
+        EXPECT_EQ(myProfiler.run(30s), StopReason{0});
+
+        // The catchpoint did not stop the profile but is back afterwards
+        EXPECT_EQ(myProc->getCaughtSyscalls(),
+                  std::vector<std::uint64_t>{SYS_exit_group});
+
+        auto& myStats = myProfiler.getStats();
+        LatencyHistogram mySleeps;
+        for (std::uint64_t myNumber : {SYS_nanosleep, SYS_clock_nanosleep}) {
+            if (auto myIt = myStats.find({myNumber, std::nullopt});
+                myIt != myStats.end()) {
+                mySleeps.merge(myIt->second.theLatencies);
+            }
+        }
+        EXPECT_EQ(mySleeps.getCount(), 5);
+        EXPECT_GE(mySleeps.getMin(), 20ms);
+
+        auto& myGetppid = myStats.at({SYS_getppid, std::nullopt});
+        EXPECT_EQ(myGetppid.theLatencies.getCount(), 100);
+        EXPECT_EQ(myGetppid.theNumErrors, 0);
+        EXPECT_LT(myGetppid.theLatencies.getQuantile(0.99), 20ms);
+
+        // Split by file descriptor
+        EXPECT_EQ(myStats.at({SYS_write, 1}).theLatencies.getCount(), 1);
+        EXPECT_EQ(myStats.at({SYS_write, 2}).theLatencies.getCount(), 1);
+
+        // A stop at entry to and return from each call
+        EXPECT_EQ(myProfiler.getOverhead().getCount(), 2 * (5 + 100 + 2));
+
+        std::ostringstream myTable;
+        myProfiler.writeTable(myTable);
+        EXPECT_NE(myTable.str().find("getppid"), std::string::npos)
+            << myTable.str();
+    }
+
+    TEST(SyscallProfilerTest, TimesEveryCallWhenNoneAreGiven) {
+        using namespace std::chrono_literals;
+
+        Pipe myPipe(false);
+        auto myProc = Process::launch("test/targets/syscall_latency", true,
+                                      myPipe.getWrite());
+        myPipe.closeWrite();
+
+        SyscallProfiler myProfiler{*myProc, {}, false};
+        EXPECT_EQ(myProfiler.run(30s), StopReason{0});
+        EXPECT_FALSE(myProc->isCatchingAllSyscalls());
+
+        auto& myStats = myProfiler.getStats();
+        EXPECT_EQ(myStats.at({SYS_getppid, std::nullopt})
+                      .theLatencies.getCount(),
+                  100);
+        EXPECT_EQ(myStats.at({SYS_write, std::nullopt})
+                      .theLatencies.getCount(),
+                  2);
+    }
+
+} // namespace sdb::test
@@ -0,0 +1,253 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fmt/format.h>
+#include <function_tracer.hpp>
+#include <memory_operations.hpp>
+#include <process.hpp>
+#include <sstream>
+#include <string>
+#include <target.hpp>
+#include <tracepoint.hpp>
+#include <vector>
+
+namespace sdb::test {
+    namespace {
+        std::vector<TraceCapture>
+        parseCaptures(std::initializer_list<std::string_view> aSpecs) {
+            std::vector<TraceCapture> myCaptures;
+            for (auto mySpec : aSpecs) {
+                auto myCapture = TraceCapture::parse(mySpec);
+                EXPECT_TRUE(myCapture.has_value()) << mySpec;
+                if (myCapture) {
+                    myCaptures.push_back(std::move(*myCapture));
+                }
+            }
+
+            return myCaptures;
+        }
+
+        // Every record comes from the first tracepoint
+        std::vector<std::string>
+        formatAll(const std::vector<Tracepoint>& aTracepoints,
+                  const TraceBuffer& aBuffer, std::string_view aFormat) {
+            std::vector<std::string> myLines;
+            aBuffer.forEach([&](const TraceRecordHeader& aHeader,
+                                std::span<const std::byte> aPayload) {
+                EXPECT_EQ(aHeader.theTracepoint, aTracepoints.front().theId);
+                myLines.push_back(
+                    formatTraceRecord(aTracepoints.front(), aPayload, aFormat));
+            });
+
+            return myLines;
+        }
+    } // namespace
+
+    TEST(TraceTest, ParsesCaptures) {
+        auto myRegister = TraceCapture::parse("rdi");
+        ASSERT_TRUE(myRegister.has_value());
+        EXPECT_EQ(myRegister->theRegister->theId, RegisterId::rdi);
+        EXPECT_FALSE(myRegister->theSize.has_value());
+
+        auto myMemory = TraceCapture::parse("[rsi + 0x10, 64]");
+        ASSERT_TRUE(myMemory.has_value());
+        EXPECT_EQ(myMemory->theRegister->theId, RegisterId::rsi);
+        EXPECT_EQ(myMemory->theOffset, 0x10);
+        EXPECT_EQ(myMemory->theSize, 64);
+
+        auto myFixed = TraceCapture::parse("[0x1000, 8]");
+        ASSERT_TRUE(myFixed.has_value());
+        EXPECT_EQ(myFixed->theRegister, nullptr);
+        EXPECT_EQ(myFixed->theOffset, 0x1000);
+
+        EXPECT_FALSE(TraceCapture::parse("edi").has_value());
+        EXPECT_FALSE(TraceCapture::parse("[rdi]").has_value());
+        EXPECT_FALSE(TraceCapture::parse("[rdi, 0]").has_value());
+    }
+
+    TEST(TraceTest, BufferOverwritesOldestRecords) {
+        // Room for two records of a header and one register
+        TraceBuffer myBuffer{2 * (sizeof(TraceRecordHeader) + 8) + 4};
+
+        for (std::uint64_t i = 0; i < 5; ++i) {
+            EXPECT_TRUE(myBuffer.push(
+                TraceRecordHeader{1, 8, i},
+                std::as_bytes(std::span<const std::uint64_t>{&i, 1})));
+        }
+
+        EXPECT_EQ(myBuffer.getNumRecords(), 2);
+        EXPECT_EQ(myBuffer.getNumDropped(), 3);
+
+        std::vector<std::uint64_t> myValues;
+        myBuffer.forEach([&](const TraceRecordHeader& aHeader,
+                             std::span<const std::byte> aPayload) {
+            std::uint64_t myValue;
+            std::memcpy(&myValue, aPayload.data(), sizeof(myValue));
+            EXPECT_EQ(aHeader.theTimestamp, myValue);
+            myValues.push_back(myValue);
+        });
+        EXPECT_EQ(myValues, (std::vector<std::uint64_t>{3, 4}));
+    }
+
+    TEST(TraceTest, CollectsWithoutStopping) {
+        auto myTarget = Target::launch("test/targets/trace_calls");
+        auto myRecord = myTarget->findSymbolAddresses("record");
+        ASSERT_EQ(myRecord.size(), 1);
+
+        auto& myTracer = myTarget->getTracer();
+        myTracer.add(myRecord.front(), parseCaptures({"rsi", "[rdi, 32]"}));
+
+        auto& myProcess = myTarget->getProcess();
+        myProcess.resume();
+        auto myReason = myProcess.waitOnSignal();
+        EXPECT_EQ(myReason.theStopState, ProcessState::Exited);
+
+        auto& myTracepoint = *myTracer.getTracepoints().front();
+        EXPECT_EQ(myTracepoint.theNumHits, 100);
+        EXPECT_EQ(myTracer.getBuffer().getNumRecords(), 100);
+        EXPECT_EQ(myTracer.getBuffer().getNumDropped(), 0);
+        EXPECT_EQ(myTracer.getNumResumes(), 100);
+        EXPECT_GT(myTracer.getMaxLatency().count(), 0);
+
+        auto myLines = formatAll({myTracepoint}, myTracer.getBuffer(),
+                                 "i=%d msg=%s");
+        ASSERT_EQ(myLines.size(), 100);
+        EXPECT_EQ(myLines.front(), "i=0 msg=hello tracepoint");
+        EXPECT_EQ(myLines.back(), "i=99 msg=hello tracepoint");
+
+        auto myPath = std::filesystem::temp_directory_path() /
+                      fmt::format("sdb_trace_{}", myProcess.getPid());
+        myTracer.save(myPath);
+        auto myTrace = loadTrace(myPath);
+        std::filesystem::remove(myPath);
+
+        ASSERT_EQ(myTrace.theTracepoints.size(), 1);
+        EXPECT_EQ(myTrace.theTracepoints.front().theNumHits, 100);
+        EXPECT_EQ(formatAll(myTrace.theTracepoints, myTrace.theBuffer,
+                            "i=%d msg=%s"),
+                  myLines);
+    }
+
+    TEST(TraceTest, FastTracepointsNeverStop) {
+        auto myTarget = Target::launch("test/targets/trace_calls");
+        auto myRecord = myTarget->findSymbolAddresses("record");
+        ASSERT_EQ(myRecord.size(), 1);
+
+        auto& myTracer = myTarget->getTracer();
+        EXPECT_THROW(myTracer.addFast(myRecord.front(),
+                                      parseCaptures({"[rdi, 32]"})),
+                     Error);
+
+        myTracer.addFast(myRecord.front(), parseCaptures({"rsi", "rip"}));
+
+        auto& myProcess = myTarget->getProcess();
+        myProcess.resume();
+        auto myReason = myProcess.waitOnSignal();
+        EXPECT_EQ(myReason.theStopState, ProcessState::Exited);
+
+        myTracer.collect();
+        auto& myTracepoint = *myTracer.getTracepoints().front();
+        EXPECT_TRUE(myTracepoint.theIsFast);
+        EXPECT_EQ(myTracepoint.theNumHits, 100);
+        EXPECT_EQ(myTracer.getBuffer().getNumRecords(), 100);
+        EXPECT_EQ(myTracer.getBuffer().getNumDropped(), 0);
+        EXPECT_EQ(myTracer.getNumResumes(), 0);
+
+        auto myLines = formatAll({myTracepoint}, myTracer.getBuffer(),
+                                 "i=%d pc=%x");
+        ASSERT_EQ(myLines.size(), 100);
+        auto myPc = std::to_underlying(myRecord.front());
+        EXPECT_EQ(myLines.front(), fmt::format("i=0 pc={:#x}", myPc));
+        EXPECT_EQ(myLines.back(), fmt::format("i=99 pc={:#x}", myPc));
+    }
+
+    TEST(TraceTest, FunctionTracerTimesCalls) {
+        using namespace std::chrono_literals;
+
+        auto myTarget = Target::launch("test/targets/timed_calls");
+        auto& myTracer = myTarget->getFunctionTracer();
+        for (auto myName : {"sleep_ms", "depth"}) {
+            auto myEntries = myTarget->findSymbolAddresses(myName);
+            ASSERT_EQ(myEntries.size(), 1);
+            myTracer.add(myName, myEntries.front());
+        }
+
+        auto& myProcess = myTarget->getProcess();
+        myProcess.resume();
+        auto myReason = myProcess.waitOnSignal();
+        EXPECT_EQ(myReason.theStopState, ProcessState::Exited);
+        EXPECT_EQ(myReason.theStatus, 0);
+
+        auto& mySleep = *myTracer.getFunctions()[0];
+        EXPECT_EQ(mySleep.theNumCalls, 5);
+        EXPECT_EQ(mySleep.theLatencies.getCount(), 5);
+        EXPECT_GE(mySleep.theLatencies.getMin(), 10ms);
+
+        // Each of the three outer calls recurses ten deep
+        auto& myDepth = *myTracer.getFunctions()[1];
+        EXPECT_EQ(myDepth.theNumCalls, 33);
+        EXPECT_EQ(myDepth.theLatencies.getCount(), 33);
+
+        auto& myCalls = myTracer.getCalls();
+        ASSERT_EQ(myCalls.size(), 38);
+        std::uint32_t myMaxDepth = 0;
+        for (auto& myCall : myCalls) {
+            myMaxDepth = std::max(myMaxDepth, myCall.theDepth);
+        }
+        EXPECT_EQ(myMaxDepth, 10);
+        EXPECT_EQ(myTracer.getNumDroppedCalls(), 0);
+        EXPECT_EQ(myTracer.getOverhead().getCount(), 76);
+
+        std::ostringstream myTrace;
+        myTracer.writeChromeTrace(myTrace);
+        EXPECT_NE(myTrace.str().find("\"traceEvents\""), std::string::npos);
+        EXPECT_NE(myTrace.str().find("\"sleep_ms\""), std::string::npos);
+    }
+
+    TEST(TraceTest, PltTracerTimesLibraryCalls) {
+        using namespace std::chrono_literals;
+
+        auto myTarget = Target::launch("test/targets/timed_calls");
+        std::vector<std::string> myNone;
+        std::vector<std::string> mySleeps{"nano*"};
+        auto myStubs = myTarget->findPltStubs(myNone, myNone);
+        EXPECT_EQ(myTarget->findPltStubs(mySleeps, myNone).size(), 1);
+        EXPECT_EQ(myTarget->findPltStubs(myNone, mySleeps).size(),
+                  myStubs.size() - 1);
+
+        auto& myProcess = myTarget->getProcess();
+        std::vector<std::vector<std::byte>> myOriginals;
+        for (auto& myStub : myStubs) {
+            myOriginals.push_back(
+                readMemory(myProcess.getPid(), myStub.second, 8));
+        }
+
+        auto& myTracer = myTarget->getFunctionTracer();
+        EXPECT_EQ(myTracer.addAll(myStubs), myStubs.size());
+        for (std::size_t i = 0; i < myStubs.size(); ++i) {
+            auto myAddress = myStubs[i].second;
+            EXPECT_EQ(readMemory(myProcess.getPid(), myAddress, 1).front(),
+                      std::byte{0xcc});
+            EXPECT_EQ(readMemoryWithoutBreakpointTraps(myProcess, myAddress, 8),
+                      myOriginals[i]);
+        }
+
+        myProcess.resume();
+        auto myReason = myProcess.waitOnSignal();
+        EXPECT_EQ(myReason.theStopState, ProcessState::Exited);
+        EXPECT_EQ(myReason.theStatus, 0);
+
+        auto mySleep = std::ranges::find(myTracer.getFunctions(),
+                                         "nanosleep@plt", [](auto& aFunction) {
+                                             return aFunction->theName;
+                                         });
+        ASSERT_NE(mySleep, myTracer.getFunctions().end());
+        EXPECT_EQ((*mySleep)->theNumCalls, 5);
+        EXPECT_EQ((*mySleep)->theLatencies.getCount(), 5);
+        EXPECT_GE((*mySleep)->theLatencies.getMin(), 10ms);
+    }
+
+} // namespace sdb::test
@@ -0,0 +1,70 @@
+#include "gtest/gtest.h"
+
+#include <memory_cache.hpp>
+#include <process.hpp>
+#include <target.hpp>
+#include <unwinder.hpp>
+
+namespace sdb::test {
+    namespace {
+        std::unique_ptr<Target> launchToTrap() {
+            auto myTarget = Target::launch("test/targets/recursion");
+            auto& myProcess = myTarget->getProcess();
+            myProcess.resume();
+
+            auto myReason = myProcess.waitOnSignal();
+            EXPECT_EQ(myReason.theStopState, ProcessState::Stopped);
+            EXPECT_EQ(myReason.theStatus, SIGTRAP);
+            return myTarget;
+        }
+
+        std::string_view getFunctionName(const Target& aTarget,
+                                         const StackFrame& aFrame) {
+            auto myLocation = aTarget.symbolize(aFrame.getCallSite());
+            return myLocation ? myLocation->theName : "";
+        }
+    } // namespace
+
+    TEST(UnwindTest, UnwindsDeepRecursion) {
+        auto myTarget = launchToTrap();
+
+        MemoryCache myCache{myTarget->getProcess().getPid()};
+        auto myFrames = Unwinder{*myTarget, myCache}.unwind(200);
+
+        ASSERT_GE(myFrames.size(), 103);
+        EXPECT_EQ(getFunctionName(*myTarget, myFrames[0]), "no_frame_pointer");
+        for (std::size_t i = 1; i <= 101; ++i) {
+            EXPECT_EQ(getFunctionName(*myTarget, myFrames[i]), "recurse")
+                << "frame " << i;
+        }
+        EXPECT_EQ(getFunctionName(*myTarget, myFrames[102]), "main");
+
+        for (std::size_t i = 1; i <= 102; ++i) {
+            EXPECT_GT(myFrames[i].theCfa, myFrames[i - 1].theCfa);
+        }
+
+        // The whole stack comes from a read or two of several pages each
+        EXPECT_LE(myCache.getNumReads(), 4);
+    }
+
+    TEST(UnwindTest, ReusesCachedCallFrameInfo) {
+        auto myTarget = launchToTrap();
+
+        auto myFirst = myTarget->backtrace(200);
+        auto myNumFdes = myTarget->getCallFrameInfo().getNumCachedFdes();
+        EXPECT_GT(myNumFdes, 0);
+
+        auto mySecond = myTarget->backtrace(200);
+        EXPECT_EQ(myTarget->getCallFrameInfo().getNumCachedFdes(), myNumFdes);
+
+        ASSERT_EQ(myFirst.size(), mySecond.size());
+        for (std::size_t i = 0; i < myFirst.size(); ++i) {
+            EXPECT_EQ(myFirst[i].thePc, mySecond[i].thePc);
+        }
+    }
+
+    TEST(UnwindTest, LimitsFrameCount) {
+        auto myTarget = launchToTrap();
+        EXPECT_EQ(myTarget->backtrace(10).size(), 10);
+    }
+} // namespace sdb::test
@@ -0,0 +1,17 @@
+// Spends all of its time two calls below main, for the sampling profiler
+extern "C" [[gnu::noinline]] void spin(volatile unsigned long& aCounter) {
+    for (int i = 0; i < 1000; ++i) {
+        ++aCounter;
+    }
+}
+
+extern "C" [[gnu::noinline]] void work(volatile unsigned long& aCounter) {
+    while (true) {
+        spin(aCounter);
+    }
+}
+
+int main() {
+    volatile unsigned long myCounter = 0;
+    work(myCounter);
+}
@@ -0,0 +1,23 @@
+// Functions for the debugger to call while the process is stopped
+#include <cstring>
+
+extern "C" {
+int theNumCalls = 0;
+
+[[gnu::noinline]] long add_and_count(long aLeft, long aRight) {
+    ++theNumCalls;
+    return aLeft + aRight;
+}
+
+[[gnu::noinline]] unsigned long measure(const char* aText) {
+    return std::strlen(aText);
+}
+
+[[gnu::noinline]] void crash() {
+    *static_cast<volatile int*>(nullptr) = 1;
+}
+}
+
+int main() {
+    return add_and_count(1, 2) == 3 ? 0 : 1;
+}
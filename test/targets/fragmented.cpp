@@ -0,0 +1,45 @@
+// Leaves holes between live blocks, small blocks in the fastbins and
+// tcache, and a second arena made by another thread, for the heap
+// inspector
+#include <cstdlib>
+#include <thread>
+
+void* theThreadKept[10];
+void* theKept[10];
+void* theSmall[20];
+
+extern "C" [[gnu::noinline]] void done() {
+    asm volatile("");
+}
+
+int main() {
+    std::thread myThread{[] {
+        for (auto& myBlock : theThreadKept) {
+            myBlock = std::malloc(500);
+        }
+    }};
+    myThread.join();
+
+    for (auto& myBlock : theSmall) {
+        myBlock = std::malloc(48);
+    }
+
+    // Every other block is freed, so no two holes merge
+    void* myBlocks[20];
+    for (auto& myBlock : myBlocks) {
+        myBlock = std::malloc(2000);
+    }
+    for (int i = 0; i < 20; ++i) {
+        if (i % 2 == 0) {
+            std::free(myBlocks[i]);
+        } else {
+            theKept[i / 2] = myBlocks[i];
+        }
+    }
+
+    // Seven fill the tcache bin and the rest go to a fastbin
+    for (auto& myBlock : theSmall) {
+        std::free(myBlock);
+    }
+    done();
+}
@@ -0,0 +1,37 @@
+// Allocates from known call sites, keeping some blocks and freeing the
+// rest, for the heap profiler
+#include <cstdlib>
+
+extern "C" [[gnu::noinline]] void* keep_buffer(std::size_t aSize) {
+    return std::malloc(aSize);
+}
+
+extern "C" [[gnu::noinline]] void churn() {
+    for (int i = 0; i < 100; ++i) {
+        void* myBlock = std::malloc(64);
+        asm volatile("" : : "r"(myBlock) : "memory");
+        std::free(myBlock);
+    }
+}
+
+extern "C" [[gnu::noinline]] void* grow(void* aBlock) {
+    return std::realloc(aBlock, 4096);
+}
+
+extern "C" [[gnu::noinline]] void done() {
+    asm volatile("");
+}
+
+void* theKept[10];
+
+int main() {
+    churn();
+    for (auto& myBlock : theKept) {
+        myBlock = keep_buffer(1000);
+    }
+
+    void* myArray = std::calloc(16, 32);
+    void* myGrown = grow(std::malloc(100));
+    asm volatile("" : : "r"(myArray), "r"(myGrown) : "memory");
+    done();
+}
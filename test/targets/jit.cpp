@@ -0,0 +1,181 @@
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <elf.h>
+#include <string>
+#include <sys/mman.h>
+#include <vector>
+
+// The GDB JIT interface, as a JIT compiler defines it
+extern "C" {
+enum jit_actions_t { JIT_NOACTION = 0, JIT_REGISTER_FN, JIT_UNREGISTER_FN };
+
+struct jit_code_entry {
+    jit_code_entry* next_entry;
+    jit_code_entry* prev_entry;
+    const char* symfile_addr;
+    std::uint64_t symfile_size;
+};
+
+struct jit_descriptor {
+    std::uint32_t version;
+    std::uint32_t action_flag;
+    jit_code_entry* relevant_entry;
+    jit_code_entry* first_entry;
+};
+
+void __attribute__((noinline)) __jit_debug_register_code() {
+    asm volatile("" ::: "memory");
+}
+
+jit_descriptor __jit_debug_descriptor = {1, 0, nullptr, nullptr};
+}
+
+namespace {
+    constexpr int NUM_FUNCTIONS = 1000;
+    constexpr std::size_t FUNCTION_SIZE = 8;
+
+    struct Registration {
+        std::vector<char> theImage;
+        jit_code_entry theEntry{};
+    };
+
+    // A relocatable object with a single function symbol in a .text
+    // section placed at the code's address, like JIT compilers emit
+    std::vector<char> makeObject(std::uint64_t aCodeAddress,
+                                 const std::string& aName) {
+        const char myShStrTab[] = "\0.text\0.symtab\0.strtab\0.shstrtab";
+        std::string myStrTab = std::string{'\0'} + aName + '\0';
+
+        Elf64_Sym mySymbols[2]{};
+        mySymbols[1].st_name = 1;
+        mySymbols[1].st_info = ELF64_ST_INFO(STB_GLOBAL, STT_FUNC);
+        mySymbols[1].st_shndx = 1;
+        mySymbols[1].st_size = 6;
+
+        auto mySymbolsOffset = sizeof(Elf64_Ehdr);
+        auto myStrTabOffset = mySymbolsOffset + sizeof(mySymbols);
+        auto myShStrTabOffset = myStrTabOffset + myStrTab.size();
+        auto myHeadersOffset =
+            (myShStrTabOffset + sizeof(myShStrTab) + 7) & ~std::size_t{7};
+
+        Elf64_Shdr mySections[5]{};
+        mySections[1] = {.sh_name = 1,
+                         .sh_type = SHT_NOBITS,
+                         .sh_flags = SHF_ALLOC | SHF_EXECINSTR,
+                         .sh_addr = aCodeAddress,
+                         .sh_size = FUNCTION_SIZE,
+                         .sh_addralign = 16};
+        mySections[2] = {.sh_name = 7,
+                         .sh_type = SHT_SYMTAB,
+                         .sh_offset = mySymbolsOffset,
+                         .sh_size = sizeof(mySymbols),
+                         .sh_link = 3,
+                         .sh_info = 1,
+                         .sh_addralign = 8,
+                         .sh_entsize = sizeof(Elf64_Sym)};
+        mySections[3] = {.sh_name = 15,
+                         .sh_type = SHT_STRTAB,
+                         .sh_offset = myStrTabOffset,
+                         .sh_size = myStrTab.size(),
+                         .sh_addralign = 1};
+        mySections[4] = {.sh_name = 23,
+                         .sh_type = SHT_STRTAB,
+                         .sh_offset = myShStrTabOffset,
+                         .sh_size = sizeof(myShStrTab),
+                         .sh_addralign = 1};
+
+        Elf64_Ehdr myHeader{};
+        std::memcpy(myHeader.e_ident, ELFMAG, SELFMAG);
+        myHeader.e_ident[EI_CLASS] = ELFCLASS64;
+        myHeader.e_ident[EI_DATA] = ELFDATA2LSB;
+        myHeader.e_ident[EI_VERSION] = EV_CURRENT;
+        myHeader.e_type = ET_REL;
+        myHeader.e_machine = EM_X86_64;
+        myHeader.e_version = EV_CURRENT;
+        myHeader.e_shoff = myHeadersOffset;
+        myHeader.e_ehsize = sizeof(Elf64_Ehdr);
+        myHeader.e_shentsize = sizeof(Elf64_Shdr);
+        myHeader.e_shnum = 5;
+        myHeader.e_shstrndx = 4;
+
+        std::vector<char> myImage(myHeadersOffset + sizeof(mySections));
+        std::memcpy(myImage.data(), &myHeader, sizeof(myHeader));
+        std::memcpy(myImage.data() + mySymbolsOffset, mySymbols,
+                    sizeof(mySymbols));
+        std::memcpy(myImage.data() + myStrTabOffset, myStrTab.data(),
+                    myStrTab.size());
+        std::memcpy(myImage.data() + myShStrTabOffset, myShStrTab,
+                    sizeof(myShStrTab));
+        std::memcpy(myImage.data() + myHeadersOffset, mySections,
+                    sizeof(mySections));
+        return myImage;
+    }
+
+    void registerCode(jit_code_entry* anEntry) {
+        anEntry->prev_entry = nullptr;
+        anEntry->next_entry = __jit_debug_descriptor.first_entry;
+        if (anEntry->next_entry != nullptr) {
+            anEntry->next_entry->prev_entry = anEntry;
+        }
+        __jit_debug_descriptor.first_entry = anEntry;
+        __jit_debug_descriptor.relevant_entry = anEntry;
+        __jit_debug_descriptor.action_flag = JIT_REGISTER_FN;
+        __jit_debug_register_code();
+    }
+
+    void unregisterCode(jit_code_entry* anEntry) {
+        if (anEntry->prev_entry != nullptr) {
+            anEntry->prev_entry->next_entry = anEntry->next_entry;
+        } else {
+            __jit_debug_descriptor.first_entry = anEntry->next_entry;
+        }
+        if (anEntry->next_entry != nullptr) {
+            anEntry->next_entry->prev_entry = anEntry->prev_entry;
+        }
+        __jit_debug_descriptor.relevant_entry = anEntry;
+        __jit_debug_descriptor.action_flag = JIT_UNREGISTER_FN;
+        __jit_debug_register_code();
+    }
+} // namespace
+
+int main() {
+    auto* myCode = static_cast<unsigned char*>(
+        mmap(nullptr, NUM_FUNCTIONS * FUNCTION_SIZE,
+             PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS,
+             -1, 0));
+    if (myCode == MAP_FAILED) {
+        return 1;
+    }
+
+    // Each function is "mov eax, i; ret"
+    std::vector<Registration> myRegistrations(NUM_FUNCTIONS);
+    for (int i = 0; i < NUM_FUNCTIONS; ++i) {
+        auto* myFunction = myCode + i * FUNCTION_SIZE;
+        myFunction[0] = 0xb8;
+        std::memcpy(myFunction + 1, &i, sizeof(i));
+        myFunction[5] = 0xc3;
+
+        auto& myRegistration = myRegistrations[i];
+        myRegistration.theImage =
+            makeObject(reinterpret_cast<std::uint64_t>(myFunction),
+                       "jit_function_" + std::to_string(i));
+        myRegistration.theEntry.symfile_addr = myRegistration.theImage.data();
+        myRegistration.theEntry.symfile_size = myRegistration.theImage.size();
+        registerCode(&myRegistration.theEntry);
+    }
+
+    auto* myFunction =
+        reinterpret_cast<int (*)()>(myCode + 500 * FUNCTION_SIZE);
+    if (myFunction() != 500) {
+        return 2;
+    }
+
+    for (int i = 0; i < NUM_FUNCTIONS / 2; ++i) {
+        unregisterCode(&myRegistrations[i].theEntry);
+    }
+
+    std::raise(SIGTRAP);
+    return 0;
+}
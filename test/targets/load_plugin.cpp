@@ -0,0 +1,15 @@
+#include <dlfcn.h>
+
+int main() {
+    auto* myHandle = dlopen("test/targets/libplugin.so", RTLD_NOW);
+    if (myHandle == nullptr) {
+        return 1;
+    }
+
+    auto* myFunction =
+        reinterpret_cast<int (*)(int)>(dlsym(myHandle, "plugin_function"));
+    int myResult = myFunction(20);
+
+    dlclose(myHandle);
+    return myResult == 42 ? 0 : 2;
+}
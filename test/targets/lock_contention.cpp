@@ -0,0 +1,51 @@
+// A second thread holds a mutex for a while after the first asks for it,
+// for the lock profiler. Only the first thread locks once sdb is watching.
+#include <atomic>
+#include <pthread.h>
+#include <time.h>
+
+pthread_mutex_t theLock = PTHREAD_MUTEX_INITIALIZER;
+std::atomic<bool> theIsHeld{false};
+std::atomic<bool> theIsWanted{false};
+
+void* hold(void*) {
+    pthread_mutex_lock(&theLock);
+    theIsHeld = true;
+    while (!theIsWanted) {
+    }
+
+    timespec myDelay{0, 50'000'000};
+    nanosleep(&myDelay, nullptr);
+    pthread_mutex_unlock(&theLock);
+    return nullptr;
+}
+
+extern "C" [[gnu::noinline]] void ready() {
+    asm volatile("");
+}
+
+extern "C" [[gnu::noinline]] void wait_for_lock() {
+    theIsWanted = true;
+    pthread_mutex_lock(&theLock);
+    pthread_mutex_unlock(&theLock);
+}
+
+extern "C" [[gnu::noinline]] void done() {
+    asm volatile("");
+}
+
+int main() {
+    pthread_t myThread;
+    pthread_create(&myThread, nullptr, hold, nullptr);
+    while (!theIsHeld) {
+    }
+
+    ready();
+    wait_for_lock();
+    for (int i = 0; i < 10; ++i) {
+        pthread_mutex_lock(&theLock);
+        pthread_mutex_unlock(&theLock);
+    }
+    done();
+    pthread_join(myThread, nullptr);
+}
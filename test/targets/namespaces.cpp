@@ -0,0 +1,28 @@
+#include <cstdio>
+
+namespace outer {
+    namespace inner {
+        int add(int a, int b) {
+            return a + b;
+        }
+    } // namespace inner
+
+    struct Widget {
+        int value() const;
+    };
+
+    int Widget::value() const {
+        return 42;
+    }
+} // namespace outer
+
+namespace {
+    int helper(int x) {
+        return x * 2;
+    }
+} // namespace
+
+int main() {
+    outer::Widget w;
+    std::printf("%d\n", outer::inner::add(w.value(), helper(1)));
+}
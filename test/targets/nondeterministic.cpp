@@ -0,0 +1,23 @@
+// Prints values that differ on every run, for recording and replaying
+// system calls
+#include <cstdio>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/random.h>
+#include <unistd.h>
+
+int main() {
+    timespec myTime;
+    clock_gettime(CLOCK_MONOTONIC, &myTime);
+
+    unsigned myRandom = 0;
+    getrandom(&myRandom, sizeof(myRandom), 0);
+
+    unsigned long myBytes = 0;
+    int myFile = open("/dev/urandom", O_RDONLY);
+    read(myFile, &myBytes, sizeof(myBytes));
+    close(myFile);
+
+    std::printf("%ld.%09ld %u %lu\n", myTime.tv_sec, myTime.tv_nsec,
+                myRandom, myBytes);
+}
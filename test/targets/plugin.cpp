@@ -0,0 +1,3 @@
+extern "C" int plugin_function(int aValue) {
+    return aValue + 22;
+}
@@ -0,0 +1,39 @@
+// Stops with a deep stack for the unwinder. The innermost function keeps
+// no frame pointer and leaves garbage in rbp, so it can only be unwound
+// through its CFI.
+asm(R"(
+    .text
+    .globl no_frame_pointer
+    .type no_frame_pointer, @function
+no_frame_pointer:
+    .cfi_startproc
+    push %rbp
+    .cfi_def_cfa_offset 16
+    .cfi_offset %rbp, -16
+    mov $1, %rbp
+    sub $16, %rsp
+    .cfi_def_cfa_offset 32
+    int3
+    add $16, %rsp
+    .cfi_def_cfa_offset 16
+    pop %rbp
+    .cfi_def_cfa_offset 8
+    ret
+    .cfi_endproc
+    .size no_frame_pointer, .-no_frame_pointer
+)");
+
+extern "C" void no_frame_pointer();
+
+extern "C" int recurse(int aDepth) {
+    if (aDepth == 0) {
+        no_frame_pointer();
+        return 0;
+    }
+
+    return recurse(aDepth - 1) + 1;
+}
+
+int main() {
+    return recurse(100) == 100 ? 0 : 1;
+}
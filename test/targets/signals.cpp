@@ -0,0 +1,23 @@
+// Raises a stream of signals and then one more, and exits with the number
+// its handlers saw, for the signal policies
+#include <csignal>
+
+namespace {
+    volatile std::sig_atomic_t theHandled = 0;
+
+    void handle(int) {
+        theHandled = theHandled + 1;
+    }
+} // namespace
+
+int main() {
+    std::signal(SIGUSR1, handle);
+    std::signal(SIGUSR2, handle);
+
+    for (int i = 0; i < 100; ++i) {
+        std::raise(SIGUSR1);
+    }
+    std::raise(SIGUSR2);
+
+    return theHandled;
+}
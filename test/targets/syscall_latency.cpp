@@ -0,0 +1,19 @@
+// Makes system calls of known length, then quick ones, and writes to two
+// file descriptors, for the system call profiler
+#include <ctime>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+int main() {
+    for (int i = 0; i < 5; ++i) {
+        timespec myDelay{0, 20'000'000};
+        nanosleep(&myDelay, nullptr);
+    }
+
+    for (int i = 0; i < 100; ++i) {
+        syscall(SYS_getppid);
+    }
+
+    write(STDOUT_FILENO, "a", 1);
+    write(STDERR_FILENO, "b", 1);
+}
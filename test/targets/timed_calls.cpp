@@ -0,0 +1,26 @@
+// Makes calls of known length and recursive ones, for the function tracer
+#include <ctime>
+
+extern "C" [[gnu::noinline]] void sleep_ms(int aMilliseconds) {
+    timespec myDelay{0, aMilliseconds * 1'000'000L};
+    nanosleep(&myDelay, nullptr);
+}
+
+extern "C" [[gnu::noinline]] int depth(int aLevel) {
+    if (aLevel == 0) {
+        return 0;
+    }
+    return depth(aLevel - 1) + 1;
+}
+
+int main() {
+    for (int i = 0; i < 5; ++i) {
+        sleep_ms(10);
+    }
+
+    int myTotal = 0;
+    for (int i = 0; i < 3; ++i) {
+        myTotal += depth(10);
+    }
+    return myTotal == 30 ? 0 : 1;
+}
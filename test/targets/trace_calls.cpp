@@ -0,0 +1,10 @@
+// Calls a function many times with a string and a counter, for tracepoints
+extern "C" [[gnu::noinline]] void record(const char* aMessage, int aNumber) {
+    asm volatile("" : : "r"(aMessage), "r"(aNumber) : "memory");
+}
+
+int main() {
+    for (int i = 0; i < 100; ++i) {
+        record("hello tracepoint", i);
+    }
+}
@@ -1,61 +1,306 @@
 #include "breakpoint_operations.hpp"
+#include "debug_info_commands.hpp"
 
 #include <register_write.hpp>
 
+#include <chrono>
 #include <cstdint>
+#include <optional>
 #include <string>
+#include <string_view>
 
 #include <fmt/core.h>
+#include <fmt/ranges.h>
 
 #include <process.hpp>
+#include <syscalls.hpp>
+#include <target.hpp>
 #include <types.hpp>
 
 namespace sdb {
+    std::vector<sdb::VirtualAddress>
+    resolve_breakpoint_location(sdb::Target& aTarget,
+                                const std::string& aLocation) {
+        if (auto myAddr = sdb::toIntegral<std::uint64_t>(aLocation)) {
+            return {sdb::VirtualAddress{*myAddr}};
+        }
+
+        auto myColon = aLocation.rfind(':');
+        if (myColon != std::string::npos) {
+            auto myLine = sdb::toIntegral<std::uint32_t>(
+                std::string_view{aLocation}.substr(myColon + 1));
+            if (myLine) {
+                wait_for_debug_info(aTarget);
+                return aTarget.findLineAddresses(
+                    std::string_view{aLocation}.substr(0, myColon),
+                    *myLine);
+            }
+        }
+
+        // Names missing from the ELF symbols are looked up in the debug
+        // info, which has to be fully indexed first
+        if (aTarget.getElf().getSymbolsByName(aLocation).empty()) {
+            wait_for_debug_info(aTarget);
+        }
+        return aTarget.findSymbolAddresses(aLocation);
+    }
+
     namespace {
+        bool is_symbol_location(const std::string& aLocation) {
+            return !sdb::toIntegral<std::uint64_t>(aLocation) and
+                   aLocation.find(':') == std::string::npos;
+        }
+
+        // Conditions may be given as one quoted argument or as several
+        std::optional<std::string> get_condition(CLI::Option* aConditionOpt) {
+            if (aConditionOpt->count() == 0) {
+                return std::nullopt;
+            }
+
+            return fmt::format(
+                "{}",
+                fmt::join(aConditionOpt->as<std::vector<std::string>>(), " "));
+        }
+
+        // Falls back to checking the condition in sdb when the site cannot
+        // be patched
+        void set_condition(sdb::BreakpointSite& aSite,
+                           const std::string& aCondition, bool aNative) {
+            auto myCondition = sdb::BreakpointCondition::compile(aCondition);
+            if (aNative) {
+                try {
+                    aSite.setNativeCondition(myCondition);
+                    return;
+                } catch (const sdb::Error& anError) {
+                    fmt::print(stderr,
+                               "{}; checking the condition in sdb instead\n",
+                               anError.what());
+                }
+            }
+            aSite.setCondition(std::move(myCondition));
+        }
+
+        // Internal sites, such as the return breakpoints of traced calls,
+        // are left to the tools that set them
+        sdb::BreakpointSite* find_user_breakpoint(sdb::Process& aProcess,
+                                                  const std::string& anId) {
+            auto myId = sdb::toIntegral<std::uint32_t>(anId);
+            auto& myBreakpointSites = aProcess.getBreakpointSites();
+            if (!myId or !myBreakpointSites.contains_id(
+                             sdb::BreakpointSite::IdTypeT{*myId})) {
+                fmt::print(stderr, "No breakpoint with id {}\n", anId);
+                return nullptr;
+            }
+
+            auto& mySite =
+                myBreakpointSites.getById(sdb::BreakpointSite::IdTypeT{*myId});
+            if (mySite.isInternal()) {
+                fmt::print(stderr, "Breakpoint {} is internal to sdb\n", anId);
+                return nullptr;
+            }
+            return &mySite;
+        }
+
+        void set_breakpoints(sdb::Target& aTarget,
+                             const std::string& aLocation,
+                             const std::optional<std::string>& aCondition,
+                             bool aNative) {
+            if (aNative and !aCondition) {
+                fmt::print(stderr, "--native needs a condition\n");
+                return;
+            }
+
+            // Checked once up front, though every site gets a condition of
+            // its own to count hits with
+            if (aCondition) {
+                try {
+                    sdb::BreakpointCondition::compile(*aCondition);
+                } catch (const sdb::Error& anError) {
+                    fmt::print(stderr, "{}\n", anError.what());
+                    return;
+                }
+            }
 
-        void add_breakpoint_listing(CLI::App& aRepl, sdb::Process& aProcess) {
+            auto myAddresses = resolve_breakpoint_location(aTarget, aLocation);
+            if (myAddresses.empty() and is_symbol_location(aLocation)) {
+                if (aCondition) {
+                    fmt::print(stderr, "Conditions can only be set on "
+                                       "loaded code\n");
+                    return;
+                }
+                aTarget.addPendingBreakpoint(aLocation);
+                fmt::print("Breakpoint on {} pending until a library "
+                           "defining it is loaded\n",
+                           aLocation);
+                return;
+            }
+            if (myAddresses.empty()) {
+                fmt::print(stderr,
+                           "Breakpoint command expects address in "
+                           "hexadecimal, prefixed with '0x', a file:line "
+                           "location or a symbol name\n");
+                return;
+            }
+
+            auto& myProcess = aTarget.getProcess();
+            for (auto myAddr : myAddresses) {
+                if (myProcess.getBreakpointSites().contains_address(myAddr)) {
+                    continue;
+                }
+
+                auto& mySite = myProcess.createBreakpointSite(myAddr);
+                if (aCondition) {
+                    set_condition(mySite, *aCondition, aNative);
+                }
+                mySite.enable();
+                fmt::print("Set breakpoint {} at {:#x}\n",
+                           std::to_underlying(mySite.getId()),
+                           std::to_underlying(myAddr));
+            }
+        }
+
+        void add_breakpoint_listing(CLI::App& aRepl,
+                                    const sdb::Target& aTarget) {
             auto bp = aRepl.get_subcommand("breakpoint");
             auto bp_list = bp->add_subcommand(
                 "list", "List all breakpoints in the current process");
 
-            bp_list->callback([&aProcess]() {
-                auto& myBreakpointSites = aProcess.getBreakpointSites();
-                if (myBreakpointSites.empty()) {
-                    fmt::print("No breakpoints set\n");
-                } else {
-                    myBreakpointSites.forEach([](auto& aSite) {
+            bp_list->callback([&aTarget]() {
+                bool myAnyListed = false;
+                aTarget.getProcess().getBreakpointSites().forEach(
+                    [&](auto& aSite) {
+                        if (aSite.isInternal()) {
+                            return;
+                        }
+
                         fmt::print("{}: address = {:#x}, {}\n",
                                    std::to_underlying(aSite.getId()),
                                    std::to_underlying(aSite.getAddress()),
                                    aSite.isEnabled() ? "enabled" : "disabled");
+                        myAnyListed = true;
+
+                        auto* myCondition = aSite.getCondition();
+                        if (!myCondition) {
+                            return;
+                        }
+
+                        if (auto* myNative = aSite.getNativeCondition()) {
+                            auto myNumHits = myNative->getNumHits();
+                            fmt::print("   if {} (native): {} hits, {} true, "
+                                       "{} false\n",
+                                       myCondition->getText(), myNumHits,
+                                       myNative->getNumTrue(),
+                                       myNumHits - myNative->getNumTrue());
+                            return;
+                        }
+
+                        std::chrono::duration<double, std::micro> myTime =
+                            myCondition->getTotalTime();
+                        fmt::print("   if {}: {} hits, {} true, {} false, "
+                                   "{:.1f} us average\n",
+                                   myCondition->getText(),
+                                   myCondition->getNumHits(),
+                                   myCondition->getNumTrue(),
+                                   myCondition->getNumFalse(),
+                                   myCondition->getNumHits() > 0
+                                       ? myTime.count() /
+                                             myCondition->getNumHits()
+                                       : 0.0);
                     });
+
+                for (auto& myName : aTarget.getPendingBreakpoints()) {
+                    fmt::print("pending: {}\n", myName);
+                    myAnyListed = true;
+                }
+
+                if (!myAnyListed) {
+                    fmt::print("No breakpoints set\n");
                 }
             });
         }
 
-        void add_breakpoint_setting(CLI::App& aRepl, sdb::Process& aProcess) {
+        void add_breakpoint_setting(CLI::App& aRepl, sdb::Target& aTarget) {
             auto bp = aRepl.get_subcommand("breakpoint");
             auto bp_set = bp->add_subcommand(
-                "set", "Set a breakpoint at the given address");
+                "set", "Set a breakpoint at the given address or symbol");
 
-            CLI::Option* myAddressOpt = bp_set->add_option("address")
+            CLI::Option* myAddressOpt = bp_set->add_option("location")
                                             ->required()
                                             ->capture_default_str();
+            CLI::Option* myConditionOpt =
+                bp_set
+                    ->add_option("-c,--if",
+                                 "Only stop when the condition is true, "
+                                 "such as rdi == 0x1234 and [rsi+8] > 100")
+                    ->expected(-1);
+            CLI::Option* myNativeOpt = bp_set->add_flag(
+                "-n,--native", "Check the condition with native code in the "
+                               "process, which only stops when it is true. "
+                               "Conditions reading memory stay in sdb.");
+
+            bp_set->callback([=, &aTarget]() {
+                set_breakpoints(aTarget, myAddressOpt->as<std::string>(),
+                                get_condition(myConditionOpt),
+                                myNativeOpt->count() > 0);
+            });
+        }
+
+        void add_break_shortcut(CLI::App& aRepl, sdb::Target& aTarget) {
+            auto break_cmd = aRepl.add_subcommand(
+                "break", "Set a breakpoint at the given address or symbol");
+
+            CLI::Option* myAddressOpt = break_cmd->add_option("location")
+                                            ->required()
+                                            ->capture_default_str();
+            CLI::Option* myConditionOpt =
+                break_cmd
+                    ->add_option("-c,--if",
+                                 "Only stop when the condition is true")
+                    ->expected(-1);
+            CLI::Option* myNativeOpt = break_cmd->add_flag(
+                "-n,--native", "Check the condition in the process");
+
+            break_cmd->callback([=, &aTarget]() {
+                set_breakpoints(aTarget, myAddressOpt->as<std::string>(),
+                                get_condition(myConditionOpt),
+                                myNativeOpt->count() > 0);
+            });
+        }
+
+        void add_breakpoint_condition(CLI::App& aRepl,
+                                      sdb::Process& aProcess) {
+            auto bp = aRepl.get_subcommand("breakpoint");
+            auto bp_condition = bp->add_subcommand(
+                "condition", "Set the condition of a breakpoint with the "
+                             "given ID, or remove it if none is given");
 
-            bp_set->callback([=, &aProcess]() {
-                const std::string& myAddressStr =
-                    myAddressOpt->as<std::string>();
+            CLI::Option* myIdOpt = bp_condition->add_option("id")
+                                       ->required()
+                                       ->capture_default_str();
+            CLI::Option* myConditionOpt =
+                bp_condition->add_option("condition")->expected(-1);
+            CLI::Option* myNativeOpt = bp_condition->add_flag(
+                "-n,--native", "Check the condition in the process");
 
-                auto myOptionalAddr =
-                    sdb::toIntegral<std::uint64_t>(myAddressStr);
-                if (!myOptionalAddr) {
-                    fmt::print(stderr, "Breakpoint command expects address in "
-                                       "hexadecimal, prefixed with '0x'\n");
+            bp_condition->callback([=, &aProcess]() {
+                auto* mySite =
+                    find_user_breakpoint(aProcess, myIdOpt->as<std::string>());
+                if (!mySite) {
                     return;
                 }
 
-                sdb::VirtualAddress myAddr{*myOptionalAddr};
-                aProcess.createBreakpointSite(myAddr).enable();
+                auto myCondition = get_condition(myConditionOpt);
+                if (!myCondition) {
+                    mySite->setCondition(std::nullopt);
+                    return;
+                }
+
+                try {
+                    set_condition(*mySite, *myCondition,
+                                  myNativeOpt->count() > 0);
+                } catch (const sdb::Error& anError) {
+                    fmt::print(stderr, "{}\n", anError.what());
+                }
             });
         }
 
@@ -68,13 +313,11 @@ namespace sdb {
                 bp_enable->add_option("id")->required()->capture_default_str();
 
             bp_enable->callback([=, &aProcess]() {
-                const std::string& myIdStr = myIdOpt->as<std::string>();
-
-                auto myOptionalId = sdb::toIntegral<std::uint32_t>(myIdStr);
-                auto& myBreakpointSites = aProcess.getBreakpointSites();
-                myBreakpointSites
-                    .getById(sdb::BreakpointSite::IdTypeT{*myOptionalId})
-                    .enable();
+                auto* mySite =
+                    find_user_breakpoint(aProcess, myIdOpt->as<std::string>());
+                if (mySite) {
+                    mySite->enable();
+                }
             });
         }
 
@@ -87,13 +330,11 @@ namespace sdb {
                 bp_disable->add_option("id")->required()->capture_default_str();
 
             bp_disable->callback([=, &aProcess]() {
-                const std::string& myIdStr = myIdOpt->as<std::string>();
-
-                auto myOptionalId = sdb::toIntegral<std::uint32_t>(myIdStr);
-                auto& myBreakpointSites = aProcess.getBreakpointSites();
-                myBreakpointSites
-                    .getById(sdb::BreakpointSite::IdTypeT{*myOptionalId})
-                    .disable();
+                auto* mySite =
+                    find_user_breakpoint(aProcess, myIdOpt->as<std::string>());
+                if (mySite) {
+                    mySite->disable();
+                }
             });
         }
 
@@ -106,25 +347,59 @@ namespace sdb {
                 bp_delete->add_option("id")->required()->capture_default_str();
 
             bp_delete->callback([=, &aProcess]() {
-                const std::string& myIdStr = myIdOpt->as<std::string>();
+                auto* mySite =
+                    find_user_breakpoint(aProcess, myIdOpt->as<std::string>());
+                if (!mySite) {
+                    return;
+                }
+
+                // A site patched with a jump has to be put back first
+                if (mySite->isEnabled()) {
+                    mySite->disable();
+                }
+                aProcess.getBreakpointSites().removeById(mySite->getId());
+            });
+        }
 
-                auto myOptionalId = sdb::toIntegral<std::uint32_t>(myIdStr);
-                auto& myBreakpointSites = aProcess.getBreakpointSites();
-                myBreakpointSites.removeById(
-                    sdb::BreakpointSite::IdTypeT{*myOptionalId});
+        void add_syscall_catchpoints(CLI::App& aRepl,
+                                     sdb::Process& aProcess) {
+            auto catch_cmd =
+                aRepl.add_subcommand("catch", "Stop at events in the process");
+            auto syscall_cmd = catch_cmd->add_subcommand(
+                "syscall", "Stop at entry to and return from the given "
+                           "system calls, every call if none are given, or "
+                           "none");
+            CLI::Option* mySyscallsOpt =
+                syscall_cmd->add_option("syscalls")->expected(-1);
+
+            syscall_cmd->callback([=, &aProcess]() {
+                try {
+                    if (mySyscallsOpt->count() == 0) {
+                        aProcess.catchAllSyscalls();
+                        return;
+                    }
+                    aProcess.setSyscallCatchPolicy(sdb::parseSyscalls(
+                        mySyscallsOpt->as<std::vector<std::string>>()));
+                } catch (const sdb::Error& anError) {
+                    fmt::print(stderr, "{}\n", anError.what());
+                }
             });
         }
 
     } // namespace
 
-    void add_breakpoint_operations(CLI::App& aRepl, sdb::Process& aProcess) {
+    void add_breakpoint_operations(CLI::App& aRepl, sdb::Target& aTarget) {
+        auto& myProcess = aTarget.getProcess();
         aRepl.add_subcommand("breakpoint", "Breakpoint operations");
 
-        add_breakpoint_listing(aRepl, aProcess);
-        add_breakpoint_setting(aRepl, aProcess);
-        add_breakpoint_enable(aRepl, aProcess);
-        add_breakpoint_disable(aRepl, aProcess);
-        add_breakpoint_delete(aRepl, aProcess);
+        add_breakpoint_listing(aRepl, aTarget);
+        add_breakpoint_setting(aRepl, aTarget);
+        add_break_shortcut(aRepl, aTarget);
+        add_breakpoint_enable(aRepl, myProcess);
+        add_breakpoint_disable(aRepl, myProcess);
+        add_breakpoint_delete(aRepl, myProcess);
+        add_breakpoint_condition(aRepl, myProcess);
+        add_syscall_catchpoints(aRepl, myProcess);
     }
 
 } // namespace sdb
@@ -1,8 +1,16 @@
 #pragma once
 
 #include <CLI/CLI.hpp>
-#include <process.hpp>
+#include <string>
+#include <target.hpp>
+#include <vector>
 
 namespace sdb {
-    void add_breakpoint_operations(CLI::App& aRepl, sdb::Process& aProcess);
+    // Accepts a hexadecimal address, a file:line pair or a symbol or
+    // qualified function name. The latter may resolve to several addresses.
+    std::vector<sdb::VirtualAddress>
+    resolve_breakpoint_location(sdb::Target& aTarget,
+                                const std::string& aLocation);
+
+    void add_breakpoint_operations(CLI::App& aRepl, sdb::Target& aTarget);
 } // namespace sdb
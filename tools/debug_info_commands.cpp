@@ -0,0 +1,83 @@
+#include <debug_info_commands.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <fmt/format.h>
+
+namespace sdb {
+    namespace {
+        void print_index_progress(const sdb::IndexProgress& aProgress) {
+            fmt::print("Indexed {}/{} compile units",
+                       aProgress.theUnitsIndexed, aProgress.theUnitsTotal);
+        }
+
+        void add_index_status(CLI::App& aRepl, const sdb::Target& aTarget) {
+            auto index_cmd = aRepl.add_subcommand(
+                "index", "Show the state of the debug info index");
+
+            index_cmd->callback([&aTarget]() {
+                auto& myDwarf = aTarget.getDwarf();
+                auto myProgress = myDwarf.getIndexProgress();
+
+                if (!myProgress.theIsComplete) {
+                    print_index_progress(myProgress);
+                    fmt::print(", still indexing\n");
+                    return;
+                }
+
+                std::chrono::duration<double, std::milli> myTime =
+                    aTarget.isIndexFromCache() ? aTarget.getIndexLoadTime()
+                                               : myDwarf.getIndexTime();
+                fmt::print("{} compile units, {} functions, {} in {:.1f} ms\n",
+                           myProgress.theUnitsTotal,
+                           myDwarf.getFunctionIndex().theEntries.size(),
+                           aTarget.isIndexFromCache() ? "mapped from cache"
+                                                      : "indexed",
+                           myTime.count());
+            });
+        }
+
+        void add_library_listing(CLI::App& aRepl, const sdb::Target& aTarget) {
+            auto libraries_cmd = aRepl.add_subcommand(
+                "libraries", "List the loaded shared libraries");
+
+            libraries_cmd->callback([&aTarget]() {
+                auto& myLibraries = aTarget.getSharedLibraries().getLibraries();
+                if (myLibraries.empty()) {
+                    fmt::print("No shared libraries loaded\n");
+                    return;
+                }
+
+                for (auto& myLibrary : myLibraries) {
+                    fmt::print("{:#018x}-{:#018x} {}\n",
+                               std::to_underlying(myLibrary->theBegin),
+                               std::to_underlying(myLibrary->theEnd),
+                               myLibrary->thePath);
+                }
+            });
+        }
+    } // namespace
+
+    void add_debug_info_commands(CLI::App& aRepl, const sdb::Target& aTarget) {
+        add_index_status(aRepl, aTarget);
+        add_library_listing(aRepl, aTarget);
+    }
+
+    void wait_for_debug_info(const sdb::Target& aTarget) {
+        using namespace std::chrono_literals;
+
+        auto& myDwarf = aTarget.getDwarf();
+        bool myReported = false;
+
+        while (!myDwarf.waitForIndex(250ms)) {
+            fmt::print("\r");
+            print_index_progress(myDwarf.getIndexProgress());
+            std::fflush(stdout);
+            myReported = true;
+        }
+
+        if (myReported) {
+            fmt::print("\n");
+        }
+    }
+} // namespace sdb
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <CLI/CLI.hpp>
+#include <target.hpp>
+
+namespace sdb {
+    void add_debug_info_commands(CLI::App& aRepl, const sdb::Target& aTarget);
+
+    // Blocks until the debug info index is complete, reporting progress if
+    // that takes a noticeable amount of time
+    void wait_for_debug_info(const sdb::Target& aTarget);
+} // namespace sdb
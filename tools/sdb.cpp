@@ -1,26 +1,74 @@
 #include <CLI/CLI.hpp>
+#include <algorithm>
 #include <breakpoint_operations.hpp>
+#include <chrono>
+#include <debug_info_commands.hpp>
 #include <disassembler.hpp>
 #include <editline/readline.h>
 #include <fmt/format.h>
+#include <filesystem>
 #include <fmt/ranges.h>
+#include <fstream>
+#include <heap_inspector.hpp>
+#include <heap_profiler.hpp>
 #include <iostream>
+#include <lock_profiler.hpp>
+#include <memory_operations.hpp>
 #include <memory_commands.hpp>
+#include <optional>
 #include <process.hpp>
+#include <profiler.hpp>
 #include <ranges>
 #include <register_write.hpp>
 #include <string>
+#include <syscall_profiler.hpp>
+#include <syscalls.hpp>
+#include <target.hpp>
+#include <trace_commands.hpp>
 #include <unistd.h>
 #include <utils.hpp>
 #include <vector>
 
-void printDisassembly(const std::vector<sdb::Instruction>& anInstructions) {
+std::string formatSymbolLocation(const sdb::Target& aTarget,
+                                 sdb::VirtualAddress anAddress) {
+    auto myLocation = aTarget.symbolize(anAddress);
+    if (!myLocation) {
+        return "";
+    }
+
+    return fmt::format(" <{}+{}>", myLocation->theName, myLocation->theOffset);
+}
+
+void printDisassembly(const sdb::Target& aTarget,
+                      const std::vector<sdb::Instruction>& anInstructions) {
     for (auto& myInstr : anInstructions) {
-        fmt::print("{:#018x}: {}\n", std::to_underlying(myInstr.theAddress),
+        fmt::print("{:#018x}{}: {}\n", std::to_underlying(myInstr.theAddress),
+                   formatSymbolLocation(aTarget, myInstr.theAddress),
                    myInstr.theInstruction);
     }
 }
 
+void printSource(const std::filesystem::path& aPath, std::uint32_t aLine,
+                 std::uint32_t aContext = 2) {
+    std::ifstream myFile{aPath};
+    if (!myFile) {
+        return;
+    }
+
+    auto myFirstLine = aLine > aContext ? aLine - aContext : 1;
+    auto myLastLine = aLine + aContext;
+
+    std::string myText;
+    for (std::uint32_t myLineNum = 1;
+         myLineNum <= myLastLine and std::getline(myFile, myText);
+         ++myLineNum) {
+        if (myLineNum >= myFirstLine) {
+            fmt::print("{} {:>4} {}\n", myLineNum == aLine ? '>' : ' ',
+                       myLineNum, myText);
+        }
+    }
+}
+
 void add_reg_reading(CLI::App& theRepl, sdb::Process& aProcess) {
     using namespace sdb;
 
@@ -76,6 +124,26 @@ void add_reg_writing(CLI::App& aRepl, sdb::Process& aProcess) {
     });
 }
 
+// The call with its arguments in hexadecimal, or its result, with the
+// errno name when it failed
+std::string format_syscall_stop(const sdb::SyscallStop& aSyscall) {
+    auto myName = sdb::getSyscallName(aSyscall.theNumber);
+    auto myCall = myName ? std::string{*myName}
+                         : fmt::format("syscall {}", aSyscall.theNumber);
+
+    if (aSyscall.theIsEntry) {
+        return fmt::format("stopped at entry to {}({:#x})", myCall,
+                           fmt::join(aSyscall.theArgs, ", "));
+    }
+    if (aSyscall.theResult < 0 and aSyscall.theResult >= -4095) {
+        return fmt::format("stopped at return from {} = -1 {}", myCall,
+                           strerrorname_np(static_cast<int>(
+                               -aSyscall.theResult)));
+    }
+    return fmt::format("stopped at return from {} = {:#x}", myCall,
+                       aSyscall.theResult);
+}
+
 void print_stop_reason(const sdb::Process& aProcess,
                        sdb::StopReason aStopReason) {
     std::cout << "Process " << aProcess.getPid() << ' ';
@@ -91,6 +159,13 @@ void print_stop_reason(const sdb::Process& aProcess,
                       << sigabbrev_np(aStopReason.theStatus);
             break;
         case sdb::ProcessState::Stopped: {
+            if (auto& mySyscall = aStopReason.theSyscall) {
+                std::cout << format_syscall_stop(*mySyscall) << " at "
+                          << fmt::format("{:#x}",
+                                         sdb::toUnderlying(aProcess.getPc()));
+                break;
+            }
+
             std::string myMessage =
                 fmt::format("stopped with signal {} at {:#x}",
                             sigabbrev_np(aStopReason.theStatus),
@@ -100,53 +175,982 @@ void print_stop_reason(const sdb::Process& aProcess,
         }
     }
     std::cout << '\n';
+
+    if (auto* myCounters = aProcess.getPerfCounters()) {
+        std::vector<std::string> myCounts;
+        for (auto& myCount : myCounters->getDelta()) {
+            auto myName = sdb::getPerfEventName(myCount.theEvent);
+            if (myCount.theEvent == sdb::PerfEvent::TaskClock) {
+                myCounts.push_back(fmt::format(
+                    "{:.3f} ms {}", myCount.theValue / 1e6, myName));
+            } else {
+                myCounts.push_back(
+                    fmt::format("{} {}", myCount.theValue, myName));
+            }
+        }
+        fmt::print("Since last stop: {}\n", fmt::join(myCounts, ", "));
+    }
 }
 
-void handle_stop(const sdb::Process& aProcess, sdb::StopReason aStopReason,
+void handle_stop(const sdb::Target& aTarget, sdb::StopReason aStopReason,
                  sdb::Disassembler& aDisassembler) {
-    print_stop_reason(aProcess, aStopReason);
+    print_stop_reason(aTarget.getProcess(), aStopReason);
+
+    // Reported once, at the stop the replay ending caused
+    static const sdb::SyscallRecorder* myDivergedLog = nullptr;
+    auto* myLog = aTarget.getProcess().getSyscallRecorder();
+    if (myLog and myLog->getDivergence() and myLog != myDivergedLog) {
+        myDivergedLog = myLog;
+        fmt::print("Replay diverged: {}. The process makes its own system "
+                   "calls from here.\n",
+                   *myLog->getDivergence());
+    }
+
     if (aStopReason.theStopState == sdb::ProcessState::Stopped) {
+        // Source lines are only shown once the debug info is indexed, so
+        // stepping through instructions never waits on the indexer
+        std::optional<sdb::SourceLocation> myLocation;
+        if (aTarget.getDwarf().getIndexProgress().theIsComplete) {
+            myLocation =
+                aTarget.getSourceLocation(aTarget.getProcess().getPc());
+        }
+        if (myLocation) {
+            fmt::print("{}:{}\n", myLocation->theFile, myLocation->theLine);
+            printSource(myLocation->theFile, myLocation->theLine);
+        }
+
         auto myDisassembledInstructions = aDisassembler.disassemble(5);
-        printDisassembly(myDisassembledInstructions);
+        printDisassembly(aTarget, myDisassembledInstructions);
     }
 }
 
-void add_continue(CLI::App& aRepl, sdb::Process& aProcess,
+void add_continue(CLI::App& aRepl, sdb::Target& aTarget,
                   sdb::Disassembler& aDisassembler) {
     auto continue_cmd = aRepl.add_subcommand("c", "Continue process");
 
     continue_cmd->callback([&]() {
-        aProcess.resume();
-        auto myStopReason = aProcess.waitOnSignal();
-        handle_stop(aProcess, myStopReason, aDisassembler);
+        auto& myProcess = aTarget.getProcess();
+        myProcess.resume();
+        auto myStopReason = myProcess.waitOnSignal();
+        handle_stop(aTarget, myStopReason, aDisassembler);
     });
 }
 
-void add_step(CLI::App& aRepl, sdb::Process& aProcess,
+void add_step(CLI::App& aRepl, sdb::Target& aTarget,
               sdb::Disassembler& aDisassembler) {
     auto step_cmd =
         aRepl.add_subcommand("s", "Step forward by one instruction");
 
     step_cmd->callback([&]() {
-        auto myStopReason = aProcess.stepInstruction();
-        handle_stop(aProcess, myStopReason, aDisassembler);
+        auto myStopReason = aTarget.getProcess().stepInstruction();
+        handle_stop(aTarget, myStopReason, aDisassembler);
+    });
+}
+
+void add_source_step(CLI::App& aRepl, sdb::Target& aTarget,
+                     sdb::Disassembler& aDisassembler) {
+    auto step_cmd =
+        aRepl.add_subcommand("step", "Step forward by one source line");
+
+    step_cmd->callback([&]() {
+        sdb::wait_for_debug_info(aTarget);
+        auto myStopReason = aTarget.stepSourceLine();
+        handle_stop(aTarget, myStopReason, aDisassembler);
+    });
+}
+
+void add_backtrace(CLI::App& aRepl, const sdb::Target& aTarget) {
+    auto backtrace_cmd =
+        aRepl.add_subcommand("backtrace", "Print the call stack");
+    backtrace_cmd->alias("bt");
+
+    CLI::Option* myCountOpt = backtrace_cmd->add_option("count")
+                                  ->default_val("64")
+                                  ->capture_default_str();
+
+    backtrace_cmd->callback([=, &aTarget]() {
+        auto myMaxFrames =
+            sdb::toIntegral<std::size_t>(myCountOpt->as<std::string>());
+        if (!myMaxFrames) {
+            fmt::print(stderr, "Backtrace count must be a number\n");
+            return;
+        }
+
+        // As when stopping, source lines are left out while indexing
+        bool myShowSource =
+            aTarget.getDwarf().getIndexProgress().theIsComplete;
+
+        auto myFrames = aTarget.backtrace(*myMaxFrames);
+        for (std::size_t i = 0; i < myFrames.size(); ++i) {
+            auto myCallSite = myFrames[i].getCallSite();
+            fmt::print("#{:<3} {:#018x}{}", i,
+                       std::to_underlying(myFrames[i].thePc),
+                       formatSymbolLocation(aTarget, myCallSite));
+
+            std::optional<sdb::SourceLocation> myLocation;
+            if (myShowSource) {
+                myLocation = aTarget.getSourceLocation(myCallSite);
+            }
+            if (myLocation) {
+                fmt::print(" at {}:{}", myLocation->theFile,
+                           myLocation->theLine);
+            }
+            fmt::print("\n");
+        }
     });
 }
 
-void readInput(std::unique_ptr<sdb::Process>& aProcess) {
+// Splits "name(1, 0x10, \"text\")" into the name and its arguments, with
+// quotes kept on string arguments
+std::optional<std::pair<std::string, std::vector<std::string>>>
+split_call(std::string_view aCall) {
+    auto trim = [](std::string_view aText) {
+        auto myBegin = aText.find_first_not_of(" \t");
+        auto myEnd = aText.find_last_not_of(" \t");
+        return myBegin == std::string_view::npos
+                   ? std::string_view{}
+                   : aText.substr(myBegin, myEnd - myBegin + 1);
+    };
+
+    auto myOpen = aCall.find('(');
+    if (myOpen == std::string_view::npos) {
+        return std::pair{std::string{trim(aCall)}, std::vector<std::string>{}};
+    }
+    if (trim(aCall).back() != ')') {
+        return std::nullopt;
+    }
+
+    auto myName = std::string{trim(aCall.substr(0, myOpen))};
+    auto myList = trim(aCall.substr(myOpen + 1));
+    myList = trim(myList.substr(0, myList.size() - 1));
+
+    std::vector<std::string> myArgs;
+    std::string myCurrent;
+    bool myInString = false;
+    for (std::size_t i = 0; i < myList.size(); ++i) {
+        auto myChar = myList[i];
+        if (myInString and myChar == '\\' and i + 1 < myList.size()) {
+            myCurrent += myChar;
+            myCurrent += myList[++i];
+            continue;
+        }
+        if (myChar == '"') {
+            myInString = !myInString;
+        }
+        if (myChar == ',' and !myInString) {
+            myArgs.emplace_back(trim(myCurrent));
+            myCurrent.clear();
+            continue;
+        }
+        myCurrent += myChar;
+    }
+    if (myInString) {
+        return std::nullopt;
+    }
+    if (!myList.empty()) {
+        myArgs.emplace_back(trim(myCurrent));
+    }
+
+    return std::pair{std::move(myName), std::move(myArgs)};
+}
+
+// Strings are copied into the scratch memory of the process, one after the
+// other, and passed by address
+std::optional<std::vector<std::uint64_t>>
+write_call_arguments(sdb::Process& aProcess,
+                     const std::vector<std::string>& anArgs) {
+    std::vector<std::uint64_t> myValues;
+    std::vector<std::byte> myStrings;
+    auto myScratch = aProcess.getScratchData();
+    for (auto& myArg : anArgs) {
+        if (myArg.size() >= 2 and myArg.front() == '"' and
+            myArg.back() == '"') {
+            myValues.push_back(std::to_underlying(myScratch) +
+                               myStrings.size());
+            for (std::size_t i = 1; i + 1 < myArg.size(); ++i) {
+                auto myChar = myArg[i];
+                if (myChar == '\\' and i + 2 < myArg.size()) {
+                    myChar = myArg[++i] == 'n' ? '\n' : myArg[i];
+                }
+                myStrings.push_back(static_cast<std::byte>(myChar));
+            }
+            myStrings.push_back(std::byte{0});
+        } else if (auto mySigned = sdb::toIntegral<std::int64_t>(myArg)) {
+            myValues.push_back(static_cast<std::uint64_t>(*mySigned));
+        } else if (auto myUnsigned = sdb::toIntegral<std::uint64_t>(myArg)) {
+            myValues.push_back(*myUnsigned);
+        } else {
+            fmt::print(stderr, "Invalid argument {}\n", myArg);
+            return std::nullopt;
+        }
+    }
+
+    if (myStrings.size() > sdb::Process::SCRATCH_DATA_SIZE) {
+        fmt::print(stderr, "String arguments are too long\n");
+        return std::nullopt;
+    }
+    if (!myStrings.empty()) {
+        sdb::writeMemory(aProcess.getPid(), myScratch, myStrings);
+    }
+
+    return myValues;
+}
+
+void add_call(CLI::App& aRepl, sdb::Target& aTarget) {
+    auto call_cmd = aRepl.add_subcommand(
+        "call", "Call a function in the process, such as call "
+                "dump_stats() or call puts(\"hi\")");
+
+    CLI::Option* myCallOpt =
+        call_cmd->add_option("function")->required()->expected(-1);
+
+    call_cmd->callback([=, &aTarget]() {
+        auto myCall = split_call(fmt::format(
+            "{}",
+            fmt::join(myCallOpt->as<std::vector<std::string>>(), " ")));
+        if (!myCall) {
+            fmt::print(stderr, "Expected a call such as name(1, \"text\")\n");
+            return;
+        }
+
+        auto& [myName, myArgs] = *myCall;
+        auto myAddresses = sdb::toIntegral<std::uint64_t>(myName)
+                               ? std::vector{sdb::VirtualAddress{
+                                     *sdb::toIntegral<std::uint64_t>(myName)}}
+                               : aTarget.findSymbolAddresses(myName);
+        if (myAddresses.empty()) {
+            fmt::print(stderr, "No function named {}\n", myName);
+            return;
+        }
+
+        auto& myProcess = aTarget.getProcess();
+        try {
+            auto myValues = write_call_arguments(myProcess, myArgs);
+            if (!myValues) {
+                return;
+            }
+
+            auto myStart = std::chrono::steady_clock::now();
+            auto myResult =
+                myProcess.callFunction(myAddresses.front(), *myValues);
+            std::chrono::duration<double, std::micro> myTime =
+                std::chrono::steady_clock::now() - myStart;
+            fmt::print("{} = {} ({:#x}) in {:.1f} us\n", myName,
+                       static_cast<std::int64_t>(myResult), myResult,
+                       myTime.count());
+        } catch (const sdb::Error& anError) {
+            fmt::print(stderr, "{}\n", anError.what());
+        }
+    });
+}
+
+// The --duration of a profile, or nothing after a message if it is not a
+// positive number of seconds
+std::optional<std::chrono::steady_clock::duration>
+parse_duration(const CLI::Option& anOption) {
+    auto mySeconds = sdb::toFloat<double>(anOption.as<std::string>());
+    if (!mySeconds or *mySeconds <= 0) {
+        fmt::print(stderr, "Duration must be a positive number\n");
+        return std::nullopt;
+    }
+
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>{*mySeconds});
+}
+
+void add_profile(CLI::App& aRepl, sdb::Target& aTarget,
+                 sdb::Disassembler& aDisassembler) {
+    auto profile_cmd = aRepl.add_subcommand(
+        "profile", "Sample the running process and print folded stacks");
+
+    CLI::Option* myHzOpt = profile_cmd->add_option("--hz")
+                               ->default_val("99")
+                               ->capture_default_str();
+    CLI::Option* myDurationOpt = profile_cmd->add_option("--duration")
+                                     ->default_val("5")
+                                     ->capture_default_str();
+    CLI::Option* myOutputOpt = profile_cmd->add_option(
+        "-o,--output", "File for the folded stacks instead of the terminal");
+
+    profile_cmd->callback([=, &aTarget, &aDisassembler]() {
+        auto myHz = sdb::toIntegral<unsigned>(myHzOpt->as<std::string>());
+        if (!myHz or *myHz == 0) {
+            fmt::print(stderr, "Sampling rate must be a positive number\n");
+            return;
+        }
+        auto myDuration = parse_duration(*myDurationOpt);
+        if (!myDuration) {
+            return;
+        }
+
+        sdb::Profiler myProfiler{aTarget, *myHz};
+        auto myStopReason = myProfiler.run(*myDuration);
+
+        if (myOutputOpt->count() > 0) {
+            std::ofstream myFile{myOutputOpt->as<std::string>()};
+            if (myFile) {
+                myProfiler.writeFoldedStacks(myFile);
+            } else {
+                fmt::print(stderr, "Could not open {}\n",
+                           myOutputOpt->as<std::string>());
+            }
+        } else {
+            myProfiler.writeFoldedStacks(std::cout);
+            std::cout.flush();
+        }
+
+        using std::chrono::duration;
+        auto& myPauses = myProfiler.getPauses();
+        duration<double, std::micro> myTotal{};
+        duration<double, std::micro> myMax{};
+        for (auto myPause : myPauses) {
+            myTotal += myPause;
+            myMax = std::max<duration<double, std::micro>>(myMax, myPause);
+        }
+        fmt::print("{} samples, {} distinct stacks; pause per sample "
+                   "{:.1f} us average, {:.1f} us max\n",
+                   myProfiler.getNumSamples(), myProfiler.getNumStacks(),
+                   myPauses.empty() ? 0.0
+                                    : myTotal.count() / myPauses.size(),
+                   myMax.count());
+
+        handle_stop(aTarget, myStopReason, aDisassembler);
+    });
+}
+
+void add_syscall_profile(CLI::App& aRepl, sdb::Target& aTarget,
+                         sdb::Disassembler& aDisassembler) {
+    auto profile_cmd = aRepl.add_subcommand(
+        "syscall-profile",
+        "Time the system calls of the running process and print their "
+        "latencies");
+
+    CLI::Option* myDurationOpt = profile_cmd->add_option("--duration")
+                                     ->default_val("5")
+                                     ->capture_default_str();
+    CLI::Option* myPerFdOpt = profile_cmd->add_flag(
+        "--per-fd", "Split calls on a file descriptor by descriptor");
+    CLI::Option* mySyscallsOpt =
+        profile_cmd->add_option("syscalls", "Calls to time, all if none")
+            ->expected(-1);
+
+    profile_cmd->callback([=, &aTarget, &aDisassembler]() {
+        auto myDuration = parse_duration(*myDurationOpt);
+        if (!myDuration) {
+            return;
+        }
+
+        try {
+            sdb::SyscallProfiler myProfiler{
+                aTarget.getProcess(),
+                sdb::parseSyscalls(
+                    mySyscallsOpt->as<std::vector<std::string>>()),
+                myPerFdOpt->count() > 0};
+            auto myStopReason = myProfiler.run(*myDuration);
+
+            myProfiler.writeTable(std::cout);
+            std::cout.flush();
+
+            // What the debugger itself added to the run
+            using std::chrono::duration;
+            auto& myOverhead = myProfiler.getOverhead();
+            duration<double, std::micro> myP50 = myOverhead.getQuantile(0.5);
+            duration<double, std::micro> myP99 = myOverhead.getQuantile(0.99);
+            duration<double, std::micro> myMax = myOverhead.getMax();
+            duration<double> myHeld = myOverhead.getTotal();
+            duration<double> myRunTime = myProfiler.getRunTime();
+            fmt::print("{} stops; held at each {:.1f} us p50, {:.1f} us p99, "
+                       "{:.1f} us max; {:.1f}% of {:.2f} s\n",
+                       myOverhead.getCount(), myP50.count(), myP99.count(),
+                       myMax.count(),
+                       myRunTime.count() > 0 ? 100 * myHeld / myRunTime
+                                             : 0.0,
+                       myRunTime.count());
+
+            handle_stop(aTarget, myStopReason, aDisassembler);
+        } catch (const sdb::Error& anError) {
+            fmt::print(stderr, "{}\n", anError.what());
+        }
+    });
+}
+
+void add_lock_profile(CLI::App& aRepl, sdb::Target& aTarget,
+                      sdb::Disassembler& aDisassembler) {
+    auto profile_cmd = aRepl.add_subcommand(
+        "lock-profile",
+        "Time the futex waits of the running process and rank the locks "
+        "waited for");
+
+    CLI::Option* myDurationOpt = profile_cmd->add_option("--duration")
+                                     ->default_val("5")
+                                     ->capture_default_str();
+    CLI::Option* myTopOpt = profile_cmd->add_option("--top")
+                                ->default_val("10")
+                                ->capture_default_str();
+    CLI::Option* myHookMutexesOpt = profile_cmd->add_flag(
+        "--hook-mutexes",
+        "Also break on pthread_mutex_lock to count acquisitions, which "
+        "kills other threads that lock mutexes meanwhile");
+
+    profile_cmd->callback([=, &aTarget, &aDisassembler]() {
+        auto myDuration = parse_duration(*myDurationOpt);
+        if (!myDuration) {
+            return;
+        }
+        auto myTop = sdb::toIntegral<std::size_t>(myTopOpt->as<std::string>());
+        if (!myTop) {
+            fmt::print(stderr, "--top must be a number\n");
+            return;
+        }
+
+        try {
+            sdb::LockProfiler myProfiler{aTarget,
+                                         myHookMutexesOpt->count() > 0};
+            auto myStopReason = myProfiler.run(*myDuration);
+
+            myProfiler.writeTable(std::cout, *myTop);
+            std::cout.flush();
+
+            using std::chrono::duration;
+            auto& myOverhead = myProfiler.getOverhead();
+            duration<double, std::micro> myP50 = myOverhead.getQuantile(0.5);
+            duration<double, std::micro> myMax = myOverhead.getMax();
+            fmt::print("{} futex stops; held at each {:.1f} us p50, {:.1f} us "
+                       "max\n",
+                       myOverhead.getCount(), myP50.count(), myMax.count());
+
+            handle_stop(aTarget, myStopReason, aDisassembler);
+        } catch (const sdb::Error& anError) {
+            fmt::print(stderr, "{}\n", anError.what());
+        }
+    });
+}
+
+void print_heap_summary(const sdb::HeapProfiler& aProfiler) {
+    auto& myLive = aProfiler.getLiveAllocations();
+    fmt::print("{} live allocations at {} sites; free hooked with a {}\n",
+               myLive.getSize(), aProfiler.getSites().size(),
+               aProfiler.isFreeFast() ? "trampoline" : "breakpoint");
+    if (aProfiler.getNumMissed() > 0 or aProfiler.getNumLostFrees() > 0) {
+        fmt::print("{} allocations missed, {} frees lost\n",
+                   aProfiler.getNumMissed(), aProfiler.getNumLostFrees());
+    }
+}
+
+void add_heap_profile(CLI::App& aRepl, sdb::Target& aTarget) {
+    auto heap_cmd = aRepl.add_subcommand(
+        "heap-profile", "Attribute heap memory to the stacks allocating it");
+    auto start_cmd = heap_cmd->add_subcommand(
+        "start", "Hook malloc, calloc, realloc and free");
+    auto stop_cmd =
+        heap_cmd->add_subcommand("stop", "Unhook the allocator, keeping "
+                                         "the profile");
+    auto report_cmd = heap_cmd->add_subcommand(
+        "report", "Print live bytes by stack, or write them for other tools");
+    CLI::Option* myFoldedOpt = report_cmd->add_flag(
+        "--folded", "Folded stacks for flame graph tools");
+    CLI::Option* myPprofOpt = report_cmd->add_flag(
+        "--pprof", "The gperftools heap profile format pprof reads");
+    CLI::Option* myTotalOpt = report_cmd->add_flag(
+        "--total", "Fold every byte allocated rather than live bytes");
+    CLI::Option* myTopOpt = report_cmd->add_option("--top")
+                                ->default_val("20")
+                                ->capture_default_str();
+    CLI::Option* myOutputOpt = report_cmd->add_option(
+        "-o,--output", "File for the profile instead of the terminal");
+
+    start_cmd->callback([&aTarget]() {
+        try {
+            aTarget.getHeapProfiler().start();
+            fmt::print("Heap profiler started\n");
+        } catch (const sdb::Error& anError) {
+            fmt::print(stderr, "{}\n", anError.what());
+        }
+    });
+
+    stop_cmd->callback([&aTarget]() {
+        auto& myProfiler = aTarget.getHeapProfiler();
+        if (!myProfiler.isRunning()) {
+            fmt::print(stderr, "The heap profiler is not running\n");
+            return;
+        }
+
+        try {
+            myProfiler.stop();
+        } catch (const sdb::Error& anError) {
+            fmt::print(stderr, "{}\n", anError.what());
+        }
+        print_heap_summary(myProfiler);
+    });
+
+    report_cmd->callback([=, &aTarget]() {
+        auto myTop = sdb::toIntegral<std::size_t>(myTopOpt->as<std::string>());
+        if (!myTop) {
+            fmt::print(stderr, "--top must be a number\n");
+            return;
+        }
+
+        auto& myProfiler = aTarget.getHeapProfiler();
+        if (myProfiler.isRunning()) {
+            myProfiler.collect();
+        }
+
+        auto myWrite = [&](std::ostream& aStream) {
+            if (myPprofOpt->count() > 0) {
+                myProfiler.writePprof(aStream);
+            } else if (myFoldedOpt->count() > 0) {
+                myProfiler.writeFoldedStacks(aStream, myTotalOpt->count() > 0);
+            } else {
+                myProfiler.writeTable(aStream, *myTop);
+            }
+        };
+
+        if (myOutputOpt->count() > 0) {
+            std::ofstream myFile{myOutputOpt->as<std::string>()};
+            if (!myFile) {
+                fmt::print(stderr, "Could not open {}\n",
+                           myOutputOpt->as<std::string>());
+                return;
+            }
+            myWrite(myFile);
+        } else {
+            myWrite(std::cout);
+            std::cout.flush();
+        }
+        print_heap_summary(myProfiler);
+    });
+}
+
+void add_heap(CLI::App& aRepl, sdb::Target& aTarget) {
+    auto heap_cmd = aRepl.add_subcommand(
+        "heap", "Inspect glibc's malloc arenas in the process's memory");
+    auto stats_cmd = heap_cmd->add_subcommand(
+        "stats", "In use and free bytes by arena, free chunk sizes and the "
+                 "largest holes");
+    CLI::Option* myTopOpt = stats_cmd->add_option("--top")
+                                ->default_val("10")
+                                ->capture_default_str();
+
+    stats_cmd->callback([=, &aTarget]() {
+        auto myTop = sdb::toIntegral<std::size_t>(myTopOpt->as<std::string>());
+        if (!myTop) {
+            fmt::print(stderr, "--top must be a number\n");
+            return;
+        }
+
+        try {
+            auto myStats = sdb::HeapInspector{aTarget}.inspect(*myTop);
+            sdb::HeapInspector::writeStats(std::cout, myStats);
+            std::cout.flush();
+        } catch (const sdb::Error& anError) {
+            fmt::print(stderr, "{}\n", anError.what());
+        }
+    });
+}
+
+void add_checkpoint(CLI::App& aRepl, sdb::Target& aTarget,
+                    sdb::Disassembler& aDisassembler) {
+    using std::chrono::duration;
+
+    auto checkpoint_cmd = aRepl.add_subcommand(
+        "checkpoint", "Keep a copy-on-write snapshot of the stopped process");
+    auto list_cmd = checkpoint_cmd->add_subcommand("list", "List checkpoints");
+    auto delete_cmd =
+        checkpoint_cmd->add_subcommand("delete", "Delete a checkpoint");
+    CLI::Option* myDeleteOpt = delete_cmd->add_option("id")->required();
+
+    checkpoint_cmd->callback([=, &aTarget]() {
+        if (!checkpoint_cmd->get_subcommands().empty()) {
+            return;
+        }
+
+        try {
+            auto& myCheckpoint = aTarget.getProcess().checkpoint();
+            duration<double, std::milli> myTime =
+                myCheckpoint.theCreationTime;
+            fmt::print("Checkpoint {} (process {}) at {:#x}{} in {:.2f} ms\n",
+                       myCheckpoint.theId, myCheckpoint.thePid,
+                       std::to_underlying(myCheckpoint.getPc()),
+                       formatSymbolLocation(aTarget, myCheckpoint.getPc()),
+                       myTime.count());
+        } catch (const sdb::Error& anError) {
+            fmt::print(stderr, "{}\n", anError.what());
+        }
+    });
+
+    list_cmd->callback([&aTarget]() {
+        for (auto& myCheckpoint : aTarget.getProcess().getCheckpoints()) {
+            duration<double, std::milli> myTime =
+                myCheckpoint.theCreationTime;
+            fmt::print("{}: process {} at {:#x}{}, taken in {:.2f} ms\n",
+                       myCheckpoint.theId, myCheckpoint.thePid,
+                       std::to_underlying(myCheckpoint.getPc()),
+                       formatSymbolLocation(aTarget, myCheckpoint.getPc()),
+                       myTime.count());
+        }
+    });
+
+    delete_cmd->callback([=, &aTarget]() {
+        auto myId =
+            sdb::toIntegral<std::size_t>(myDeleteOpt->as<std::string>());
+        if (!myId) {
+            fmt::print(stderr, "Checkpoint id must be a number\n");
+            return;
+        }
+
+        try {
+            aTarget.getProcess().deleteCheckpoint(*myId);
+        } catch (const sdb::Error& anError) {
+            fmt::print(stderr, "{}\n", anError.what());
+        }
+    });
+
+    auto restart_cmd = aRepl.add_subcommand(
+        "restart", "Replace the process with a fresh copy of a checkpoint");
+    CLI::Option* myRestartOpt = restart_cmd->add_option("id")->required();
+
+    restart_cmd->callback([=, &aTarget, &aDisassembler]() {
+        auto myId =
+            sdb::toIntegral<std::size_t>(myRestartOpt->as<std::string>());
+        if (!myId) {
+            fmt::print(stderr, "Checkpoint id must be a number\n");
+            return;
+        }
+
+        auto& myProcess = aTarget.getProcess();
+        try {
+            duration<double, std::milli> myTime = myProcess.restart(*myId);
+            fmt::print("Restarted checkpoint {} as process {} in {:.2f} ms\n",
+                       *myId, myProcess.getPid(), myTime.count());
+            if (std::ranges::any_of(aTarget.getTracer().getTracepoints(),
+                                    [](auto& aTracepoint) {
+                                        return aTracepoint->theIsFast;
+                                    })) {
+                fmt::print("Fast tracepoints are as they were at the "
+                           "checkpoint\n");
+            }
+        } catch (const sdb::Error& anError) {
+            fmt::print(stderr, "{}\n", anError.what());
+            return;
+        }
+
+        printDisassembly(aTarget, aDisassembler.disassemble(5));
+    });
+}
+
+void add_record(CLI::App& aRepl, sdb::Target& aTarget,
+                sdb::Disassembler& aDisassembler) {
+    auto record_cmd = aRepl.add_subcommand(
+        "record", "Record instructions as the process runs, for reverse "
+                  "execution");
+    auto start_cmd = record_cmd->add_subcommand(
+        "start", "Single-step the process from now on, recording each "
+                 "instruction");
+    CLI::Option* mySizeOpt =
+        start_cmd->add_option("--size", "Megabytes of history to keep")
+            ->default_val("64")
+            ->capture_default_str();
+    auto stop_cmd =
+        record_cmd->add_subcommand("stop", "Stop recording and forget it");
+    auto status_cmd = record_cmd->add_subcommand(
+        "status", "Show how much is recorded and how fast");
+
+    start_cmd->callback([=, &aTarget]() {
+        auto myMegabytes =
+            sdb::toIntegral<std::size_t>(mySizeOpt->as<std::string>());
+        if (!myMegabytes or *myMegabytes == 0) {
+            fmt::print(stderr, "Size must be a positive number\n");
+            return;
+        }
+
+        try {
+            aTarget.getProcess().startRecording(*myMegabytes << 20);
+        } catch (const sdb::Error& anError) {
+            fmt::print(stderr, "{}\n", anError.what());
+        }
+    });
+
+    stop_cmd->callback(
+        [&aTarget]() { aTarget.getProcess().stopRecording(); });
+
+    status_cmd->callback([&aTarget]() {
+        auto* myRecorder = aTarget.getProcess().getRecorder();
+        if (!myRecorder) {
+            fmt::print("Not recording\n");
+            return;
+        }
+
+        std::chrono::duration<double> myTime =
+            myRecorder->getRecordingTime();
+        auto myNumRecorded = myRecorder->getNumRecorded();
+        fmt::print("{} instructions recorded at {:.0f} instructions/s, {:.1f} "
+                   "bytes/instruction\n",
+                   myNumRecorded,
+                   myTime.count() > 0 ? myNumRecorded / myTime.count() : 0.0,
+                   myNumRecorded ? static_cast<double>(
+                                       myRecorder->getBytesRecorded()) /
+                                       myNumRecorded
+                                 : 0.0);
+        fmt::print("{} instructions can be undone, using {:.1f} of {} MB; "
+                   "{} dropped\n",
+                   myRecorder->getNumRecords(),
+                   myRecorder->getUsed() / double(1 << 20),
+                   myRecorder->getCapacity() >> 20,
+                   myRecorder->getNumDropped());
+    });
+
+    auto reverse_step_cmd = aRepl.add_subcommand(
+        "reverse-stepi", "Undo the last recorded instruction");
+    reverse_step_cmd->alias("rsi");
+    reverse_step_cmd->callback([&aTarget, &aDisassembler]() {
+        try {
+            auto myStopReason =
+                aTarget.getProcess().reverseStepInstruction();
+            handle_stop(aTarget, myStopReason, aDisassembler);
+        } catch (const sdb::Error& anError) {
+            fmt::print(stderr, "{}\n", anError.what());
+        }
+    });
+
+    auto reverse_continue_cmd = aRepl.add_subcommand(
+        "reverse-continue",
+        "Undo recorded instructions back to the previous breakpoint");
+    reverse_continue_cmd->alias("rc");
+    reverse_continue_cmd->callback([&aTarget, &aDisassembler]() {
+        try {
+            auto& myProcess = aTarget.getProcess();
+            auto myStopReason = myProcess.reverseContinue();
+            if (myProcess.getRecorder()->getNumRecords() == 0) {
+                fmt::print("Reached the start of the recording\n");
+            }
+            handle_stop(aTarget, myStopReason, aDisassembler);
+        } catch (const sdb::Error& anError) {
+            fmt::print(stderr, "{}\n", anError.what());
+        }
+    });
+}
+
+void add_syscall_log(CLI::App& aRepl, sdb::Target& aTarget) {
+    auto record_cmd = aRepl.add_subcommand(
+        "record-syscalls",
+        "Log the results of system calls a run cannot repeat to a file");
+    CLI::Option* myRecordOpt = record_cmd->add_option("file")->required();
+    auto replay_cmd = aRepl.add_subcommand(
+        "replay-syscalls",
+        "Return the logged results instead of making the system calls");
+    CLI::Option* myReplayOpt = replay_cmd->add_option("file")->required();
+    auto log_cmd =
+        aRepl.add_subcommand("syscall-log", "Recorded system call log");
+    auto stop_cmd = log_cmd->add_subcommand(
+        "stop", "Close the log and run calls as they are");
+    auto status_cmd =
+        log_cmd->add_subcommand("status", "Show how much is logged");
+
+    record_cmd->callback([=, &aTarget]() {
+        try {
+            aTarget.getProcess().recordSyscalls(
+                myRecordOpt->as<std::string>());
+        } catch (const sdb::Error& anError) {
+            fmt::print(stderr, "{}\n", anError.what());
+        }
+    });
+
+    replay_cmd->callback([=, &aTarget]() {
+        try {
+            aTarget.getProcess().replaySyscalls(
+                myReplayOpt->as<std::string>());
+            fmt::print("Replaying {} system calls\n",
+                       aTarget.getProcess()
+                           .getSyscallRecorder()
+                           ->getNumRemaining());
+        } catch (const sdb::Error& anError) {
+            fmt::print(stderr, "{}\n", anError.what());
+        }
+    });
+
+    stop_cmd->callback(
+        [&aTarget]() { aTarget.getProcess().stopSyscallLog(); });
+
+    status_cmd->callback([&aTarget]() {
+        auto* myLog = aTarget.getProcess().getSyscallRecorder();
+        if (!myLog) {
+            fmt::print("No system call log\n");
+            return;
+        }
+
+        bool myIsRecording =
+            myLog->getMode() == sdb::SyscallRecorder::Mode::Record;
+        fmt::print("{} {}: {} calls, {} bytes of output{}\n",
+                   myIsRecording ? "Recording to" : "Replaying",
+                   myLog->getPath().string(), myLog->getNumCalls(),
+                   myLog->getNumBytes(),
+                   myLog->isVdsoHidden() ? ", vDSO hidden" : "");
+        if (!myIsRecording) {
+            fmt::print("{} calls left\n", myLog->getNumRemaining());
+        }
+        if (auto myDivergence = myLog->getDivergence()) {
+            fmt::print("Diverged: {}\n", *myDivergence);
+        }
+    });
+}
+
+void printStartupTime(const sdb::Target& aTarget,
+                      std::chrono::steady_clock::time_point aStartTime) {
+    using std::chrono::duration;
+    using std::chrono::steady_clock;
+
+    duration<double, std::milli> myStartup = steady_clock::now() - aStartTime;
+    duration<double, std::milli> myIndex = aTarget.getIndexLoadTime();
+
+    if (aTarget.isIndexFromCache()) {
+        fmt::print("Ready in {:.1f} ms (index mapped from cache in {:.1f} "
+                   "ms)\n",
+                   myStartup.count(), myIndex.count());
+    } else {
+        fmt::print("Ready in {:.1f} ms (indexing {} compile units in the "
+                   "background)\n",
+                   myStartup.count(),
+                   aTarget.getDwarf().getIndexProgress().theUnitsTotal);
+    }
+}
+
+// By name, with or without SIG, or by number
+std::optional<int> parse_signal(std::string_view aName) {
+    if (aName.starts_with("SIG")) {
+        aName.remove_prefix(3);
+    }
+    for (int mySignal = 1; mySignal < NSIG; ++mySignal) {
+        if (auto* myName = sigabbrev_np(mySignal); myName and aName == myName) {
+            return mySignal;
+        }
+    }
+
+    auto mySignal = sdb::toIntegral<int>(aName);
+    if (mySignal and *mySignal > 0 and *mySignal < NSIG) {
+        return mySignal;
+    }
+    return std::nullopt;
+}
+
+std::string get_signal_name(int aSignal) {
+    auto* myName = sigabbrev_np(aSignal);
+    return myName ? fmt::format("SIG{}", myName) : fmt::format("{}", aSignal);
+}
+
+void add_handle(CLI::App& aRepl, sdb::Process& aProcess) {
+    auto handle_cmd = aRepl.add_subcommand(
+        "handle", "Set what a signal does with stop|nostop, pass|nopass and "
+                  "print|noprint, or list the signals");
+    CLI::Option* mySignalOpt = handle_cmd->add_option("signal");
+    CLI::Option* myActionsOpt =
+        handle_cmd->add_option("actions")->expected(-1);
+
+    handle_cmd->callback([=, &aProcess]() {
+        auto myPrintRow = [&](int aSignal) {
+            auto& myPolicy = aProcess.getSignalPolicy(aSignal);
+            fmt::print("{:<10} {:<5} {:<5} {:<6} {}\n",
+                       get_signal_name(aSignal),
+                       myPolicy.theStop ? "Yes" : "No",
+                       myPolicy.thePrint ? "Yes" : "No",
+                       myPolicy.thePass ? "Yes" : "No",
+                       aProcess.getSignalCount(aSignal));
+        };
+        auto myHeader = [] {
+            fmt::print("{:<10} {:<5} {:<5} {:<6} {}\n", "Signal", "Stop",
+                       "Print", "Pass", "Count");
+        };
+
+        // Every named signal, and others once they are set or received
+        if (mySignalOpt->count() == 0) {
+            myHeader();
+            for (int mySignal = 1; mySignal < NSIG; ++mySignal) {
+                if (sigabbrev_np(mySignal) or
+                    aProcess.getSignalCount(mySignal) > 0 or
+                    aProcess.getSignalPolicy(mySignal) !=
+                        sdb::SignalPolicy{}) {
+                    myPrintRow(mySignal);
+                }
+            }
+            return;
+        }
+
+        auto mySignal = parse_signal(mySignalOpt->as<std::string>());
+        if (!mySignal) {
+            fmt::print(stderr, "Unknown signal {}\n",
+                       mySignalOpt->as<std::string>());
+            return;
+        }
+
+        // As in gdb, a signal that stops is printed, and one that is not
+        // printed does not stop
+        auto myPolicy = aProcess.getSignalPolicy(*mySignal);
+        for (auto& myAction :
+             myActionsOpt->as<std::vector<std::string>>()) {
+            if (myAction == "stop") {
+                myPolicy.theStop = myPolicy.thePrint = true;
+            } else if (myAction == "nostop") {
+                myPolicy.theStop = false;
+            } else if (myAction == "print") {
+                myPolicy.thePrint = true;
+            } else if (myAction == "noprint") {
+                myPolicy.theStop = myPolicy.thePrint = false;
+            } else if (myAction == "pass") {
+                myPolicy.thePass = true;
+            } else if (myAction == "nopass") {
+                myPolicy.thePass = false;
+            } else {
+                fmt::print(stderr, "Unknown action {}\n", myAction);
+                return;
+            }
+        }
+
+        try {
+            aProcess.setSignalPolicy(*mySignal, myPolicy);
+        } catch (const sdb::Error& anError) {
+            fmt::print(stderr, "{}\n", anError.what());
+            return;
+        }
+        myHeader();
+        myPrintRow(*mySignal);
+    });
+}
+
+void readInput(sdb::Target& aTarget,
+               std::chrono::steady_clock::time_point aStartTime) {
     CLI::App myRepl;
 
-    sdb::Disassembler myDisassembler(*aProcess);
+    auto& myProcess = aTarget.getProcess();
+    sdb::Disassembler myDisassembler(myProcess);
+    myProcess.setSignalHandler([&myProcess](int aSignal) {
+        fmt::print("Process {} received signal {}\n", myProcess.getPid(),
+                   get_signal_name(aSignal));
+    });
 
-    add_continue(myRepl, *aProcess, myDisassembler);
-    add_step(myRepl, *aProcess, myDisassembler);
+    add_continue(myRepl, aTarget, myDisassembler);
+    add_step(myRepl, aTarget, myDisassembler);
+    add_source_step(myRepl, aTarget, myDisassembler);
+    add_backtrace(myRepl, aTarget);
+    add_call(myRepl, aTarget);
+    add_profile(myRepl, aTarget, myDisassembler);
+    add_syscall_profile(myRepl, aTarget, myDisassembler);
+    add_lock_profile(myRepl, aTarget, myDisassembler);
+    add_heap_profile(myRepl, aTarget);
+    add_heap(myRepl, aTarget);
+    add_checkpoint(myRepl, aTarget, myDisassembler);
+    add_record(myRepl, aTarget, myDisassembler);
+    add_syscall_log(myRepl, aTarget);
+    add_handle(myRepl, myProcess);
 
     myRepl.add_subcommand("reg", "Register operations");
-    add_reg_reading(myRepl, *aProcess);
-    add_reg_writing(myRepl, *aProcess);
+    add_reg_reading(myRepl, myProcess);
+    add_reg_writing(myRepl, myProcess);
 
-    add_breakpoint_operations(myRepl, *aProcess);
-    add_memory_commands(myRepl, *aProcess);
+    add_breakpoint_operations(myRepl, aTarget);
+    add_memory_commands(myRepl, myProcess);
+    add_debug_info_commands(myRepl, aTarget);
+    add_trace_commands(myRepl, aTarget);
+
+    printStartupTime(aTarget, aStartTime);
 
     char* myLine = nullptr;
     while ((myLine = readline("sdb> ")) != nullptr) {
@@ -173,6 +1177,8 @@ void readInput(std::unique_ptr<sdb::Process>& aProcess) {
 }
 
 int main(int argc, char** argv) {
+    auto myStartTime = std::chrono::steady_clock::now();
+
     CLI::App mySdb{"Debugger!"};
 
     pid_t myPid{};
@@ -192,14 +1198,15 @@ int main(int argc, char** argv) {
         return mySdb.exit(e);
     }
 
-    std::unique_ptr<sdb::Process> myProcess;
+    std::unique_ptr<sdb::Target> myTarget;
 
     if (myPidOpt->count() > 0) {
-        myProcess = sdb::Process::attach(myPid);
-        readInput(myProcess);
+        myTarget = sdb::Target::attach(myPid);
+        readInput(*myTarget, myStartTime);
     } else if (myFileOpt->count() > 0) {
-        myProcess = sdb::Process::launch(myFilename);
-        fmt::print("Launched process with PID {}\n", myProcess->getPid());
-        readInput(myProcess);
+        myTarget = sdb::Target::launch(myFilename);
+        fmt::print("Launched process with PID {}\n",
+                   myTarget->getProcess().getPid());
+        readInput(*myTarget, myStartTime);
     }
 }
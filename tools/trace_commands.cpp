@@ -0,0 +1,332 @@
+#include <trace_commands.hpp>
+
+#include <breakpoint_operations.hpp>
+#include <chrono>
+#include <cstdio>
+#include <fmt/format.h>
+#include <fmt/ranges.h>
+#include <fstream>
+#include <function_tracer.hpp>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <target.hpp>
+#include <tracepoint.hpp>
+#include <vector>
+
+namespace sdb {
+    namespace {
+        void print_records(const std::vector<sdb::Tracepoint>& aTracepoints,
+                           const sdb::TraceBuffer& aBuffer,
+                           const std::string& aFormat) {
+            std::optional<std::uint64_t> myFirstTime;
+            std::size_t myIndex = 0;
+            aBuffer.forEach([&](const sdb::TraceRecordHeader& aHeader,
+                                std::span<const std::byte> aPayload) {
+                if (!myFirstTime) {
+                    myFirstTime = aHeader.theTimestamp;
+                }
+
+                auto myTracepoint = std::ranges::find(
+                    aTracepoints, aHeader.theTracepoint,
+                    &sdb::Tracepoint::theId);
+                if (myTracepoint == aTracepoints.end()) {
+                    return;
+                }
+
+                fmt::print("{:>6} +{:.6f}s tracepoint {}: {}\n", myIndex++,
+                           (aHeader.theTimestamp - *myFirstTime) / 1e9,
+                           aHeader.theTracepoint,
+                           sdb::formatTraceRecord(*myTracepoint, aPayload,
+                                                  aFormat));
+            });
+
+            if (aBuffer.getNumDropped() > 0) {
+                fmt::print("{} earlier records were dropped\n",
+                           aBuffer.getNumDropped());
+            }
+        }
+
+        void add_trace_function(CLI::App& aTraceCommand,
+                                sdb::Target& aTarget) {
+            auto function_cmd = aTraceCommand.add_subcommand(
+                "function", "Time calls to functions without stopping, or "
+                            "print the latencies so far");
+            CLI::Option* myNamesOpt =
+                function_cmd->add_option("functions")->expected(-1);
+            CLI::Option* myChromeOpt = function_cmd->add_option(
+                "--chrome", "File for the calls as a Chrome trace");
+
+            function_cmd->callback([=, &aTarget]() {
+                auto& myTracer = aTarget.getFunctionTracer();
+                for (auto& myName :
+                     myNamesOpt->as<std::vector<std::string>>()) {
+                    auto myEntries = aTarget.findSymbolAddresses(myName);
+                    if (myEntries.empty()) {
+                        fmt::print(stderr, "Could not find {}\n", myName);
+                        continue;
+                    }
+
+                    for (auto myEntry : myEntries) {
+                        try {
+                            myTracer.add(myName, myEntry);
+                            fmt::print("Tracing {} at {:#x}\n", myName,
+                                       std::to_underlying(myEntry));
+                        } catch (const sdb::Error& anError) {
+                            fmt::print(stderr, "{}\n", anError.what());
+                        }
+                    }
+                }
+                if (myNamesOpt->count() > 0 and myChromeOpt->count() == 0) {
+                    return;
+                }
+
+                if (myChromeOpt->count() > 0) {
+                    std::ofstream myFile{myChromeOpt->as<std::string>()};
+                    if (!myFile) {
+                        fmt::print(stderr, "Could not open {}\n",
+                                   myChromeOpt->as<std::string>());
+                        return;
+                    }
+                    myTracer.writeChromeTrace(myFile);
+                    fmt::print("Wrote {} calls to {}\n",
+                               myTracer.getCalls().size(),
+                               myChromeOpt->as<std::string>());
+                    return;
+                }
+
+                myTracer.writeTable(std::cout);
+                std::cout.flush();
+
+                auto& myOverhead = myTracer.getOverhead();
+                if (myOverhead.getCount() > 0) {
+                    fmt::print("Hit to resume {} p50, {} p99, {} max\n",
+                               sdb::formatLatency(myOverhead.getQuantile(0.5)),
+                               sdb::formatLatency(
+                                   myOverhead.getQuantile(0.99)),
+                               sdb::formatLatency(myOverhead.getMax()));
+                }
+                if (myTracer.getNumDroppedCalls() > 0) {
+                    fmt::print("{} calls left out of the timeline\n",
+                               myTracer.getNumDroppedCalls());
+                }
+            });
+        }
+
+        void add_trace_plt(CLI::App& aTraceCommand, sdb::Target& aTarget) {
+            auto plt_cmd = aTraceCommand.add_subcommand(
+                "plt", "Time calls through the PLT to functions matching "
+                       "globs, such as mem*; trace function shows them");
+            CLI::Option* myIncludeOpt =
+                plt_cmd->add_option("-i,--include", "Functions to trace")
+                    ->expected(-1);
+            CLI::Option* myExcludeOpt =
+                plt_cmd->add_option("-e,--exclude", "Functions to skip")
+                    ->expected(-1);
+            CLI::Option* myLibrariesOpt = plt_cmd->add_flag(
+                "--libraries", "Also trace the PLT of loaded libraries");
+
+            plt_cmd->callback([=, &aTarget]() {
+                std::vector<std::string> myIncludes;
+                if (myIncludeOpt->count() > 0) {
+                    myIncludes = myIncludeOpt->as<std::vector<std::string>>();
+                }
+                std::vector<std::string> myExcludes;
+                if (myExcludeOpt->count() > 0) {
+                    myExcludes = myExcludeOpt->as<std::vector<std::string>>();
+                }
+
+                auto myStubs = aTarget.findPltStubs(
+                    myIncludes, myExcludes, myLibrariesOpt->count() > 0);
+                if (myStubs.empty()) {
+                    fmt::print(stderr, "No PLT stubs match\n");
+                    return;
+                }
+
+                auto myNumAdded =
+                    aTarget.getFunctionTracer().addAll(myStubs);
+                fmt::print("Tracing {} PLT stubs", myNumAdded);
+                if (myNumAdded < myStubs.size()) {
+                    fmt::print(", {} already had breakpoints",
+                               myStubs.size() - myNumAdded);
+                }
+                fmt::print("\n");
+            });
+        }
+
+        void add_trace(CLI::App& aRepl, sdb::Target& aTarget) {
+            auto trace_cmd = aRepl.add_subcommand(
+                "trace", "Set a tracepoint that collects registers and "
+                         "memory, such as rdi or [rdi, 64], without stopping");
+
+            CLI::Option* myLocationOpt = trace_cmd->add_option("location")
+                                             ->capture_default_str();
+            CLI::Option* myCapturesOpt =
+                trace_cmd->add_option("captures")->expected(-1);
+            CLI::Option* myFastOpt = trace_cmd->add_flag(
+                "--fast", "Collect registers with a trampoline patched into "
+                          "the process instead of stopping it");
+
+            add_trace_function(*trace_cmd, aTarget);
+            add_trace_plt(*trace_cmd, aTarget);
+
+            trace_cmd->callback([=, &aTarget]() {
+                if (!trace_cmd->get_subcommands().empty()) {
+                    return;
+                }
+                if (myLocationOpt->count() == 0) {
+                    fmt::print(stderr, "A location is required\n");
+                    return;
+                }
+
+                std::vector<sdb::TraceCapture> myCaptures;
+                if (myCapturesOpt->count() > 0) {
+                    for (auto& mySpec :
+                         myCapturesOpt->as<std::vector<std::string>>()) {
+                        auto myCapture = sdb::TraceCapture::parse(mySpec);
+                        if (!myCapture) {
+                            fmt::print(stderr,
+                                       "Captures are a 64 bit register or "
+                                       "[register+offset, size] or "
+                                       "[address, size], not {}\n",
+                                       mySpec);
+                            return;
+                        }
+                        myCaptures.push_back(std::move(*myCapture));
+                    }
+                }
+
+                auto myAddresses = sdb::resolve_breakpoint_location(
+                    aTarget, myLocationOpt->as<std::string>());
+                if (myAddresses.empty()) {
+                    fmt::print(stderr, "Could not find {}\n",
+                               myLocationOpt->as<std::string>());
+                    return;
+                }
+
+                for (auto myAddr : myAddresses) {
+                    try {
+                        auto& myTracer = aTarget.getTracer();
+                        auto& myTracepoint =
+                            myFastOpt->count() > 0
+                                ? myTracer.addFast(myAddr, myCaptures)
+                                : myTracer.add(myAddr, myCaptures);
+                        fmt::print("Set {}tracepoint {} at {:#x}\n",
+                                   myTracepoint.theIsFast ? "fast " : "",
+                                   myTracepoint.theId,
+                                   std::to_underlying(myAddr));
+                    } catch (const sdb::Error& anError) {
+                        fmt::print(stderr, "{}\n", anError.what());
+                    }
+                }
+            });
+        }
+
+        void add_trace_status(CLI::App& aRepl, sdb::Target& aTarget) {
+            auto tstatus_cmd = aRepl.add_subcommand(
+                "tstatus", "Show tracepoint hits, drops and latency");
+
+            tstatus_cmd->callback([&aTarget]() {
+                auto& myTracer = aTarget.getTracer();
+                myTracer.collect();
+                auto& myBuffer = myTracer.getBuffer();
+
+                std::uint64_t myHits = 0;
+                for (auto& myTracepoint : myTracer.getTracepoints()) {
+                    std::vector<std::string_view> mySpecs;
+                    for (auto& myCapture : myTracepoint->theCaptures) {
+                        mySpecs.push_back(myCapture.theSpec);
+                    }
+                    fmt::print(
+                        "{}: address = {:#x}, {} hits, collects {}{}\n",
+                        myTracepoint->theId,
+                        std::to_underlying(myTracepoint->theAddress),
+                        myTracepoint->theNumHits, fmt::join(mySpecs, " "),
+                        myTracepoint->theIsFast ? " (fast)" : "");
+                    myHits += myTracepoint->theNumHits;
+                }
+
+                fmt::print("{} hits, {} records buffered, {} dropped; "
+                           "{}/{} buffer bytes used\n",
+                           myHits, myBuffer.getNumRecords(),
+                           myBuffer.getNumDropped(), myBuffer.getUsed(),
+                           myBuffer.getCapacity());
+
+                using std::chrono::duration;
+                if (myTracer.getNumResumes() > 0) {
+                    duration<double, std::micro> myTotal =
+                        myTracer.getTotalLatency();
+                    duration<double, std::micro> myMax =
+                        myTracer.getMaxLatency();
+                    fmt::print("Hit to resume {:.1f} us average, {:.1f} us "
+                               "max\n",
+                               myTotal.count() / myTracer.getNumResumes(),
+                               myMax.count());
+                }
+            });
+        }
+
+        void add_trace_save(CLI::App& aRepl, sdb::Target& aTarget) {
+            auto tsave_cmd = aRepl.add_subcommand(
+                "tsave", "Save the tracepoints and buffered records to a file");
+
+            CLI::Option* myPathOpt = tsave_cmd->add_option("file")
+                                         ->required()
+                                         ->capture_default_str();
+
+            tsave_cmd->callback([=, &aTarget]() {
+                try {
+                    aTarget.getTracer().collect();
+                    aTarget.getTracer().save(myPathOpt->as<std::string>());
+                } catch (const sdb::Error& anError) {
+                    fmt::print(stderr, "{}\n", anError.what());
+                }
+            });
+        }
+
+        void add_trace_view(CLI::App& aRepl, sdb::Target& aTarget) {
+            auto tview_cmd = aRepl.add_subcommand(
+                "tview", "Print buffered records, or those of a saved trace");
+
+            CLI::Option* myPathOpt = tview_cmd->add_option("file");
+            CLI::Option* myFormatOpt = tview_cmd->add_option(
+                "-f,--format", "printf-style format taking one capture per "
+                               "%d, %u, %x, %s or %b");
+
+            tview_cmd->callback([=, &aTarget]() {
+                std::string myFormat;
+                if (myFormatOpt->count() > 0) {
+                    myFormat = myFormatOpt->as<std::string>();
+                }
+
+                if (myPathOpt->count() == 0) {
+                    aTarget.getTracer().collect();
+                    std::vector<sdb::Tracepoint> myTracepoints;
+                    for (auto& myTracepoint :
+                         aTarget.getTracer().getTracepoints()) {
+                        myTracepoints.push_back(*myTracepoint);
+                    }
+                    print_records(myTracepoints,
+                                  aTarget.getTracer().getBuffer(), myFormat);
+                    return;
+                }
+
+                try {
+                    auto myTrace = sdb::loadTrace(myPathOpt->as<std::string>());
+                    print_records(myTrace.theTracepoints, myTrace.theBuffer,
+                                  myFormat);
+                } catch (const sdb::Error& anError) {
+                    fmt::print(stderr, "{}\n", anError.what());
+                }
+            });
+        }
+    } // namespace
+
+    void add_trace_commands(CLI::App& aRepl, sdb::Target& aTarget) {
+        add_trace(aRepl, aTarget);
+        add_trace_status(aRepl, aTarget);
+        add_trace_save(aRepl, aTarget);
+        add_trace_view(aRepl, aTarget);
+    }
+
+} // namespace sdb
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <CLI/CLI.hpp>
+#include <target.hpp>
+
+namespace sdb {
+    void add_trace_commands(CLI::App& aRepl, sdb::Target& aTarget);
+} // namespace sdb